@@ -17,8 +17,16 @@
 
 TEST_PATH=tests/$(TEST)
 
+# see build_keyboard.mk
+ifeq ($(strip $(DYNAMIC_KEYMAP_ENABLE)), yes)
+    OPT_DEFS += -DKEYMAP_C=\"$(TEST_PATH)/keymap.c\"
+    TEST_KEYMAP_SRC := $(QUANTUM_DIR)/keymap_introspection.c
+else
+    TEST_KEYMAP_SRC := $(TEST_PATH)/keymap.c
+endif
+
 $(TEST)_SRC= \
-	$(TEST_PATH)/keymap.c \
+	$(TEST_KEYMAP_SRC) \
 	$(TMK_COMMON_SRC) \
 	$(QUANTUM_SRC) \
 	$(SRC) \
@@ -224,9 +224,18 @@ ifneq ("$(wildcard $(KEYMAP_PATH)/config.h)","")
     CONFIG_H += $(KEYMAP_PATH)/config.h
 endif
 
+# The dynamic keymap needs the size of keymaps[], so the keymap is built
+# through keymap_introspection.c, which includes it
+ifeq ($(strip $(DYNAMIC_KEYMAP_ENABLE)), yes)
+    OPT_DEFS += -DKEYMAP_C=\"$(KEYMAP_C)\"
+    KEYMAP_SRC := $(QUANTUM_DIR)/keymap_introspection.c
+else
+    KEYMAP_SRC := $(KEYMAP_C)
+endif
+
 # # project specific files
 SRC += $(KEYBOARD_SRC) \
-    $(KEYMAP_C) \
+    $(KEYMAP_SRC) \
     $(QUANTUM_SRC)
 
 # Optimize size but this may cause error "relocation truncated to fit"
@@ -74,6 +74,11 @@ ifeq ($(strip $(FAUXCLICKY_ENABLE)), yes)
     SRC += $(QUANTUM_DIR)/fauxclicky.c
 endif
 
+ifeq ($(strip $(DYNAMIC_KEYMAP_ENABLE)), yes)
+	OPT_DEFS += -DDYNAMIC_KEYMAP_ENABLE
+	SRC += $(QUANTUM_DIR)/dynamic_keymap.c
+endif
+
 ifeq ($(strip $(POINTING_DEVICE_ENABLE)), yes)
 	OPT_DEFS += -DPOINTING_DEVICE_ENABLE
 	OPT_DEFS += -DMOUSE_ENABLE
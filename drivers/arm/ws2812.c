@@ -0,0 +1,193 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch.h"
+#include "hal.h"
+#include "ws2812.h"
+
+/* The defaults are TIM2 channel 2 on an STM32F303, with the data pin on
+ * A1 (AF1). The DMA stream has to be the one serving the update event of
+ * the timer, see the DMA request mapping in the reference manual.
+ */
+#ifndef WS2812_PWM_DRIVER
+#define WS2812_PWM_DRIVER PWMD2
+#endif
+#ifndef WS2812_PWM_CHANNEL
+#define WS2812_PWM_CHANNEL 2
+#endif
+#ifndef WS2812_PWM_PAL_MODE
+#define WS2812_PWM_PAL_MODE 1
+#endif
+#ifndef WS2812_DMA_STREAM
+#define WS2812_DMA_STREAM STM32_DMA1_STREAM2
+#endif
+#ifndef RGB_DI_PIN
+#define RGB_DI_PIN PAL_LINE(GPIOA, 1U)
+#endif
+
+// Low time at the end of every frame, 280us is enough for current WS2812B
+#ifndef WS2812_TRST_US
+#define WS2812_TRST_US 280
+#endif
+
+#if WS2812_PWM_CHANNEL < 1 || WS2812_PWM_CHANNEL > 4
+#error "WS2812_PWM_CHANNEL must be between 1 and 4"
+#endif
+
+// Timer ticks, the frequency has to divide the timer clock
+#define WS2812_PWM_FREQUENCY 8000000
+#define WS2812_PWM_PERIOD    (WS2812_PWM_FREQUENCY / 800000)
+#define WS2812_DUTY_0        ((WS2812_PWM_FREQUENCY / 1000 * 350 + 500000) / 1000000)
+#define WS2812_DUTY_1        ((WS2812_PWM_FREQUENCY / 1000 * 900 + 500000) / 1000000)
+
+#ifdef RGBW
+#define WS2812_COLOR_BITS 32
+#else
+#define WS2812_COLOR_BITS 24
+#endif
+
+#define WS2812_RESET_BIT_N (WS2812_TRST_US * 1000 / 1250)
+#define WS2812_BIT_N       (RGBLED_NUM * WS2812_COLOR_BITS)
+#define WS2812_BUFFER_SIZE (WS2812_BIT_N + WS2812_RESET_BIT_N)
+
+// One duty cycle per bit, followed by the reset time at zero duty. The DMA
+// streams one of them while the next frame is written into the other.
+static uint16_t ws2812_frame_buffer[2][WS2812_BUFFER_SIZE];
+// The one being streamed, or the last one streamed
+static uint8_t ws2812_front = 0;
+// Set once a complete frame is waiting in the back buffer
+static bool ws2812_pending = false;
+static bool ws2812_busy = false;
+static bool ws2812_initialized = false;
+
+static const PWMConfig ws2812_pwm_config = {
+    .frequency = WS2812_PWM_FREQUENCY,
+    .period    = WS2812_PWM_PERIOD,
+    .callback  = NULL,
+    .channels  = {
+        [WS2812_PWM_CHANNEL - 1] = { .mode = PWM_OUTPUT_ACTIVE_HIGH, .callback = NULL },
+    },
+    .cr2  = 0,
+    // Each update event requests the duty cycle of the next bit
+    .dier = STM32_TIM_DIER_UDE,
+};
+
+// Swaps in the back buffer and streams it once. Called locked.
+static void ws2812_start_frame(void) {
+    ws2812_front ^= 1;
+    ws2812_pending = false;
+    ws2812_busy = true;
+
+    dmaStreamDisable(WS2812_DMA_STREAM);
+    dmaStreamSetMemory0(WS2812_DMA_STREAM, ws2812_frame_buffer[ws2812_front]);
+    dmaStreamSetTransactionSize(WS2812_DMA_STREAM, WS2812_BUFFER_SIZE);
+    dmaStreamSetMode(WS2812_DMA_STREAM,
+#ifdef WS2812_DMA_CHANNEL
+                     STM32_DMA_CR_CHSEL(WS2812_DMA_CHANNEL) |
+#endif
+                     STM32_DMA_CR_DIR_M2P | STM32_DMA_CR_PSIZE_HWORD | STM32_DMA_CR_MSIZE_HWORD |
+                     STM32_DMA_CR_MINC | STM32_DMA_CR_PL(3) | STM32_DMA_CR_TCIE);
+    dmaStreamEnable(WS2812_DMA_STREAM);
+}
+
+// The last duty cycle read is a reset one, so the line stays low until the
+// next frame
+static void ws2812_dma_end(void *param, uint32_t flags) {
+    (void)param;
+    (void)flags;
+
+    chSysLockFromISR();
+    if (ws2812_pending) {
+        ws2812_start_frame();
+    } else {
+        dmaStreamDisable(WS2812_DMA_STREAM);
+        ws2812_busy = false;
+    }
+    chSysUnlockFromISR();
+}
+
+void ws2812_init(void) {
+    for (uint8_t b = 0; b < 2; b++) {
+        for (uint16_t i = 0; i < WS2812_BIT_N; i++) {
+            ws2812_frame_buffer[b][i] = WS2812_DUTY_0;
+        }
+        for (uint16_t i = WS2812_BIT_N; i < WS2812_BUFFER_SIZE; i++) {
+            ws2812_frame_buffer[b][i] = 0;
+        }
+    }
+
+    palSetLineMode(RGB_DI_PIN, PAL_MODE_ALTERNATE(WS2812_PWM_PAL_MODE));
+
+    dmaStreamAllocate(WS2812_DMA_STREAM, 10, ws2812_dma_end, NULL);
+    dmaStreamSetPeripheral(WS2812_DMA_STREAM, &(WS2812_PWM_DRIVER.tim->CCR[WS2812_PWM_CHANNEL - 1]));
+
+    pwmStart(&WS2812_PWM_DRIVER, &ws2812_pwm_config);
+    pwmEnableChannel(&WS2812_PWM_DRIVER, WS2812_PWM_CHANNEL - 1, 0);
+
+    chSysLock();
+    ws2812_start_frame();
+    chSysUnlock();
+
+    ws2812_initialized = true;
+}
+
+// Writes the bits of the GRB(W) bytes, MSB first, into the back buffer,
+// which is streamed as soon as the current frame is out. A frame that is
+// still waiting is replaced.
+static void ws2812_write_frame(LED_TYPE *ledarray, uint16_t number_of_leds) {
+    if (!ws2812_initialized) {
+        ws2812_init();
+    }
+    if (number_of_leds > RGBLED_NUM) {
+        number_of_leds = RGBLED_NUM;
+    }
+
+    // Keeps the interrupt from swapping in a half written buffer, and so
+    // the front buffer from changing until the frame is complete
+    chSysLock();
+    ws2812_pending = false;
+    chSysUnlock();
+    uint16_t *back = ws2812_frame_buffer[ws2812_front ^ 1];
+    const uint16_t *front = ws2812_frame_buffer[ws2812_front];
+
+    const uint8_t *data = (const uint8_t *)ledarray;
+    uint16_t bit = 0;
+    for (uint16_t i = 0; i < number_of_leds * (WS2812_COLOR_BITS / 8); i++) {
+        uint8_t byte = data[i];
+        for (uint8_t mask = 0x80; mask; mask >>= 1) {
+            back[bit++] = (byte & mask) ? WS2812_DUTY_1 : WS2812_DUTY_0;
+        }
+    }
+    // LEDs that were left out keep their color
+    for (; bit < WS2812_BIT_N; bit++) {
+        back[bit] = front[bit];
+    }
+
+    chSysLock();
+    ws2812_pending = true;
+    if (!ws2812_busy) {
+        ws2812_start_frame();
+    }
+    chSysUnlock();
+}
+
+void ws2812_setleds(LED_TYPE *ledarray, uint16_t number_of_leds) {
+    ws2812_write_frame(ledarray, number_of_leds);
+}
+
+void ws2812_setleds_rgbw(LED_TYPE *ledarray, uint16_t number_of_leds) {
+    ws2812_write_frame(ledarray, number_of_leds);
+}
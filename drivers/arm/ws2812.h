@@ -0,0 +1,36 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WS2812_H
+#define WS2812_H
+
+#include <stdint.h>
+#include "rgblight_types.h"
+
+/* WS2812 driver for STM32 ChibiOS boards
+ *
+ * A timer channel generates the bitstream as PWM, one period per bit, and a
+ * DMA stream reloads the duty cycle from a frame buffer on every update
+ * event. Setting the LEDs writes the other of two frame buffers, which the
+ * DMA interrupt swaps in once the current frame is out, so a frame never
+ * changes while it is being sent.
+ */
+
+void ws2812_init(void);
+void ws2812_setleds(LED_TYPE *ledarray, uint16_t number_of_leds);
+void ws2812_setleds_rgbw(LED_TYPE *ledarray, uint16_t number_of_leds);
+
+#endif
@@ -8,6 +8,14 @@
 #include "i2c_master.h"
 #include "timer.h"
 
+#ifdef I2C_ASYNC
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "spsc_queue.h"
+
+static i2c_status_t i2c_queue_drain(uint16_t timeout);
+#endif
+
 #define F_SCL 400000UL // SCL frequency
 #define Prescaler 1
 #define TWBR_val ((((F_CPU / F_SCL) / Prescaler) - 16 ) / 2)
@@ -20,6 +28,10 @@ void i2c_init(void)
 
 i2c_status_t i2c_start(uint8_t address, uint16_t timeout)
 {
+#ifdef I2C_ASYNC
+  // don't interrupt a queued transfer
+  if (i2c_queue_drain(timeout)) return I2C_STATUS_TIMEOUT;
+#endif
   // reset TWI control register
   TWCR = 0;
   // transmit START condition
@@ -215,4 +227,145 @@ i2c_status_t i2c_stop(uint16_t timeout)
   }
 
   return I2C_STATUS_SUCCESS;
-}
\ No newline at end of file
+}
+
+#ifdef I2C_ASYNC
+#if !SPSC_QUEUE_SIZE_VALID(I2C_ASYNC_QUEUE_SIZE)
+#error "I2C_ASYNC_QUEUE_SIZE must be a power of two between 2 and 128"
+#endif
+
+// Every transfer is queued as the address, the length and then the data
+static uint8_t i2c_queue_buffer[I2C_ASYNC_QUEUE_SIZE];
+static spsc_queue_t i2c_queue = SPSC_QUEUE_INITIALIZER(i2c_queue_buffer);
+static volatile bool i2c_queue_busy = false;
+// Data bytes left in the current transfer, once its header is taken off
+// the queue after the START
+static uint8_t i2c_queue_remaining;
+static bool i2c_queue_addressed = false;
+// STARTs of the current transfer that failed in a row
+static uint8_t i2c_queue_start_failures;
+// Set when a transfer was dropped, cleared by i2c_queue_wait()
+static volatile bool i2c_queue_failed = false;
+
+#define TWCR_ASYNC ((1<<TWINT) | (1<<TWEN) | (1<<TWIE))
+
+// The producer pushes the header before the data, so only start once the
+// whole transfer is there
+static bool i2c_queue_transfer_ready(void)
+{
+  uint8_t count = spsc_queue_count(&i2c_queue);
+  return count >= 2 && count - 2 >= spsc_queue_peek(&i2c_queue, 1);
+}
+
+// Called with interrupts disabled, either from the ISR or an atomic block
+static void i2c_queue_next(bool stop)
+{
+  i2c_queue_addressed = false;
+  if (i2c_queue_transfer_ready()) {
+    i2c_queue_busy = true;
+    // STOP followed by a START when both are set
+    TWCR = TWCR_ASYNC | (1<<TWSTA) | (stop ? (1<<TWSTO) : 0);
+  } else {
+    i2c_queue_busy = false;
+    if (stop) {
+      TWCR = (1<<TWINT) | (1<<TWEN) | (1<<TWSTO);
+    }
+  }
+}
+
+ISR(TWI_vect)
+{
+  uint8_t data;
+
+  switch (TW_STATUS & 0xF8) {
+    case TW_START:
+    case TW_REP_START:
+      spsc_queue_pop(&i2c_queue, &data);
+      TWDR = data | I2C_WRITE;
+      spsc_queue_pop(&i2c_queue, &i2c_queue_remaining);
+      i2c_queue_addressed = true;
+      i2c_queue_start_failures = 0;
+      TWCR = TWCR_ASYNC;
+      break;
+    case TW_MT_SLA_ACK:
+    case TW_MT_DATA_ACK:
+      if (i2c_queue_remaining) {
+        spsc_queue_pop(&i2c_queue, &data);
+        TWDR = data;
+        i2c_queue_remaining--;
+        TWCR = TWCR_ASYNC;
+      } else {
+        i2c_queue_next(true);
+      }
+      break;
+    default:
+      if (!i2c_queue_addressed && ++i2c_queue_start_failures < I2C_ASYNC_START_RETRIES) {
+        // the START didn't make it onto the bus, try the transfer again
+        i2c_queue_next(true);
+        break;
+      }
+      // NACK, lost arbitration or no START after all the retries, drop the
+      // rest of the transfer
+      if (!i2c_queue_addressed) {
+        spsc_queue_pop(&i2c_queue, &data);
+        spsc_queue_pop(&i2c_queue, &i2c_queue_remaining);
+      }
+      spsc_queue_consume(&i2c_queue, i2c_queue_remaining);
+      i2c_queue_remaining = 0;
+      i2c_queue_start_failures = 0;
+      i2c_queue_failed = true;
+      i2c_queue_next(true);
+      break;
+  }
+}
+
+i2c_status_t i2c_queue_transmit(uint8_t address, const uint8_t* data, uint8_t length, uint16_t timeout)
+{
+  uint16_t timeout_timer = timer_read();
+  while (spsc_queue_space(&i2c_queue) < length + 2) {
+    if ((timeout != I2C_TIMEOUT_INFINITE) && ((timer_read() - timeout_timer) >= timeout)) {
+      return I2C_STATUS_TIMEOUT;
+    }
+  }
+
+  spsc_queue_push(&i2c_queue, address);
+  spsc_queue_push(&i2c_queue, length);
+  spsc_queue_write(&i2c_queue, data, length);
+
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    if (!i2c_queue_busy) {
+      // the STOP of the previous transfer has to be on the bus first
+      while (TWCR & (1<<TWSTO));
+      i2c_queue_next(false);
+    }
+  }
+  return I2C_STATUS_SUCCESS;
+}
+
+static i2c_status_t i2c_queue_drain(uint16_t timeout)
+{
+  uint16_t timeout_timer = timer_read();
+  while (i2c_queue_busy || (TWCR & (1<<TWSTO))) {
+    if ((timeout != I2C_TIMEOUT_INFINITE) && ((timer_read() - timeout_timer) >= timeout)) {
+      return I2C_STATUS_TIMEOUT;
+    }
+  }
+  return I2C_STATUS_SUCCESS;
+}
+
+i2c_status_t i2c_queue_wait(uint16_t timeout)
+{
+  if (i2c_queue_drain(timeout)) return I2C_STATUS_TIMEOUT;
+  return i2c_queue_error() ? I2C_STATUS_ERROR : I2C_STATUS_SUCCESS;
+}
+
+bool i2c_queue_error(void)
+{
+  bool failed;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    failed = i2c_queue_failed;
+    i2c_queue_failed = false;
+  }
+  return failed;
+}
+#endif
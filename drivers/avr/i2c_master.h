@@ -28,4 +28,30 @@ i2c_status_t i2c_writeReg(uint8_t devaddr, uint8_t regaddr, uint8_t* data, uint1
 i2c_status_t i2c_readReg(uint8_t devaddr, uint8_t regaddr, uint8_t* data, uint16_t length, uint16_t timeout);
 i2c_status_t i2c_stop(uint16_t timeout);
 
+#ifdef I2C_ASYNC
+#include <stdbool.h>
+
+// Interrupt driven writes. The data is copied into a queue and sent by the
+// TWI interrupt, so the caller doesn't wait for the bus. The blocking
+// functions above first wait for the queue to drain, so the order of the
+// transfers is kept. Failed transfers are dropped, and reported by
+// i2c_queue_error() and i2c_queue_wait().
+#ifndef I2C_ASYNC_QUEUE_SIZE
+#define I2C_ASYNC_QUEUE_SIZE 128
+#endif
+// Attempts at getting the START of a transfer onto the bus before it is
+// dropped
+#ifndef I2C_ASYNC_START_RETRIES
+#define I2C_ASYNC_START_RETRIES 3
+#endif
+
+// Waits for space in the queue, returns I2C_STATUS_TIMEOUT if there was none
+i2c_status_t i2c_queue_transmit(uint8_t address, const uint8_t* data, uint8_t length, uint16_t timeout);
+// Waits until everything queued has been sent, returns I2C_STATUS_ERROR if
+// a transfer was dropped since the last check
+i2c_status_t i2c_queue_wait(uint16_t timeout);
+// Returns and clears whether a transfer was dropped since the last check
+bool i2c_queue_error(void);
+#endif
+
 #endif // I2C_MASTER_H
\ No newline at end of file
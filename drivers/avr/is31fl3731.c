@@ -67,6 +67,8 @@ uint8_t g_twi_transfer_buffer[20];
 // probably not worth the extra complexity.
 uint8_t g_pwm_buffer[DRIVER_COUNT][144];
 bool g_pwm_buffer_update_required = false;
+// What the PWM registers were last set to, IS31FL3731_init() clears them
+static uint8_t g_pwm_buffer_sent[DRIVER_COUNT][144];
 
 uint8_t g_led_control_registers[DRIVER_COUNT][18] = { { 0 }, { 0 } };
 bool g_led_control_registers_update_required = false;
@@ -86,47 +88,80 @@ bool g_led_control_registers_update_required = false;
 // 0x10 - R16,R15,R14,R13,R12,R11,R10,R09
 
 
-void IS31FL3731_write_register( uint8_t addr, uint8_t reg, uint8_t data )
+// Returns false if the transfer failed, or couldn't be queued
+static bool IS31FL3731_transmit( uint8_t addr, uint8_t length )
 {
-	g_twi_transfer_buffer[0] = reg;
-	g_twi_transfer_buffer[1] = data;
-
-  #if ISSI_PERSISTENCE > 0
+  #ifdef I2C_ASYNC
+    // copied into the queue, so g_twi_transfer_buffer can be reused at once
+    return i2c_queue_transmit(addr << 1, g_twi_transfer_buffer, length, ISSI_TIMEOUT) == 0;
+  #elif ISSI_PERSISTENCE > 0
     for (uint8_t i = 0; i < ISSI_PERSISTENCE; i++) {
-      if (i2c_transmit(addr << 1, g_twi_transfer_buffer, 2, ISSI_TIMEOUT) == 0)
-        break;
+      if (i2c_transmit(addr << 1, g_twi_transfer_buffer, length, ISSI_TIMEOUT) == 0)
+        return true;
     }
+    return false;
   #else
-    i2c_transmit(addr << 1, g_twi_transfer_buffer, 2, ISSI_TIMEOUT);
+    return i2c_transmit(addr << 1, g_twi_transfer_buffer, length, ISSI_TIMEOUT) == 0;
   #endif
 }
 
+void IS31FL3731_write_register( uint8_t addr, uint8_t reg, uint8_t data )
+{
+	g_twi_transfer_buffer[0] = reg;
+	g_twi_transfer_buffer[1] = data;
+
+	IS31FL3731_transmit( addr, 2 );
+}
+
+// Sends registers first to last of one 16 byte block of pwm_buffer
+static bool IS31FL3731_write_pwm_span( uint8_t addr, const uint8_t *pwm_buffer, uint8_t first, uint8_t last )
+{
+	// device will auto-increment register for data after the first byte
+	g_twi_transfer_buffer[0] = 0x24 + first;
+	memcpy( &g_twi_transfer_buffer[1], &pwm_buffer[first], last - first + 1 );
+
+	return IS31FL3731_transmit( addr, last - first + 2 );
+}
+
 void IS31FL3731_write_pwm_buffer( uint8_t addr, uint8_t *pwm_buffer )
 {
 	// assumes bank is already selected
 
 	// transmit PWM registers in 9 transfers of 16 bytes
 	// g_twi_transfer_buffer[] is 20 bytes
-
-	// iterate over the pwm_buffer contents at 16 byte intervals
 	for ( int i = 0; i < 144; i += 16 ) {
-		// set the first register, e.g. 0x24, 0x34, 0x44, etc.
-		g_twi_transfer_buffer[0] = 0x24 + i;
-		// copy the data from i to i+15
-		// device will auto-increment register for data after the first byte
-		// thus this sets registers 0x24-0x33, 0x34-0x43, etc. in one transfer
-		for ( int j = 0; j < 16; j++ ) {
-			g_twi_transfer_buffer[1 + j] = pwm_buffer[i + j];
-		}
+		IS31FL3731_write_pwm_span( addr, pwm_buffer, i, i + 15 );
+	}
+}
 
-    #if ISSI_PERSISTENCE > 0
-      for (uint8_t i = 0; i < ISSI_PERSISTENCE; i++) {
-        if (i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT) == 0)
-          break;
-      }
-    #else
-      i2c_transmit(addr << 1, g_twi_transfer_buffer, 17, ISSI_TIMEOUT);
-    #endif
+// Like IS31FL3731_write_pwm_buffer(), but only sends what differs from the
+// last values sent to this driver. Every 16 byte block with a change is sent
+// from its first to its last changed register.
+static void IS31FL3731_write_pwm_changes( uint8_t addr, uint8_t index )
+{
+	const uint8_t *pwm_buffer = g_pwm_buffer[index];
+	uint8_t *sent = g_pwm_buffer_sent[index];
+
+	for ( uint8_t i = 0; i < 144; i += 16 ) {
+		uint8_t first = 0xFF;
+		uint8_t last = 0;
+		for ( uint8_t j = i; j < i + 16; j++ ) {
+			if ( pwm_buffer[j] != sent[j] ) {
+				if ( first == 0xFF ) {
+					first = j;
+				}
+				last = j;
+			}
+		}
+		if ( first == 0xFF ) {
+			continue;
+		}
+		if ( IS31FL3731_write_pwm_span( addr, pwm_buffer, first, last ) ) {
+			memcpy( &sent[first], &pwm_buffer[first], last - first + 1 );
+		} else {
+			// tried again with the next update
+			g_pwm_buffer_update_required = true;
+		}
 	}
 }
 
@@ -184,6 +219,10 @@ void IS31FL3731_init( uint8_t addr )
 	// as there's not much point in double-buffering
 	IS31FL3731_write_register( addr, ISSI_COMMANDREGISTER, 0 );
 
+	// the PWM registers are all 0 now, so the next update sends every
+	// register that isn't
+	memset( g_pwm_buffer_sent, 0, sizeof( g_pwm_buffer_sent ) );
+	g_pwm_buffer_update_required = true;
 }
 
 void IS31FL3731_set_color( int index, uint8_t red, uint8_t green, uint8_t blue )
@@ -240,12 +279,24 @@ void IS31FL3731_set_led_control_register( uint8_t index, bool red, bool green, b
 
 void IS31FL3731_update_pwm_buffers( uint8_t addr1, uint8_t addr2 )
 {
+  #ifdef I2C_ASYNC
+	if ( i2c_queue_error() ) {
+		// some queued registers never made it, and there's no telling
+		// which, so make every register differ and send them all again
+		for ( uint8_t i = 0; i < DRIVER_COUNT; i++ ) {
+			for ( uint8_t j = 0; j < 144; j++ ) {
+				g_pwm_buffer_sent[i][j] = ~g_pwm_buffer[i][j];
+			}
+		}
+		g_pwm_buffer_update_required = true;
+	}
+  #endif
 	if ( g_pwm_buffer_update_required )
 	{
-		IS31FL3731_write_pwm_buffer( addr1, g_pwm_buffer[0] );
-		IS31FL3731_write_pwm_buffer( addr2, g_pwm_buffer[1] );
+		g_pwm_buffer_update_required = false;
+		IS31FL3731_write_pwm_changes( addr1, 0 );
+		IS31FL3731_write_pwm_changes( addr2, 1 );
 	}
-	g_pwm_buffer_update_required = false;
 }
 
 void IS31FL3731_update_led_control_registers( uint8_t addr1, uint8_t addr2 )
@@ -28,6 +28,27 @@
 static uint8_t displaying;
 #endif
 static uint16_t last_flush;
+static bool display_on;
+
+// The characters on the screen, only cells that differ from the matrix are
+// sent when rendering
+static uint8_t shown[MatrixRows][MatrixCols];
+// Cells whose entry in shown can't be trusted, because clearing the screen
+// or sending them failed. They are sent whatever the matrix holds.
+static uint8_t stale[MatrixRows][(MatrixCols + 7) / 8];
+
+static inline void mark_stale(uint8_t row, uint8_t col, bool value) {
+  if (value) {
+    stale[row][col / 8] |= 1 << (col % 8);
+  } else {
+    stale[row][col / 8] &= ~(1 << (col % 8));
+  }
+}
+
+static inline bool cell_changed(struct CharacterMatrix *matrix, uint8_t row, uint8_t col) {
+  return matrix->display[row][col] != shown[row][col] ||
+         (stale[row][col / 8] & (1 << (col % 8)));
+}
 
 // Write command sequence.
 // Returns true on success.
@@ -82,6 +103,8 @@ static inline bool _send_cmd3(uint8_t cmd, uint8_t opr1, uint8_t opr2) {
 
 static void clear_display(void) {
   matrix_clear(&display);
+  // Until the screen is known to be blank
+  memset(stale, 0xFF, sizeof(stale));
 
   // Clear all of the display bits (there can be random noise
   // in the RAM on startup)
@@ -101,6 +124,9 @@ static void clear_display(void) {
     }
   }
 
+  // A blank screen shows the cleared matrix
+  memset(shown, ' ', sizeof(shown));
+  memset(stale, 0, sizeof(stale));
   display.dirty = false;
 
 done:
@@ -174,6 +200,7 @@ bool iota_gfx_off(void) {
   bool success = false;
 
   send_cmd1(DisplayOff);
+  display_on = false;
   success = true;
 
 done:
@@ -184,6 +211,7 @@ bool iota_gfx_on(void) {
   bool success = false;
 
   send_cmd1(DisplayOn);
+  display_on = true;
   success = true;
 
 done:
@@ -261,16 +289,21 @@ void iota_gfx_clear_screen(void) {
   matrix_clear(&display);
 }
 
-void matrix_render(struct CharacterMatrix *matrix) {
-  last_flush = timer_read();
-  iota_gfx_on();
-#if DEBUG_TO_SCREEN
-  ++displaying;
-#endif
+// Sends the glyphs of cells first to last of a row as one window
+static bool send_cells(struct CharacterMatrix *matrix, uint8_t row, uint8_t first, uint8_t last) {
+  bool res = false;
 
-  // Move to the home position
-  send_cmd3(PageAddr, 0, MatrixRows - 1);
-  send_cmd3(ColumnAddr, 0, (MatrixCols * FontWidth) - 1);
+  // Address the window with a single command transaction
+  if (i2c_start_write(SSD1306_ADDRESS)) {
+    goto done;
+  }
+  if (i2c_master_write(0x0 /* command bytes follow */) ||
+      i2c_master_write(PageAddr) || i2c_master_write(row) || i2c_master_write(row) ||
+      i2c_master_write(ColumnAddr) || i2c_master_write(first * FontWidth) ||
+      i2c_master_write((last + 1) * FontWidth - 1)) {
+    goto done;
+  }
+  i2c_master_stop();
 
   if (i2c_start_write(SSD1306_ADDRESS)) {
     goto done;
@@ -280,24 +313,87 @@ void matrix_render(struct CharacterMatrix *matrix) {
     goto done;
   }
 
+  for (uint8_t col = first; col <= last; ++col) {
+    const uint8_t *glyph = font + (matrix->display[row][col] * (FontWidth - 1));
+
+    for (uint8_t glyphCol = 0; glyphCol < FontWidth - 1; ++glyphCol) {
+      uint8_t colBits = pgm_read_byte(glyph + glyphCol);
+      i2c_master_write(colBits);
+    }
+
+    // 1 column of space between chars (it's not included in the glyph)
+    i2c_master_write(0);
+
+    shown[row][col] = matrix->display[row][col];
+    mark_stale(row, col, false);
+  }
+  res = true;
+
+done:
+  i2c_master_stop();
+  if (!res) {
+    // The screen may have been addressed already, resend the window
+    for (uint8_t col = first; col <= last; ++col) {
+      mark_stale(row, col, true);
+    }
+  }
+  return res;
+}
+
+// Sends at most max_cells of the cells that differ from what is shown.
+// Returns true when the screen shows the whole matrix.
+static bool render_cells(struct CharacterMatrix *matrix, uint8_t max_cells) {
+  last_flush = timer_read();
+  if (!display_on) {
+    iota_gfx_on();
+  }
+
   for (uint8_t row = 0; row < MatrixRows; ++row) {
-    for (uint8_t col = 0; col < MatrixCols; ++col) {
-      const uint8_t *glyph = font + (matrix->display[row][col] * (FontWidth - 1));
+    uint8_t col = 0;
+    while (col < MatrixCols) {
+      if (!cell_changed(matrix, row, col)) {
+        ++col;
+        continue;
+      }
+      if (max_cells == 0) {
+        return false;
+      }
 
-      for (uint8_t glyphCol = 0; glyphCol < FontWidth - 1; ++glyphCol) {
-        uint8_t colBits = pgm_read_byte(glyph + glyphCol);
-        i2c_master_write(colBits);
+      // Extend the window over changed cells, and over single unchanged
+      // ones too, as resending a glyph is cheaper than addressing a new
+      // window
+      uint8_t first = col;
+      uint8_t last = col;
+      while (last + 1 - first < max_cells && last + 1 < MatrixCols) {
+        if (cell_changed(matrix, row, last + 1)) {
+          last += 1;
+        } else if (last + 2 < MatrixCols && last + 2 - first < max_cells &&
+                   cell_changed(matrix, row, last + 2)) {
+          last += 2;
+        } else {
+          break;
+        }
       }
 
-      // 1 column of space between chars (it's not included in the glyph)
-      i2c_master_write(0);
+      if (!send_cells(matrix, row, first, last)) {
+        return false;
+      }
+      max_cells -= last + 1 - first;
+      col = last + 1;
     }
   }
+  return true;
+}
 
-  matrix->dirty = false;
+void matrix_render(struct CharacterMatrix *matrix) {
+#if DEBUG_TO_SCREEN
+  ++displaying;
+#endif
+
+  if (render_cells(matrix, MatrixRows * MatrixCols)) {
+    matrix->dirty = false;
+  }
 
-done:
-  i2c_master_stop();
 #if DEBUG_TO_SCREEN
   --displaying;
 #endif
@@ -314,11 +410,12 @@ void iota_gfx_task_user(void) {
 void iota_gfx_task(void) {
   iota_gfx_task_user();
 
-  if (display.dirty) {
-    iota_gfx_flush();
+  // Large updates are spread over several scans
+  if (display.dirty && render_cells(&display, SSD1306_CELLS_PER_TASK)) {
+    display.dirty = false;
   }
 
-  if (timer_elapsed(last_flush) > ScreenOffInterval) {
+  if (display_on && timer_elapsed(last_flush) > ScreenOffInterval) {
     iota_gfx_off();
   }
 }
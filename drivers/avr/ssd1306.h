@@ -52,6 +52,11 @@ enum ssd1306_cmds {
 #define SSD1306_ADDRESS 0x3C
 #endif
 
+// Characters sent by each iota_gfx_task(), about 140us each at 400kHz
+#ifndef SSD1306_CELLS_PER_TASK
+#define SSD1306_CELLS_PER_TASK 8
+#endif
+
 #define DisplayHeight 32
 #define DisplayWidth 128
 
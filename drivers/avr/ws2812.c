@@ -201,6 +201,58 @@ void ws2812_sendarray(uint8_t *data,uint16_t datlen)
   ws2812_sendarray_mask(data,datlen,_BV(RGB_DI_PIN & 0xF));
 }
 
+#ifdef WS2812_USART
+
+/*
+  Sends the bitstream through USART1 in master SPI mode instead of cycle
+  counted bit banging. Each WS2812 bit becomes four SPI bits, 1000 for a
+  '0' and 1100 for a '1', so every SPI byte carries two WS2812 bits and
+  ends low. The USART double buffers, so interrupts stay enabled; a late
+  refill only stretches a low period, which the LEDs tolerate up to their
+  reset time.
+*/
+
+#if RGB_DI_PIN != D3
+  #error "WS2812_USART sends through TXD1, RGB_DI_PIN must be D3"
+#endif
+
+// SPI bit time of about 350ns
+#define WS2812_USART_UBRR   ((F_CPU + 2857143UL) / (2 * 2857143UL) - 1)
+#define WS2812_USART_BIT_NS (2000000000UL / (F_CPU / 1000) * (WS2812_USART_UBRR + 1) / 1000)
+
+#if WS2812_USART_BIT_NS < 300 || WS2812_USART_BIT_NS > 450
+  #error "WS2812_USART: can't get a suitable SPI clock from F_CPU"
+#endif
+
+static const uint8_t ws2812_usart_bits[4] = { 0x88, 0x8C, 0xC8, 0xCC };
+
+void inline ws2812_sendarray_mask(uint8_t *data,uint16_t datlen,uint8_t maskhi)
+{
+  (void)maskhi;
+
+  // XCK1 has to be an output for master mode, even though it isn't used
+  DDRD |= _BV(PD5) | _BV(PD3);
+  UBRR1 = 0;
+  UCSR1C = _BV(UMSEL11) | _BV(UMSEL10);
+  UCSR1B = _BV(TXEN1);
+  UBRR1 = WS2812_USART_UBRR;
+  UCSR1A = _BV(TXC1);
+
+  while (datlen--) {
+    uint8_t curbyte = *data++;
+    for (uint8_t i = 0; i < 4; i++) {
+      while (!(UCSR1A & _BV(UDRE1)));
+      UDR1 = ws2812_usart_bits[curbyte >> 6];
+      curbyte <<= 2;
+    }
+  }
+
+  while (!(UCSR1A & _BV(TXC1)));
+  UCSR1B = 0;
+}
+
+#else
+
 /*
   This routine writes an array of bytes with RGB values to the Dataout pin
   using the fast 800kHz clockless WS2811/2812 protocol.
@@ -262,10 +314,29 @@ void ws2812_sendarray(uint8_t *data,uint16_t datlen)
 #define w_nop8  w_nop4 w_nop4
 #define w_nop16 w_nop8 w_nop8
 
+/*
+  With WS2812_SEGMENT_LEDS defined, interrupts are enabled again after that
+  many LEDs instead of being masked for the whole strip. The line is low
+  between bytes, and the LEDs keep waiting for the next bit as long as the
+  pending interrupts take less than their reset time, which is about 6us
+  for older WS2812 and 280us for current WS2812B.
+*/
+#ifdef WS2812_SEGMENT_LEDS
+  #ifdef RGBW
+    #define WS2812_SEGMENT_BYTES (WS2812_SEGMENT_LEDS * 4)
+  #else
+    #define WS2812_SEGMENT_BYTES (WS2812_SEGMENT_LEDS * 3)
+  #endif
+#endif
+
 void inline ws2812_sendarray_mask(uint8_t *data,uint16_t datlen,uint8_t maskhi)
 {
   uint8_t curbyte,ctr,masklo;
   uint8_t sreg_prev;
+#ifdef WS2812_SEGMENT_BYTES
+  uint8_t pinmask = maskhi;
+  uint16_t segment = 0;
+#endif
 
   // masklo  =~maskhi&ws2812_PORTREG;
   // maskhi |=        ws2812_PORTREG;
@@ -275,6 +346,16 @@ void inline ws2812_sendarray_mask(uint8_t *data,uint16_t datlen,uint8_t maskhi)
   cli();
 
   while (datlen--) {
+#ifdef WS2812_SEGMENT_BYTES
+    if (segment++ == WS2812_SEGMENT_BYTES) {
+      SREG=sreg_prev;
+      segment = 1;
+      cli();
+      // The interrupts may have changed other pins of the port
+      masklo  =~pinmask&_SFR_IO8((RGB_DI_PIN >> 4) + 2);
+      maskhi  = pinmask|_SFR_IO8((RGB_DI_PIN >> 4) + 2);
+    }
+#endif
     curbyte=(*data++);
 
     asm volatile(
@@ -340,3 +421,5 @@ w_nop16
 
   SREG=sreg_prev;
 }
+
+#endif
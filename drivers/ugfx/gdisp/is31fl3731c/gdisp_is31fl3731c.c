@@ -104,11 +104,23 @@ extern const uint8_t CIE1931_CURVE[];
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#if GDISP_SCREEN_HEIGHT > 16
+    #error "The IS31FL3731C driver supports at most 16 rows"
+#endif
+
+#define ALL_ROWS ((uint16_t)((1UL << GDISP_SCREEN_HEIGHT) - 1))
+
 typedef struct{
     uint8_t write_buffer_offset;
     uint8_t write_buffer[IS31_FRAME_SIZE];
     uint8_t frame_buffer[GDISP_SCREEN_HEIGHT * GDISP_SCREEN_WIDTH];
     uint8_t page;
+    // Rows drawn to since the last flush
+    uint16_t dirty_rows;
+    // PWM registers written by the last flush, which the other frame hasn't
+    // seen yet. flushed_lo > flushed_hi when nothing was written.
+    uint8_t flushed_lo;
+    uint8_t flushed_hi;
 }__attribute__((__packed__)) PrivData;
 
 // Some common routines and macros
@@ -139,11 +151,26 @@ static GFXINLINE void write_ram(GDisplay *g, uint8_t page, uint16_t offset, uint
     write_data(g, (uint8_t*)PRIV(g), length + 1);
 }
 
+// Writes write_buffer[start] to write_buffer[start + length - 1] in one
+// transfer. The byte before them temporarily holds the register address.
+static GFXINLINE void write_ram_span(GDisplay *g, uint8_t page, uint8_t offset, uint8_t start, uint8_t length) {
+    uint8_t* tx = PRIV(g)->write_buffer + start - 1;
+    uint8_t saved = *tx;
+    *tx = offset + start;
+    write_page(g, page);
+    write_data(g, tx, length + 1);
+    *tx = saved;
+}
+
 LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
     // The private area is the display surface.
     g->priv = gfxAlloc(sizeof(PrivData));
     __builtin_memset(PRIV(g), 0, sizeof(PrivData));
     PRIV(g)->page = 0;
+    // Both frames start out blank, so the first flush writes everything
+    PRIV(g)->dirty_rows = ALL_ROWS;
+    PRIV(g)->flushed_lo = 0;
+    PRIV(g)->flushed_hi = IS31_PWM_SIZE - 1;
 
     // Initialise the board interface
     init_board(g);
@@ -193,20 +220,38 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
 
         PRIV(g)->page++;
         PRIV(g)->page %= 2;
-        // TODO: some smarter algorithm for this
-        // We should run only one physical page at a time
-        // This way we don't need to send so much data, and
-        // we could use slightly less memory
-        uint8_t* src = PRIV(g)->frame_buffer;
+        // Only the dirty rows are converted, and only the span of PWM
+        // registers that actually changed is sent
+        uint8_t lo = 0xFF;
+        uint8_t hi = 0;
         for (int y=0;y<GDISP_SCREEN_HEIGHT;y++) {
+            if (!(PRIV(g)->dirty_rows & (1 << y)))
+                continue;
+            uint8_t* src = PRIV(g)->frame_buffer + y * GDISP_SCREEN_WIDTH;
             for (int x=0;x<GDISP_SCREEN_WIDTH;x++) {
-                uint8_t val = (uint16_t)*src * g->g.Backlight / 100;
-                PRIV(g)->write_buffer[get_led_address(g, x, y)]=CIE1931_CURVE[val];
+                uint8_t val = CIE1931_CURVE[(uint16_t)*src * g->g.Backlight / 100];
+                uint8_t address = get_led_address(g, x, y);
                 ++src;
+                if (PRIV(g)->write_buffer[address] == val)
+                    continue;
+                PRIV(g)->write_buffer[address] = val;
+                if (address < lo)
+                    lo = address;
+                if (address > hi)
+                    hi = address;
             }
         }
-        write_ram(g, PRIV(g)->page, IS31_PWM_REG, IS31_PWM_SIZE);
-        gfxSleepMilliseconds(1);
+        PRIV(g)->dirty_rows = 0;
+
+        // The frame being written missed the last flush, so it gets that span too
+        uint8_t send_lo = lo < PRIV(g)->flushed_lo ? lo : PRIV(g)->flushed_lo;
+        uint8_t send_hi = hi > PRIV(g)->flushed_hi ? hi : PRIV(g)->flushed_hi;
+        PRIV(g)->flushed_lo = lo;
+        PRIV(g)->flushed_hi = hi;
+        if (send_lo <= send_hi) {
+            write_ram_span(g, PRIV(g)->page, IS31_PWM_REG, send_lo, send_hi - send_lo + 1);
+            gfxSleepMilliseconds(1);
+        }
         write_register(g, IS31_FUNCTIONREG, IS31_REG_PICTDISP, PRIV(g)->page);
 
         g->flags &= ~GDISP_FLG_NEEDFLUSH;
@@ -228,8 +273,13 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
             y = g->p.y;
             break;
         }
-        PRIV(g)->frame_buffer[y * GDISP_SCREEN_WIDTH + x] = gdispColor2Native(g->p.color);
-        g->flags |= GDISP_FLG_NEEDFLUSH;
+        uint8_t* dst = &PRIV(g)->frame_buffer[y * GDISP_SCREEN_WIDTH + x];
+        uint8_t color = gdispColor2Native(g->p.color);
+        if (*dst != color) {
+            *dst = color;
+            PRIV(g)->dirty_rows |= 1 << y;
+            g->flags |= GDISP_FLG_NEEDFLUSH;
+        }
     }
 #endif
 
@@ -299,6 +349,7 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
                 return;
             unsigned val = (unsigned)g->p.ptr;
             g->g.Backlight = val > 100 ? 100 : val;
+            PRIV(g)->dirty_rows = ALL_ROWS;
             g->flags |= GDISP_FLG_NEEDFLUSH;
             return;
         }
@@ -56,11 +56,23 @@
 /* Driver local functions.                                                   */
 /*===========================================================================*/
 
+#define GDISP_PAGES                 (GDISP_SCREEN_HEIGHT / 8)
+
+// Columns lo to hi of a page need to be sent, lo > hi when the page is clean
+typedef struct{
+    uint8_t lo;
+    uint8_t hi;
+}DirtySpan;
+
 typedef struct{
     bool_t buffer2;
     uint8_t data_pos;
     uint8_t data[16];
     uint8_t ram[GDISP_SCREEN_HEIGHT * GDISP_SCREEN_WIDTH / 8];
+    // Changes since the last flush, and the changes written by the last flush,
+    // which the other half of the display RAM hasn't seen yet
+    DirtySpan dirty[GDISP_PAGES];
+    DirtySpan flushed[GDISP_PAGES];
 }PrivData;
 
 // Some common routines and macros
@@ -86,6 +98,22 @@ static GFXINLINE void flush_cmd(GDisplay* g) {
 #define xyaddr(x, y)        ((x) + ((y)>>3)*GDISP_SCREEN_WIDTH)
 #define xybit(y)            (1<<((y)&7))
 
+static GFXINLINE void mark_dirty(GDisplay* g, coord_t x0, coord_t x1, coord_t y0, coord_t y1) {
+    for (unsigned p = y0 >> 3; p <= (unsigned)(y1 >> 3); p++) {
+        DirtySpan* span = &PRIV(g)->dirty[p];
+        if (x0 < span->lo)
+            span->lo = x0;
+        if (x1 > span->hi)
+            span->hi = x1;
+    }
+    g->flags |= GDISP_FLG_NEEDFLUSH;
+}
+
+static GFXINLINE void set_span(DirtySpan* span, bool_t all) {
+    span->lo = all ? 0 : 0xFF;
+    span->hi = all ? GDISP_SCREEN_WIDTH - 1 : 0;
+}
+
 /*===========================================================================*/
 /* Driver exported functions.                                                */
 /*===========================================================================*/
@@ -102,6 +130,11 @@ LLDSPEC bool_t gdisp_lld_init(GDisplay *g) {
     g->priv = gfxAlloc(sizeof(PrivData));
     PRIV(g)->buffer2 = false;
     PRIV(g)->data_pos = 0;
+    // Neither half of the display RAM has been written yet
+    for (unsigned p = 0; p < GDISP_PAGES; p++) {
+        set_span(&PRIV(g)->dirty[p], TRUE);
+        set_span(&PRIV(g)->flushed[p], TRUE);
+    }
 
     // Initialise the board interface
     init_board(g);
@@ -159,14 +192,25 @@ LLDSPEC void gdisp_lld_flush(GDisplay *g) {
     acquire_bus(g);
     enter_cmd_mode(g);
     unsigned dstOffset = (PRIV(g)->buffer2 ? 4 : 0);
-    for (p = 0; p < 4; p++) {
+    for (p = 0; p < GDISP_PAGES; p++) {
+        // The half being written missed the last flush, so it gets those
+        // columns too
+        DirtySpan* dirty = &PRIV(g)->dirty[p];
+        DirtySpan* flushed = &PRIV(g)->flushed[p];
+        uint8_t lo = dirty->lo < flushed->lo ? dirty->lo : flushed->lo;
+        uint8_t hi = dirty->hi > flushed->hi ? dirty->hi : flushed->hi;
+        *flushed = *dirty;
+        set_span(dirty, FALSE);
+        if (lo > hi)
+            continue;
+
         write_cmd(g, ST7565_PAGE | (p + dstOffset));
-        write_cmd(g, ST7565_COLUMN_MSB | 0);
-        write_cmd(g, ST7565_COLUMN_LSB | 0);
+        write_cmd(g, ST7565_COLUMN_MSB | (lo >> 4));
+        write_cmd(g, ST7565_COLUMN_LSB | (lo & 0x0F));
         write_cmd(g, ST7565_RMW);
         flush_cmd(g);
         enter_data_mode(g);
-        write_data(g, RAM(g) + (p*GDISP_SCREEN_WIDTH), GDISP_SCREEN_WIDTH);
+        write_data(g, RAM(g) + (p*GDISP_SCREEN_WIDTH) + lo, hi - lo + 1);
         enter_cmd_mode(g);
     }
     unsigned line = (PRIV(g)->buffer2 ? 32 : 0);
@@ -202,11 +246,14 @@ LLDSPEC void gdisp_lld_draw_pixel(GDisplay *g) {
         y = g->p.x;
         break;
     }
+    uint8_t* dst = &RAM(g)[xyaddr(x, y)];
+    uint8_t old = *dst;
     if (gdispColor2Native(g->p.color) != Black)
-        RAM(g)[xyaddr(x, y)] |= xybit(y);
+        *dst |= xybit(y);
     else
-        RAM(g)[xyaddr(x, y)] &= ~xybit(y);
-    g->flags |= GDISP_FLG_NEEDFLUSH;
+        *dst &= ~xybit(y);
+    if (*dst != old)
+        mark_dirty(g, x, x, y, y);
 }
 #endif
 
@@ -261,7 +308,8 @@ LLDSPEC void gdisp_lld_blit_area(GDisplay *g) {
             srcbit++;
         }
     }
-    g->flags |= GDISP_FLG_NEEDFLUSH;
+    if (g->p.cx > 0 && g->p.cy > 0)
+        mark_dirty(g, g->p.x, g->p.x + g->p.cx - 1, g->p.y, g->p.y + g->p.cy - 1);
 }
 
 #if GDISP_NEED_CONTROL && GDISP_HARDWARE_CONTROL
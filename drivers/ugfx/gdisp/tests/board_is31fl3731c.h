@@ -0,0 +1,83 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _GDISP_LLD_BOARD_H
+#define _GDISP_LLD_BOARD_H
+
+#include "stub_board.h"
+
+// The LED layout of the Infinity Ergodox
+#define LED_WIDTH 7
+#define LED_HEIGHT 7
+
+#define LA(c, r) (c + r * 16 )
+#define NA LA(8, 8)
+
+static const uint8_t led_mask[] = {
+    0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0xFF, 0x00, 0x3F, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t led_mapping[LED_HEIGHT][LED_WIDTH] = {
+   { LA(1, 1), LA(1, 0), LA(0, 4), LA(0, 3), LA(0, 2), LA(0, 1), LA(0, 0)},
+   { LA(2, 3), LA(2, 2), LA(2, 1), LA(2, 0), LA(1, 4), LA(1, 3), LA(1, 2) },
+   { LA(3, 4), LA(3, 3), LA(3, 2), LA(3, 1), LA(3, 0), LA(2, 4), NA },
+   { LA(5, 3), LA(5, 2), LA(5, 1), LA(5, 0), LA(4, 4), LA(4, 3), LA(4, 2) },
+   { LA(7, 3), LA(7, 2), LA(7, 1), LA(7, 0), LA(6, 3), LA(4, 1), LA(4, 0) },
+   { NA,       NA,       NA,       NA,       NA,       NA,       LA(5, 4) },
+   { NA,       NA,       NA,       NA,       LA(6, 2), LA(6, 1), LA(6, 0) },
+};
+
+static GFXINLINE void init_board(GDisplay *g) { (void) g; }
+static GFXINLINE void post_init_board(GDisplay *g) { (void) g; }
+static GFXINLINE void set_hardware_shutdown(GDisplay* g, bool shutdown) { (void) g; (void) shutdown; }
+
+static GFXINLINE const uint8_t* get_led_mask(GDisplay* g) {
+    (void) g;
+    return led_mask;
+}
+
+static GFXINLINE uint8_t get_led_address(GDisplay* g, uint16_t x, uint16_t y) {
+    (void) g;
+    return led_mapping[y][x];
+}
+
+static uint8_t stub_page;
+
+// Emulates the page and register addressing of the controller
+static GFXINLINE void write_data(GDisplay *g, uint8_t* data, uint16_t length) {
+    (void) g;
+    stub_board_stats.transfers++;
+    stub_board_stats.bytes += length;
+    if (data[0] == 0xFD) {
+        stub_page = data[1];
+        return;
+    }
+    // everything after the register address is data
+    stub_board_stats.data_bytes += length - 1;
+    for (uint16_t i = 1; i < length; i++) {
+        uint8_t reg = data[0] + i - 1;
+        if (stub_page == 0x0B) {
+            if (reg < sizeof(stub_is31_function))
+                stub_is31_function[reg] = data[i];
+        } else if (stub_page < 8 && reg < sizeof(stub_is31_frames[0])) {
+            stub_is31_frames[stub_page][reg] = data[i];
+        }
+    }
+}
+
+#endif /* _GDISP_LLD_BOARD_H */
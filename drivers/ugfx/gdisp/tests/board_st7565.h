@@ -0,0 +1,63 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _GDISP_LLD_BOARD_H
+#define _GDISP_LLD_BOARD_H
+
+#include "stub_board.h"
+#include "st7565.h"
+
+#define LCD_WIDTH 128
+#define LCD_HEIGHT 32
+
+static bool_t stub_data_mode;
+static uint8_t stub_page;
+static uint8_t stub_column;
+
+static GFXINLINE void acquire_bus(GDisplay *g) { (void) g; }
+static GFXINLINE void release_bus(GDisplay *g) { (void) g; }
+static GFXINLINE void init_board(GDisplay *g) { (void) g; }
+static GFXINLINE void post_init_board(GDisplay *g) { (void) g; }
+static GFXINLINE void setpin_reset(GDisplay *g, bool_t state) { (void) g; (void) state; }
+static GFXINLINE void enter_data_mode(GDisplay *g) { (void) g; stub_data_mode = TRUE; }
+static GFXINLINE void enter_cmd_mode(GDisplay *g) { (void) g; stub_data_mode = FALSE; }
+
+// Emulates the addressing commands of the controller, the rest are ignored
+static GFXINLINE void write_data(GDisplay *g, uint8_t* data, uint16_t length) {
+    (void) g;
+    stub_board_stats.transfers++;
+    stub_board_stats.bytes += length;
+    for (uint16_t i = 0; i < length; i++) {
+        uint8_t byte = data[i];
+        if (stub_data_mode) {
+            stub_board_stats.data_bytes++;
+            stub_st7565_ram[stub_page][stub_column++ % 128] = byte;
+        } else if (byte == ST7565_CONTRAST) {
+            i++; // skip the value
+        } else if ((byte & 0xF0) == ST7565_PAGE) {
+            stub_page = byte & 0x07;
+        } else if ((byte & 0xF0) == ST7565_COLUMN_MSB) {
+            stub_column = (stub_column & 0x0F) | ((byte & 0x0F) << 4);
+        } else if ((byte & 0xF0) == ST7565_COLUMN_LSB) {
+            stub_column = (stub_column & 0xF0) | (byte & 0x0F);
+        } else if ((byte & 0xC0) == ST7565_START_LINE) {
+            stub_st7565_start_line = byte & 0x3F;
+        }
+    }
+}
+
+#endif /* _GDISP_LLD_BOARD_H */
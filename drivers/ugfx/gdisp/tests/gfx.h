@@ -0,0 +1,95 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Just enough of the ugfx gdisp driver interface to build the QMK gdisp
+ * drivers on the host, against the stub boards in this directory.
+ */
+
+#ifndef _GFX_H
+#define _GFX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define GFX_USE_GDISP           TRUE
+#define GDISP_NEED_CONTROL      TRUE
+
+#ifndef TRUE
+#define TRUE                    1
+#endif
+#ifndef FALSE
+#define FALSE                   0
+#endif
+
+#define GFXINLINE               inline
+#define LLDSPEC
+
+typedef bool bool_t;
+typedef int16_t coord_t;
+typedef uint8_t color_t;
+
+#define Black                   0
+#define White                   255
+#define gdispColor2Native(c)    (c)
+#define gdispNative2Color(c)    (c)
+
+typedef enum { powerOff, powerSleep, powerDeepSleep, powerOn } powermode_t;
+typedef enum { GDISP_ROTATE_0, GDISP_ROTATE_90, GDISP_ROTATE_180, GDISP_ROTATE_270 } orientation_t;
+
+#define GDISP_CONTROL_POWER         0
+#define GDISP_CONTROL_ORIENTATION   1
+#define GDISP_CONTROL_BACKLIGHT     2
+#define GDISP_CONTROL_CONTRAST      3
+
+#define GDISP_FLG_DRIVER            0x0100
+
+typedef struct GDisplay {
+    struct {
+        coord_t Width;
+        coord_t Height;
+        orientation_t Orientation;
+        powermode_t Powermode;
+        uint8_t Backlight;
+        uint8_t Contrast;
+    } g;
+    void* priv;
+    uint16_t flags;
+    struct {
+        coord_t x, y;
+        coord_t cx, cy;
+        coord_t x1, y1;
+        coord_t x2, y2;
+        color_t color;
+        void* ptr;
+    } p;
+} GDisplay;
+
+// zeroed, like the cleared screen ugfx starts with
+#define gfxAlloc(size)                  calloc(1, size)
+#define gfxSleepMilliseconds(ms)
+#define gfxSleepMicroseconds(us)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,161 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstring>
+extern "C" {
+#include "gfx.h"
+#include "src/gdisp/gdisp_driver.h"
+#include "stub_board.h"
+#include "led_tables.h"
+}
+
+stub_board_stats_t stub_board_stats;
+uint8_t stub_st7565_ram[8][128];
+uint8_t stub_st7565_start_line;
+uint8_t stub_is31_frames[8][0xB4];
+uint8_t stub_is31_function[0x0D];
+
+static const int width = 7;
+static const int height = 7;
+static const uint8_t pwm_reg = 0x24;
+static const uint8_t picture_display_reg = 0x01;
+
+// the addresses of the stub board, NA is unmapped
+#define LA(c, r) (c + r * 16 )
+#define NA LA(8, 8)
+static const uint8_t led_mapping[height][width] = {
+   { LA(1, 1), LA(1, 0), LA(0, 4), LA(0, 3), LA(0, 2), LA(0, 1), LA(0, 0)},
+   { LA(2, 3), LA(2, 2), LA(2, 1), LA(2, 0), LA(1, 4), LA(1, 3), LA(1, 2) },
+   { LA(3, 4), LA(3, 3), LA(3, 2), LA(3, 1), LA(3, 0), LA(2, 4), NA },
+   { LA(5, 3), LA(5, 2), LA(5, 1), LA(5, 0), LA(4, 4), LA(4, 3), LA(4, 2) },
+   { LA(7, 3), LA(7, 2), LA(7, 1), LA(7, 0), LA(6, 3), LA(4, 1), LA(4, 0) },
+   { NA,       NA,       NA,       NA,       NA,       NA,       LA(5, 4) },
+   { NA,       NA,       NA,       NA,       LA(6, 2), LA(6, 1), LA(6, 0) },
+};
+
+class IS31FL3731C : public testing::Test {
+public:
+    IS31FL3731C() {
+        memset(&g, 0, sizeof(g));
+        memset(stub_is31_frames, 0xAA, sizeof(stub_is31_frames));
+        gdisp_lld_init(&g);
+        set_backlight(100);
+    }
+
+    ~IS31FL3731C() {
+        free(g.priv);
+    }
+
+    void set_pixel(coord_t x, coord_t y, color_t color) {
+        g.p.x = x;
+        g.p.y = y;
+        g.p.color = color;
+        gdisp_lld_draw_pixel(&g);
+    }
+
+    void set_backlight(unsigned percent) {
+        g.p.x = GDISP_CONTROL_BACKLIGHT;
+        g.p.ptr = (void*)(uintptr_t)percent;
+        gdisp_lld_control(&g);
+    }
+
+    // Returns the number of PWM bytes sent
+    unsigned flush() {
+        memset(&stub_board_stats, 0, sizeof(stub_board_stats));
+        gdisp_lld_flush(&g);
+        // not counting the frame select
+        return stub_board_stats.data_bytes ? stub_board_stats.data_bytes - 1 : 0;
+    }
+
+    // Compares the frame being displayed to what has been drawn
+    void expect_shown() {
+        uint8_t* frame = stub_is31_frames[stub_is31_function[picture_display_reg]];
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                if (led_mapping[y][x] == NA) {
+                    continue;
+                }
+                g.p.x = x;
+                g.p.y = y;
+                uint8_t expected = CIE1931_CURVE[gdisp_lld_get_pixel_color(&g) * g.g.Backlight / 100];
+                ASSERT_EQ(frame[pwm_reg + led_mapping[y][x]], expected) << "at " << x << ", " << y;
+            }
+        }
+    }
+
+    GDisplay g;
+};
+
+TEST_F(IS31FL3731C, FirstFlushSendsAllRegisters) {
+    set_pixel(0, 0, 255);
+    EXPECT_EQ(flush(), 0x90);
+    expect_shown();
+}
+
+TEST_F(IS31FL3731C, NothingIsSentWithoutChanges) {
+    set_pixel(0, 0, 255);
+    flush();
+    set_pixel(1, 1, 100);
+    flush();
+    EXPECT_EQ(flush(), 0);
+    set_pixel(1, 1, 100);
+    EXPECT_EQ(flush(), 0);
+}
+
+TEST_F(IS31FL3731C, OnlyChangedRegistersAreSent) {
+    set_pixel(0, 0, 255);
+    flush();
+    // the other frame also gets the registers changed by the previous flush
+    set_pixel(6, 0, 255);
+    EXPECT_EQ(flush(), LA(1, 1) - LA(0, 0) + 1);
+    expect_shown();
+    set_pixel(5, 0, 255);
+    EXPECT_EQ(flush(), LA(0, 1) - LA(0, 0) + 1);
+    expect_shown();
+    set_pixel(5, 0, 0);
+    EXPECT_EQ(flush(), 1);
+    expect_shown();
+}
+
+TEST_F(IS31FL3731C, RowChangeCostsLessThanFullFrame) {
+    set_pixel(0, 0, 255);
+    flush();
+    flush();
+    for (int frame = 0; frame < 4; frame++) {
+        for (int x = 0; x < width; x++) {
+            set_pixel(x, 3, frame % 2 ? 0 : 255);
+        }
+        EXPECT_LT(flush(), 0x90 / 2);
+        expect_shown();
+    }
+}
+
+TEST_F(IS31FL3731C, BacklightChangeUpdatesEverything) {
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            set_pixel(x, y, 200);
+        }
+    }
+    flush();
+    flush();
+    set_backlight(50);
+    flush();
+    expect_shown();
+    set_backlight(20);
+    flush();
+    expect_shown();
+}
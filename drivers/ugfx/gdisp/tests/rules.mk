@@ -0,0 +1,21 @@
+GDISP_PATH := $(DRIVER_PATH)/ugfx/gdisp
+
+gdisp_st7565_SRC :=\
+	$(GDISP_PATH)/tests/st7565_tests.cpp \
+	$(GDISP_PATH)/st7565/gdisp_lld_ST7565.c
+
+gdisp_st7565_INC := $(GDISP_PATH)/tests $(GDISP_PATH)/st7565
+
+gdisp_is31fl3731c_SRC :=\
+	$(GDISP_PATH)/tests/is31fl3731c_tests.cpp \
+	$(GDISP_PATH)/is31fl3731c/gdisp_is31fl3731c.c \
+	$(QUANTUM_PATH)/led_tables.c
+
+gdisp_is31fl3731c_INC := $(GDISP_PATH)/tests $(GDISP_PATH)/is31fl3731c $(TMK_PATH)/$(COMMON_DIR)
+gdisp_is31fl3731c_DEFS := -DUSE_CIE1931_CURVE
+
+# ugfx passes control values through the void pointer argument, which
+# only matches the integer size on the 32-bit targets
+ifneq ($(filter gdisp_%,$(TEST)),)
+    CFLAGS += -Wno-pointer-to-int-cast
+endif
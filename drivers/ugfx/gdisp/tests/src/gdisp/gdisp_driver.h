@@ -0,0 +1,38 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef _GDISP_DRIVER_H
+#define _GDISP_DRIVER_H
+
+#include "gfx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool_t gdisp_lld_init(GDisplay *g);
+void gdisp_lld_flush(GDisplay *g);
+void gdisp_lld_draw_pixel(GDisplay *g);
+color_t gdisp_lld_get_pixel_color(GDisplay *g);
+void gdisp_lld_blit_area(GDisplay *g);
+void gdisp_lld_control(GDisplay *g);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
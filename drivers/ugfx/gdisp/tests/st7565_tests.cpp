@@ -0,0 +1,157 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <cstring>
+extern "C" {
+#include "gfx.h"
+#include "src/gdisp/gdisp_driver.h"
+#include "stub_board.h"
+}
+
+stub_board_stats_t stub_board_stats;
+uint8_t stub_st7565_ram[8][128];
+uint8_t stub_st7565_start_line;
+uint8_t stub_is31_frames[8][0xB4];
+uint8_t stub_is31_function[0x0D];
+
+static const int width = 128;
+static const int height = 32;
+
+class ST7565 : public testing::Test {
+public:
+    ST7565() {
+        memset(&g, 0, sizeof(g));
+        memset(stub_st7565_ram, 0xAA, sizeof(stub_st7565_ram));
+        gdisp_lld_init(&g);
+    }
+
+    ~ST7565() {
+        free(g.priv);
+    }
+
+    void set_pixel(coord_t x, coord_t y, color_t color) {
+        g.p.x = x;
+        g.p.y = y;
+        g.p.color = color;
+        gdisp_lld_draw_pixel(&g);
+    }
+
+    void fill(coord_t x, coord_t y, coord_t cx, coord_t cy, color_t color) {
+        for (coord_t j = y; j < y + cy; j++) {
+            for (coord_t i = x; i < x + cx; i++) {
+                set_pixel(i, j, color);
+            }
+        }
+    }
+
+    // Returns the number of data bytes sent
+    unsigned flush() {
+        memset(&stub_board_stats, 0, sizeof(stub_board_stats));
+        gdisp_lld_flush(&g);
+        return stub_board_stats.data_bytes;
+    }
+
+    // Compares what the display shows to what has been drawn
+    void expect_shown() {
+        uint8_t first_page = stub_st7565_start_line / 8;
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                g.p.x = x;
+                g.p.y = y;
+                bool drawn = gdisp_lld_get_pixel_color(&g) != Black;
+                bool shown = stub_st7565_ram[first_page + y / 8][x] & (1 << (y % 8));
+                ASSERT_EQ(drawn, shown) << "at " << x << ", " << y;
+            }
+        }
+    }
+
+    // Writes both halves of the display RAM once
+    void flush_both() {
+        set_pixel(0, 0, White);
+        flush();
+        set_pixel(0, 0, Black);
+        flush();
+    }
+
+    GDisplay g;
+};
+
+TEST_F(ST7565, FirstFlushesSendTheWholeScreen) {
+    // nothing to show yet
+    EXPECT_EQ(flush(), 0);
+    // both halves of the display RAM need to be written once
+    set_pixel(0, 0, White);
+    EXPECT_EQ(flush(), width * height / 8);
+    expect_shown();
+    set_pixel(1, 0, White);
+    EXPECT_EQ(flush(), width * height / 8);
+    expect_shown();
+}
+
+TEST_F(ST7565, NothingIsSentWithoutChanges) {
+    flush_both();
+    EXPECT_EQ(flush(), 0);
+    // drawing what is already there doesn't count as a change
+    set_pixel(0, 0, Black);
+    EXPECT_EQ(flush(), 0);
+}
+
+TEST_F(ST7565, OnlyChangedColumnsAreSent) {
+    flush_both();
+    fill(10, 0, 5, 1, White);
+    // the other half also needs the pixel cleared by flush_both()
+    EXPECT_EQ(flush(), 15);
+    expect_shown();
+    fill(20, 0, 2, 1, White);
+    // columns 10 to 21 of the first page
+    EXPECT_EQ(flush(), 12);
+    expect_shown();
+    EXPECT_EQ(flush(), 0);
+    set_pixel(50, 20, White);
+    // the last change, and the new pixel in another page
+    EXPECT_EQ(flush(), 2 + 1);
+    expect_shown();
+}
+
+TEST_F(ST7565, LayerTextChangeCostsLessThanFullScreen) {
+    flush_both();
+    for (int frame = 0; frame < 4; frame++) {
+        // a line of text in the first row, like the layer name
+        fill(0, 0, 60, 8, frame % 2 ? White : Black);
+        fill(0, 0, 60 - frame * 10, 8, frame % 2 ? Black : White);
+        unsigned sent = flush();
+        EXPECT_LE(sent, 60);
+        expect_shown();
+    }
+}
+
+TEST_F(ST7565, BlitMarksTheAreaDirty) {
+    flush_both();
+    uint8_t bitmap[2] = {0xFF, 0xFF};
+    g.p.ptr = bitmap;
+    g.p.x = 100;
+    g.p.y = 10;
+    g.p.cx = 8;
+    g.p.cy = 2;
+    g.p.x1 = 0;
+    g.p.y1 = 0;
+    g.p.x2 = 8;
+    gdisp_lld_blit_area(&g);
+    // and the pixel cleared by flush_both() in the first page
+    EXPECT_EQ(flush(), 8 + 1);
+    expect_shown();
+}
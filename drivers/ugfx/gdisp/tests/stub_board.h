@@ -0,0 +1,47 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef STUB_BOARD_H
+#define STUB_BOARD_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// What the stub boards have sent, for checking how much each flush costs
+typedef struct {
+    unsigned transfers;
+    unsigned bytes;
+    unsigned data_bytes;
+} stub_board_stats_t;
+
+extern stub_board_stats_t stub_board_stats;
+
+// Contents of the emulated controllers, defined by the tests using them
+extern uint8_t stub_st7565_ram[8][128];
+extern uint8_t stub_st7565_start_line;
+
+extern uint8_t stub_is31_frames[8][0xB4];
+extern uint8_t stub_is31_function[0x0D];
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,3 @@
+TEST_LIST +=\
+	gdisp_st7565\
+	gdisp_is31fl3731c
@@ -0,0 +1,251 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "quantum.h"
+#include "eeprom.h"
+#include "dynamic_keymap.h"
+#ifdef RAW_ENABLE
+#include "raw_hid.h"
+#ifdef PROFILER_ENABLE
+#include "profiler.h"
+#endif
+#endif
+
+#if DYNAMIC_KEYMAP_SIZE > 0xFFFF
+#   error "The dynamic keymap is addressed with 16 bit offsets, reduce DYNAMIC_KEYMAP_LAYER_COUNT"
+#endif
+
+/* 4 header bytes, then the keycodes */
+#if defined(E2END) && DYNAMIC_KEYMAP_EEPROM_ADDR + 4 + DYNAMIC_KEYMAP_SIZE > E2END + 1
+#   error "The dynamic keymap does not fit in the EEPROM, reduce DYNAMIC_KEYMAP_LAYER_COUNT"
+#endif
+
+#define DYNAMIC_KEYMAP_EEPROM_HEADER ((uint8_t *)(DYNAMIC_KEYMAP_EEPROM_ADDR))
+#define DYNAMIC_KEYMAP_EEPROM_DATA   ((uint8_t *)(DYNAMIC_KEYMAP_EEPROM_ADDR + 4))
+/* last header byte, written once the keycodes are complete */
+#define DYNAMIC_KEYMAP_EEPROM_VALID  0x4B
+
+#if defined(__AVR__)
+#   define DYNAMIC_KEYMAP_EEPROM_READY() eeprom_is_ready()
+#else
+#   define DYNAMIC_KEYMAP_EEPROM_READY() true
+#endif
+
+/* unchanged bytes the commit skips over in one call */
+#define DYNAMIC_KEYMAP_COMMIT_SCAN 32
+
+static uint16_t keymap_cache[DYNAMIC_KEYMAP_LAYER_COUNT][MATRIX_ROWS][MATRIX_COLS];
+#define keymap_cache_bytes ((uint8_t *)keymap_cache)
+
+/* bytes of keymap_cache not written to the EEPROM yet */
+static uint16_t commit_pos;
+static uint16_t commit_end;
+static bool commit_header;
+
+static const uint8_t eeprom_header[4] = {
+    DYNAMIC_KEYMAP_LAYER_COUNT, MATRIX_ROWS, MATRIX_COLS, DYNAMIC_KEYMAP_EEPROM_VALID
+};
+
+static void mark_dirty(uint16_t from, uint16_t to)
+{
+    if (commit_pos >= commit_end) {
+        commit_pos = from;
+        commit_end = to;
+        return;
+    }
+    if (from < commit_pos) {
+        commit_pos = from;
+    }
+    if (to > commit_end) {
+        commit_end = to;
+    }
+}
+
+void dynamic_keymap_reset(void)
+{
+    /* layers the keymap does not define start out transparent */
+    uint8_t flash_layers = keymap_layer_count();
+    for (uint8_t layer = 0; layer < DYNAMIC_KEYMAP_LAYER_COUNT; layer++) {
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                keymap_cache[layer][row][col] = layer < flash_layers ? pgm_read_word(&keymaps[layer][row][col]) : KC_TRNS;
+            }
+        }
+    }
+    /* the EEPROM does not hold a complete keymap until the commit is done */
+    eeprom_update_byte(DYNAMIC_KEYMAP_EEPROM_HEADER + 3, 0);
+    mark_dirty(0, DYNAMIC_KEYMAP_SIZE);
+    commit_header = true;
+}
+
+void dynamic_keymap_init(void)
+{
+    uint8_t header[4];
+    eeprom_read_block(header, DYNAMIC_KEYMAP_EEPROM_HEADER, sizeof(header));
+    if (memcmp(header, eeprom_header, sizeof(header)) != 0) {
+        dynamic_keymap_reset();
+        return;
+    }
+    eeprom_read_block(keymap_cache, DYNAMIC_KEYMAP_EEPROM_DATA, DYNAMIC_KEYMAP_SIZE);
+    commit_pos = commit_end = 0;
+    commit_header = false;
+}
+
+/* Writes at most one changed byte per call, so the scan never waits for
+ * more than one EEPROM write. */
+void dynamic_keymap_task(void)
+{
+    if (!DYNAMIC_KEYMAP_EEPROM_READY()) {
+        return;
+    }
+    for (uint8_t scanned = 0; commit_pos < commit_end && scanned < DYNAMIC_KEYMAP_COMMIT_SCAN; scanned++) {
+        uint16_t pos = commit_pos++;
+        if (eeprom_read_byte(DYNAMIC_KEYMAP_EEPROM_DATA + pos) != keymap_cache_bytes[pos]) {
+            eeprom_write_byte(DYNAMIC_KEYMAP_EEPROM_DATA + pos, keymap_cache_bytes[pos]);
+            return;
+        }
+    }
+    if (commit_pos >= commit_end && commit_header) {
+        eeprom_update_block(eeprom_header, DYNAMIC_KEYMAP_EEPROM_HEADER, sizeof(eeprom_header));
+        commit_header = false;
+    }
+}
+
+bool dynamic_keymap_is_committed(void)
+{
+    return commit_pos >= commit_end && !commit_header;
+}
+
+uint16_t dynamic_keymap_get_keycode(uint8_t layer, uint8_t row, uint8_t col)
+{
+    if (layer >= DYNAMIC_KEYMAP_LAYER_COUNT || row >= MATRIX_ROWS || col >= MATRIX_COLS) {
+        return KC_NO;
+    }
+    return keymap_cache[layer][row][col];
+}
+
+void dynamic_keymap_set_keycode(uint8_t layer, uint8_t row, uint8_t col, uint16_t keycode)
+{
+    if (layer >= DYNAMIC_KEYMAP_LAYER_COUNT || row >= MATRIX_ROWS || col >= MATRIX_COLS) {
+        return;
+    }
+    keymap_cache[layer][row][col] = keycode;
+    uint16_t pos = (uint8_t *)&keymap_cache[layer][row][col] - keymap_cache_bytes;
+    mark_dirty(pos, pos + 2);
+}
+
+void dynamic_keymap_get_buffer(uint16_t offset, uint8_t size, uint8_t *data)
+{
+    const uint16_t *keycodes = &keymap_cache[0][0][0];
+    for (uint8_t i = 0; i < size; i++) {
+        uint16_t pos = offset + i;
+        uint16_t keycode = keycodes[pos / 2];
+        data[i] = (pos & 1) ? keycode & 0xFF : keycode >> 8;
+    }
+}
+
+void dynamic_keymap_set_buffer(uint16_t offset, uint8_t size, const uint8_t *data)
+{
+    uint16_t *keycodes = &keymap_cache[0][0][0];
+    for (uint8_t i = 0; i < size; i++) {
+        uint16_t pos = offset + i;
+        uint16_t *keycode = &keycodes[pos / 2];
+        if (pos & 1) {
+            *keycode = (*keycode & 0xFF00) | data[i];
+        } else {
+            *keycode = (*keycode & 0x00FF) | (data[i] << 8);
+        }
+    }
+    mark_dirty(offset & ~1, (offset + size + 1) & ~1);
+}
+
+bool dynamic_keymap_process_raw_hid(uint8_t *data, uint8_t length)
+{
+    uint8_t *args = &data[1];
+    if (length < 4) {
+        return false;
+    }
+    switch (data[0]) {
+    case DYNAMIC_KEYMAP_GET_PROTOCOL_VERSION:
+        args[0] = DYNAMIC_KEYMAP_PROTOCOL_VERSION >> 8;
+        args[1] = DYNAMIC_KEYMAP_PROTOCOL_VERSION & 0xFF;
+        break;
+    case DYNAMIC_KEYMAP_GET_INFO:
+        args[0] = DYNAMIC_KEYMAP_LAYER_COUNT;
+        args[1] = MATRIX_ROWS;
+        args[2] = MATRIX_COLS;
+        break;
+    case DYNAMIC_KEYMAP_GET_KEYCODE:
+    case DYNAMIC_KEYMAP_SET_KEYCODE:
+        if (length < 6 || args[0] >= DYNAMIC_KEYMAP_LAYER_COUNT ||
+            args[1] >= MATRIX_ROWS || args[2] >= MATRIX_COLS) {
+            goto error;
+        }
+        if (data[0] == DYNAMIC_KEYMAP_SET_KEYCODE) {
+            dynamic_keymap_set_keycode(args[0], args[1], args[2], (args[3] << 8) | args[4]);
+        } else {
+            uint16_t keycode = dynamic_keymap_get_keycode(args[0], args[1], args[2]);
+            args[3] = keycode >> 8;
+            args[4] = keycode & 0xFF;
+        }
+        break;
+    case DYNAMIC_KEYMAP_RESET:
+        dynamic_keymap_reset();
+        break;
+    case DYNAMIC_KEYMAP_GET_BUFFER:
+    case DYNAMIC_KEYMAP_SET_BUFFER: {
+        uint16_t offset = (args[0] << 8) | args[1];
+        uint8_t size = args[2];
+        if (size > length - 4 || (uint32_t)offset + size > DYNAMIC_KEYMAP_SIZE) {
+            goto error;
+        }
+        if (data[0] == DYNAMIC_KEYMAP_SET_BUFFER) {
+            dynamic_keymap_set_buffer(offset, size, &args[3]);
+        } else {
+            dynamic_keymap_get_buffer(offset, size, &args[3]);
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    return true;
+
+error:
+    data[0] = DYNAMIC_KEYMAP_ERROR;
+    return true;
+}
+
+__attribute__ ((weak))
+void raw_hid_receive_kb(uint8_t *data, uint8_t length)
+{
+}
+
+#ifdef RAW_ENABLE
+void raw_hid_receive(uint8_t *data, uint8_t length)
+{
+    if (dynamic_keymap_process_raw_hid(data, length)
+#ifdef PROFILER_ENABLE
+        || profiler_process_raw_hid(data, length)
+#endif
+        ) {
+        raw_hid_send(data, length);
+    } else {
+        raw_hid_receive_kb(data, length);
+    }
+}
+#endif
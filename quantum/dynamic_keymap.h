@@ -0,0 +1,84 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "keyboard.h"
+
+/* Dynamic keymap (DYNAMIC_KEYMAP_ENABLE = yes)
+ *
+ * The first DYNAMIC_KEYMAP_LAYER_COUNT layers are stored in the EEPROM
+ * and mirrored in RAM, where keymap_key_to_keycode() reads them. Changes
+ * go to the RAM copy right away and are written to the EEPROM in the
+ * background, a byte per scan. Higher layers still come from keymaps[].
+ */
+
+#ifndef DYNAMIC_KEYMAP_LAYER_COUNT
+#define DYNAMIC_KEYMAP_LAYER_COUNT 4
+#endif
+
+/* Start of the EEPROM block: 4 bytes of header, then the keycodes */
+#ifndef DYNAMIC_KEYMAP_EEPROM_ADDR
+#define DYNAMIC_KEYMAP_EEPROM_ADDR 32
+#endif
+
+#define DYNAMIC_KEYMAP_SIZE (DYNAMIC_KEYMAP_LAYER_COUNT * MATRIX_ROWS * MATRIX_COLS * 2)
+
+/* Raw HID commands, the first byte of a packet. The reply is the same
+ * packet with the results filled in, or with the first byte replaced by
+ * DYNAMIC_KEYMAP_ERROR. Multi-byte values are big endian.
+ */
+enum dynamic_keymap_command {
+    /* -> version (2 bytes) */
+    DYNAMIC_KEYMAP_GET_PROTOCOL_VERSION = 0x01,
+    /* -> layer count, rows, cols */
+    DYNAMIC_KEYMAP_GET_INFO,
+    /* layer, row, col -> keycode (2 bytes) */
+    DYNAMIC_KEYMAP_GET_KEYCODE,
+    /* layer, row, col, keycode (2 bytes) */
+    DYNAMIC_KEYMAP_SET_KEYCODE,
+    /* copy keymaps[] over the dynamic layers */
+    DYNAMIC_KEYMAP_RESET,
+    /* offset (2 bytes), size -> size bytes of the keymap from offset */
+    DYNAMIC_KEYMAP_GET_BUFFER,
+    /* offset (2 bytes), size, size bytes */
+    DYNAMIC_KEYMAP_SET_BUFFER,
+    DYNAMIC_KEYMAP_ERROR = 0xFF
+};
+
+#define DYNAMIC_KEYMAP_PROTOCOL_VERSION 1
+
+/* loads the layers from the EEPROM, or resets them if it holds none */
+void dynamic_keymap_init(void);
+void dynamic_keymap_reset(void);
+void dynamic_keymap_task(void);
+bool dynamic_keymap_is_committed(void);
+
+uint16_t dynamic_keymap_get_keycode(uint8_t layer, uint8_t row, uint8_t col);
+void dynamic_keymap_set_keycode(uint8_t layer, uint8_t row, uint8_t col, uint16_t keycode);
+
+/* The layers as one buffer of big endian keycodes, layer by layer and
+ * row by row, as transferred by the raw HID protocol. */
+void dynamic_keymap_get_buffer(uint16_t offset, uint8_t size, uint8_t *data);
+void dynamic_keymap_set_buffer(uint16_t offset, uint8_t size, const uint8_t *data);
+
+/* Handles one raw HID packet in place, returns false when the command
+ * is not a dynamic keymap one. */
+bool dynamic_keymap_process_raw_hid(uint8_t *data, uint8_t length);
+/* gets the packets dynamic_keymap_process_raw_hid() does not handle */
+void raw_hid_receive_kb(uint8_t *data, uint8_t length);
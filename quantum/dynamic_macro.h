@@ -19,18 +19,35 @@
 #define DYNAMIC_MACROS_H
 
 #include "action_layer.h"
+#include "eeprom.h"
+#include "timer.h"
 
 #ifndef DYNAMIC_MACRO_SIZE
-/* May be overridden with a custom value. Be aware that the effective
- * macro length is half of this value: each keypress is recorded twice
- * because of the down-event and up-event. This is not a bug, it's the
- * intended behavior.
- *
- * Usually it should be fine to set the macro size to at least 256 but
- * there have been reports of it being too much in some users' cases,
- * so 128 is considered a safe default.
+/* May be overridden with a custom value. This is the size in bytes of
+ * the buffer shared by both macros. Each keypress is recorded twice,
+ * once for the down-event and once for the up-event, and each event
+ * takes 2 bytes, 3 if it came more than 224ms after the previous one.
+ * The default fits 64 keypresses in a third of the RAM the old
+ * keyrecord_t buffer of 128 events needed.
  */
-#define DYNAMIC_MACRO_SIZE 128
+#define DYNAMIC_MACRO_SIZE 256
+#endif
+
+/* Minimum time in ms between two played back events, so a long macro
+ * neither blocks the keyboard nor floods the host. */
+#ifndef DYNAMIC_MACRO_PLAY_INTERVAL
+#define DYNAMIC_MACRO_PLAY_INTERVAL 10
+#endif
+
+/* When DYNAMIC_MACRO_REALTIME is defined the macros are played back
+ * with the delays they were recorded with. */
+
+/* When DYNAMIC_MACRO_EEPROM_ADDR is defined the macros are saved at
+ * that EEPROM address after each recording and restored at power up.
+ * They take DYNAMIC_MACRO_SIZE + 6 bytes. */
+
+#if MATRIX_ROWS * MATRIX_COLS > 256
+#   error "Dynamic macros store the key position in a byte, the matrix is too large"
 #endif
 
 /* DYNAMIC_MACRO_RANGE must be set as the last element of user's
@@ -45,6 +62,80 @@ enum dynamic_macro_keycodes {
     DYN_MACRO_PLAY2,
 };
 
+/* Event encoding
+ *
+ * byte 0: row * MATRIX_COLS + col
+ * byte 1: bit 7    pressed
+ *         bit 6    tap.interrupted
+ *         bits 5-4 tap.count, saturated at 3
+ *         bits 3-0 delay after the previous event in 16ms units, 15
+ *                  means the delay is in byte 2
+ * byte 2: the delay in 16ms units, saturated at 255
+ */
+#define DYNAMIC_MACRO_PRESSED       0x80
+#define DYNAMIC_MACRO_INTERRUPTED   0x40
+#define DYNAMIC_MACRO_TAP_SHIFT     4
+#define DYNAMIC_MACRO_DELAY_MASK    0x0F
+#define DYNAMIC_MACRO_DELAY_LONG    0x0F
+#define DYNAMIC_MACRO_DELAY_UNIT    16
+#define DYNAMIC_MACRO_EVENT_MAX     3
+
+/* Both macros use the same buffer but read/write on different
+ * ends of it.
+ *
+ * Macro1 is written left-to-right starting from the beginning of
+ * the buffer.
+ *
+ * Macro2 is written right-to-left starting from the end of the
+ * buffer, so its bytes are read backwards too.
+ *
+ *                 length[0]
+ *  v--------------------v
+ * +------------------------------------------------------------+
+ * |>>>>>> MACRO1 >>>>>>      <<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
+ * +------------------------------------------------------------+
+ *                           ^--------------------------------^
+ *                                       length[1]
+ *
+ * During the recording when one macro encounters the end of the
+ * other macro, the recording is stopped. Apart from this, there
+ * are no arbitrary limits for the macros' length in relation to
+ * each other: for example one can either have two medium sized
+ * macros or one long macro and one short macro. Or even one empty
+ * and one using the whole buffer.
+ */
+static struct {
+    uint8_t buffer[DYNAMIC_MACRO_SIZE];
+    uint16_t length[2];
+
+    /* 0   - no macro is being recorded right now
+     * 1,2 - either macro 1 or 2 is being recorded */
+    uint8_t recording;
+    /* bytes written and the length up to the last key release, the
+     * recording is trimmed to it at the end */
+    uint16_t record_length;
+    uint16_t record_released_length;
+    uint16_t record_last_time;
+
+    /* 0 when nothing is played, 1 or 2 otherwise */
+    uint8_t playing;
+    uint16_t play_pos;
+    uint16_t play_delay;
+    uint16_t play_last_time;
+    uint32_t play_saved_layer_state;
+
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+    bool loaded;
+    bool save_pending;
+    /* next byte to write, counting macro1 and then macro2 */
+    uint16_t save_pos;
+#endif
+} dynamic_macro;
+
+/* Direction the slot (0 or 1) grows in and its byte at position pos */
+#define DYNAMIC_MACRO_INDEX(SLOT, POS) \
+    ((SLOT) == 0 ? (POS) : DYNAMIC_MACRO_SIZE - 1 - (POS))
+
 /* Blink the LEDs to notify the user about some event. */
 void dynamic_macro_led_blink(void)
 {
@@ -55,23 +146,114 @@ void dynamic_macro_led_blink(void)
 #endif
 }
 
-/* Convenience macros used for retrieving the debug info. All of them
- * need a `direction` variable accessible at the call site.
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+#define DYNAMIC_MACRO_EEPROM_SIZE   ((uint16_t *)(DYNAMIC_MACRO_EEPROM_ADDR))
+#define DYNAMIC_MACRO_EEPROM_LENGTH ((uint16_t *)(DYNAMIC_MACRO_EEPROM_ADDR + 2))
+#define DYNAMIC_MACRO_EEPROM_DATA   ((uint8_t *)(DYNAMIC_MACRO_EEPROM_ADDR + 6))
+
+#if defined(__AVR__)
+#   define DYNAMIC_MACRO_EEPROM_READY() eeprom_is_ready()
+#else
+#   define DYNAMIC_MACRO_EEPROM_READY() true
+#endif
+
+/**
+ * Check that a slot holds only whole events of keys inside the matrix,
+ * which dynamic_macro_play_step() relies on.
  */
-#define DYNAMIC_MACRO_CURRENT_SLOT() (direction > 0 ? 1 : 2)
-#define DYNAMIC_MACRO_CURRENT_LENGTH(BEGIN, POINTER) \
-    ((int)(direction * ((POINTER) - (BEGIN))))
-#define DYNAMIC_MACRO_CURRENT_CAPACITY(BEGIN, END2) \
-    ((int)(direction * ((END2) - (BEGIN)) + 1))
+bool dynamic_macro_valid(uint8_t slot)
+{
+    uint16_t length = dynamic_macro.length[slot];
+    uint16_t pos = 0;
+
+    while (pos < length) {
+        if (length - pos < 2 ||
+            dynamic_macro.buffer[DYNAMIC_MACRO_INDEX(slot, pos)] >= MATRIX_ROWS * MATRIX_COLS) {
+            return false;
+        }
+        uint8_t flags = dynamic_macro.buffer[DYNAMIC_MACRO_INDEX(slot, pos + 1)];
+        uint8_t event_length = (flags & DYNAMIC_MACRO_DELAY_MASK) == DYNAMIC_MACRO_DELAY_LONG ? 3 : 2;
+        if (length - pos < event_length) {
+            return false;
+        }
+        pos += event_length;
+    }
+    return true;
+}
+
+/**
+ * Restore the macros saved by dynamic_macro_save_step(), once. Both
+ * are dropped if either of them does not decode.
+ */
+void dynamic_macro_load(void)
+{
+    if (dynamic_macro.loaded) {
+        return;
+    }
+    dynamic_macro.loaded = true;
+
+    uint16_t length0 = eeprom_read_word(DYNAMIC_MACRO_EEPROM_LENGTH);
+    uint16_t length1 = eeprom_read_word(DYNAMIC_MACRO_EEPROM_LENGTH + 1);
+    if (eeprom_read_word(DYNAMIC_MACRO_EEPROM_SIZE) != DYNAMIC_MACRO_SIZE ||
+        (uint32_t)length0 + length1 > DYNAMIC_MACRO_SIZE) {
+        return;
+    }
+    eeprom_read_block(dynamic_macro.buffer, DYNAMIC_MACRO_EEPROM_DATA, length0);
+    eeprom_read_block(dynamic_macro.buffer + DYNAMIC_MACRO_SIZE - length1,
+                      DYNAMIC_MACRO_EEPROM_DATA + DYNAMIC_MACRO_SIZE - length1, length1);
+    dynamic_macro.length[0] = length0;
+    dynamic_macro.length[1] = length1;
+    if (!dynamic_macro_valid(0) || !dynamic_macro_valid(1)) {
+        dynamic_macro.length[0] = 0;
+        dynamic_macro.length[1] = 0;
+        dprintln("dynamic macro: discarded the saved macros, they are corrupt");
+        return;
+    }
+    dprintf("dynamic macro: loaded %d and %d bytes\n", length0, length1);
+}
+
+/**
+ * Write one step of a pending save, at most one EEPROM byte per call
+ * so the scan keeps going while the EEPROM is busy.
+ *
+ * The lengths are cleared first and written last, so a save cut short
+ * by a power loss leaves empty macros instead of garbage.
+ */
+void dynamic_macro_save_step(void)
+{
+    if (!dynamic_macro.save_pending || dynamic_macro.recording ||
+        !DYNAMIC_MACRO_EEPROM_READY()) {
+        return;
+    }
+
+    uint16_t length0 = dynamic_macro.length[0];
+    uint16_t length1 = dynamic_macro.length[1];
+    uint16_t pos = dynamic_macro.save_pos++;
+
+    if (pos == 0) {
+        eeprom_update_word(DYNAMIC_MACRO_EEPROM_SIZE, 0);
+    } else if (pos <= length0) {
+        uint16_t index = pos - 1;
+        eeprom_update_byte(DYNAMIC_MACRO_EEPROM_DATA + index, dynamic_macro.buffer[index]);
+    } else if (pos <= length0 + length1) {
+        uint16_t index = DYNAMIC_MACRO_SIZE - (pos - length0);
+        eeprom_update_byte(DYNAMIC_MACRO_EEPROM_DATA + index, dynamic_macro.buffer[index]);
+    } else {
+        eeprom_update_word(DYNAMIC_MACRO_EEPROM_LENGTH, length0);
+        eeprom_update_word(DYNAMIC_MACRO_EEPROM_LENGTH + 1, length1);
+        eeprom_update_word(DYNAMIC_MACRO_EEPROM_SIZE, DYNAMIC_MACRO_SIZE);
+        dynamic_macro.save_pending = false;
+        dprintln("dynamic macro: saved");
+    }
+}
+#endif
 
 /**
  * Start recording of the dynamic macro.
  *
- * @param[out] macro_pointer The new macro buffer iterator.
- * @param[in]  macro_buffer  The macro buffer used to initialize macro_pointer.
+ * @param[in] macro_id 1 or 2, the macro to record.
  */
-void dynamic_macro_record_start(
-    keyrecord_t **macro_pointer, keyrecord_t *macro_buffer)
+void dynamic_macro_record_start(uint8_t macro_id)
 {
     dprintln("dynamic macro recording: started");
 
@@ -79,102 +261,197 @@ void dynamic_macro_record_start(
 
     clear_keyboard();
     layer_clear();
-    *macro_pointer = macro_buffer;
+    dynamic_macro.recording = macro_id;
+    dynamic_macro.record_length = 0;
+    dynamic_macro.record_released_length = 0;
+    dynamic_macro.length[macro_id - 1] = 0;
 }
 
 /**
- * Play the dynamic macro.
+ * Start playing the dynamic macro. The events are fed to
+ * process_record() by dynamic_macro_task().
  *
- * @param macro_buffer[in] The beginning of the macro buffer being played.
- * @param macro_end[in]    The element after the last macro buffer element.
- * @param direction[in]    Either +1 or -1, which way to iterate the buffer.
+ * @param[in] macro_id 1 or 2, the macro to play.
  */
-void dynamic_macro_play(
-    keyrecord_t *macro_buffer, keyrecord_t *macro_end, int8_t direction)
+void dynamic_macro_play(uint8_t macro_id)
 {
-    dprintf("dynamic macro: slot %d playback\n", DYNAMIC_MACRO_CURRENT_SLOT());
+    dprintf("dynamic macro: slot %d playback\n", macro_id);
+
+    if (dynamic_macro.length[macro_id - 1] == 0) {
+        return;
+    }
 
-    uint32_t saved_layer_state = layer_state;
+    dynamic_macro.play_saved_layer_state = layer_state;
 
     clear_keyboard();
     layer_clear();
 
-    while (macro_buffer != macro_end) {
-        process_record(macro_buffer);
-        macro_buffer += direction;
+    dynamic_macro.playing = macro_id;
+    dynamic_macro.play_pos = 0;
+    dynamic_macro.play_delay = 0;
+    dynamic_macro.play_last_time = timer_read() - DYNAMIC_MACRO_PLAY_INTERVAL;
+}
+
+/**
+ * Play the next event of the current macro if it is due.
+ */
+void dynamic_macro_play_step(void)
+{
+    uint8_t slot = dynamic_macro.playing - 1;
+    uint16_t pos = dynamic_macro.play_pos;
+    const uint8_t *buffer = dynamic_macro.buffer;
+
+    if (pos >= dynamic_macro.length[slot]) {
+        clear_keyboard();
+        layer_state = dynamic_macro.play_saved_layer_state;
+        dynamic_macro.playing = 0;
+        dprintln("dynamic macro: playback done");
+        return;
     }
 
-    clear_keyboard();
+    uint8_t key = buffer[DYNAMIC_MACRO_INDEX(slot, pos)];
+    uint8_t flags = buffer[DYNAMIC_MACRO_INDEX(slot, pos + 1)];
+    uint8_t event_length = 2;
+    uint16_t delay = DYNAMIC_MACRO_PLAY_INTERVAL;
+#ifdef DYNAMIC_MACRO_REALTIME
+    uint16_t recorded = flags & DYNAMIC_MACRO_DELAY_MASK;
+    if (recorded == DYNAMIC_MACRO_DELAY_LONG) {
+        recorded = buffer[DYNAMIC_MACRO_INDEX(slot, pos + 2)];
+    }
+    recorded *= DYNAMIC_MACRO_DELAY_UNIT;
+    if (recorded > delay) {
+        delay = recorded;
+    }
+#endif
+    if ((flags & DYNAMIC_MACRO_DELAY_MASK) == DYNAMIC_MACRO_DELAY_LONG) {
+        event_length = 3;
+    }
 
-    layer_state = saved_layer_state;
+    if (timer_elapsed(dynamic_macro.play_last_time) < delay) {
+        return;
+    }
+    dynamic_macro.play_last_time = timer_read();
+    dynamic_macro.play_pos = pos + event_length;
+
+    keyrecord_t record = {
+        .event = {
+            .key = { .col = key % MATRIX_COLS, .row = key / MATRIX_COLS },
+            .pressed = flags & DYNAMIC_MACRO_PRESSED,
+            .time = timer_read() | 1,
+        },
+#ifndef NO_ACTION_TAPPING
+        .tap = {
+            .interrupted = flags & DYNAMIC_MACRO_INTERRUPTED,
+            .count = (flags >> DYNAMIC_MACRO_TAP_SHIFT) & 3,
+        },
+#endif
+    };
+    process_record(&record);
 }
 
 /**
  * Record a single key in a dynamic macro.
  *
- * @param macro_buffer[in] The start of the used macro buffer.
- * @param macro_pointer[in,out] The current buffer position.
- * @param macro2_end[in] The end of the other macro.
- * @param direction[in]  Either +1 or -1, which way to iterate the buffer.
  * @param record[in]     The current keypress.
  */
-void dynamic_macro_record_key(
-    keyrecord_t *macro_buffer,
-    keyrecord_t **macro_pointer,
-    keyrecord_t *macro2_end,
-    int8_t direction,
-    keyrecord_t *record)
+void dynamic_macro_record_key(keyrecord_t *record)
 {
+    uint8_t slot = dynamic_macro.recording - 1;
+    uint16_t length = dynamic_macro.record_length;
+
     /* If we've just started recording, ignore all the key releases. */
-    if (!record->event.pressed && *macro_pointer == macro_buffer) {
+    if (!record->event.pressed && length == 0) {
         dprintln("dynamic macro: ignoring a leading key-up event");
         return;
     }
+    if (record->event.key.row >= MATRIX_ROWS || record->event.key.col >= MATRIX_COLS) {
+        return;
+    }
 
-    /* The other end of the other macro is the last buffer element it
-     * is safe to use before overwriting the other macro.
-     */
-    if (*macro_pointer - direction != macro2_end) {
-        **macro_pointer = *record;
-        *macro_pointer += direction;
+    uint16_t delay = 0;
+    if (length != 0) {
+        delay = TIMER_DIFF_16(record->event.time, dynamic_macro.record_last_time) / DYNAMIC_MACRO_DELAY_UNIT;
+    }
+    uint8_t flags = record->event.pressed ? DYNAMIC_MACRO_PRESSED : 0;
+#ifndef NO_ACTION_TAPPING
+    if (record->tap.interrupted) {
+        flags |= DYNAMIC_MACRO_INTERRUPTED;
+    }
+    flags |= (record->tap.count > 3 ? 3 : record->tap.count) << DYNAMIC_MACRO_TAP_SHIFT;
+#endif
+    uint8_t event_length = 2;
+    if (delay >= DYNAMIC_MACRO_DELAY_LONG) {
+        flags |= DYNAMIC_MACRO_DELAY_LONG;
+        event_length = 3;
+    } else {
+        flags |= delay;
+    }
+
+    /* The other macro's end is the limit before overwriting it. */
+    if (length + event_length + dynamic_macro.length[!slot] <= DYNAMIC_MACRO_SIZE) {
+        uint8_t *buffer = dynamic_macro.buffer;
+        buffer[DYNAMIC_MACRO_INDEX(slot, length)] = record->event.key.row * MATRIX_COLS + record->event.key.col;
+        buffer[DYNAMIC_MACRO_INDEX(slot, length + 1)] = flags;
+        if (event_length == 3) {
+            buffer[DYNAMIC_MACRO_INDEX(slot, length + 2)] = delay > 255 ? 255 : delay;
+        }
+        length += event_length;
+        dynamic_macro.record_length = length;
+        dynamic_macro.record_last_time = record->event.time;
+        if (!record->event.pressed) {
+            dynamic_macro.record_released_length = length;
+        }
     } else {
         dynamic_macro_led_blink();
     }
 
     dprintf(
         "dynamic macro: slot %d length: %d/%d\n",
-        DYNAMIC_MACRO_CURRENT_SLOT(),
-        DYNAMIC_MACRO_CURRENT_LENGTH(macro_buffer, *macro_pointer),
-        DYNAMIC_MACRO_CURRENT_CAPACITY(macro_buffer, macro2_end));
+        dynamic_macro.recording, length,
+        DYNAMIC_MACRO_SIZE - dynamic_macro.length[!slot]);
 }
 
 /**
- * End recording of the dynamic macro. Essentially just update the
- * pointer to the end of the macro.
+ * End recording of the dynamic macro.
  */
-void dynamic_macro_record_end(
-    keyrecord_t *macro_buffer,
-    keyrecord_t *macro_pointer,
-    int8_t direction,
-    keyrecord_t **macro_end)
+void dynamic_macro_record_end(void)
 {
     dynamic_macro_led_blink();
 
     /* Do not save the keys being held when stopping the recording,
      * i.e. the keys used to access the layer DYN_REC_STOP is on.
+     * Everything after the last key release is a key-down event.
      */
-    while (macro_pointer != macro_buffer &&
-           (macro_pointer - direction)->event.pressed) {
-        dprintln("dynamic macro: trimming a trailing key-down event");
-        macro_pointer -= direction;
+    uint8_t slot = dynamic_macro.recording - 1;
+    if (dynamic_macro.record_length != dynamic_macro.record_released_length) {
+        dprintln("dynamic macro: trimming the trailing key-down events");
     }
+    dynamic_macro.length[slot] = dynamic_macro.record_released_length;
+    dynamic_macro.recording = 0;
 
     dprintf(
         "dynamic macro: slot %d saved, length: %d\n",
-        DYNAMIC_MACRO_CURRENT_SLOT(),
-        DYNAMIC_MACRO_CURRENT_LENGTH(macro_buffer, macro_pointer));
+        slot + 1, dynamic_macro.length[slot]);
+
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+    dynamic_macro.save_pending = true;
+    dynamic_macro.save_pos = 0;
+#endif
+}
 
-    *macro_end = macro_pointer;
+/* Plays back and saves the macros in the background. Called for every
+ * scan by quantum_task(), the weak default there is replaced by this
+ * one when the header is included.
+ */
+void dynamic_macro_task(void)
+{
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+    dynamic_macro_load();
+    dynamic_macro_save_step();
+#endif
+    if (dynamic_macro.playing) {
+        dynamic_macro_play_step();
+    }
 }
 
 /* Handle the key events related to the dynamic macros. Should be
@@ -189,69 +466,37 @@ void dynamic_macro_record_end(
  */
 bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
 {
-    /* Both macros use the same buffer but read/write on different
-     * ends of it.
-     *
-     * Macro1 is written left-to-right starting from the beginning of
-     * the buffer.
-     *
-     * Macro2 is written right-to-left starting from the end of the
-     * buffer.
-     *
-     * &macro_buffer   macro_end
-     *  v                   v
-     * +------------------------------------------------------------+
-     * |>>>>>> MACRO1 >>>>>>      <<<<<<<<<<<<< MACRO2 <<<<<<<<<<<<<|
-     * +------------------------------------------------------------+
-     *                           ^                                 ^
-     *                         r_macro_end                  r_macro_buffer
-     *
-     * During the recording when one macro encounters the end of the
-     * other macro, the recording is stopped. Apart from this, there
-     * are no arbitrary limits for the macros' length in relation to
-     * each other: for example one can either have two medium sized
-     * macros or one long macro and one short macro. Or even one empty
-     * and one using the whole buffer.
-     */
-    static keyrecord_t macro_buffer[DYNAMIC_MACRO_SIZE];
-
-    /* Pointer to the first buffer element after the first macro.
-     * Initially points to the very beginning of the buffer since the
-     * macro is empty. */
-    static keyrecord_t *macro_end = macro_buffer;
+    bool dynamic_key = keycode >= DYN_REC_START1 && keycode <= DYN_MACRO_PLAY2;
 
-    /* The other end of the macro buffer. Serves as the beginning of
-     * the second macro. */
-    static keyrecord_t *const r_macro_buffer = macro_buffer + DYNAMIC_MACRO_SIZE - 1;
-
-    /* Like macro_end but for the second macro. */
-    static keyrecord_t *r_macro_end = r_macro_buffer;
-
-    /* A persistent pointer to the current macro position (iterator)
-     * used during the recording. */
-    static keyrecord_t *macro_pointer = NULL;
+#ifdef DYNAMIC_MACRO_EEPROM_ADDR
+    dynamic_macro_load();
+#endif
 
-    /* 0   - no macro is being recorded right now
-     * 1,2 - either macro 1 or 2 is being recorded */
-    static uint8_t macro_id = 0;
+    if (dynamic_macro.playing) {
+        /* The played back events and anything typed meanwhile are
+         * passed through, the macro keys wait for the end. */
+        if (dynamic_key) {
+            dprintln("dynamic macro: ignoring macro key during playback");
+            return false;
+        }
+        return true;
+    }
 
-    if (macro_id == 0) {
+    if (dynamic_macro.recording == 0) {
         /* No macro recording in progress. */
         if (!record->event.pressed) {
             switch (keycode) {
             case DYN_REC_START1:
-                dynamic_macro_record_start(&macro_pointer, macro_buffer);
-                macro_id = 1;
+                dynamic_macro_record_start(1);
                 return false;
             case DYN_REC_START2:
-                dynamic_macro_record_start(&macro_pointer, r_macro_buffer);
-                macro_id = 2;
+                dynamic_macro_record_start(2);
                 return false;
             case DYN_MACRO_PLAY1:
-                dynamic_macro_play(macro_buffer, macro_end, +1);
+                dynamic_macro_play(1);
                 return false;
             case DYN_MACRO_PLAY2:
-                dynamic_macro_play(r_macro_buffer, r_macro_end, -1);
+                dynamic_macro_play(2);
                 return false;
             }
         }
@@ -263,15 +508,7 @@ bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
             if (record->event.pressed) { /* Ignore the initial release
                                           * just after the recoding
                                           * starts. */
-                switch (macro_id) {
-                case 1:
-                    dynamic_macro_record_end(macro_buffer, macro_pointer, +1, &macro_end);
-                    break;
-                case 2:
-                    dynamic_macro_record_end(r_macro_buffer, macro_pointer, -1, &r_macro_end);
-                    break;
-                }
-                macro_id = 0;
+                dynamic_macro_record_end();
             }
             return false;
         case DYN_MACRO_PLAY1:
@@ -280,14 +517,7 @@ bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
             return false;
         default:
             /* Store the key in the macro buffer and process it normally. */
-            switch (macro_id) {
-            case 1:
-                dynamic_macro_record_key(macro_buffer, &macro_pointer, r_macro_end, +1, record);
-                break;
-            case 2:
-                dynamic_macro_record_key(r_macro_buffer, &macro_pointer, macro_end, -1, record);
-                break;
-            }
+            dynamic_macro_record_key(record);
             return true;
             break;
         }
@@ -296,8 +526,6 @@ bool process_record_dynamic_macro(uint16_t keycode, keyrecord_t *record)
     return true;
 }
 
-#undef DYNAMIC_MACRO_CURRENT_SLOT
-#undef DYNAMIC_MACRO_CURRENT_LENGTH
-#undef DYNAMIC_MACRO_CURRENT_CAPACITY
+#undef DYNAMIC_MACRO_INDEX
 
 #endif
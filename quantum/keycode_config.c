@@ -18,7 +18,23 @@
 
 extern keymap_config_t keymap_config;
 
-uint16_t keycode_config(uint16_t keycode) {
+/* The only keycodes keycode_config() can change */
+static const uint16_t remappable[] = {
+    KC_CAPSLOCK, KC_LOCKING_CAPS, KC_LCTL,
+    KC_LALT, KC_LGUI, KC_RALT, KC_RGUI,
+    KC_GRAVE, KC_ESC, KC_BSLASH, KC_BSPACE
+};
+
+#define REMAP_MAX (sizeof(remappable) / sizeof(remappable[0]))
+
+/* Remaps active under the current keymap_config, rebuilt when it changes so
+ * that the common case (nothing swapped) costs a single compare per lookup. */
+static uint16_t remap_from[REMAP_MAX];
+static uint16_t remap_to[REMAP_MAX];
+static uint8_t remap_count;
+static uint16_t remap_config = 0xFFFF;
+
+static uint16_t remap_keycode(uint16_t keycode) {
 
     switch (keycode) {
         case KC_CAPSLOCK:
@@ -89,6 +105,31 @@ uint16_t keycode_config(uint16_t keycode) {
     }
 }
 
+static void remap_build(void) {
+    remap_count = 0;
+    for (uint8_t i = 0; i < REMAP_MAX; i++) {
+        uint16_t to = remap_keycode(remappable[i]);
+        if (to != remappable[i]) {
+            remap_from[remap_count] = remappable[i];
+            remap_to[remap_count] = to;
+            remap_count++;
+        }
+    }
+    remap_config = keymap_config.raw;
+}
+
+uint16_t keycode_config(uint16_t keycode) {
+    if (keymap_config.raw != remap_config) {
+        remap_build();
+    }
+    for (uint8_t i = 0; i < remap_count; i++) {
+        if (remap_from[i] == keycode) {
+            return remap_to[i];
+        }
+    }
+    return keycode;
+}
+
 uint8_t mod_config(uint8_t mod) {
     if (keymap_config.swap_lalt_lgui) {
         if ((mod & MOD_RGUI) == MOD_LGUI) {
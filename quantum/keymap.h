@@ -52,5 +52,8 @@ uint16_t keymap_function_id_to_action( uint16_t function_id );
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
 extern const uint16_t fn_actions[];
 
+// number of layers in keymaps[], only built with DYNAMIC_KEYMAP_ENABLE
+uint8_t keymap_layer_count(void);
+
 
 #endif
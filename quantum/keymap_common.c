@@ -41,15 +41,9 @@ extern keymap_config_t keymap_config;
 
 #include <inttypes.h>
 
-/* converts key to action */
-action_t action_for_key(uint8_t layer, keypos_t key)
+/* converts keycode to action */
+static action_t keycode_to_action(uint16_t keycode)
 {
-    // 16bit keycodes - important
-    uint16_t keycode = keymap_key_to_keycode(layer, key);
-
-    // keycode remapping
-    keycode = keycode_config(keycode);
-
     action_t action;
     uint8_t action_layer, when, mod;
 
@@ -186,6 +180,35 @@ action_t action_for_key(uint8_t layer, keypos_t key)
     return action;
 }
 
+/* converts key to action */
+action_t action_for_key(uint8_t layer, keypos_t key)
+{
+    // 16bit keycodes - important
+    uint16_t keycode = keymap_key_to_keycode(layer, key);
+
+    // keycode remapping
+    keycode = keycode_config(keycode);
+
+    return keycode_to_action(keycode);
+}
+
+/* Same as action_for_key(layer, key).code == ACTION_TRANSPARENT, without
+ * building the action. The remapping never touches these keycodes. */
+bool action_key_is_transparent(uint8_t layer, keypos_t key)
+{
+    uint16_t keycode = keymap_key_to_keycode(layer, key);
+
+    switch (keycode) {
+        case KC_TRNS:
+            return true;
+        case KC_FN0 ... KC_FN31:
+        case QK_FUNCTION ... QK_FUNCTION_MAX:
+            return keycode_to_action(keycode).code == ACTION_TRANSPARENT;
+        default:
+            return false;
+    }
+}
+
 __attribute__ ((weak))
 const uint16_t PROGMEM fn_actions[] = {
 
@@ -208,6 +231,12 @@ void action_function(keyrecord_t *record, uint8_t id, uint8_t opt)
 __attribute__ ((weak))
 uint16_t keymap_key_to_keycode(uint8_t layer, keypos_t key)
 {
+#ifdef DYNAMIC_KEYMAP_ENABLE
+    // the dynamic layers come from their RAM copy
+    if (layer < DYNAMIC_KEYMAP_LAYER_COUNT) {
+        return dynamic_keymap_get_keycode(layer, key.row, key.col);
+    }
+#endif
     // Read entire word (16bits)
     return pgm_read_word(&keymaps[(layer)][(key.row)][(key.col)]);
 }
@@ -0,0 +1,26 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+/* Built instead of the keymap itself (see KEYMAP_C in build_keyboard.mk),
+ * because only the translation unit that defines keymaps[] knows how many
+ * layers it has. */
+#include KEYMAP_C
+
+uint8_t keymap_layer_count(void)
+{
+    return sizeof(keymaps) / sizeof(keymaps[0]);
+}
@@ -18,6 +18,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdbool.h>
 #if defined(__AVR__)
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
 #endif
 #include "wait.h"
 #include "print.h"
@@ -33,6 +35,23 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #   define DEBOUNCING_DELAY 5
 #endif
 
+/* us to let the lines settle after selecting a row (col). With
+ * MATRIX_IO_DELAY_ADAPTIVE the wait moves to after the unselect and only
+ * lasts until the input lines read released again, at most this long. */
+#ifndef MATRIX_IO_DELAY
+#   define MATRIX_IO_DELAY 30
+#endif
+
+/* With MATRIX_IDLE_TIMEOUT set, the matrix goes idle after that many ms
+ * without a key down: every row (col) is selected at once and a scan only
+ * has to check whether any input line is pulled low. MATRIX_IDLE_SLEEP also
+ * sleeps the MCU until the next interrupt while idle. Inputs on port B arm
+ * pin change interrupts, which wake it right away and timestamp the edge,
+ * anything else is noticed on the next 1ms timer tick. */
+#if defined(MATRIX_IDLE_TIMEOUT) && (DIODE_DIRECTION != COL2ROW) && (DIODE_DIRECTION != ROW2COL)
+#   error "MATRIX_IDLE_TIMEOUT needs DIODE_DIRECTION COL2ROW or ROW2COL"
+#endif
+
 #if (DEBOUNCING_DELAY > 0)
     static uint16_t debouncing_time;
     static bool debouncing = false;
@@ -62,6 +81,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #if (DIODE_DIRECTION == ROW2COL) || (DIODE_DIRECTION == COL2ROW)
 static const uint8_t row_pins[MATRIX_ROWS] = MATRIX_ROW_PINS;
 static const uint8_t col_pins[MATRIX_COLS] = MATRIX_COL_PINS;
+
+/* The input pins (cols for COL2ROW, rows for ROW2COL) are read a whole port
+ * at a time. matrix_init() finds the ports they are on and splits them into
+ * runs of neighbouring bits on one port that belong to neighbouring matrix
+ * positions, so each run is moved into place with a mask and two shifts
+ * instead of testing every pin on its own. */
+#   if (DIODE_DIRECTION == COL2ROW)
+#       define MATRIX_INPUTS MATRIX_COLS
+#       define input_pins col_pins
+#   else
+#       define MATRIX_INPUTS MATRIX_ROWS
+#       define input_pins row_pins
+#   endif
+
+typedef struct {
+    uint8_t port;   // index into input_port_addr
+    uint8_t mask;   // bits of the run on that port
+    uint8_t shift;  // lowest bit of the run
+    uint8_t first;  // input index of the lowest bit
+} input_run_t;
+
+static uint8_t input_port_count;
+static uint8_t input_port_addr[MATRIX_INPUTS];  // PINx I/O address
+static uint8_t input_port_mask[MATRIX_INPUTS];  // every input bit on that port
+static uint8_t input_run_count;
+static input_run_t input_runs[MATRIX_INPUTS];
 #endif
 
 /* matrix state(1:on, 0:off) */
@@ -69,7 +114,21 @@ static matrix_row_t matrix[MATRIX_ROWS];
 
 static matrix_row_t matrix_debouncing[MATRIX_ROWS];
 
+#ifdef MATRIX_IDLE_TIMEOUT
+    static bool matrix_idle = false;
+    static uint16_t matrix_last_active;
+    static void update_idle(void);
+    static bool leave_idle(void);
+#   if defined(MATRIX_IDLE_SLEEP) && defined(PCMSK0)
+        static volatile bool matrix_woken = false;
+        static volatile uint16_t matrix_wake_time;
+#   endif
+#endif
+
 
+#if (DIODE_DIRECTION == COL2ROW) || (DIODE_DIRECTION == ROW2COL)
+    static void group_input_pins(void);
+#endif
 #if (DIODE_DIRECTION == COL2ROW)
     static void init_cols(void);
     static bool read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row);
@@ -149,6 +208,9 @@ uint8_t matrix_cols(void) {
 void matrix_init(void) {
 
     // initialize row and col
+#if (DIODE_DIRECTION == COL2ROW) || (DIODE_DIRECTION == ROW2COL)
+    group_input_pins();
+#endif
 #if (DIODE_DIRECTION == COL2ROW)
     unselect_rows();
     init_cols();
@@ -169,6 +231,13 @@ void matrix_init(void) {
 uint8_t matrix_scan(void)
 {
 
+#ifdef MATRIX_IDLE_TIMEOUT
+    if (matrix_idle && !leave_idle()) {
+        matrix_scan_quantum();
+        return 1;
+    }
+#endif
+
 #if (DIODE_DIRECTION == COL2ROW)
 
     // Set row, read cols
@@ -205,6 +274,16 @@ uint8_t matrix_scan(void)
 
 #endif
 
+#   if (DEBOUNCING_DELAY > 0) && defined(MATRIX_IDLE_TIMEOUT) && defined(MATRIX_IDLE_SLEEP) && defined(PCMSK0)
+        // debounce from the edge that woke us, not from this scan
+        if (matrix_woken) {
+            if (debouncing) {
+                debouncing_time = matrix_wake_time;
+            }
+            matrix_woken = false;
+        }
+#   endif
+
 #   if (DEBOUNCING_DELAY > 0)
         if (debouncing && (timer_elapsed(debouncing_time) > DEBOUNCING_DELAY)) {
             for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
@@ -214,6 +293,10 @@ uint8_t matrix_scan(void)
         }
 #   endif
 
+#ifdef MATRIX_IDLE_TIMEOUT
+    update_idle();
+#endif
+
     matrix_scan_quantum();
     return 1;
 }
@@ -266,6 +349,190 @@ uint8_t matrix_key_count(void)
 
 
 
+#if (DIODE_DIRECTION == COL2ROW) || (DIODE_DIRECTION == ROW2COL)
+
+static void group_input_pins(void)
+{
+    input_port_count = 0;
+    input_run_count = 0;
+    for (uint8_t i = 0; i < MATRIX_INPUTS; i++) {
+        uint8_t addr = input_pins[i] >> 4;
+        uint8_t bit = _BV(input_pins[i] & 0xF);
+
+        uint8_t port = 0;
+        while (port < input_port_count && input_port_addr[port] != addr) {
+            port++;
+        }
+        if (port == input_port_count) {
+            input_port_addr[port] = addr;
+            input_port_mask[port] = 0;
+            input_port_count++;
+        }
+        input_port_mask[port] |= bit;
+
+        // extend the previous run if this pin is the next bit on its port
+        if (input_run_count > 0) {
+            input_run_t *last = &input_runs[input_run_count - 1];
+            if (last->port == port && (uint8_t)(last->mask + _BV(last->shift)) == bit) {
+                last->mask |= bit;
+                continue;
+            }
+        }
+        input_run_t *run = &input_runs[input_run_count++];
+        run->port = port;
+        run->mask = bit;
+        run->shift = input_pins[i] & 0xF;
+        run->first = i;
+    }
+}
+
+// Input ports with 1 for every line pulled low
+static void read_input_ports(uint8_t state[])
+{
+    for (uint8_t port = 0; port < input_port_count; port++) {
+        state[port] = ~_SFR_IO8(input_port_addr[port]);
+    }
+}
+
+static void settle_after_select(void)
+{
+#   ifdef MATRIX_IO_DELAY_ADAPTIVE
+        // only the input synchronizer, the lines are pulled low quickly
+        wait_us(1);
+#   else
+        wait_us(MATRIX_IO_DELAY);
+#   endif
+}
+
+// The pull-ups take a while to bring the lines back up after the unselect
+static void settle_after_unselect(void)
+{
+#   ifdef MATRIX_IO_DELAY_ADAPTIVE
+        for (uint16_t us = 0; us < MATRIX_IO_DELAY; us++) {
+            bool released = true;
+            for (uint8_t port = 0; port < input_port_count; port++) {
+                if ((_SFR_IO8(input_port_addr[port]) & input_port_mask[port]) != input_port_mask[port]) {
+                    released = false;
+                }
+            }
+            if (released) {
+                return;
+            }
+            wait_us(1);
+        }
+#   endif
+}
+
+#endif
+
+#ifdef MATRIX_IDLE_TIMEOUT
+
+#   if defined(MATRIX_IDLE_SLEEP) && defined(PCMSK0)
+ISR(PCINT0_vect)
+{
+    // the first edge counts, bounces after it don't
+    if (!matrix_woken) {
+        matrix_wake_time = timer_read();
+        matrix_woken = true;
+    }
+}
+#   endif
+
+static void update_idle(void)
+{
+    bool active = false;
+    for (uint8_t i = 0; i < MATRIX_ROWS; i++) {
+        if (matrix[i] || matrix_debouncing[i]) {
+            active = true;
+        }
+    }
+#   if (DEBOUNCING_DELAY > 0)
+        active |= debouncing;
+#   endif
+    if (active) {
+        matrix_last_active = timer_read();
+        return;
+    }
+    if (timer_elapsed(matrix_last_active) < MATRIX_IDLE_TIMEOUT) {
+        return;
+    }
+
+    // select every row (col), any key down now pulls its input line low
+#   if (DIODE_DIRECTION == COL2ROW)
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            select_row(row);
+        }
+#   else
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            select_col(col);
+        }
+#   endif
+    matrix_idle = true;
+
+#   if defined(MATRIX_IDLE_SLEEP) && defined(PCMSK0)
+        uint8_t wake_mask = 0;
+        for (uint8_t port = 0; port < input_port_count; port++) {
+            if (input_port_addr[port] == _SFR_IO_ADDR(PINB)) {
+                wake_mask = input_port_mask[port];
+            }
+        }
+        matrix_woken = false;
+        PCIFR = _BV(PCIF0);
+        PCMSK0 = wake_mask;
+        PCICR |= _BV(PCIE0);
+#   endif
+}
+
+// Returns true once a key is down again and the matrix is ready for a full scan
+static bool leave_idle(void)
+{
+    uint8_t state[MATRIX_INPUTS];
+    bool pressed = false;
+
+    read_input_ports(state);
+    for (uint8_t port = 0; port < input_port_count; port++) {
+        if (state[port] & input_port_mask[port]) {
+            pressed = true;
+        }
+    }
+
+    if (!pressed) {
+#       ifdef MATRIX_IDLE_SLEEP
+            // anything that could change the matrix or needs service wakes us
+            cli();
+#           ifdef PCMSK0
+                // an edge came in since the read, or it was a bounce
+                if (matrix_woken) {
+                    matrix_woken = false;
+                    sei();
+                    return false;
+                }
+#           endif
+            set_sleep_mode(SLEEP_MODE_IDLE);
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+#       endif
+        return false;
+    }
+
+#   if defined(MATRIX_IDLE_SLEEP) && defined(PCMSK0)
+        PCMSK0 = 0;
+#   endif
+#   if (DIODE_DIRECTION == COL2ROW)
+        unselect_rows();
+#   else
+        unselect_cols();
+#   endif
+    settle_after_unselect();
+    matrix_idle = false;
+    matrix_last_active = timer_read();
+    return true;
+}
+
+#endif
+
 #if (DIODE_DIRECTION == COL2ROW)
 
 static void init_cols(void)
@@ -279,31 +546,30 @@ static void init_cols(void)
 
 static bool read_cols_on_row(matrix_row_t current_matrix[], uint8_t current_row)
 {
-    // Store last value of row prior to reading
-    matrix_row_t last_row_value = current_matrix[current_row];
-
-    // Clear data in matrix row
-    current_matrix[current_row] = 0;
+    uint8_t state[MATRIX_INPUTS];
+    matrix_row_t row_value = 0;
 
     // Select row and wait for row selecton to stabilize
     select_row(current_row);
-    wait_us(30);
+    settle_after_select();
 
-    // For each col...
-    for(uint8_t col_index = 0; col_index < MATRIX_COLS; col_index++) {
+    // Read every col port once, active low
+    read_input_ports(state);
 
-        // Select the col pin to read (active low)
-        uint8_t pin = col_pins[col_index];
-        uint8_t pin_state = (_SFR_IO8(pin >> 4) & _BV(pin & 0xF));
+    // Unselect row
+    unselect_row(current_row);
 
-        // Populate the matrix row with the state of the col pin
-        current_matrix[current_row] |=  pin_state ? 0 : (ROW_SHIFTER << col_index);
+    // Move each run of col bits into place
+    for (uint8_t i = 0; i < input_run_count; i++) {
+        const input_run_t *run = &input_runs[i];
+        row_value |= (matrix_row_t)((state[run->port] & run->mask) >> run->shift) << run->first;
     }
 
-    // Unselect row
-    unselect_row(current_row);
+    settle_after_unselect();
 
-    return (last_row_value != current_matrix[current_row]);
+    bool matrix_changed = (current_matrix[current_row] != row_value);
+    current_matrix[current_row] = row_value;
+    return matrix_changed;
 }
 
 static void select_row(uint8_t row)
@@ -342,40 +608,41 @@ static void init_rows(void)
 
 static bool read_rows_on_col(matrix_row_t current_matrix[], uint8_t current_col)
 {
+    uint8_t state[MATRIX_INPUTS];
     bool matrix_changed = false;
+    matrix_row_t col_bit = ROW_SHIFTER << current_col;
 
     // Select col and wait for col selecton to stabilize
     select_col(current_col);
-    wait_us(30);
+    settle_after_select();
 
-    // For each row...
-    for(uint8_t row_index = 0; row_index < MATRIX_ROWS; row_index++)
-    {
+    // Read every row port once, active low
+    read_input_ports(state);
 
-        // Store last value of row prior to reading
-        matrix_row_t last_row_value = current_matrix[row_index];
+    // Unselect col
+    unselect_col(current_col);
 
-        // Check row pin state
-        if ((_SFR_IO8(row_pins[row_index] >> 4) & _BV(row_pins[row_index] & 0xF)) == 0)
-        {
-            // Pin LO, set col bit
-            current_matrix[row_index] |= (ROW_SHIFTER << current_col);
-        }
-        else
-        {
-            // Pin HI, clear col bit
-            current_matrix[row_index] &= ~(ROW_SHIFTER << current_col);
-        }
+    // Each run holds the bits of neighbouring rows
+    for (uint8_t i = 0; i < input_run_count; i++) {
+        const input_run_t *run = &input_runs[i];
+        uint8_t bits = (state[run->port] & run->mask) >> run->shift;
+        uint8_t row_index = run->first;
+        for (uint8_t mask = run->mask >> run->shift; mask; mask >>= 1, bits >>= 1, row_index++) {
+            matrix_row_t last_row_value = current_matrix[row_index];
+
+            if (bits & 1) {
+                current_matrix[row_index] |= col_bit;
+            } else {
+                current_matrix[row_index] &= ~col_bit;
+            }
 
-        // Determine if the matrix changed state
-        if ((last_row_value != current_matrix[row_index]) && !(matrix_changed))
-        {
-            matrix_changed = true;
+            if (last_row_value != current_matrix[row_index]) {
+                matrix_changed = true;
+            }
         }
     }
 
-    // Unselect col
-    unselect_col(current_col);
+    settle_after_unselect();
 
     return matrix_changed;
 }
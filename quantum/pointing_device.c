@@ -23,8 +23,53 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "debug.h"
 #include "pointing_device.h"
 
+#if defined(__AVR__)
+#include <util/atomic.h>
+#define POINTING_DEVICE_ATOMIC ATOMIC_BLOCK(ATOMIC_RESTORESTATE)
+#else
+#define POINTING_DEVICE_ATOMIC
+#endif
+
 static report_mouse_t mouseReport = {};
 
+// motion not sent yet, from pointing_device_add_motion and the x/y/v/h of mouseReport
+static int16_t pending_x, pending_y, pending_v, pending_h;
+static uint8_t sent_buttons;
+static uint16_t last_send_time;
+
+static int16_t add_saturated(int16_t a, int16_t b) {
+    int32_t sum = (int32_t)a + b;
+    if (sum > INT16_MAX) return INT16_MAX;
+    if (sum < -INT16_MAX) return -INT16_MAX;
+    return sum;
+}
+
+// Takes what fits into one report (-127..127) off the accumulator
+static int8_t take_delta(int16_t *pending) {
+    int16_t delta = *pending;
+    if (delta > 127) delta = 127;
+    if (delta < -127) delta = -127;
+    *pending -= delta;
+    return delta;
+}
+
+void pointing_device_add_motion(int16_t x, int16_t y, int16_t v, int16_t h) {
+    POINTING_DEVICE_ATOMIC {
+        pending_x = add_saturated(pending_x, x);
+        pending_y = add_saturated(pending_y, y);
+        pending_v = add_saturated(pending_v, v);
+        pending_h = add_saturated(pending_h, h);
+    }
+}
+
+bool pointing_device_has_motion(void) {
+    bool motion;
+    POINTING_DEVICE_ATOMIC {
+        motion = pending_x || pending_y || pending_v || pending_h;
+    }
+    return motion;
+}
+
 __attribute__ ((weak))
 void pointing_device_init(void){
     //initialize device, if that needs to be done.
@@ -33,12 +78,36 @@ void pointing_device_init(void){
 __attribute__ ((weak))
 void pointing_device_send(void){
     //If you need to do other things, like debugging, this is the place to do it.
-    host_mouse_send(&mouseReport);
-	//send it and 0 it out except for buttons, so those stay until they are explicity over-ridden using update_pointing_device
-	mouseReport.x = 0;
-	mouseReport.y = 0;
-	mouseReport.v = 0;
-	mouseReport.h = 0;
+    //x/y/v/h set through the report are added to the pending motion and 0ed out,
+    //buttons stay until they are explicity over-ridden using update_pointing_device
+    pointing_device_add_motion(mouseReport.x, mouseReport.y, mouseReport.v, mouseReport.h);
+    mouseReport.x = 0;
+    mouseReport.y = 0;
+    mouseReport.v = 0;
+    mouseReport.h = 0;
+
+    //button changes go out right away, motion at most once per report interval
+    bool buttons_changed = mouseReport.buttons != sent_buttons;
+    if (!buttons_changed) {
+        if (!pointing_device_has_motion()) {
+            return;
+        }
+        if (timer_elapsed(last_send_time) < POINTING_DEVICE_REPORT_INTERVAL) {
+            return;
+        }
+    }
+
+    //motion beyond -127..127 stays pending and goes out with the next reports
+    report_mouse_t report = { .buttons = mouseReport.buttons };
+    POINTING_DEVICE_ATOMIC {
+        report.x = take_delta(&pending_x);
+        report.y = take_delta(&pending_y);
+        report.v = take_delta(&pending_v);
+        report.h = take_delta(&pending_h);
+    }
+    host_mouse_send(&report);
+    sent_buttons = report.buttons;
+    last_send_time = timer_read();
 }
 
 __attribute__ ((weak))
@@ -49,7 +118,8 @@ void pointing_device_task(void){
     //mouseReport.v = 127 max -127 min (scroll vertical)
     //mouseReport.h = 127 max -127 min (scroll horizontal)
     //mouseReport.buttons = 0x1F (decimal 31, binary 00011111) max (bitmask for mouse buttons 1-5, 1 is rightmost, 5 is leftmost) 0x00 min
-    //send the report
+    //or add larger motion with pointing_device_add_motion(), e.g. from a sensor interrupt
+    //send the report, this only goes to the host when something changed
     pointing_device_send();
 }
 
@@ -59,4 +129,4 @@ report_mouse_t pointing_device_get_report(void){
 
 void pointing_device_set_report(report_mouse_t newMouseReport){
 	mouseReport = newMouseReport;
-}
\ No newline at end of file
+}
@@ -19,13 +19,24 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define POINTING_DEVICE_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include "host.h"
 #include "report.h"
 
+/* Minimum time in ms between two reports with motion. Motion in between
+ * is accumulated, button changes are always sent right away. */
+#ifndef POINTING_DEVICE_REPORT_INTERVAL
+#define POINTING_DEVICE_REPORT_INTERVAL 10
+#endif
+
 void pointing_device_init(void);
 void pointing_device_task(void);
 void pointing_device_send(void);
 report_mouse_t pointing_device_get_report(void);
 void pointing_device_set_report(report_mouse_t newMouseReport);
+/* Adds motion to the next reports, deltas larger than a report are split.
+ * Safe to call from an interrupt on AVR. */
+void pointing_device_add_motion(int16_t x, int16_t y, int16_t v, int16_t h);
+bool pointing_device_has_motion(void);
 
 #endif
@@ -19,21 +19,57 @@
 #include "version.h"
 #include <stdio.h>
 #include <math.h>
+#include "spsc_queue.h"
 
-#ifndef CMD_BUFF_SIZE
-  #define CMD_BUFF_SIZE 5
+// Longest command line, including the terminator
+#ifndef TERMINAL_LINE_SIZE
+  #define TERMINAL_LINE_SIZE 64
 #endif
 
+// Bytes of command history, entries are stored back to back and the oldest
+// ones are dropped to make room for new ones
+#ifndef TERMINAL_HISTORY_SIZE
+  #define TERMINAL_HISTORY_SIZE 128
+#endif
+
+// Output waiting to be typed, drained a character per scan by terminal_task()
+#ifndef TERMINAL_OUTPUT_SIZE
+  #define TERMINAL_OUTPUT_SIZE 128
+#endif
+
+// Most output a single command step may queue
+#define TERMINAL_STEP_SIZE (TERMINAL_LINE_SIZE + 16)
+
+#define TERMINAL_MAX_ARGS 6
+
+#if !SPSC_QUEUE_SIZE_VALID(TERMINAL_OUTPUT_SIZE)
+  #error "TERMINAL_OUTPUT_SIZE must be a power of two between 2 and 128"
+#endif
+#if TERMINAL_OUTPUT_SIZE < TERMINAL_STEP_SIZE
+  #error "TERMINAL_OUTPUT_SIZE is too small for TERMINAL_LINE_SIZE"
+#endif
+#if TERMINAL_HISTORY_SIZE > 255
+  #error "TERMINAL_HISTORY_SIZE can't be larger than 255"
+#endif
 
 bool terminal_enabled = false;
-char buffer[80] = "";
-char cmd_buffer[CMD_BUFF_SIZE][80];
-bool cmd_buffer_enabled = true; //replace with ifdef?
-char newline[2] = "\n";
-char arguments[6][20];
-bool firstTime = true;
+char buffer[TERMINAL_LINE_SIZE] = "";
+char *arguments[TERMINAL_MAX_ARGS];
+
+static char history[TERMINAL_HISTORY_SIZE];
+static uint8_t history_head = 0; // where the next entry is written
+static uint8_t history_used = 0; // bytes of history holding whole entries
+static int8_t history_pos = -1;  // entry shown by up/down, -1 is the line being edited
+
+static uint8_t output_data[TERMINAL_OUTPUT_SIZE];
+static spsc_queue_t output = SPSC_QUEUE_INITIALIZER(output_data);
 
-short int current_cmd_buffer_pos = 0; //used for up/down arrows - keeps track of where you are in the command buffer
+// A command produces its output in steps, so that long output never has to
+// fit the queue or block the scan. Returns false once there is no more.
+typedef bool (*terminal_step_t)(uint16_t step);
+static terminal_step_t pending_step = NULL;
+static uint16_t pending_step_index;
+static bool pending_prompt; // show the prompt once the steps are done
 
 __attribute__ ((weak))
 const char terminal_prompt[8] = "> ";
@@ -66,200 +102,353 @@ const char shifted_keycode_to_ascii_lut[58] = {
     ' ', '_', '+', '{', '}', '|', 0, ':', '\'', '~', '<', '>', '?'
 };
 
-struct stringcase {
-    char* string;
-    void (*func)(void);
-} typedef stringcase;
+/*
+ * Output queue
+ */
+static void terminal_puts(const char *str) {
+    spsc_queue_write(&output, (const uint8_t *)str, strlen(str));
+}
+
+#define TERMINAL_PUTS_P(str) terminal_puts_P(PSTR(str))
+static void terminal_puts_P(const char *str) {
+    char c;
+    while ((c = pgm_read_byte(str++))) {
+        spsc_queue_push(&output, c);
+    }
+}
+
+static bool terminal_busy(void) {
+    return pending_step || !spsc_queue_empty(&output);
+}
+
+static void terminal_run(terminal_step_t step, bool prompt) {
+    pending_step = step;
+    pending_step_index = 0;
+    pending_prompt = prompt;
+}
+
+static void terminal_cancel(void) {
+    pending_step = NULL;
+    spsc_queue_clear(&output);
+}
+
+// Types out the next character, and queues the next command step once there
+// is room for it
+void terminal_task(void) {
+    uint8_t c;
+    if (spsc_queue_pop(&output, &c)) {
+        if (c >= 1 && c <= 3) {
+            uint8_t keycode = 0;
+            spsc_queue_pop(&output, &keycode);
+            if (c != 3) {
+                register_code(keycode);
+            }
+            if (c != 2) {
+                unregister_code(keycode);
+            }
+        } else {
+            send_char(c);
+        }
+    }
+
+    if (pending_step && spsc_queue_space(&output) >= TERMINAL_STEP_SIZE) {
+        if (!pending_step(pending_step_index++)) {
+            pending_step = NULL;
+            if (pending_prompt && terminal_enabled) {
+                strcpy(buffer, "");
+                TERMINAL_PUTS_P(SS_TAP(X_HOME));
+                terminal_puts(terminal_prompt);
+            }
+        }
+    }
+}
+
+/*
+ * History ring
+ */
+static void history_clear(void) {
+    history_head = 0;
+    history_used = 0;
+}
+
+static void history_push(const char *line) {
+    uint8_t len = strlen(line);
+    if (len == 0 || len >= TERMINAL_HISTORY_SIZE) {
+        return;
+    }
+    // drop the oldest entries until the line fits
+    while (history_used + len + 1 > TERMINAL_HISTORY_SIZE) {
+        uint8_t tail = (history_head + TERMINAL_HISTORY_SIZE - history_used) % TERMINAL_HISTORY_SIZE;
+        do {
+            history_used--;
+            tail = (tail + 1) % TERMINAL_HISTORY_SIZE;
+        } while (history[(tail + TERMINAL_HISTORY_SIZE - 1) % TERMINAL_HISTORY_SIZE] != 0);
+    }
+    for (uint8_t i = 0; i <= len; i++) {
+        history[history_head] = line[i];
+        history_head = (history_head + 1) % TERMINAL_HISTORY_SIZE;
+    }
+    history_used += len + 1;
+}
+
+// Copies entry n, 0 being the most recent, to dest if it isn't NULL. Returns
+// false if there is no such entry.
+static bool history_get(uint8_t n, char *dest) {
+    uint8_t back = 0; // bytes walked back from the head
+    uint8_t start;
+    for (uint8_t entry = 0; entry <= n; entry++) {
+        if (back >= history_used) {
+            return false;
+        }
+        // skip the terminator of this entry and walk to its first character,
+        // the oldest entry starts history_used bytes back
+        back++;
+        while (back < history_used &&
+               history[(history_head + TERMINAL_HISTORY_SIZE - back - 1) % TERMINAL_HISTORY_SIZE] != 0) {
+            back++;
+        }
+        start = (history_head + TERMINAL_HISTORY_SIZE - back) % TERMINAL_HISTORY_SIZE;
+    }
+    if (!dest) {
+        return true;
+    }
+    for (uint8_t i = 0; i < TERMINAL_LINE_SIZE - 1; i++) {
+        dest[i] = history[(start + i) % TERMINAL_HISTORY_SIZE];
+        if (!dest[i]) {
+            return true;
+        }
+    }
+    dest[TERMINAL_LINE_SIZE - 1] = 0;
+    return true;
+}
 
+/*
+ * Commands
+ */
 void enable_terminal(void) {
     terminal_enabled = true;
+    terminal_cancel();
     strcpy(buffer, "");
-    memset(cmd_buffer,0,CMD_BUFF_SIZE * 80);
-    for (int i = 0; i < 6; i++)
-        strcpy(arguments[i], "");
+    history_pos = -1;
     // select all text to start over
     // SEND_STRING(SS_LCTRL("a"));
-    send_string(terminal_prompt);
+    terminal_puts(terminal_prompt);
 }
 
 void disable_terminal(void) {
     terminal_enabled = false;
-    SEND_STRING("\n");
+    terminal_cancel();
+    TERMINAL_PUTS_P("\n");
 }
 
-void push_to_cmd_buffer(void) {
-if (cmd_buffer_enabled) {
-    if (cmd_buffer == NULL) {
-      return;
-    } else {
-    if (firstTime) {
-     firstTime = false;
-     strcpy(cmd_buffer[0],buffer);
-     return;
-   }
-
-   for (int i= CMD_BUFF_SIZE - 1;i > 0 ;--i) {
-      strncpy(cmd_buffer[i],cmd_buffer[i-1],80);
-   }
-
-   strcpy(cmd_buffer[0],buffer);
-
-   return;
+static bool terminal_about(uint16_t step) {
+    switch (step) {
+        case 0:
+            TERMINAL_PUTS_P("QMK Firmware\n  v" QMK_VERSION "\n");
+            return true;
+        case 1:
+            TERMINAL_PUTS_P(SS_TAP(X_HOME) "  Built: " QMK_BUILDDATE "\n");
+            return true;
+        default:
+            #ifdef TERMINAL_HELP
+                if (arguments[1]) {
+                    TERMINAL_PUTS_P("You entered: ");
+                    terminal_puts(arguments[1]);
+                    TERMINAL_PUTS_P("\n");
+                }
+            #endif
+            return false;
     }
-  }
 }
 
-void terminal_about(void) {
-    SEND_STRING("QMK Firmware\n");
-    SEND_STRING("  v");
-    SEND_STRING(QMK_VERSION);
-    SEND_STRING("\n"SS_TAP(X_HOME)"  Built: ");
-    SEND_STRING(QMK_BUILDDATE);
-    send_string(newline);
-    #ifdef TERMINAL_HELP
-        if (strlen(arguments[1]) != 0) {
-            SEND_STRING("You entered: ");
-            send_string(arguments[1]);
-            send_string(newline);
-        }
-    #endif
-}
-
-void terminal_help(void);
+static bool terminal_help(uint16_t step);
 
 extern const uint16_t keymaps[][MATRIX_ROWS][MATRIX_COLS];
 
-void terminal_keycode(void) {
-    if (strlen(arguments[1]) != 0 && strlen(arguments[2]) != 0 && strlen(arguments[3]) != 0) {
-        char keycode_dec[5];
-        char keycode_hex[5];
+static bool terminal_keycode(uint16_t step) {
+    if (arguments[1] && arguments[2] && arguments[3]) {
+        char keycode_s[16];
         uint16_t layer = strtol(arguments[1], (char **)NULL, 10);
         uint16_t row = strtol(arguments[2], (char **)NULL, 10);
         uint16_t col = strtol(arguments[3], (char **)NULL, 10);
         uint16_t keycode = pgm_read_word(&keymaps[layer][row][col]);
-        itoa(keycode, keycode_dec, 10);
-        itoa(keycode, keycode_hex, 16);
-        SEND_STRING("0x");
-        send_string(keycode_hex);
-        SEND_STRING(" (");
-        send_string(keycode_dec);
-        SEND_STRING(")\n");
+        sprintf(keycode_s, "0x%x (%u)\n", keycode, keycode);
+        terminal_puts(keycode_s);
     } else {
         #ifdef TERMINAL_HELP
-            SEND_STRING("usage: keycode <layer> <row> <col>\n");
+            TERMINAL_PUTS_P("usage: keycode <layer> <row> <col>\n");
         #endif
     }
+    return false;
 }
 
-void terminal_keymap(void) {
-    if (strlen(arguments[1]) != 0) {
-        uint16_t layer = strtol(arguments[1], (char **)NULL, 10);
-        for (int r = 0; r < MATRIX_ROWS; r++) {
-            for (int c = 0; c < MATRIX_COLS; c++) {
-                uint16_t keycode = pgm_read_word(&keymaps[layer][r][c]);
-                char keycode_s[8];
-                sprintf(keycode_s, "0x%04x,", keycode);
-                send_string(keycode_s);
-            }
-            send_string(newline);
-        }
-    } else {
+// one key per step, so even large keymaps stream through the queue
+static bool terminal_keymap(uint16_t step) {
+    static uint8_t layer;
+    if (!arguments[1]) {
         #ifdef TERMINAL_HELP
-            SEND_STRING("usage: keymap <layer>\n");
+            TERMINAL_PUTS_P("usage: keymap <layer>\n");
         #endif
+        return false;
     }
+    if (step == 0) {
+        layer = strtol(arguments[1], (char **)NULL, 10);
+    }
+    if (step >= MATRIX_ROWS * MATRIX_COLS) {
+        return false;
+    }
+    uint8_t r = step / MATRIX_COLS;
+    uint8_t c = step % MATRIX_COLS;
+    char keycode_s[9];
+    sprintf(keycode_s, "0x%04x,", pgm_read_word(&keymaps[layer][r][c]));
+    terminal_puts(keycode_s);
+    if (c == MATRIX_COLS - 1) {
+        TERMINAL_PUTS_P("\n");
+    }
+    return true;
 }
 
-void print_cmd_buff(void) {
-  /* without the below wait, a race condition can occur wherein the
-   buffer can be printed before it has been fully moved */
-  wait_ms(250);
-  for(int i=0;i<CMD_BUFF_SIZE;i++){
-    char tmpChar = ' ';
-    itoa(i ,&tmpChar,10);
-    const char * tmpCnstCharStr = &tmpChar; //because sned_string wont take a normal char *
-    send_string(tmpCnstCharStr);
-    SEND_STRING(". ");
-    send_string(cmd_buffer[i]);
-    SEND_STRING("\n");
-  }
+static bool print_cmd_buff(uint16_t step) {
+    char entry[TERMINAL_LINE_SIZE];
+    if (step > 9 || !history_get(step, entry)) {
+        return false;
+    }
+    char index[4] = { '0' + step, '.', ' ', 0 };
+    terminal_puts(index);
+    terminal_puts(entry);
+    TERMINAL_PUTS_P("\n");
+    return true;
 }
 
+static bool flush_cmd_buffer(uint16_t step) {
+    history_clear();
+    TERMINAL_PUTS_P("Buffer Cleared!\n");
+    return false;
+}
 
-void flush_cmd_buffer(void) {
-  memset(cmd_buffer,0,CMD_BUFF_SIZE * 80);
-  SEND_STRING("Buffer Cleared!\n");
+static bool terminal_exit(uint16_t step) {
+    disable_terminal();
+    return false;
 }
 
-stringcase terminal_cases[] = {
+typedef struct {
+    const char *string;
+    terminal_step_t func;
+} stringcase;
+
+static const stringcase terminal_cases[] = {
     { "about", terminal_about },
     { "help", terminal_help },
     { "keycode", terminal_keycode },
     { "keymap", terminal_keymap },
-    { "flush-buffer" , flush_cmd_buffer},
-    { "print-buffer" , print_cmd_buff},
-    { "exit", disable_terminal }
+    { "flush-buffer", flush_cmd_buffer },
+    { "print-buffer", print_cmd_buff },
+    { "exit", terminal_exit }
 };
 
-void terminal_help(void) {
-    SEND_STRING("commands available:\n  ");
-    for( stringcase* case_p = terminal_cases; case_p != terminal_cases + sizeof( terminal_cases ) / sizeof( terminal_cases[0] ); case_p++ ) {
-        send_string(case_p->string);
-        SEND_STRING(" ");
-    }
-    send_string(newline);
-}
+#define TERMINAL_CASES (sizeof(terminal_cases) / sizeof(terminal_cases[0]))
 
-void command_not_found(void) {
-    wait_ms(50); //sometimes buffer isnt grabbed quick enough
-    SEND_STRING("command \"");
-    send_string(buffer);
-    SEND_STRING("\" not found\n");
+/* Hash of the command names, from their first and last characters and
+ * their length. The table is built from terminal_cases on the first lookup
+ * and maps each hash to the index of its command plus one, 0 is an empty
+ * slot. Commands that share a hash are looked up one by one instead.
+ */
+#define TERMINAL_HASH_SIZE 16
+#define TERMINAL_HASH_SHARED 0xFF
+
+static uint8_t terminal_hash_table[TERMINAL_HASH_SIZE];
+static bool terminal_hash_ready = false;
+
+static uint8_t terminal_hash(const char *name, uint8_t len) {
+    return ((uint8_t)name[0] + (uint8_t)name[len - 1] + len) & (TERMINAL_HASH_SIZE - 1);
 }
 
-void process_terminal_command(void) {
-    // we capture return bc of the order of events, so we need to manually send a newline
-    send_string(newline);
-
-    char * pch;
-    uint8_t i = 0;
-    pch = strtok(buffer, " ");
-    while (pch != NULL) {
-        strcpy(arguments[i], pch);
-        pch = strtok(NULL, " ");
-        i++;
+static void terminal_hash_init(void) {
+    for (uint8_t i = 0; i < TERMINAL_CASES; i++) {
+        const char *name = terminal_cases[i].string;
+        uint8_t *slot = &terminal_hash_table[terminal_hash(name, strlen(name))];
+        *slot = *slot ? TERMINAL_HASH_SHARED : i + 1;
     }
+    terminal_hash_ready = true;
+}
 
-    bool command_found = false;
-    for( stringcase* case_p = terminal_cases; case_p != terminal_cases + sizeof( terminal_cases ) / sizeof( terminal_cases[0] ); case_p++ ) {
-        if( 0 == strcmp( case_p->string, buffer ) ) {
-            command_found = true;
-            (*case_p->func)();
-            break;
+static const stringcase *terminal_lookup(const char *name) {
+    uint8_t len = strlen(name);
+    if (len == 0) {
+        return NULL;
+    }
+    if (!terminal_hash_ready) {
+        terminal_hash_init();
+    }
+    uint8_t index = terminal_hash_table[terminal_hash(name, len)];
+    if (index == TERMINAL_HASH_SHARED) {
+        for (uint8_t i = 0; i < TERMINAL_CASES; i++) {
+            if (strcmp(terminal_cases[i].string, name) == 0) {
+                return &terminal_cases[i];
+            }
         }
+        return NULL;
     }
+    if (index == 0 || strcmp(terminal_cases[index - 1].string, name) != 0) {
+        return NULL;
+    }
+    return &terminal_cases[index - 1];
+}
 
-    if (!command_found)
-        command_not_found();
-
-    if (terminal_enabled) {
-        strcpy(buffer, "");
-        for (int i = 0; i < 6; i++)
-            strcpy(arguments[i], "");
-        SEND_STRING(SS_TAP(X_HOME));
-        send_string(terminal_prompt);
+static bool terminal_help(uint16_t step) {
+    if (step == 0) {
+        TERMINAL_PUTS_P("commands available:\n ");
+    }
+    if (step < TERMINAL_CASES) {
+        TERMINAL_PUTS_P(" ");
+        terminal_puts(terminal_cases[step].string);
+        return true;
     }
+    TERMINAL_PUTS_P("\n");
+    return false;
 }
-void check_pos(void) {
-  if (current_cmd_buffer_pos >= CMD_BUFF_SIZE) { //if over the top, move it back down to the top of the buffer so you can climb back down...
-    current_cmd_buffer_pos = CMD_BUFF_SIZE - 1;
-  } else  if (current_cmd_buffer_pos < 0) { //...and if you fall under the bottom of the buffer, reset back to 0 so you can climb back up
-    current_cmd_buffer_pos = 0;
-  }
+
+static bool command_not_found(uint16_t step) {
+    TERMINAL_PUTS_P("command \"");
+    terminal_puts(buffer);
+    TERMINAL_PUTS_P("\" not found\n");
+    return false;
 }
 
+void process_terminal_command(void) {
+    // we capture return bc of the order of events, so we need to manually send a newline
+    TERMINAL_PUTS_P("\n");
 
+    // split the line into arguments in place, unused ones are NULL
+    char * pch = strtok(buffer, " ");
+    for (uint8_t i = 0; i < TERMINAL_MAX_ARGS; i++) {
+        arguments[i] = pch;
+        pch = pch ? strtok(NULL, " ") : NULL;
+    }
 
+    const stringcase *command = terminal_lookup(buffer);
+    terminal_run(command ? command->func : command_not_found, true);
+}
+
+// replaces the line being edited with history entry history_pos
+static bool terminal_recall(uint16_t step) {
+    static uint8_t erase;
+    if (step == 0) {
+        erase = strlen(buffer);
+        if (history_pos < 0 || !history_get(history_pos, buffer)) {
+            strcpy(buffer, "");
+        }
+    }
+    if (erase) {
+        // a few at a time, so a long line fits the queue
+        for (uint8_t i = 0; i < 8 && erase; i++, erase--) {
+            TERMINAL_PUTS_P(SS_TAP(X_BSPACE));
+        }
+        return true;
+    }
+    terminal_puts(buffer);
+    return false;
+}
 
 bool process_terminal(uint16_t keycode, keyrecord_t *record) {
 
@@ -273,19 +462,24 @@ bool process_terminal(uint16_t keycode, keyrecord_t *record) {
             disable_terminal();
             return false;
         }
+        if (keycode == KC_ESC) {
+            SEND_STRING("\n");
+            enable_terminal();
+            return false;
+        }
+        // keep typing and output from getting mixed up
+        if (terminal_busy()) {
+            return false;
+        }
         if (keycode < 256) {
             uint8_t str_len;
             char char_to_add;
             switch (keycode) {
                 case KC_ENTER:
-                    push_to_cmd_buffer();
-                    current_cmd_buffer_pos = 0;
+                    history_push(buffer);
+                    history_pos = -1;
                     process_terminal_command();
                     return false; break;
-                case KC_ESC:
-                    SEND_STRING("\n");
-                    enable_terminal();
-                    return false; break;
                 case KC_BSPC:
                     str_len = strlen(buffer);
                     if (str_len > 0) {
@@ -300,31 +494,19 @@ bool process_terminal(uint16_t keycode, keyrecord_t *record) {
                 case KC_RIGHT:
                     return false; break;
                 case KC_UP: // 0 = recent
-                  check_pos(); //check our current buffer position is valid
-                  if (current_cmd_buffer_pos <= CMD_BUFF_SIZE - 1) { //once we get to the top, dont do anything
-                    str_len = strlen(buffer);
-                    for(int  i= 0;i < str_len ;++i) {
-                        send_string(SS_TAP(X_BSPACE)); //clear w/e is on the line already
-                        //process_terminal(KC_BSPC,record);
+                    if (history_get(history_pos + 1, NULL)) {
+                        history_pos++;
+                        terminal_run(terminal_recall, false);
+                    } else {
+                        TERMINAL_BELL();
                     }
-                    strncpy(buffer,cmd_buffer[current_cmd_buffer_pos],80);
-
-                    send_string(buffer);
-                    ++current_cmd_buffer_pos; //get ready to access the above cmd if up/down is pressed again
-                  }
                     return false; break;
                 case KC_DOWN:
-                  check_pos();
-                  if (current_cmd_buffer_pos >= 0) { //once we get to the bottom, dont do anything
-                      str_len = strlen(buffer);
-                      for(int  i= 0;i < str_len ;++i) {
-                          send_string(SS_TAP(X_BSPACE)); //clear w/e is on the line already
-                          //process_terminal(KC_BSPC,record);
-                      }
-                      strncpy(buffer,cmd_buffer[current_cmd_buffer_pos],79);
-
-                      send_string(buffer);
-                      --current_cmd_buffer_pos; //get ready to access the above cmd if down/up is pressed again
+                    if (history_pos >= 0) {
+                        history_pos--;
+                        terminal_run(terminal_recall, false);
+                    } else {
+                        TERMINAL_BELL();
                     }
                     return false; break;
                 default:
@@ -336,7 +518,13 @@ bool process_terminal(uint16_t keycode, keyrecord_t *record) {
                             char_to_add = keycode_to_ascii_lut[keycode];
                         }
                         if (char_to_add != 0) {
-                            strncat(buffer, &char_to_add, 1);
+                            str_len = strlen(buffer);
+                            if (str_len >= TERMINAL_LINE_SIZE - 1) {
+                                TERMINAL_BELL();
+                                return false;
+                            }
+                            buffer[str_len] = char_to_add;
+                            buffer[str_len + 1] = 0;
                         }
                     } break;
             }
@@ -162,6 +162,7 @@ void reset_keyboard(void) {
 #ifdef BOOTLOADER_CATERINA
   *(uint16_t *)0x0800 = 0x7777; // these two are a-star-specific
 #endif
+  eeconfig_flush();
   bootloader_jump();
 }
 
@@ -921,6 +922,9 @@ void matrix_init_quantum() {
   #ifdef RGB_MATRIX_ENABLE
     rgb_matrix_init();
   #endif
+  #ifdef DYNAMIC_KEYMAP_ENABLE
+    dynamic_keymap_init();
+  #endif
   matrix_init_kb();
 }
 
@@ -930,7 +934,15 @@ uint8_t rgb_matrix_task_counter = 0;
   #define RGB_MATRIX_SKIP_FRAMES 1
 #endif
 
-void matrix_scan_quantum() {
+/* Replaced by dynamic_macro.h in keymaps that use dynamic macros */
+__attribute__ ((weak))
+void dynamic_macro_task(void) {}
+
+/* Per scan feature jobs, split so the threaded runtime can run the
+ * lighting at its own rate instead of after every matrix scan. */
+void quantum_task(void) {
+  PROFILE_BEGIN(PROFILER_QUANTUM);
+
   #if defined(AUDIO_ENABLE)
     matrix_scan_music();
   #endif
@@ -943,26 +955,50 @@ void matrix_scan_quantum() {
     matrix_scan_combo();
   #endif
 
-  #if defined(BACKLIGHT_ENABLE) && defined(BACKLIGHT_PIN)
+  #ifdef TERMINAL_ENABLE
+    terminal_task();
+  #endif
+
+  dynamic_macro_task();
+
+  #ifdef DYNAMIC_KEYMAP_ENABLE
+    dynamic_keymap_task();
+  #endif
+
+  PROFILE_END(PROFILER_QUANTUM);
+}
+
+void quantum_led_task(void) {
+  #if defined(BACKLIGHT_ENABLE) && (defined(BACKLIGHT_PIN) || defined(BACKLIGHT_PINS))
+    PROFILE_BEGIN(PROFILER_BACKLIGHT);
     backlight_task();
+    PROFILE_END(PROFILER_BACKLIGHT);
   #endif
 
   #ifdef RGB_MATRIX_ENABLE
+    PROFILE_BEGIN(PROFILER_RGB);
     rgb_matrix_task();
     if (rgb_matrix_task_counter == 0) {
       rgb_matrix_update_pwm_buffers();
     }
     rgb_matrix_task_counter = ((rgb_matrix_task_counter + 1) % (RGB_MATRIX_SKIP_FRAMES + 1));
+    PROFILE_END(PROFILER_RGB);
   #endif
+}
 
+void matrix_scan_quantum() {
+#ifndef THREADED_RUNTIME_ENABLE
+  quantum_task();
+  quantum_led_task();
   matrix_scan_kb();
+#endif
 }
-#if defined(BACKLIGHT_ENABLE) && defined(BACKLIGHT_PIN)
-
-static const uint8_t backlight_pin = BACKLIGHT_PIN;
+#if defined(BACKLIGHT_ENABLE) && (defined(BACKLIGHT_PIN) || defined(BACKLIGHT_PINS))
 
 // depending on the pin, we use a different output compare unit
-#if BACKLIGHT_PIN == B7
+#if defined(BACKLIGHT_PINS)
+#  define NO_HARDWARE_PWM
+#elif BACKLIGHT_PIN == B7
 #  define TCCRxA TCCR1A
 #  define TCCRxB TCCR1B
 #  define COMxx1 COM1C1
@@ -994,55 +1030,43 @@ static const uint8_t backlight_pin = BACKLIGHT_PIN;
 #define BACKLIGHT_ON_STATE 0
 #endif
 
-#ifdef NO_HARDWARE_PWM // pwm through software
+#include <util/atomic.h>
+
+#ifdef NO_HARDWARE_PWM
+#  ifndef BACKLIGHT_PINS
+#    define BACKLIGHT_PINS { BACKLIGHT_PIN }
+#  endif
+static const uint8_t backlight_pins[] = BACKLIGHT_PINS;
+#  define BACKLIGHT_PIN_COUNT (sizeof(backlight_pins) / sizeof(backlight_pins[0]))
+#  define FOR_EACH_BACKLIGHT_PIN(i) for (uint8_t i = 0; i < BACKLIGHT_PIN_COUNT; i++)
+#else
+static const uint8_t backlight_pin = BACKLIGHT_PIN;
+#endif
+
+#if defined(NO_HARDWARE_PWM) && defined(BACKLIGHT_CUSTOM_DRIVER) // custom driver does the pwm
 
 __attribute__ ((weak))
 void backlight_init_ports(void)
 {
-  // Setup backlight pin as output and output to on state.
-  // DDRx |= n
-  _SFR_IO8((backlight_pin >> 4) + 1) |= _BV(backlight_pin & 0xF);
-  #if BACKLIGHT_ON_STATE == 0
-    // PORTx &= ~n
-    _SFR_IO8((backlight_pin >> 4) + 2) &= ~_BV(backlight_pin & 0xF);
-  #else
-    // PORTx |= n
-    _SFR_IO8((backlight_pin >> 4) + 2) |= _BV(backlight_pin & 0xF);
-  #endif
-}
-
-__attribute__ ((weak))
-void backlight_set(uint8_t level) {}
-
-uint8_t backlight_tick = 0;
-
-#ifndef BACKLIGHT_CUSTOM_DRIVER
-void backlight_task(void) {
-  if ((0xFFFF >> ((BACKLIGHT_LEVELS - get_backlight_level()) * ((BACKLIGHT_LEVELS + 1) / 2))) & (1 << backlight_tick)) {
+  // Setup backlight pins as output and output to on state.
+  FOR_EACH_BACKLIGHT_PIN(i) {
+    // DDRx |= n
+    _SFR_IO8((backlight_pins[i] >> 4) + 1) |= _BV(backlight_pins[i] & 0xF);
     #if BACKLIGHT_ON_STATE == 0
       // PORTx &= ~n
-      _SFR_IO8((backlight_pin >> 4) + 2) &= ~_BV(backlight_pin & 0xF);
+      _SFR_IO8((backlight_pins[i] >> 4) + 2) &= ~_BV(backlight_pins[i] & 0xF);
     #else
       // PORTx |= n
-      _SFR_IO8((backlight_pin >> 4) + 2) |= _BV(backlight_pin & 0xF);
-    #endif
-  } else {
-    #if BACKLIGHT_ON_STATE == 0
-      // PORTx |= n
-      _SFR_IO8((backlight_pin >> 4) + 2) |= _BV(backlight_pin & 0xF);
-    #else
-      // PORTx &= ~n
-      _SFR_IO8((backlight_pin >> 4) + 2) &= ~_BV(backlight_pin & 0xF);
+      _SFR_IO8((backlight_pins[i] >> 4) + 2) |= _BV(backlight_pins[i] & 0xF);
     #endif
   }
-  backlight_tick = (backlight_tick + 1) % 16;
 }
-#endif
+
+__attribute__ ((weak))
+void backlight_set(uint8_t level) {}
 
 #ifdef BACKLIGHT_BREATHING
-  #ifndef BACKLIGHT_CUSTOM_DRIVER
-  #error "Backlight breathing only available with hardware PWM. Please disable."
-  #endif
+  #error "Backlight breathing is not available with a custom software PWM driver. Please disable."
 #endif
 
 #else // pwm through timer
@@ -1065,9 +1089,86 @@ static uint16_t cie_lightness(uint16_t v) {
   }
 }
 
+// CIE corrected duty cycle for every backlight level, filled once at init so
+// level changes don't need the 32 bit math above.
+static uint16_t backlight_duty_table[BACKLIGHT_LEVELS + 1];
+
+static void backlight_duty_table_init(void) {
+  for (uint8_t level = 0; level <= BACKLIGHT_LEVELS; level++) {
+    backlight_duty_table[level] = cie_lightness(TIMER_TOP * (uint32_t)level / BACKLIGHT_LEVELS);
+  }
+}
+
+#ifdef NO_HARDWARE_PWM // pwm through software, driven by timer 1 interrupts
+
+#if defined(B5_AUDIO) || defined(B6_AUDIO) || defined(B7_AUDIO)
+  #error "Software PWM backlight uses timer 1, which is taken by audio on B5, B6 or B7."
+#endif
+
+#define OCRxx  OCR1A
+#define ICRx   ICR1
+
+// Written by the main loop and the breathing interrupt, read by the pwm interrupts.
+static volatile bool backlight_pwm_on = false;
+
+static inline void backlight_pins_on(void) {
+  FOR_EACH_BACKLIGHT_PIN(i) {
+    #if BACKLIGHT_ON_STATE == 0
+      // PORTx &= ~n
+      _SFR_IO8((backlight_pins[i] >> 4) + 2) &= ~_BV(backlight_pins[i] & 0xF);
+    #else
+      // PORTx |= n
+      _SFR_IO8((backlight_pins[i] >> 4) + 2) |= _BV(backlight_pins[i] & 0xF);
+    #endif
+  }
+}
+
+static inline void backlight_pins_off(void) {
+  FOR_EACH_BACKLIGHT_PIN(i) {
+    #if BACKLIGHT_ON_STATE == 0
+      // PORTx |= n
+      _SFR_IO8((backlight_pins[i] >> 4) + 2) |= _BV(backlight_pins[i] & 0xF);
+    #else
+      // PORTx &= ~n
+      _SFR_IO8((backlight_pins[i] >> 4) + 2) &= ~_BV(backlight_pins[i] & 0xF);
+    #endif
+  }
+}
+
+// range for val is [0..TIMER_TOP]. Pins are on from overflow until the compare match.
+static inline void set_pwm(uint16_t val) {
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    OCRxx = val;
+    backlight_pwm_on = val != 0;
+  }
+  if (!val) {
+    backlight_pins_off();
+  }
+}
+
+#ifndef BACKLIGHT_CUSTOM_DRIVER
+__attribute__ ((weak))
+void backlight_set(uint8_t level) {
+  if (level > BACKLIGHT_LEVELS)
+    level = BACKLIGHT_LEVELS;
+
+  set_pwm(backlight_duty_table[level]);
+}
+#endif
+
+// Compare match ends the on phase of the period.
+ISR(TIMER1_COMPA_vect)
+{
+  backlight_pins_off();
+}
+
+#else // pwm through hardware
+
 // range for val is [0..TIMER_TOP]. PWM pin is high while the timer count is below val.
 static inline void set_pwm(uint16_t val) {
-	OCRxx = val;
+  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+    OCRxx = val;
+  }
 }
 
 #ifndef BACKLIGHT_CUSTOM_DRIVER
@@ -1084,11 +1185,16 @@ void backlight_set(uint8_t level) {
     TCCRxA |= _BV(COMxx1);
   }
   // Set the brightness
-  set_pwm(cie_lightness(TIMER_TOP * (uint32_t)level / BACKLIGHT_LEVELS));
+  set_pwm(backlight_duty_table[level]);
 }
+#endif  // BACKLIGHT_CUSTOM_DRIVER
 
+#endif // NO_HARDWARE_PWM
+
+#ifndef BACKLIGHT_CUSTOM_DRIVER
+// Both pwm modes are independent of the matrix scan rate.
 void backlight_task(void) {}
-#endif  // BACKLIGHT_CUSTOM_DRIVER
+#endif
 
 #ifdef BACKLIGHT_BREATHING
 
@@ -1100,13 +1206,27 @@ void backlight_task(void) {}
 static uint8_t breathing_period = BREATHING_PERIOD;
 static uint8_t breathing_halt = BREATHING_NO_HALT;
 static uint16_t breathing_counter = 0;
+static uint8_t breathing_index = BREATHING_STEPS;
+
+#ifdef NO_HARDWARE_PWM
+// The overflow interrupt always runs to start each pwm period, so breathing
+// is just a flag checked there.
+static volatile bool breathing = false;
+
+bool is_breathing(void) {
+    return breathing;
+}
 
+#define breathing_interrupt_enable() do {breathing_index = BREATHING_STEPS; breathing = true;} while (0)
+#define breathing_interrupt_disable() do {breathing = false;} while (0)
+#else
 bool is_breathing(void) {
     return !!(TIMSK1 & _BV(TOIE1));
 }
 
-#define breathing_interrupt_enable() do {TIMSK1 |= _BV(TOIE1);} while (0)
+#define breathing_interrupt_enable() do {breathing_index = BREATHING_STEPS; TIMSK1 |= _BV(TOIE1);} while (0)
 #define breathing_interrupt_disable() do {TIMSK1 &= ~_BV(TOIE1);} while (0)
+#endif
 #define breathing_min() do {breathing_counter = 0;} while (0)
 #define breathing_max() do {breathing_counter = breathing_period * 244 / 2;} while (0)
 
@@ -1180,10 +1300,10 @@ static inline uint16_t scale_backlight(uint16_t v) {
   return v / BACKLIGHT_LEVELS * get_backlight_level();
 }
 
-/* Assuming a 16MHz CPU clock and a timer that resets at 64k (ICR1), the following interrupt handler will run
- * about 244 times per second.
+/* Assuming a 16MHz CPU clock and a timer that resets at 64k (ICR1), this runs
+ * about 244 times per second from the overflow interrupt.
  */
-ISR(TIMER1_OVF_vect)
+static inline void breathing_task(void)
 {
   uint16_t interval = (uint16_t) breathing_period * 244 / BREATHING_STEPS;
   // resetting after one period to prevent ugly reset at overflow.
@@ -1196,14 +1316,48 @@ ISR(TIMER1_OVF_vect)
       breathing_interrupt_disable();
   }
 
+  // the curve only moves every interval ticks, skip the cie math in between
+  if (index == breathing_index)
+    return;
+  breathing_index = index;
+
   set_pwm(cie_lightness(scale_backlight((uint16_t) pgm_read_byte(&breathing_table[index]) * 0x0101U)));
 }
 
 #endif // BACKLIGHT_BREATHING
 
+#ifdef NO_HARDWARE_PWM
+// Overflow starts every pwm period. When the duty is shorter than the
+// latency of this interrupt, the compare match is already past and, having
+// the higher priority, may even have run first. Switching the pins on then
+// would keep them on for the whole period, so such a period stays off.
+ISR(TIMER1_OVF_vect)
+{
+  if (backlight_pwm_on && TCNT1 < OCRxx)
+    backlight_pins_on();
+  #ifdef BACKLIGHT_BREATHING
+  if (breathing)
+    breathing_task();
+  #endif
+}
+#elif defined(BACKLIGHT_BREATHING)
+ISR(TIMER1_OVF_vect)
+{
+  breathing_task();
+}
+#endif
+
 __attribute__ ((weak))
 void backlight_init_ports(void)
 {
+#ifdef NO_HARDWARE_PWM
+  // Setup backlight pins as output and output to off state, the interrupts take it from here.
+  FOR_EACH_BACKLIGHT_PIN(i) {
+    // DDRx |= n
+    _SFR_IO8((backlight_pins[i] >> 4) + 1) |= _BV(backlight_pins[i] & 0xF);
+  }
+  backlight_pins_off();
+#else
   // Setup backlight pin as output and output to on state.
   // DDRx |= n
   _SFR_IO8((backlight_pin >> 4) + 1) |= _BV(backlight_pin & 0xF);
@@ -1214,6 +1368,9 @@ void backlight_init_ports(void)
     // PORTx |= n
     _SFR_IO8((backlight_pin >> 4) + 2) |= _BV(backlight_pin & 0xF);
   #endif
+#endif
+  backlight_duty_table_init();
+
   // I could write a wall of text here to explain... but TL;DW
   // Go read the ATmega32u4 datasheet.
   // And this: http://blog.saikoled.com/post/43165849837/secret-konami-cheat-code-to-high-resolution-pwm-on
@@ -1229,10 +1386,19 @@ void backlight_init_ports(void)
   "In fast PWM mode, the compare units allow generation of PWM waveforms on the OCnx pins. Setting the COMnx1:0 bits to two will produce a non-inverted PWM [..]."
   "In fast PWM mode the counter is incremented until the counter value matches either one of the fixed values 0x00FF, 0x01FF, or 0x03FF (WGMn3:0 = 5, 6, or 7), the value in ICRn (WGMn3:0 = 14), or the value in OCRnA (WGMn3:0 = 15)."
   */
+#ifdef NO_HARDWARE_PWM
+  // Same timer mode, but nothing is connected to the output compare pin. The
+  // overflow interrupt turns the pins on and the compare A interrupt turns them off.
+  TCCR1A = _BV(WGM11);
+  TCCR1B = _BV(WGM13) | _BV(WGM12) | _BV(CS10);
+  ICRx = TIMER_TOP;
+  TIMSK1 |= _BV(OCIE1A) | _BV(TOIE1);
+#else
   TCCRxA = _BV(COMxx1) | _BV(WGM11); // = 0b00001010;
   TCCRxB = _BV(WGM13) | _BV(WGM12) | _BV(CS10); // = 0b00011001;
   // Use full 16-bit resolution. Counter counts to ICR1 before reset to 0.
   ICRx = TIMER_TOP;
+#endif
 
   backlight_init();
   #ifdef BACKLIGHT_BREATHING
@@ -1240,7 +1406,7 @@ void backlight_init_ports(void)
   #endif
 }
 
-#endif // NO_HARDWARE_PWM
+#endif // NO_HARDWARE_PWM && BACKLIGHT_CUSTOM_DRIVER
 
 #else // backlight
 
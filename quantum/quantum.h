@@ -52,6 +52,7 @@
 #include "action_util.h"
 #include <stdlib.h>
 #include "print.h"
+#include "profiler.h"
 #include "send_string_keycodes.h"
 
 extern uint32_t default_layer_state;
@@ -127,6 +128,10 @@ extern uint32_t default_layer_state;
 	#include "process_terminal_nop.h"
 #endif
 
+#ifdef DYNAMIC_KEYMAP_ENABLE
+	#include "dynamic_keymap.h"
+#endif
+
 #ifdef HD44780_ENABLE
 	#include "hd44780.h"
 #endif
@@ -169,6 +174,9 @@ void tap_random_base64(void);
 
 void matrix_init_kb(void);
 void matrix_scan_kb(void);
+void quantum_task(void);
+void dynamic_macro_task(void);
+void quantum_led_task(void);
 void matrix_init_user(void);
 void matrix_scan_user(void);
 bool process_action_kb(keyrecord_t *record);
@@ -26,6 +26,8 @@
 #include "eeprom.h"
 #include "lufa.h"
 #include <math.h>
+#include <string.h>
+#include "spsc_queue.h"
 
 rgb_config_t rgb_matrix_config;
 
@@ -61,10 +63,10 @@ uint32_t g_any_key_hit = 0;
 #endif
 
 uint32_t eeconfig_read_rgb_matrix(void) {
-  return eeprom_read_dword(EECONFIG_RGB_MATRIX);
+  return eeconfig_read_dword(EECONFIG_RGB_MATRIX);
 }
 void eeconfig_update_rgb_matrix(uint32_t val) {
-  eeprom_update_dword(EECONFIG_RGB_MATRIX, val);
+  eeconfig_update_dword(EECONFIG_RGB_MATRIX, val);
 }
 void eeconfig_update_rgb_matrix_default(void) {
   dprintf("eeconfig_update_rgb_matrix_default\n");
@@ -91,17 +93,78 @@ void eeconfig_debug_rgb_matrix(void) {
 uint8_t g_last_led_hit[LED_HITS_TO_REMEMBER] = {255};
 uint8_t g_last_led_count = 0;
 
-void map_row_column_to_led( uint8_t row, uint8_t column, uint8_t *led_i, uint8_t *led_count) {
-    rgb_led led;
-    *led_count = 0;
+// Key hits queued by process_rgb_matrix() for rgb_matrix_task(). With the
+// threaded runtime they run in different threads, this way only the led
+// thread touches the hit state above. Two bytes per hit: the row, then the
+// column with the pressed flag in bit 7.
+#ifndef RGB_MATRIX_HIT_QUEUE_SIZE
+    #define RGB_MATRIX_HIT_QUEUE_SIZE 32
+#endif
+#if MATRIX_COLS > 128
+    #error "The RGB matrix hit queue packs the column into 7 bits"
+#endif
+#define HIT_PRESSED 0x80
+static uint8_t g_hit_buffer[RGB_MATRIX_HIT_QUEUE_SIZE];
+static spsc_queue_t g_hit_queue = SPSC_QUEUE_INITIALIZER(g_hit_buffer);
+
+// First LED under each key and the next LED under the same key, 255 ends
+// the list. Built once in rgb_matrix_init() since g_rgb_leds never changes.
+#define NO_LED 255
+static uint8_t g_key_first_led[MATRIX_ROWS][MATRIX_COLS];
+static uint8_t g_led_next_same_key[DRIVER_LED_TOTAL];
+
+// LEDs bucketed into a grid of square cells by position. The LEDs of cell n
+// are g_grid_leds[g_grid_start[n]] up to g_grid_leds[g_grid_start[n + 1] - 1].
+#define RGB_MATRIX_GRID_SHIFT 5
+#define RGB_MATRIX_GRID_SIZE (256 >> RGB_MATRIX_GRID_SHIFT)
+#define RGB_MATRIX_GRID_CELLS (RGB_MATRIX_GRID_SIZE * RGB_MATRIX_GRID_SIZE)
+static uint8_t g_grid_start[RGB_MATRIX_GRID_CELLS + 1];
+static uint8_t g_grid_leds[DRIVER_LED_TOTAL];
+
+static uint8_t rgb_matrix_grid_cell(Point point) {
+    return (point.y >> RGB_MATRIX_GRID_SHIFT) * RGB_MATRIX_GRID_SIZE + (point.x >> RGB_MATRIX_GRID_SHIFT);
+}
+
+static void rgb_matrix_build_led_index(void) {
+    for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+        for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+            g_key_first_led[row][col] = NO_LED;
+        }
+    }
+    // backwards, so the LEDs of a key end up in ascending order
+    for (uint8_t i = DRIVER_LED_TOTAL; i-- > 0;) {
+        uint8_t row = g_rgb_leds[i].matrix_co.row;
+        uint8_t col = g_rgb_leds[i].matrix_co.col;
+        g_led_next_same_key[i] = NO_LED;
+        if (row < MATRIX_ROWS && col < MATRIX_COLS) {
+            g_led_next_same_key[i] = g_key_first_led[row][col];
+            g_key_first_led[row][col] = i;
+        }
+    }
 
+    // counting sort of the LEDs by grid cell
+    memset(g_grid_start, 0, sizeof(g_grid_start));
     for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
-        // map_index_to_led(i, &led);
-        led = g_rgb_leds[i];
-        if (row == led.matrix_co.row && column == led.matrix_co.col) {
-            led_i[*led_count] = i;
-            (*led_count)++;
-        }
+        g_grid_start[rgb_matrix_grid_cell(g_rgb_leds[i].point) + 1]++;
+    }
+    for (uint8_t cell = 0; cell < RGB_MATRIX_GRID_CELLS; cell++) {
+        g_grid_start[cell + 1] += g_grid_start[cell];
+    }
+    uint8_t fill[RGB_MATRIX_GRID_CELLS];
+    memcpy(fill, g_grid_start, sizeof(fill));
+    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        g_grid_leds[fill[rgb_matrix_grid_cell(g_rgb_leds[i].point)]++] = i;
+    }
+}
+
+void map_row_column_to_led( uint8_t row, uint8_t column, uint8_t *led_i, uint8_t *led_count) {
+    *led_count = 0;
+    if (row >= MATRIX_ROWS || column >= MATRIX_COLS) {
+        return;
+    }
+    for (uint8_t i = g_key_first_led[row][column]; i != NO_LED; i = g_led_next_same_key[i]) {
+        led_i[*led_count] = i;
+        (*led_count)++;
     }
 }
 
@@ -119,9 +182,23 @@ void rgb_matrix_set_color_all( uint8_t red, uint8_t green, uint8_t blue ) {
 }
 
 bool process_rgb_matrix(uint16_t keycode, keyrecord_t *record) {
-    if ( record->event.pressed ) {
+    #ifndef RGB_MATRIX_KEYRELEASES
+    if ( !record->event.pressed ) {
+        return true;
+    }
+    #endif
+    // a hit that does not fit only misses its animation
+    if ( spsc_queue_space(&g_hit_queue) >= 2 ) {
+        spsc_queue_push(&g_hit_queue, record->event.key.row);
+        spsc_queue_push(&g_hit_queue, record->event.key.col | (record->event.pressed ? HIT_PRESSED : 0));
+    }
+    return true;
+}
+
+static void rgb_matrix_apply_hit(uint8_t row, uint8_t column, bool pressed) {
+    if ( pressed ) {
         uint8_t led[8], led_count;
-        map_row_column_to_led(record->event.key.row, record->event.key.col, led, &led_count);
+        map_row_column_to_led(row, column, led, &led_count);
         if (led_count > 0) {
             for (uint8_t i = LED_HITS_TO_REMEMBER; i > 1; i--) {
                 g_last_led_hit[i - 1] = g_last_led_hit[i - 2];
@@ -133,16 +210,23 @@ bool process_rgb_matrix(uint16_t keycode, keyrecord_t *record) {
             g_key_hit[led[i]] = 0;
         g_any_key_hit = 0;
     } else {
-        #ifdef RGB_MATRIX_KEYRELEASES
         uint8_t led[8], led_count;
-        map_row_column_to_led(record->event.key.row, record->event.key.col, led, &led_count);
+        map_row_column_to_led(row, column, led, &led_count);
         for(uint8_t i = 0; i < led_count; i++)
             g_key_hit[led[i]] = 255;
 
         g_any_key_hit = 255;
-        #endif
     }
-    return true;
+}
+
+static void rgb_matrix_apply_hits(void) {
+    // the producer pushes the row first, so a pair is complete once both are in
+    while ( spsc_queue_count(&g_hit_queue) >= 2 ) {
+        uint8_t row, column;
+        spsc_queue_pop(&g_hit_queue, &row);
+        spsc_queue_pop(&g_hit_queue, &column);
+        rgb_matrix_apply_hit(row, column & ~HIT_PRESSED, column & HIT_PRESSED);
+    }
 }
 
 void rgb_matrix_set_suspend_state(bool state) {
@@ -492,34 +576,92 @@ void rgb_matrix_jellybean_raindrops( bool initialize ) {
     }
 }
 
-void rgb_matrix_multisplash(void) {
-    // if (g_any_key_hit < 0xFF) {
-        HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
-        RGB rgb;
-        rgb_led led;
-        for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
-            led = g_rgb_leds[i];
-            uint16_t c = 0, d = 0;
-            rgb_led last_led;
-            // if (g_last_led_count) {
-                for (uint8_t last_i = 0; last_i < g_last_led_count; last_i++) {
-                    last_led = g_rgb_leds[g_last_led_hit[last_i]];
-                    uint16_t dist = (uint16_t)sqrt(pow(led.point.x - last_led.point.x, 2) + pow(led.point.y - last_led.point.y, 2));
-                    uint16_t effect = (g_key_hit[g_last_led_hit[last_i]] << 2) - dist;
-                    c += MIN(MAX(effect, 0), 255);
-                    d += 255 - MIN(MAX(effect, 0), 255);
+// floor(sqrt(value)), bit by bit
+static uint16_t isqrt32(uint32_t value) {
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > value) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (value >= root + bit) {
+            value -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return root;
+}
+
+// Distance of value from the range [low, high] and of the far end
+static void rgb_matrix_span_distance(uint8_t value, uint8_t low, uint8_t high, uint8_t *near, uint8_t *far) {
+    *near = value < low ? low - value : value > high ? value - high : 0;
+    *far = MAX(abs(value - low), abs(value - high));
+}
+
+// Adds the rings of the remembered hits. Each hit lights the LEDs whose
+// distance lies in (age * 4 - 255, age * 4] with a strength of
+// effect = age * 4 - distance, every other LED counts as effect 255.
+// hue gets the sum of all effects (mod 256) and val the saturated sum of
+// 255 - effect. Only grid cells that overlap a ring are looked at.
+static void rgb_matrix_splash_rings(uint8_t *hue, uint8_t *val) {
+    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        hue[i] = -g_last_led_count;
+        val[i] = 0;
+    }
+    for (uint8_t last_i = 0; last_i < g_last_led_count; last_i++) {
+        Point hit = g_rgb_leds[g_last_led_hit[last_i]].point;
+        int16_t outer = g_key_hit[g_last_led_hit[last_i]] << 2;
+        int16_t inner = MAX(outer - 254, 0);
+        // no two LEDs are further apart than the corners of the 255x255 space
+        if (inner > 360) {
+            continue;
+        }
+        uint32_t inner_sq = (uint32_t)inner * inner;
+        uint32_t outer_sq = (uint32_t)(outer + 1) * (outer + 1);
+
+        for (uint8_t cell = 0; cell < RGB_MATRIX_GRID_CELLS; cell++) {
+            if (g_grid_start[cell] == g_grid_start[cell + 1]) {
+                continue;
+            }
+            uint8_t x0 = (cell % RGB_MATRIX_GRID_SIZE) << RGB_MATRIX_GRID_SHIFT;
+            uint8_t y0 = (cell / RGB_MATRIX_GRID_SIZE) << RGB_MATRIX_GRID_SHIFT;
+            uint8_t near_x, far_x, near_y, far_y;
+            rgb_matrix_span_distance(hit.x, x0, x0 + (1 << RGB_MATRIX_GRID_SHIFT) - 1, &near_x, &far_x);
+            rgb_matrix_span_distance(hit.y, y0, y0 + (1 << RGB_MATRIX_GRID_SHIFT) - 1, &near_y, &far_y);
+            if ((uint32_t)far_x * far_x + (uint32_t)far_y * far_y < inner_sq ||
+                (uint32_t)near_x * near_x + (uint32_t)near_y * near_y >= outer_sq) {
+                continue;
+            }
+            for (uint8_t j = g_grid_start[cell]; j < g_grid_start[cell + 1]; j++) {
+                uint8_t led_i = g_grid_leds[j];
+                uint8_t dx = abs(g_rgb_leds[led_i].point.x - hit.x);
+                uint8_t dy = abs(g_rgb_leds[led_i].point.y - hit.y);
+                uint32_t dist_sq = (uint32_t)dx * dx + (uint32_t)dy * dy;
+                if (dist_sq < inner_sq || dist_sq >= outer_sq) {
+                    continue;
                 }
-            // } else {
-            //     d = 255;
-            // }
-            hsv.h = (rgb_matrix_config.hue + c) % 256;
-            hsv.v = MAX(MIN(d, 255), 0);
-            rgb = hsv_to_rgb( hsv );
-            rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
+                uint8_t effect = outer - isqrt32(dist_sq);
+                hue[led_i] += effect + 1;
+                val[led_i] = MIN(val[led_i] + (255 - effect), 255);
+            }
         }
-    // } else {
-        // rgb_matrix_set_color_all( 0, 0, 0 );
-    // }
+    }
+}
+
+void rgb_matrix_multisplash(void) {
+    HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
+    RGB rgb;
+    uint8_t hue[DRIVER_LED_TOTAL], val[DRIVER_LED_TOTAL];
+    rgb_matrix_splash_rings(hue, val);
+    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        hsv.h = (rgb_matrix_config.hue + hue[i]) % 256;
+        hsv.v = val[i];
+        rgb = hsv_to_rgb( hsv );
+        rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
+    }
 }
 
 
@@ -530,31 +672,15 @@ void rgb_matrix_splash(void) {
 
 
 void rgb_matrix_solid_multisplash(void) {
-    // if (g_any_key_hit < 0xFF) {
-        HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
-        RGB rgb;
-        rgb_led led;
-        for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
-            led = g_rgb_leds[i];
-            uint16_t d = 0;
-            rgb_led last_led;
-            // if (g_last_led_count) {
-                for (uint8_t last_i = 0; last_i < g_last_led_count; last_i++) {
-                    last_led = g_rgb_leds[g_last_led_hit[last_i]];
-                    uint16_t dist = (uint16_t)sqrt(pow(led.point.x - last_led.point.x, 2) + pow(led.point.y - last_led.point.y, 2));
-                    uint16_t effect = (g_key_hit[g_last_led_hit[last_i]] << 2) - dist;
-                    d += 255 - MIN(MAX(effect, 0), 255);
-                }
-            // } else {
-            //     d = 255;
-            // }
-            hsv.v = MAX(MIN(d, 255), 0);
-            rgb = hsv_to_rgb( hsv );
-            rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
-        }
-    // } else {
-        // rgb_matrix_set_color_all( 0, 0, 0 );
-    // }
+    HSV hsv = { .h = rgb_matrix_config.hue, .s = rgb_matrix_config.sat, .v = rgb_matrix_config.val };
+    RGB rgb;
+    uint8_t hue[DRIVER_LED_TOTAL], val[DRIVER_LED_TOTAL];
+    rgb_matrix_splash_rings(hue, val);
+    for (uint8_t i = 0; i < DRIVER_LED_TOTAL; i++) {
+        hsv.v = val[i];
+        rgb = hsv_to_rgb( hsv );
+        rgb_matrix_set_color( i, rgb.r, rgb.g, rgb.b );
+    }
 }
 
 
@@ -581,6 +707,7 @@ void rgb_matrix_custom(void) {
 
 void rgb_matrix_task(void) {
     static uint8_t toggle_enable_last = 255;
+    rgb_matrix_apply_hits();
 	if (!rgb_matrix_config.enable) {
     	rgb_matrix_all_off();
         toggle_enable_last = rgb_matrix_config.enable;
@@ -726,6 +853,7 @@ void rgb_matrix_indicators_user(void) {}
 
 void rgb_matrix_init(void) {
   rgb_matrix_setup_drivers();
+  rgb_matrix_build_led_index();
 
   // TODO: put the 1 second startup delay here?
 
@@ -14,6 +14,7 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <math.h>
+#include <string.h>
 #ifdef __AVR__
   #include <avr/eeprom.h>
   #include <avr/interrupt.h>
@@ -52,6 +53,17 @@ rgblight_config_t rgblight_config;
 LED_TYPE led[RGBLED_NUM];
 bool rgblight_timer_enabled = false;
 
+// The last frame sent to the strip, identical frames aren't sent again
+static LED_TYPE led_sent[RGBLED_NUM];
+static bool led_sent_valid = false;
+
+#ifdef RGBLIGHT_ANIMATIONS
+// Hue of each LED relative to the first one for the full circle effects,
+// built for led_hue_offset_num LEDs, 0 when it has to be rebuilt
+static uint16_t led_hue_offset[RGBLED_NUM];
+static uint8_t led_hue_offset_num = 0;
+#endif
+
 void sethsv(uint16_t hue, uint8_t sat, uint8_t val, LED_TYPE *led1) {
   uint8_t r = 0, g = 0, b = 0, base, color;
 
@@ -116,14 +128,14 @@ void setrgb(uint8_t r, uint8_t g, uint8_t b, LED_TYPE *led1) {
 
 uint32_t eeconfig_read_rgblight(void) {
   #ifdef __AVR__
-    return eeprom_read_dword(EECONFIG_RGBLIGHT);
+    return eeconfig_read_dword(EECONFIG_RGBLIGHT);
   #else
     return 0;
   #endif
 }
 void eeconfig_update_rgblight(uint32_t val) {
   #ifdef __AVR__
-    eeprom_update_dword(EECONFIG_RGBLIGHT, val);
+    eeconfig_update_dword(EECONFIG_RGBLIGHT, val);
   #endif
 }
 void eeconfig_update_rgblight_default(void) {
@@ -242,31 +254,20 @@ void rgblight_mode_eeprom_helper(uint8_t mode, bool write_to_eeprom) {
   } else {
     xprintf("rgblight mode [NOEEPROM]: %u\n", rgblight_config.mode);
   }
-  if (rgblight_config.mode == 1) {
-    #ifdef RGBLIGHT_ANIMATIONS
-      rgblight_timer_disable();
-    #endif
-  } else if ((rgblight_config.mode >= 2 && rgblight_config.mode <= 24) ||
-	     rgblight_config.mode == 35 || rgblight_config.mode == 36) {
-    // MODE 2-5, breathing
-    // MODE 6-8, rainbow mood
-    // MODE 9-14, rainbow swirl
-    // MODE 15-20, snake
-    // MODE 21-23, knight
-    // MODE 24, xmas
-    // MODE 35  RGB test
-    // MODE 36, alterating
-
-    #ifdef RGBLIGHT_ANIMATIONS
+  #ifdef RGBLIGHT_ANIMATIONS
+    if (rgblight_mode_is_animated(rgblight_config.mode)) {
       rgblight_timer_enable();
-    #endif
-  } else if (rgblight_config.mode >= 25 && rgblight_config.mode <= 34) {
-    // MODE 25-34, static gradient
-
-    #ifdef RGBLIGHT_ANIMATIONS
+    } else {
+      // MODE 1, static light
+      // MODE 25-34, static gradient
       rgblight_timer_disable();
-    #endif
-  }
+    }
+  #endif
+  // the next frame has to reach the strip even if it matches an old one
+  led_sent_valid = false;
+  #ifdef RGBLIGHT_ANIMATIONS
+    led_hue_offset_num = 0;
+  #endif
   rgblight_sethsv_noeeprom(rgblight_config.hue, rgblight_config.sat, rgblight_config.val);
 }
 
@@ -505,31 +506,49 @@ void rgblight_sethsv_at(uint16_t hue, uint8_t sat, uint8_t val, uint8_t index) {
   rgblight_setrgb_at(tmp_led.r, tmp_led.g, tmp_led.b, index);
 }
 
+#if !defined(RGBLIGHT_CUSTOM_DRIVER) || defined(RGBLIGHT_ANIMATIONS)
+static bool rgblight_frame_changed(void) {
+  if (led_sent_valid && memcmp(led_sent, led, sizeof(led)) == 0) {
+    return false;
+  }
+  memcpy(led_sent, led, sizeof(led));
+  led_sent_valid = true;
+  return true;
+}
+#endif
+
 #ifndef RGBLIGHT_CUSTOM_DRIVER
 void rgblight_set(void) {
-  if (rgblight_config.enable) {
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
-  } else {
+  if (!rgblight_config.enable) {
     for (uint8_t i = 0; i < RGBLED_NUM; i++) {
       led[i].r = 0;
       led[i].g = 0;
       led[i].b = 0;
     }
-    #ifdef RGBW
-      ws2812_setleds_rgbw(led, RGBLED_NUM);
-    #else
-      ws2812_setleds(led, RGBLED_NUM);
-    #endif
   }
+  if (!rgblight_frame_changed()) {
+    return;
+  }
+  #ifdef RGBW
+    ws2812_setleds_rgbw(led, RGBLED_NUM);
+  #else
+    ws2812_setleds(led, RGBLED_NUM);
+  #endif
 }
 #endif
 
 #ifdef RGBLIGHT_ANIMATIONS
 
+static void rgblight_update_hue_offsets(void) {
+  if (led_hue_offset_num == RGBLED_NUM) {
+    return;
+  }
+  for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+    led_hue_offset[i] = 360 / RGBLED_NUM * i;
+  }
+  led_hue_offset_num = RGBLED_NUM;
+}
+
 // Animation timer -- AVR Timer3
 void rgblight_timer_init(void) {
   // static uint8_t rgblight_timer_is_init = 0;
@@ -568,36 +587,112 @@ void rgblight_show_solid_color(uint8_t r, uint8_t g, uint8_t b) {
   rgblight_setrgb(r, g, b);
 }
 
+static void rgblight_effect_christmas_variant(uint8_t variant) {
+  (void)variant;
+  rgblight_effect_christmas();
+}
+static void rgblight_effect_rgbtest_variant(uint8_t variant) {
+  (void)variant;
+  rgblight_effect_rgbtest();
+}
+static void rgblight_effect_alternating_variant(uint8_t variant) {
+  (void)variant;
+  rgblight_effect_alternating();
+}
+
+// Animated modes, each effect covers count modes starting at mode and is
+// passed the offset into that range. Modes not listed here are static.
+static const struct {
+  uint8_t mode;
+  uint8_t count;
+  void (*render)(uint8_t variant);
+} rgblight_effects[] = {
+  { 2,  4, rgblight_effect_breathing },
+  { 6,  3, rgblight_effect_rainbow_mood },
+  { 9,  6, rgblight_effect_rainbow_swirl },
+  { 15, 6, rgblight_effect_snake },
+  { 21, 3, rgblight_effect_knight },
+  { 24, 1, rgblight_effect_christmas_variant },
+  { 35, 1, rgblight_effect_rgbtest_variant },
+  { 36, 1, rgblight_effect_alternating_variant },
+};
+#define RGBLIGHT_EFFECT_COUNT (sizeof(rgblight_effects) / sizeof(rgblight_effects[0]))
+
+// Index into rgblight_effects[], or the table size for static modes
+static uint8_t rgblight_find_effect(uint8_t mode) {
+  uint8_t i = 0;
+  while (i < RGBLIGHT_EFFECT_COUNT && (uint8_t)(mode - rgblight_effects[i].mode) >= rgblight_effects[i].count) {
+    i++;
+  }
+  return i;
+}
+
+bool rgblight_mode_is_animated(uint8_t mode) {
+  return rgblight_find_effect(mode) < RGBLIGHT_EFFECT_COUNT;
+}
+
+// Renders the next frame of the current effect, only from the main loop as
+// the setters write led[] and the mode without masking interrupts
+static void rgblight_effect_render(void) {
+  static uint8_t last_mode = 0;
+  static uint8_t effect = RGBLIGHT_EFFECT_COUNT;
+
+  if (!rgblight_timer_enabled) {
+    return;
+  }
+  // the mode only changes on user input, so remember where it was found
+  if (rgblight_config.mode != last_mode) {
+    last_mode = rgblight_config.mode;
+    effect = rgblight_find_effect(last_mode);
+  }
+  if (effect < RGBLIGHT_EFFECT_COUNT) {
+    rgblight_effects[effect].render(last_mode - rgblight_effects[effect].mode);
+  }
+}
+
+#ifdef RGBLIGHT_EFFECT_TIMER
+static volatile bool rgblight_tick_pending = false;
+#endif
+
+// Safe to call from an interrupt, it only asks rgblight_task() for a frame
+void rgblight_effect_tick(void) {
+  #ifdef RGBLIGHT_EFFECT_TIMER
+    rgblight_tick_pending = true;
+  #endif
+}
+
 void rgblight_task(void) {
-  if (rgblight_timer_enabled) {
-    // mode = 1, static light, do nothing here
-    if (rgblight_config.mode >= 2 && rgblight_config.mode <= 5) {
-      // mode = 2 to 5, breathing mode
-      rgblight_effect_breathing(rgblight_config.mode - 2);
-    } else if (rgblight_config.mode >= 6 && rgblight_config.mode <= 8) {
-      // mode = 6 to 8, rainbow mood mod
-      rgblight_effect_rainbow_mood(rgblight_config.mode - 6);
-    } else if (rgblight_config.mode >= 9 && rgblight_config.mode <= 14) {
-      // mode = 9 to 14, rainbow swirl mode
-      rgblight_effect_rainbow_swirl(rgblight_config.mode - 9);
-    } else if (rgblight_config.mode >= 15 && rgblight_config.mode <= 20) {
-      // mode = 15 to 20, snake mode
-      rgblight_effect_snake(rgblight_config.mode - 15);
-    } else if (rgblight_config.mode >= 21 && rgblight_config.mode <= 23) {
-      // mode = 21 to 23, knight mode
-      rgblight_effect_knight(rgblight_config.mode - 21);
-    } else if (rgblight_config.mode == 24) {
-      // mode = 24, christmas mode
-      rgblight_effect_christmas();
-    } else if (rgblight_config.mode == 35) {
-      // mode = 35, RGB test
-      rgblight_effect_rgbtest();
-    } else if (rgblight_config.mode == 36){
-      rgblight_effect_alternating();
+  #ifdef RGBLIGHT_EFFECT_TIMER
+    if (!rgblight_tick_pending) {
+      return;
     }
+    rgblight_tick_pending = false;
+  #endif
+  rgblight_effect_render();
+}
+
+// Fills the frame buffer with a single color without sending it
+static void rgblight_fill_hsv(uint16_t hue, uint8_t sat, uint8_t val) {
+  LED_TYPE tmp_led;
+  sethsv(hue, sat, val, &tmp_led);
+  for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+    led[i].r = tmp_led.r;
+    led[i].g = tmp_led.g;
+    led[i].b = tmp_led.b;
   }
 }
 
+// Hands a frame rendered into led[] by an effect to the strip
+static void rgblight_push_frame(void) {
+  #ifdef RGBLIGHT_CUSTOM_DRIVER
+    // custom drivers don't filter unchanged frames themselves
+    if (!rgblight_frame_changed()) {
+      return;
+    }
+  #endif
+  rgblight_set();
+}
+
 // Effects
 void rgblight_effect_breathing(uint8_t interval) {
   static uint8_t pos = 0;
@@ -612,8 +707,9 @@ void rgblight_effect_breathing(uint8_t interval) {
 
   // http://sean.voisen.org/blog/2011/10/breathing-led-with-arduino/
   val = (exp(sin((pos/255.0)*M_PI)) - RGBLIGHT_EFFECT_BREATHE_CENTER/M_E)*(RGBLIGHT_EFFECT_BREATHE_MAX/(M_E-1/M_E));
-  rgblight_sethsv_noeeprom_old(rgblight_config.hue, rgblight_config.sat, val);
+  rgblight_fill_hsv(rgblight_config.hue, rgblight_config.sat, val);
   pos = (pos + 1) % 256;
+  rgblight_push_frame();
 }
 void rgblight_effect_rainbow_mood(uint8_t interval) {
   static uint16_t current_hue = 0;
@@ -623,8 +719,9 @@ void rgblight_effect_rainbow_mood(uint8_t interval) {
     return;
   }
   last_timer = timer_read();
-  rgblight_sethsv_noeeprom_old(current_hue, rgblight_config.sat, rgblight_config.val);
+  rgblight_fill_hsv(current_hue, rgblight_config.sat, rgblight_config.val);
   current_hue = (current_hue + 1) % 360;
+  rgblight_push_frame();
 }
 void rgblight_effect_rainbow_swirl(uint8_t interval) {
   static uint16_t current_hue = 0;
@@ -635,11 +732,15 @@ void rgblight_effect_rainbow_swirl(uint8_t interval) {
     return;
   }
   last_timer = timer_read();
+  rgblight_update_hue_offsets();
   for (i = 0; i < RGBLED_NUM; i++) {
-    hue = (360 / RGBLED_NUM * i + current_hue) % 360;
+    // both are below 360
+    hue = led_hue_offset[i] + current_hue;
+    if (hue >= 360) {
+      hue -= 360;
+    }
     sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
   }
-  rgblight_set();
 
   if (interval % 2) {
     current_hue = (current_hue + 1) % 360;
@@ -650,6 +751,7 @@ void rgblight_effect_rainbow_swirl(uint8_t interval) {
       current_hue = current_hue - 1;
     }
   }
+  rgblight_push_frame();
 }
 void rgblight_effect_snake(uint8_t interval) {
   static uint8_t pos = 0;
@@ -668,17 +770,17 @@ void rgblight_effect_snake(uint8_t interval) {
     led[i].r = 0;
     led[i].g = 0;
     led[i].b = 0;
-    for (j = 0; j < RGBLIGHT_EFFECT_SNAKE_LENGTH; j++) {
-      k = pos + j * increment;
-      if (k < 0) {
-        k = k + RGBLED_NUM;
-      }
-      if (i == k) {
-        sethsv(rgblight_config.hue, rgblight_config.sat, (uint8_t)(rgblight_config.val*(RGBLIGHT_EFFECT_SNAKE_LENGTH-j)/RGBLIGHT_EFFECT_SNAKE_LENGTH), (LED_TYPE *)&led[i]);
-      }
+  }
+  // only the LEDs under the snake need a color
+  for (j = 0; j < RGBLIGHT_EFFECT_SNAKE_LENGTH; j++) {
+    k = pos + j * increment;
+    if (k < 0) {
+      k = k + RGBLED_NUM;
+    }
+    if (k < RGBLED_NUM) {
+      sethsv(rgblight_config.hue, rgblight_config.sat, (uint8_t)(rgblight_config.val*(RGBLIGHT_EFFECT_SNAKE_LENGTH-j)/RGBLIGHT_EFFECT_SNAKE_LENGTH), (LED_TYPE *)&led[k]);
     }
   }
-  rgblight_set();
   if (increment == 1) {
     if (pos - 1 < 0) {
       pos = RGBLED_NUM - 1;
@@ -688,6 +790,7 @@ void rgblight_effect_snake(uint8_t interval) {
   } else {
     pos = (pos + 1) % RGBLED_NUM;
   }
+  rgblight_push_frame();
 }
 void rgblight_effect_knight(uint8_t interval) {
   static uint16_t last_timer = 0;
@@ -719,7 +822,6 @@ void rgblight_effect_knight(uint8_t interval) {
       led[cur].b = 0;
     }
   }
-  rgblight_set();
 
   // Move from low_bound to high_bound changing the direction we increment each
   // time a boundary is hit.
@@ -729,6 +831,7 @@ void rgblight_effect_knight(uint8_t interval) {
   if (high_bound <= 0 || low_bound >= RGBLIGHT_EFFECT_KNIGHT_LED_NUM - 1) {
     increment = -increment;
   }
+  rgblight_push_frame();
 }
 
 
@@ -746,7 +849,7 @@ void rgblight_effect_christmas(void) {
     hue = 0 + ((i/RGBLIGHT_EFFECT_CHRISTMAS_STEP + current_offset) % 2) * 120;
     sethsv(hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
   }
-  rgblight_set();
+  rgblight_push_frame();
 }
 
 void rgblight_effect_rgbtest(void) {
@@ -771,8 +874,13 @@ void rgblight_effect_rgbtest(void) {
     case 1: g = maxval; break;
     case 2: b = maxval; break;
   }
-  rgblight_setrgb(r, g, b);
+  for (uint8_t i = 0; i < RGBLED_NUM; i++) {
+    led[i].r = r;
+    led[i].g = g;
+    led[i].b = b;
+  }
   pos = (pos + 1) % 3;
+  rgblight_push_frame();
 }
 
 void rgblight_effect_alternating(void){
@@ -785,15 +893,15 @@ void rgblight_effect_alternating(void){
 
   for(int i = 0; i<RGBLED_NUM; i++){
 		  if(i<RGBLED_NUM/2 && pos){
-			  rgblight_sethsv_at(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, i);
+			  sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
 		  }else if (i>=RGBLED_NUM/2 && !pos){
-			  rgblight_sethsv_at(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, i);
+			  sethsv(rgblight_config.hue, rgblight_config.sat, rgblight_config.val, (LED_TYPE *)&led[i]);
 		  }else{
-			  rgblight_sethsv_at(rgblight_config.hue, rgblight_config.sat, 0, i);
+			  sethsv(rgblight_config.hue, rgblight_config.sat, 0, (LED_TYPE *)&led[i]);
 		  }
   }
-  rgblight_set();
   pos = (pos + 1) % 2;
+  rgblight_push_frame();
 }
 
 #endif /* RGBLIGHT_ANIMATIONS */
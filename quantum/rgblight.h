@@ -154,6 +154,8 @@ void rgblight_mode_eeprom_helper(uint8_t mode, bool write_to_eeprom);
 void rgblight_show_solid_color(uint8_t r, uint8_t g, uint8_t b);
 
 void rgblight_task(void);
+void rgblight_effect_tick(void);
+bool rgblight_mode_is_animated(uint8_t mode);
 
 void rgblight_timer_init(void);
 void rgblight_timer_enable(void);
@@ -0,0 +1,232 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "animation_scheduler.h"
+
+//#define DEBUG_VISUALIZER
+
+#ifdef DEBUG_VISUALIZER
+#include "debug.h"
+#else
+#include "nodebug.h"
+#endif
+
+typedef struct {
+    keyframe_animation_t* animation;
+    systemticks_t last_update;
+    bool deferred;
+} scheduled_animation_t;
+
+// Sorted by priority, highest first. Animations with the same priority are
+// kept in the order they were started.
+static scheduled_animation_t animations[MAX_SIMULTANEOUS_ANIMATIONS];
+static uint8_t num_animations = 0;
+
+static animation_scheduler_stats_t stats;
+static bool running = false;
+static bool started_while_running;
+// Set when a frame function has been called
+static bool frame_drawn;
+
+static int8_t find_animation(keyframe_animation_t* animation) {
+    for (uint8_t i = 0; i < num_animations; i++) {
+        if (animations[i].animation == animation) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void remove_animation(keyframe_animation_t* animation) {
+    int8_t index = find_animation(animation);
+    if (index >= 0) {
+        num_animations--;
+        memmove(&animations[index], &animations[index + 1],
+                (num_animations - index) * sizeof(scheduled_animation_t));
+    }
+}
+
+void start_keyframe_animation(keyframe_animation_t* animation) {
+    animation->current_frame = -1;
+    animation->time_left_in_frame = 0;
+    animation->need_update = true;
+    if (find_animation(animation) >= 0) {
+        return;
+    }
+    if (num_animations == MAX_SIMULTANEOUS_ANIMATIONS) {
+        // Make room by stopping the least important animation, if the new
+        // one is more important
+        keyframe_animation_t* lowest = animations[num_animations - 1].animation;
+        if (lowest->priority >= animation->priority) {
+            return;
+        }
+        stop_keyframe_animation(lowest);
+    }
+    uint8_t i = num_animations;
+    while (i > 0 && animations[i - 1].animation->priority < animation->priority) {
+        animations[i] = animations[i - 1];
+        i--;
+    }
+    animations[i].animation = animation;
+    animations[i].last_update = 0;
+    animations[i].deferred = false;
+    num_animations++;
+    if (running) {
+        started_while_running = true;
+    }
+}
+
+void stop_keyframe_animation(keyframe_animation_t* animation) {
+    animation->current_frame = animation->num_frames;
+    animation->time_left_in_frame = 0;
+    animation->need_update = true;
+    animation->first_update_of_frame = false;
+    animation->last_update_of_frame = false;
+    remove_animation(animation);
+}
+
+void stop_all_keyframe_animations(void) {
+    while (num_animations) {
+        stop_keyframe_animation(animations[0].animation);
+    }
+}
+
+uint8_t animation_scheduler_count(void) {
+    return num_animations;
+}
+
+void animation_scheduler_get_stats(animation_scheduler_stats_t* s) {
+    *s = stats;
+}
+
+static bool call_frame_function(keyframe_animation_t* animation, visualizer_state_t* state) {
+    frame_drawn = true;
+    stats.frames++;
+    return (*animation->frame_functions[animation->current_frame])(animation, state);
+}
+
+static bool update_keyframe_animation(keyframe_animation_t* animation, visualizer_state_t* state, systemticks_t delta, systemticks_t* sleep_time) {
+    // TODO: Clean up this messy code
+    dprintf("Animation frame%d, left %d, delta %d\n", animation->current_frame,
+            animation->time_left_in_frame, delta);
+    if (animation->current_frame == animation->num_frames) {
+        animation->need_update = false;
+        return false;
+    }
+    if (animation->current_frame == -1) {
+       animation->current_frame = 0;
+       animation->time_left_in_frame = animation->frame_lengths[0];
+       animation->need_update = true;
+       animation->first_update_of_frame = true;
+    } else {
+        animation->time_left_in_frame -= delta;
+        while (animation->time_left_in_frame <= 0) {
+            int left = animation->time_left_in_frame;
+            if (animation->need_update) {
+                animation->time_left_in_frame = 0;
+                animation->last_update_of_frame = true;
+                call_frame_function(animation, state);
+                animation->last_update_of_frame = false;
+            }
+            animation->current_frame++;
+            animation->need_update = true;
+            animation->first_update_of_frame = true;
+            if (animation->current_frame == animation->num_frames) {
+                if (animation->loop) {
+                    animation->current_frame = 0;
+                }
+                else {
+                    stop_keyframe_animation(animation);
+                    return false;
+                }
+            }
+            delta = -left;
+            animation->time_left_in_frame = animation->frame_lengths[animation->current_frame];
+            animation->time_left_in_frame -= delta;
+        }
+    }
+    if (animation->need_update) {
+        animation->need_update = call_frame_function(animation, state);
+        animation->first_update_of_frame = false;
+    }
+
+    systemticks_t wanted_sleep = animation->need_update ? gfxMillisecondsToTicks(VISUALIZER_FRAME_INTERVAL) : (unsigned)animation->time_left_in_frame;
+    if (wanted_sleep < *sleep_time) {
+        *sleep_time = wanted_sleep;
+    }
+
+    return true;
+}
+
+systemticks_t animation_scheduler_run(visualizer_state_t* state, systemticks_t now, uint8_t* displays) {
+    systemticks_t sleep_time = TIME_INFINITE;
+    // The frame functions can start and stop animations, so work on a copy
+    keyframe_animation_t* order[MAX_SIMULTANEOUS_ANIMATIONS];
+    uint8_t count = num_animations;
+    for (uint8_t i = 0; i < count; i++) {
+        order[i] = animations[i].animation;
+    }
+
+    stats.wakeups++;
+    running = true;
+    started_while_running = false;
+    for (uint8_t i = 0; i < count; i++) {
+        int8_t index = find_animation(order[i]);
+        if (index < 0) {
+            continue;
+        }
+        scheduled_animation_t* scheduled = &animations[index];
+#if VISUALIZER_FRAME_BUDGET > 0
+        if (i > 0 && !scheduled->deferred &&
+            gfxSystemTicks() - now >= gfxMillisecondsToTicks(VISUALIZER_FRAME_BUDGET)) {
+            scheduled->deferred = true;
+            stats.deferred++;
+            sleep_time = 0;
+            continue;
+        }
+#endif
+        systemticks_t delta = now - scheduled->last_update;
+        scheduled->deferred = false;
+        scheduled->last_update = now;
+
+        frame_drawn = false;
+        update_keyframe_animation(order[i], state, delta, &sleep_time);
+        if (frame_drawn) {
+            *displays |= order[i]->displays ? order[i]->displays : VISUALIZER_DISPLAY_ALL;
+        }
+    }
+    running = false;
+    if (started_while_running) {
+        sleep_time = 0;
+    }
+    return sleep_time;
+}
+
+void run_next_keyframe(keyframe_animation_t* animation, visualizer_state_t* state) {
+    int next_frame = animation->current_frame + 1;
+    if (next_frame == animation->num_frames) {
+        next_frame = 0;
+    }
+    keyframe_animation_t temp_animation = *animation;
+    temp_animation.current_frame = next_frame;
+    temp_animation.time_left_in_frame = animation->frame_lengths[next_frame];
+    temp_animation.first_update_of_frame = true;
+    temp_animation.last_update_of_frame = false;
+    temp_animation.need_update  = false;
+    visualizer_state_t temp_state = *state;
+    (*temp_animation.frame_functions[next_frame])(&temp_animation, &temp_state);
+}
@@ -0,0 +1,59 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ANIMATION_SCHEDULER_H
+#define ANIMATION_SCHEDULER_H
+
+#include "visualizer.h"
+
+// Used by the visualizer thread, the user code starts and stops animations
+// through visualizer.h
+
+#ifndef MAX_SIMULTANEOUS_ANIMATIONS
+#define MAX_SIMULTANEOUS_ANIMATIONS 8
+#endif
+
+// How often animations that want continuous updates are updated, in ms
+#ifndef VISUALIZER_FRAME_INTERVAL
+#define VISUALIZER_FRAME_INTERVAL 10
+#endif
+
+// The time in ms the animations may take per wakeup of the visualizer
+// thread, 0 for no limit. Once it has been used up the remaining animations
+// are updated at the next wakeup instead, which comes right away. The
+// highest priority animation and the ones that were delayed last time are
+// always updated.
+#ifndef VISUALIZER_FRAME_BUDGET
+#define VISUALIZER_FRAME_BUDGET 0
+#endif
+
+typedef struct {
+    uint32_t wakeups;
+    // Calls of frame functions
+    uint32_t frames;
+    // Animation updates moved to the next wakeup by the frame budget
+    uint32_t deferred;
+} animation_scheduler_stats_t;
+
+// Updates the running animations, returns how long to sleep until the next
+// update is needed. The VISUALIZER_DISPLAY_* bits of the displays that were
+// drawn to are added to displays.
+systemticks_t animation_scheduler_run(visualizer_state_t* state, systemticks_t now, uint8_t* displays);
+uint8_t animation_scheduler_count(void);
+void stop_all_keyframe_animations(void);
+void animation_scheduler_get_stats(animation_scheduler_stats_t* stats);
+
+#endif
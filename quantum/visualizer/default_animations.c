@@ -137,6 +137,7 @@ keyframe_animation_t default_suspend_animation = {
 keyframe_animation_t led_test_animation = {
     .num_frames = 14,
     .loop = true,
+    .displays = VISUALIZER_DISPLAY_LED,
     .frame_lengths = {
         gfxMillisecondsToTicks(1000), // fade in
         gfxMillisecondsToTicks(1000), // no op (leds on)
@@ -0,0 +1,208 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <algorithm>
+
+extern "C" {
+#include "animation_scheduler.h"
+}
+
+static systemticks_t now;
+// The simulated time each frame function call takes
+static systemticks_t frame_cost;
+// Names of the animations in the order their frame functions were called
+static std::vector<char> calls;
+
+extern "C" systemticks_t gfxSystemTicks(void) {
+    return now;
+}
+
+static bool frame(keyframe_animation_t* animation, visualizer_state_t* state) {
+    (void)state;
+    // the test animations have one frame, the name is in the unused second
+    calls.push_back((char)(animation->frame_lengths[1]));
+    now += frame_cost;
+    return false;
+}
+
+static bool continuous_frame(keyframe_animation_t* animation, visualizer_state_t* state) {
+    frame(animation, state);
+    return true;
+}
+
+class AnimationScheduler : public testing::Test {
+protected:
+    void SetUp() override {
+        now = 1000;
+        frame_cost = 0;
+        calls.clear();
+    }
+
+    void TearDown() override {
+        stop_all_keyframe_animations();
+    }
+
+    keyframe_animation_t* make(char name, uint8_t priority = 0, uint8_t displays = 0, bool continuous = false) {
+        keyframe_animation_t* animation = &pool[used++];
+        *animation = {};
+        animation->num_frames = 1;
+        animation->loop = true;
+        animation->frame_lengths[0] = 100;
+        animation->frame_lengths[1] = name;
+        animation->frame_functions[0] = continuous ? continuous_frame : frame;
+        animation->priority = priority;
+        animation->displays = displays;
+        return animation;
+    }
+
+    systemticks_t run(uint8_t* displays = nullptr) {
+        uint8_t ignored = 0;
+        return animation_scheduler_run(&state, now, displays ? displays : &ignored);
+    }
+
+    visualizer_state_t state = {};
+    keyframe_animation_t pool[16];
+    int used = 0;
+};
+
+TEST_F(AnimationScheduler, RunsInPriorityOrder) {
+    auto low = make('l', 1);
+    auto high = make('h', 5);
+    auto mid = make('m', 3);
+    auto mid2 = make('n', 3);
+    start_keyframe_animation(low);
+    start_keyframe_animation(high);
+    start_keyframe_animation(mid);
+    start_keyframe_animation(mid2);
+    run();
+    EXPECT_EQ(calls, (std::vector<char>{'h', 'm', 'n', 'l'}));
+}
+
+TEST_F(AnimationScheduler, SleepsUntilTheNextKeyframe) {
+    auto a = make('a');
+    start_keyframe_animation(a);
+    EXPECT_EQ(run(), 100u);
+    now += 60;
+    EXPECT_EQ(run(), 40u);
+}
+
+TEST_F(AnimationScheduler, ContinuousUpdatesUseTheFrameInterval) {
+    auto a = make('a', 0, 0, true);
+    start_keyframe_animation(a);
+    EXPECT_EQ(run(), (systemticks_t)VISUALIZER_FRAME_INTERVAL);
+}
+
+TEST_F(AnimationScheduler, BudgetDefersLowerPriorities) {
+    auto high = make('h', 2);
+    auto low = make('l', 1);
+    start_keyframe_animation(high);
+    start_keyframe_animation(low);
+    frame_cost = VISUALIZER_FRAME_BUDGET;
+    EXPECT_EQ(run(), 0u);
+    EXPECT_EQ(calls, (std::vector<char>{'h'}));
+    animation_scheduler_stats_t stats;
+    animation_scheduler_get_stats(&stats);
+    // The deferred animation runs first thing next time, even over budget
+    calls.clear();
+    run();
+    EXPECT_EQ(calls, (std::vector<char>{'l'}));
+    animation_scheduler_stats_t after;
+    animation_scheduler_get_stats(&after);
+    EXPECT_EQ(after.deferred - stats.deferred, 0u);
+}
+
+TEST_F(AnimationScheduler, DeferredAnimationKeepsItsTime) {
+    auto high = make('h', 2);
+    auto low = make('l', 1);
+    start_keyframe_animation(high);
+    start_keyframe_animation(low);
+    run();
+    now += 50;
+    frame_cost = VISUALIZER_FRAME_BUDGET;
+    run();
+    frame_cost = 0;
+    now += 10;
+    run();
+    // 60 of the 100 ms frame have passed for the deferred animation too
+    EXPECT_EQ(low->time_left_in_frame, 40);
+}
+
+TEST_F(AnimationScheduler, FullTableMakesRoomForHigherPriority) {
+    for (int i = 0; i < MAX_SIMULTANEOUS_ANIMATIONS; i++) {
+        start_keyframe_animation(make('a' + i, 1));
+    }
+    auto same = make('s', 1);
+    start_keyframe_animation(same);
+    EXPECT_EQ(animation_scheduler_count(), MAX_SIMULTANEOUS_ANIMATIONS);
+    auto important = make('i', 2);
+    start_keyframe_animation(important);
+    EXPECT_EQ(animation_scheduler_count(), MAX_SIMULTANEOUS_ANIMATIONS);
+    run();
+    EXPECT_EQ(calls.front(), 'i');
+    EXPECT_EQ(std::count(calls.begin(), calls.end(), 's'), 0);
+    // The most recently started of the least important ones was stopped
+    EXPECT_EQ(std::count(calls.begin(), calls.end(), 'a' + MAX_SIMULTANEOUS_ANIMATIONS - 1), 0);
+}
+
+TEST_F(AnimationScheduler, ReportsDrawnDisplays) {
+    auto lcd = make('c', 0, VISUALIZER_DISPLAY_LCD);
+    start_keyframe_animation(lcd);
+    uint8_t displays = 0;
+    run(&displays);
+    EXPECT_EQ(displays, VISUALIZER_DISPLAY_LCD);
+
+    // Nothing is drawn in the middle of a frame
+    now += 10;
+    displays = 0;
+    run(&displays);
+    EXPECT_EQ(displays, 0);
+
+    auto unknown = make('u');
+    start_keyframe_animation(unknown);
+    displays = 0;
+    run(&displays);
+    EXPECT_EQ(displays, VISUALIZER_DISPLAY_ALL);
+}
+
+static keyframe_animation_t started_by_frame;
+
+static bool start_other(keyframe_animation_t* animation, visualizer_state_t* state) {
+    frame(animation, state);
+    start_keyframe_animation(&started_by_frame);
+    return false;
+}
+
+TEST_F(AnimationScheduler, AnimationStartedByAFrameRunsRightAway) {
+    auto a = make('a');
+    a->frame_functions[0] = start_other;
+    started_by_frame = *make('b', 1);
+    start_keyframe_animation(a);
+    EXPECT_EQ(run(), 0u);
+    run();
+    EXPECT_EQ(calls, (std::vector<char>{'a', 'b'}));
+}
+
+TEST_F(AnimationScheduler, FinishedAnimationIsRemoved) {
+    auto a = make('a');
+    a->loop = false;
+    start_keyframe_animation(a);
+    run();
+    now += 100;
+    EXPECT_EQ(run(), TIME_INFINITE);
+    EXPECT_EQ(animation_scheduler_count(), 0);
+}
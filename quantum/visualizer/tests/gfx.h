@@ -0,0 +1,43 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Just enough of ugfx to build the animation scheduler on the host */
+
+#ifndef _GFX_H
+#define _GFX_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef uint32_t systemticks_t;
+typedef struct GDisplay GDisplay;
+
+#define TIME_INFINITE               ((systemticks_t)-1)
+// One tick per ms
+#define gfxMillisecondsToTicks(ms)  ((systemticks_t)(ms))
+
+// Implemented by the tests
+systemticks_t gfxSystemTicks(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,8 @@
+animation_scheduler_SRC :=\
+	$(QUANTUM_PATH)/visualizer/tests/animation_scheduler_tests.cpp \
+	$(QUANTUM_PATH)/visualizer/animation_scheduler.c
+
+animation_scheduler_INC :=\
+	$(QUANTUM_PATH)/visualizer/tests \
+	$(QUANTUM_PATH)/visualizer \
+	$(TMK_PATH)/common
@@ -24,6 +24,8 @@ SOFTWARE.
 
 #include "config.h"
 #include "visualizer.h"
+#include "animation_scheduler.h"
+#include "seqlock.h"
 #include <string.h>
 #ifdef PROTOCOL_CHIBIOS
 #include "ch.h"
@@ -50,6 +52,10 @@ SOFTWARE.
 
 #include "action_util.h"
 
+#ifdef EMULATOR
+#include <stdio.h>
+#endif
+
 // Define this in config.h
 #ifndef VISUALIZER_THREAD_PRIORITY
 // The visualizer needs gfx thread priorities
@@ -70,6 +76,11 @@ static visualizer_keyboard_status_t current_status = {
 #endif
 };
 
+// current_status belongs to the main thread, the visualizer thread reads the
+// copy published with update_status()
+static visualizer_keyboard_status_t published_status;
+static seqlock_t status_lock = SEQLOCK_INITIALIZER;
+
 static bool same_status(visualizer_keyboard_status_t* status1, visualizer_keyboard_status_t* status2) {
     return status1->layer == status2->layer &&
         status1->default_layer == status2->default_layer &&
@@ -91,14 +102,28 @@ static bool visualizer_enabled = false;
 static uint8_t user_data[VISUALIZER_USER_DATA_SIZE];
 #endif
 
-#define MAX_SIMULTANEOUS_ANIMATIONS 4
-static keyframe_animation_t* animations[MAX_SIMULTANEOUS_ANIMATIONS] = {};
-
 #ifdef SERIAL_LINK_ENABLE
-MASTER_TO_ALL_SLAVES_OBJECT(current_status, visualizer_keyboard_status_t);
+typedef struct {
+    // Incremented by the master for every change, so the slaves normally
+    // don't have to compare the status itself. Never 0, which is what the
+    // slaves start with.
+    uint32_t version;
+    visualizer_keyboard_status_t status;
+} visualizer_status_message_t;
+
+// The master only writes the status when it changes, and repeats it this
+// often for slaves that connect later
+#ifndef VISUALIZER_STATUS_RESEND_MS
+#define VISUALIZER_STATUS_RESEND_MS 1000
+#endif
+
+static uint32_t status_version = 0;
+static uint32_t received_status_version = 0;
+
+MASTER_TO_ALL_SLAVES_OBJECT(status_message, visualizer_status_message_t);
 
 static remote_object_t* remote_objects[] = {
-    REMOTE_OBJECT(current_status),
+    REMOTE_OBJECT(status_message),
 };
 
 #endif
@@ -120,126 +145,37 @@ GDisplay* get_led_display(void) {
 }
 #endif
 
-void start_keyframe_animation(keyframe_animation_t* animation) {
-    animation->current_frame = -1;
-    animation->time_left_in_frame = 0;
-    animation->need_update = true;
-    int free_index = -1;
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        if (animations[i] == animation) {
-            return;
-        }
-        if (free_index == -1 && animations[i] == NULL) {
-           free_index=i;
-        }
-    }
-    if (free_index!=-1) {
-        animations[free_index] = animation;
-    }
-}
-
-void stop_keyframe_animation(keyframe_animation_t* animation) {
-    animation->current_frame = animation->num_frames;
-    animation->time_left_in_frame = 0;
-    animation->need_update = true;
-    animation->first_update_of_frame = false;
-    animation->last_update_of_frame = false;
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        if (animations[i] == animation) {
-            animations[i] = NULL;
-            return;
-        }
-    }
-}
-
-void stop_all_keyframe_animations(void) {
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        if (animations[i]) {
-            animations[i]->current_frame = animations[i]->num_frames;
-            animations[i]->time_left_in_frame = 0;
-            animations[i]->need_update = true;
-            animations[i]->first_update_of_frame = false;
-            animations[i]->last_update_of_frame = false;
-            animations[i] = NULL;
-        }
-    }
-}
-
-static uint8_t get_num_running_animations(void) {
-    uint8_t count = 0;
-    for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-        count += animations[i] ? 1 : 0;
-    }
-    return count;
-}
-
-static bool update_keyframe_animation(keyframe_animation_t* animation, visualizer_state_t* state, systemticks_t delta, systemticks_t* sleep_time) {
-    // TODO: Clean up this messy code
-    dprintf("Animation frame%d, left %d, delta %d\n", animation->current_frame,
-            animation->time_left_in_frame, delta);
-    if (animation->current_frame == animation->num_frames) {
-        animation->need_update = false;
-        return false;
-    }
-    if (animation->current_frame == -1) {
-       animation->current_frame = 0;
-       animation->time_left_in_frame = animation->frame_lengths[0];
-       animation->need_update = true;
-       animation->first_update_of_frame = true;
-    } else {
-        animation->time_left_in_frame -= delta;
-        while (animation->time_left_in_frame <= 0) {
-            int left = animation->time_left_in_frame;
-            if (animation->need_update) {
-                animation->time_left_in_frame = 0;
-                animation->last_update_of_frame = true;
-                (*animation->frame_functions[animation->current_frame])(animation, state);
-                animation->last_update_of_frame = false;
-            }
-            animation->current_frame++;
-            animation->need_update = true;
-            animation->first_update_of_frame = true;
-            if (animation->current_frame == animation->num_frames) {
-                if (animation->loop) {
-                    animation->current_frame = 0;
-                }
-                else {
-                    stop_keyframe_animation(animation);
-                    return false;
-                }
-            }
-            delta = -left;
-            animation->time_left_in_frame = animation->frame_lengths[animation->current_frame];
-            animation->time_left_in_frame -= delta;
-        }
-    }
-    if (animation->need_update) {
-        animation->need_update = (*animation->frame_functions[animation->current_frame])(animation, state);
-        animation->first_update_of_frame = false;
-    }
-
-    systemticks_t wanted_sleep = animation->need_update ? gfxMillisecondsToTicks(10) : (unsigned)animation->time_left_in_frame;
-    if (wanted_sleep < *sleep_time) {
-        *sleep_time = wanted_sleep;
+#ifdef EMULATOR
+// Prints the frame rate of each display once per second
+static void report_frame_rate(systemticks_t now, unsigned update_time, uint8_t displays) {
+    static systemticks_t period_start = 0;
+    static unsigned lcd_frames = 0;
+    static unsigned led_frames = 0;
+    static unsigned longest_update = 0;
+    static animation_scheduler_stats_t last_stats = {};
+
+    lcd_frames += (displays & VISUALIZER_DISPLAY_LCD) ? 1 : 0;
+    led_frames += (displays & VISUALIZER_DISPLAY_LED) ? 1 : 0;
+    if (update_time > longest_update) {
+        longest_update = update_time;
     }
-
-    return true;
-}
-
-void run_next_keyframe(keyframe_animation_t* animation, visualizer_state_t* state) {
-    int next_frame = animation->current_frame + 1;
-    if (next_frame == animation->num_frames) {
-        next_frame = 0;
+    if (now - period_start >= gfxMillisecondsToTicks(1000)) {
+        animation_scheduler_stats_t stats;
+        animation_scheduler_get_stats(&stats);
+        printf("visualizer: LCD %u fps, LED %u fps, %u wakeups, %u frames, %u deferred, longest update %u ticks\n",
+               lcd_frames, led_frames,
+               (unsigned)(stats.wakeups - last_stats.wakeups),
+               (unsigned)(stats.frames - last_stats.frames),
+               (unsigned)(stats.deferred - last_stats.deferred),
+               longest_update);
+        last_stats = stats;
+        period_start = now;
+        lcd_frames = 0;
+        led_frames = 0;
+        longest_update = 0;
     }
-    keyframe_animation_t temp_animation = *animation;
-    temp_animation.current_frame = next_frame;
-    temp_animation.time_left_in_frame = animation->frame_lengths[next_frame];
-    temp_animation.first_update_of_frame = true;
-    temp_animation.last_update_of_frame = false;
-    temp_animation.need_update  = false;
-    visualizer_state_t temp_state = *state;
-    (*temp_animation.frame_functions[next_frame])(&temp_animation, &temp_state);
 }
+#endif
 
 // TODO: Optimize the stack size, this is probably way too big
 static DECLARE_THREAD_STACK(visualizerThreadStack, 1024);
@@ -248,7 +184,7 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
 
     GListener event_listener;
     geventListenerInit(&event_listener);
-    geventAttachSource(&event_listener, (GSourceHandle)&current_status, 0);
+    geventAttachSource(&event_listener, (GSourceHandle)&published_status, 0);
 
     visualizer_keyboard_status_t initial_status = {
         .default_layer = 0xFFFFFFFF,
@@ -285,70 +221,79 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
     systemticks_t sleep_time = TIME_INFINITE;
     systemticks_t current_time = gfxSystemTicks();
     bool force_update = true;
+    visualizer_keyboard_status_t latest_status;
+    uint32_t status_sequence = seqlock_read(&status_lock, &latest_status, &published_status, sizeof(latest_status));
 
     while(true) {
-        systemticks_t new_time = gfxSystemTicks();
-        systemticks_t delta = new_time - current_time;
-        current_time = new_time;
+        current_time = gfxSystemTicks();
         bool enabled = visualizer_enabled;
-        if (force_update || !same_status(&state.status, &current_status)) {
+        uint8_t displays = 0;
+        bool status_changed = seqlock_sequence(&status_lock) != status_sequence;
+        if (status_changed) {
+            status_sequence = seqlock_read(&status_lock, &latest_status, &published_status, sizeof(latest_status));
+        }
+        if (force_update || status_changed) {
             force_update = false;
+            // The user code can draw anywhere
+            displays = VISUALIZER_DISPLAY_ALL;
     #if BACKLIGHT_ENABLE
-            if(current_status.backlight_level != state.status.backlight_level) {
-                if (current_status.backlight_level != 0) {
+            if(latest_status.backlight_level != state.status.backlight_level) {
+                if (latest_status.backlight_level != 0) {
                     gdispGSetPowerMode(LED_DISPLAY, powerOn);
-                    uint16_t percent = (uint16_t)current_status.backlight_level * 100 / BACKLIGHT_LEVELS;
+                    uint16_t percent = (uint16_t)latest_status.backlight_level * 100 / BACKLIGHT_LEVELS;
                     gdispGSetBacklight(LED_DISPLAY, percent);
                 }
                 else {
                     gdispGSetPowerMode(LED_DISPLAY, powerOff);
                 }
-                state.status.backlight_level = current_status.backlight_level;
+                state.status.backlight_level = latest_status.backlight_level;
             }
     #endif
             if (visualizer_enabled) {
-                if (current_status.suspended) {
+                if (latest_status.suspended) {
                     stop_all_keyframe_animations();
                     visualizer_enabled = false;
-                    state.status = current_status;
+                    state.status = latest_status;
                     user_visualizer_suspend(&state);
                 }
                 else {
                     visualizer_keyboard_status_t prev_status = state.status;
-                    state.status = current_status;
+                    state.status = latest_status;
                     update_user_visualizer_state(&state, &prev_status);
                 }
                 state.prev_lcd_color = state.current_lcd_color;
             }
         }
-        if (!enabled && state.status.suspended && current_status.suspended == false) {
+        if (!enabled && state.status.suspended && latest_status.suspended == false) {
             // Setting the status to the initial status will force an update
             // when the visualizer is enabled again
             state.status = initial_status;
             state.status.suspended = false;
             stop_all_keyframe_animations();
             user_visualizer_resume(&state);
+            displays = VISUALIZER_DISPLAY_ALL;
             state.prev_lcd_color = state.current_lcd_color;
         }
-        sleep_time = TIME_INFINITE;
-        for (int i=0;i<MAX_SIMULTANEOUS_ANIMATIONS;i++) {
-            if (animations[i]) {
-                update_keyframe_animation(animations[i], &state, delta, &sleep_time);
-            }
-        }
+        sleep_time = animation_scheduler_run(&state, current_time, &displays);
+        // Displays nothing has drawn to since the last flush are left alone,
+        // so a fast LCD animation doesn't also flush the LEDs every frame
 #ifdef BACKLIGHT_ENABLE
-        gdispGFlush(LED_DISPLAY);
+        if (displays & VISUALIZER_DISPLAY_LED) {
+            gdispGFlush(LED_DISPLAY);
+        }
 #endif
 
 #ifdef LCD_ENABLE
-        gdispGFlush(LCD_DISPLAY);
+        if (displays & VISUALIZER_DISPLAY_LCD) {
+            gdispGFlush(LCD_DISPLAY);
+        }
 #endif
 
 #ifdef EMULATOR
         draw_emulator();
 #endif
         // Enable the visualizer when the startup or the suspend animation has finished
-        if (!visualizer_enabled && state.status.suspended == false && get_num_running_animations() == 0) {
+        if (!visualizer_enabled && state.status.suspended == false && animation_scheduler_count() == 0) {
             visualizer_enabled = true;
             force_update = true;
             sleep_time = 0;
@@ -356,6 +301,9 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
 
         systemticks_t after_update = gfxSystemTicks();
         unsigned update_delta = after_update - current_time;
+#ifdef EMULATOR
+        report_frame_rate(after_update, update_delta, displays);
+#endif
         if (sleep_time != TIME_INFINITE) {
             if (sleep_time > update_delta) {
                 sleep_time -= update_delta;
@@ -364,7 +312,7 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
                 sleep_time = 0;
             }
         }
-        dprintf("Update took %d, last delta %d, sleep_time %d\n", update_delta, delta, sleep_time);
+        dprintf("Update took %d, sleep_time %d\n", update_delta, sleep_time);
 #ifdef PROTOCOL_CHIBIOS
         // The gEventWait function really takes milliseconds, even if the documentation says ticks.
         // Unfortunately there's no generic ugfx conversion from system time to milliseconds,
@@ -386,6 +334,7 @@ static DECLARE_THREAD_FUNCTION(visualizerThread, arg) {
 }
 
 void visualizer_init(void) {
+    seqlock_write(&status_lock, &published_status, &current_status, sizeof(current_status));
     gfxInit();
 
   #ifdef LCD_BACKLIGHT_ENABLE
@@ -412,7 +361,8 @@ void visualizer_init(void) {
 
 void update_status(bool changed) {
     if (changed) {
-        GSourceListener* listener = geventGetSourceListener((GSourceHandle)&current_status, NULL);
+        seqlock_write(&status_lock, &published_status, &current_status, sizeof(current_status));
+        GSourceListener* listener = geventGetSourceListener((GSourceHandle)&published_status, NULL);
         if (listener) {
             geventSendEvent(listener);
         }
@@ -421,12 +371,20 @@ void update_status(bool changed) {
     static systime_t last_update = 0;
     systime_t current_update = chVTGetSystemTimeX();
     systime_t delta = current_update - last_update;
-    if (changed || delta > MS2ST(10)) {
-        last_update = current_update;
-        visualizer_keyboard_status_t* r = begin_write_current_status();
-        *r = current_status;
-        end_write_current_status();
+    // The first status is always sent, so version 0 never goes out
+    if (changed || status_version == 0) {
+        if (++status_version == 0) {
+            status_version = 1;
+        }
+    }
+    else if (delta <= MS2ST(VISUALIZER_STATUS_RESEND_MS)) {
+        return;
     }
+    last_update = current_update;
+    visualizer_status_message_t* r = begin_write_status_message();
+    r->version = status_version;
+    r->status = current_status;
+    end_write_status_message();
 #endif
 }
 
@@ -448,20 +406,17 @@ void visualizer_set_user_data(void* u) {
 #endif
 
 void visualizer_update(uint32_t default_state, uint32_t state, uint8_t mods, uint32_t leds) {
-    // Note that there's a small race condition here, the thread could read
-    // a state where one of these are set but not the other. But this should
-    // not really matter as it will be fixed during the next loop step.
-    // Alternatively a mutex could be used instead of the volatile variables
-
     bool changed = false;
 #ifdef SERIAL_LINK_ENABLE
     if (is_serial_link_connected ()) {
-        visualizer_keyboard_status_t* new_status = read_current_status();
-        if (new_status) {
-            if (!same_status(&current_status, new_status)) {
-                changed = true;
-                current_status = *new_status;
-            }
+        visualizer_status_message_t* message = read_status_message();
+        // A rebooted master starts counting again, so a version that was
+        // already seen can still carry a different status
+        if (message && (message->version != received_status_version ||
+                        !same_status(&current_status, &message->status))) {
+            received_status_version = message->version;
+            changed = true;
+            current_status = message->status;
         }
     }
     else {
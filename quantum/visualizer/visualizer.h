@@ -63,7 +63,14 @@ void draw_emulator(void);
 #endif
 
 // If you need support for more than 16 keyframes per animation, you can change this
+#ifndef MAX_VISUALIZER_KEY_FRAMES
 #define MAX_VISUALIZER_KEY_FRAMES 16
+#endif
+
+// Bits of keyframe_animation_t.displays
+#define VISUALIZER_DISPLAY_LCD (1 << 0)
+#define VISUALIZER_DISPLAY_LED (1 << 1)
+#define VISUALIZER_DISPLAY_ALL (VISUALIZER_DISPLAY_LCD | VISUALIZER_DISPLAY_LED)
 
 struct keyframe_animation_t;
 
@@ -114,6 +121,12 @@ typedef struct keyframe_animation_t {
     bool loop;
     int frame_lengths[MAX_VISUALIZER_KEY_FRAMES];
     frame_func frame_functions[MAX_VISUALIZER_KEY_FRAMES];
+    // Optional, animations with a higher priority are updated first and
+    // are not delayed by the VISUALIZER_FRAME_BUDGET
+    uint8_t priority;
+    // Optional, the VISUALIZER_DISPLAY_* bits of the displays the frame
+    // functions draw to. Only those are flushed, 0 flushes all of them.
+    uint8_t displays;
 
     // Used internally by the system, and can also be read by
     // keyframe update functions
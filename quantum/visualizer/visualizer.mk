@@ -45,6 +45,7 @@ endef
 GDISP_DRIVER_LIST:=
 
 SRC += $(VISUALIZER_DIR)/visualizer.c \
+	$(VISUALIZER_DIR)/animation_scheduler.c \
 	$(VISUALIZER_DIR)/visualizer_keyframes.c
 EXTRAINCDIRS += $(GFXINC) $(VISUALIZER_DIR)
 GFXLIB = $(LIB_PATH)/ugfx
@@ -0,0 +1,32 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        {KC_A, KC_B, MO(1)},
+        {KC_C, KC_D, MO(2)},
+    },
+    [1] = {
+        {KC_1, KC_2, KC_TRNS},
+        {KC_3, KC_4, KC_TRNS},
+    },
+    [2] = {
+        {KC_X, KC_Y, KC_TRNS},
+        {KC_Z, KC_NO, KC_TRNS},
+    },
+};
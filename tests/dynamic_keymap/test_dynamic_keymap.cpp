@@ -0,0 +1,168 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+
+extern "C" {
+#include "dynamic_keymap.h"
+}
+
+using testing::InSequence;
+
+static const uint8_t packet_size = 32;
+static const uint8_t data_size = packet_size - 4;
+
+class DynamicKeymap : public TestFixture {
+protected:
+    TestDriver driver;
+
+    void SetUp() override {
+        dynamic_keymap_reset();
+        commit();
+    }
+
+    void commit() {
+        for (unsigned ms = 0; !dynamic_keymap_is_committed() && ms < 10000; ms++) {
+            run_one_scan_loop();
+        }
+        ASSERT_TRUE(dynamic_keymap_is_committed());
+    }
+
+    std::vector<uint8_t> request(std::vector<uint8_t> bytes) {
+        bytes.resize(packet_size);
+        EXPECT_TRUE(dynamic_keymap_process_raw_hid(bytes.data(), bytes.size()));
+        return bytes;
+    }
+
+    void set_keycode(uint8_t layer, uint8_t row, uint8_t col, uint16_t keycode) {
+        request({DYNAMIC_KEYMAP_SET_KEYCODE, layer, row, col, (uint8_t)(keycode >> 8), (uint8_t)keycode});
+    }
+
+    void tap_expecting(uint8_t col, uint8_t row, uint16_t keycode) {
+        {
+            InSequence s;
+            EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(keycode)));
+            EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+        }
+        press_key(col, row);
+        run_one_scan_loop();
+        release_key(col, row);
+        run_one_scan_loop();
+        testing::Mock::VerifyAndClearExpectations(&driver);
+    }
+};
+
+TEST_F(DynamicKeymap, StartsWithTheCompiledKeymap) {
+    tap_expecting(0, 0, KC_A);
+    tap_expecting(1, 1, KC_D);
+    auto reply = request({DYNAMIC_KEYMAP_GET_KEYCODE, 1, 1, 0});
+    EXPECT_EQ((reply[4] << 8) | reply[5], KC_3);
+}
+
+TEST_F(DynamicKeymap, KnowsHowManyLayersTheKeymapHas) {
+    EXPECT_EQ(keymap_layer_count(), 3);
+}
+
+TEST_F(DynamicKeymap, ReportsItsLayout) {
+    auto reply = request({DYNAMIC_KEYMAP_GET_INFO});
+    EXPECT_EQ(reply[1], DYNAMIC_KEYMAP_LAYER_COUNT);
+    EXPECT_EQ(reply[2], MATRIX_ROWS);
+    EXPECT_EQ(reply[3], MATRIX_COLS);
+}
+
+TEST_F(DynamicKeymap, SetKeycodeTakesEffectRightAway) {
+    set_keycode(0, 0, 0, KC_Q);
+    tap_expecting(0, 0, KC_Q);
+}
+
+TEST_F(DynamicKeymap, BulkWriteWholeKeymap) {
+    std::vector<uint8_t> keymap;
+    for (uint16_t i = 0; i < DYNAMIC_KEYMAP_SIZE / 2; i++) {
+        uint16_t keycode = (i % 3 == 2) ? (uint16_t)KC_TRNS : (uint16_t)(KC_E + i);
+        keymap.push_back(keycode >> 8);
+        keymap.push_back(keycode & 0xFF);
+    }
+    // keep the layer key
+    keymap[2 * 2 + 1] = MO(1) & 0xFF;
+    keymap[2 * 2] = MO(1) >> 8;
+
+    for (uint16_t offset = 0; offset < keymap.size(); offset += data_size) {
+        uint8_t size = std::min<size_t>(data_size, keymap.size() - offset);
+        std::vector<uint8_t> packet = {DYNAMIC_KEYMAP_SET_BUFFER, (uint8_t)(offset >> 8), (uint8_t)offset, size};
+        packet.insert(packet.end(), keymap.begin() + offset, keymap.begin() + offset + size);
+        request(packet);
+    }
+
+    std::vector<uint8_t> read;
+    for (uint16_t offset = 0; offset < keymap.size(); offset += data_size) {
+        uint8_t size = std::min<size_t>(data_size, keymap.size() - offset);
+        auto reply = request({DYNAMIC_KEYMAP_GET_BUFFER, (uint8_t)(offset >> 8), (uint8_t)offset, size});
+        read.insert(read.end(), reply.begin() + 4, reply.begin() + 4 + size);
+    }
+    EXPECT_EQ(read, keymap);
+
+    tap_expecting(1, 0, KC_E + 1);
+    // key 6 is row 0 col 0 of layer 1
+    press_key(2, 0);
+    run_one_scan_loop();
+    tap_expecting(0, 0, KC_E + 6);
+    release_key(2, 0);
+    run_one_scan_loop();
+}
+
+TEST_F(DynamicKeymap, UpperLayersComeFromFlash) {
+    set_keycode(0, 0, 0, KC_Q);
+    press_key(2, 1);
+    run_one_scan_loop();
+    tap_expecting(0, 0, KC_X);
+    release_key(2, 1);
+    run_one_scan_loop();
+}
+
+TEST_F(DynamicKeymap, RejectsOutOfRangeRequests) {
+    auto reply = request({DYNAMIC_KEYMAP_GET_KEYCODE, DYNAMIC_KEYMAP_LAYER_COUNT, 0, 0});
+    EXPECT_EQ(reply[0], DYNAMIC_KEYMAP_ERROR);
+    reply = request({DYNAMIC_KEYMAP_GET_BUFFER, 0, DYNAMIC_KEYMAP_SIZE - 1, 2});
+    EXPECT_EQ(reply[0], DYNAMIC_KEYMAP_ERROR);
+    reply = request({DYNAMIC_KEYMAP_SET_BUFFER, 0, 0, data_size + 1});
+    EXPECT_EQ(reply[0], DYNAMIC_KEYMAP_ERROR);
+
+    uint8_t unknown[packet_size] = {0x80};
+    EXPECT_FALSE(dynamic_keymap_process_raw_hid(unknown, packet_size));
+}
+
+TEST_F(DynamicKeymap, SurvivesPowerCycle) {
+    set_keycode(0, 1, 0, KC_W);
+    set_keycode(1, 1, 1, KC_ESC);
+    commit();
+    // lost with the power, it never made it to the EEPROM
+    set_keycode(0, 1, 0, KC_E);
+    dynamic_keymap_init();
+    tap_expecting(0, 1, KC_W);
+    auto reply = request({DYNAMIC_KEYMAP_GET_KEYCODE, 1, 1, 1});
+    EXPECT_EQ((reply[4] << 8) | reply[5], KC_ESC);
+}
+
+TEST_F(DynamicKeymap, InterruptedResetStartsOver) {
+    set_keycode(0, 0, 0, KC_Q);
+    commit();
+    dynamic_keymap_reset();
+    // power lost before the reset was written
+    dynamic_keymap_init();
+    commit();
+    tap_expecting(0, 0, KC_A);
+}
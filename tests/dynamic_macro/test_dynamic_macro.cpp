@@ -0,0 +1,168 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+
+extern "C" {
+#include "eeprom.h"
+void dynamic_macro_test_power_cycle(void);
+}
+
+using testing::_;
+using testing::Invoke;
+
+static const uint8_t key_a = 0;
+static const uint8_t key_b = 1;
+static const uint8_t key_shift = 2;
+static const uint8_t rec_start1 = 3;
+static const uint8_t rec_start2 = 4;
+static const uint8_t rec_stop = 5;
+static const uint8_t play1 = 6;
+static const uint8_t play2 = 7;
+
+class DynamicMacro : public TestFixture {
+protected:
+    TestDriver driver;
+    // every key that showed up in a report, in order
+    std::vector<uint8_t> typed;
+
+    void SetUp() override {
+        EXPECT_CALL(driver, send_keyboard_mock(_)).WillRepeatedly(Invoke([&](report_keyboard_t& report) {
+            if (report.keys[0] != KC_NO) {
+                typed.push_back(report.keys[0]);
+            }
+            if (report.mods & MOD_BIT(KC_LSFT)) {
+                typed.push_back(KC_LSFT);
+            }
+        }));
+    }
+
+    void tap(uint8_t col) {
+        press_key(col, 0);
+        idle_for(20);
+        release_key(col, 0);
+        idle_for(20);
+    }
+
+    void record(uint8_t start, std::initializer_list<uint8_t> cols) {
+        tap(start);
+        for (uint8_t col : cols) {
+            tap(col);
+        }
+        press_key(rec_stop, 0);
+        run_one_scan_loop();
+        release_key(rec_stop, 0);
+        run_one_scan_loop();
+        typed.clear();
+    }
+
+    // scans until the playback is over, returns how many ms that took
+    unsigned play(uint8_t key) {
+        tap(key);
+        unsigned ms = 0;
+        size_t seen = typed.size();
+        for (unsigned idle = 0; idle < DYNAMIC_MACRO_PLAY_INTERVAL * 4; idle++, ms++) {
+            run_one_scan_loop();
+            if (typed.size() != seen) {
+                seen = typed.size();
+                idle = 0;
+            }
+        }
+        return ms;
+    }
+};
+
+TEST_F(DynamicMacro, RecordsAndPlaysBack) {
+    record(rec_start1, {key_a, key_b});
+    play(play1);
+    EXPECT_EQ(typed, std::vector<uint8_t>({KC_A, KC_B}));
+}
+
+TEST_F(DynamicMacro, MacrosShareTheBuffer) {
+    record(rec_start1, {key_a, key_b});
+    record(rec_start2, {key_b, key_a, key_a});
+    play(play2);
+    EXPECT_EQ(typed, std::vector<uint8_t>({KC_B, KC_A, KC_A}));
+    typed.clear();
+    play(play1);
+    EXPECT_EQ(typed, std::vector<uint8_t>({KC_A, KC_B}));
+}
+
+TEST_F(DynamicMacro, PlaybackIsPaced) {
+    record(rec_start1, {key_a, key_b, key_a});
+    unsigned ms = play(play1);
+    EXPECT_EQ(typed, std::vector<uint8_t>({KC_A, KC_B, KC_A}));
+    // six events, one per interval
+    EXPECT_GE(ms, 5 * DYNAMIC_MACRO_PLAY_INTERVAL);
+}
+
+TEST_F(DynamicMacro, EventsTakeTwoBytes) {
+    record(rec_start2, {});
+    record(rec_start1, {key_a, key_a, key_a, key_a, key_a, key_a, key_a, key_a, key_a, key_a});
+    play(play1);
+    EXPECT_EQ(typed, std::vector<uint8_t>(DYNAMIC_MACRO_SIZE / 4, KC_A));
+}
+
+TEST_F(DynamicMacro, TrailingKeyDownsAreTrimmed) {
+    tap(rec_start1);
+    tap(key_a);
+    press_key(key_shift, 0);
+    idle_for(20);
+    press_key(rec_stop, 0);
+    run_one_scan_loop();
+    release_key(rec_stop, 0);
+    release_key(key_shift, 0);
+    idle_for(20);
+    typed.clear();
+    play(play1);
+    EXPECT_EQ(typed, std::vector<uint8_t>({KC_A}));
+}
+
+TEST_F(DynamicMacro, SurvivesPowerCycle) {
+    record(rec_start1, {key_b, key_a});
+    record(rec_start2, {key_a});
+    // the save writes one byte per scan
+    idle_for(DYNAMIC_MACRO_SIZE + 10);
+    dynamic_macro_test_power_cycle();
+    play(play1);
+    play(play2);
+    EXPECT_EQ(typed, std::vector<uint8_t>({KC_B, KC_A, KC_A}));
+}
+
+TEST_F(DynamicMacro, PowerCycleDuringRecordingKeepsOldMacros) {
+    record(rec_start1, {key_b});
+    record(rec_start2, {});
+    idle_for(DYNAMIC_MACRO_SIZE + 10);
+    tap(rec_start1);
+    tap(key_a);
+    dynamic_macro_test_power_cycle();
+    typed.clear();
+    play(play1);
+    EXPECT_EQ(typed, std::vector<uint8_t>({KC_B}));
+}
+
+TEST_F(DynamicMacro, CorruptSaveIsDiscarded) {
+    record(rec_start1, {key_b, key_a});
+    record(rec_start2, {key_a});
+    idle_for(DYNAMIC_MACRO_SIZE + 10);
+    // the first key of macro 1 is outside the matrix
+    eeprom_update_byte((uint8_t *)(DYNAMIC_MACRO_EEPROM_ADDR + 6), MATRIX_ROWS * MATRIX_COLS);
+    dynamic_macro_test_power_cycle();
+    play(play1);
+    play(play2);
+    EXPECT_TRUE(typed.empty());
+}
@@ -0,0 +1,59 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "quantum.h"
+
+// The upper layers are mostly transparent, so lookups fall through several
+// of them before reaching layer 0
+const uint16_t PROGMEM keymaps[][MATRIX_ROWS][MATRIX_COLS] = {
+    [0] = {
+        {KC_GRAVE, KC_LALT, KC_CAPS, KC_A},
+        {KC_B,     KC_C,    KC_D,    KC_E},
+    },
+    [1] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_1},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+    [2] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_FN1,  KC_TRNS},
+    },
+    [3] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+    [4] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+    [5] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_FN0},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+    [6] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+    [7] = {
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+        {KC_TRNS, KC_TRNS, KC_TRNS, KC_TRNS},
+    },
+};
+
+const uint16_t PROGMEM fn_actions[] = {
+    [0] = ACTION_TRANSPARENT,
+    [1] = ACTION_KEY(KC_F),
+};
@@ -0,0 +1,163 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <chrono>
+#include <cstdio>
+
+using testing::InSequence;
+
+// The remapping as it was done before the lookup table, one switch per lookup
+static uint16_t reference_remap(keymap_config_t config, uint16_t keycode) {
+    switch (keycode) {
+        case KC_CAPSLOCK:
+        case KC_LOCKING_CAPS:
+            if (config.swap_control_capslock || config.capslock_to_control) {
+                return KC_LCTL;
+            }
+            return keycode;
+        case KC_LCTL:
+            return config.swap_control_capslock ? KC_CAPSLOCK : KC_LCTL;
+        case KC_LALT:
+            if (config.swap_lalt_lgui) {
+                return config.no_gui ? KC_NO : KC_LGUI;
+            }
+            return KC_LALT;
+        case KC_LGUI:
+            if (config.swap_lalt_lgui) {
+                return KC_LALT;
+            }
+            return config.no_gui ? KC_NO : KC_LGUI;
+        case KC_RALT:
+            if (config.swap_ralt_rgui) {
+                return config.no_gui ? KC_NO : KC_RGUI;
+            }
+            return KC_RALT;
+        case KC_RGUI:
+            if (config.swap_ralt_rgui) {
+                return KC_RALT;
+            }
+            return config.no_gui ? KC_NO : KC_RGUI;
+        case KC_GRAVE:
+            return config.swap_grave_esc ? KC_ESC : KC_GRAVE;
+        case KC_ESC:
+            return config.swap_grave_esc ? KC_GRAVE : KC_ESC;
+        case KC_BSLASH:
+            return config.swap_backslash_backspace ? KC_BSPACE : KC_BSLASH;
+        case KC_BSPACE:
+            return config.swap_backslash_backspace ? KC_BSLASH : KC_BSPACE;
+        default:
+            return keycode;
+    }
+}
+
+static const uint8_t layer_count = 8;
+
+class KeycodeConfig : public TestFixture {
+protected:
+    TestDriver driver;
+
+    void TearDown() override {
+        keymap_config.raw = 0;
+        layer_clear();
+        TestFixture::TearDown();
+    }
+
+    void tap_expecting(uint8_t col, uint8_t row, uint16_t keycode) {
+        {
+            InSequence s;
+            EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport(keycode)));
+            EXPECT_CALL(driver, send_keyboard_mock(KeyboardReport()));
+        }
+        press_key(col, row);
+        run_one_scan_loop();
+        release_key(col, row);
+        run_one_scan_loop();
+        testing::Mock::VerifyAndClearExpectations(&driver);
+    }
+};
+
+TEST_F(KeycodeConfig, TableMatchesTheSwitchForEveryConfig) {
+    for (uint16_t raw = 0; raw < 0x80; raw++) {
+        keymap_config.raw = raw;
+        for (uint16_t keycode = 0; keycode < 0x200; keycode++) {
+            ASSERT_EQ(keycode_config(keycode), reference_remap(keymap_config, keycode))
+                << "config " << raw << " keycode " << keycode;
+        }
+    }
+}
+
+TEST_F(KeycodeConfig, BitfieldChangesTakeEffectImmediately) {
+    tap_expecting(0, 0, KC_GRAVE);
+    keymap_config.swap_grave_esc = true;
+    tap_expecting(0, 0, KC_ESC);
+    keymap_config.swap_lalt_lgui = true;
+    tap_expecting(1, 0, KC_LGUI);
+    keymap_config.no_gui = true;
+    EXPECT_EQ(keycode_config(KC_LALT), KC_NO);
+    keymap_config.raw = 0;
+    tap_expecting(0, 0, KC_GRAVE);
+    tap_expecting(1, 0, KC_LALT);
+}
+
+TEST_F(KeycodeConfig, TransparencyMatchesActionForKey) {
+    for (uint8_t layer = 0; layer < layer_count; layer++) {
+        for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+            for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                keypos_t key = { .col = col, .row = row };
+                EXPECT_EQ(action_key_is_transparent(layer, key),
+                          action_for_key(layer, key).code == ACTION_TRANSPARENT)
+                    << "layer " << (int)layer << " row " << (int)row << " col " << (int)col;
+            }
+        }
+    }
+}
+
+TEST_F(KeycodeConfig, LookupFallsThroughTransparentLayers) {
+    layer_state_set((1UL << layer_count) - 1);
+    // KC_FN0 on layer 5 is ACTION_TRANSPARENT, layer 1 has KC_1
+    tap_expecting(3, 0, KC_1);
+    // KC_FN1 on layer 2 is a plain key
+    tap_expecting(2, 1, KC_F);
+    // nothing above layer 0
+    tap_expecting(0, 1, KC_B);
+    keymap_config.swap_grave_esc = true;
+    tap_expecting(0, 0, KC_ESC);
+}
+
+// Not a pass/fail test, prints the cost of resolving a key through every
+// active layer so changes to the lookup path can be compared
+TEST_F(KeycodeConfig, LookupBenchmark) {
+    const unsigned rounds = 20000;
+    layer_state_set((1UL << layer_count) - 1);
+    for (uint16_t raw : {0, 0x7F}) {
+        keymap_config.raw = raw;
+        uint32_t sink = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned i = 0; i < rounds; i++) {
+            for (uint8_t row = 0; row < MATRIX_ROWS; row++) {
+                for (uint8_t col = 0; col < MATRIX_COLS; col++) {
+                    keypos_t key = { .col = col, .row = row };
+                    sink += layer_switch_get_action(key).code;
+                }
+            }
+        }
+        auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+        double lookups = (double)rounds * MATRIX_ROWS * MATRIX_COLS;
+        printf("config 0x%02X: %.1f ns per key lookup through %u layers (%u)\n",
+               raw, elapsed.count() / lookups, layer_count, (unsigned)(sink & 1));
+    }
+}
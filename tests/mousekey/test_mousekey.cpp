@@ -0,0 +1,204 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+
+extern "C" {
+#include "mousekey.h"
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+
+// Cursor position after every mouse report, to compare whole paths
+struct Point {
+    int x, y, v;
+};
+
+class Mousekey : public TestFixture {
+protected:
+    void SetUp() override {
+        mk_delay = MOUSEKEY_DELAY/10;
+        mk_interval = MOUSEKEY_INTERVAL;
+        mk_max_speed = MOUSEKEY_MAX_SPEED;
+        mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
+        mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
+        mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
+        mk_curve = MOUSEKEY_CURVE;
+        mk_report_interval = MOUSEKEY_REPORT_INTERVAL;
+    }
+
+    // Holds the keys at the given columns for ms and records the path
+    std::vector<Point> hold(std::initializer_list<uint8_t> cols, unsigned ms) {
+        TestDriver driver;
+        std::vector<Point> path;
+        Point pos = {0, 0, 0};
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+        EXPECT_CALL(driver, send_mouse_mock(_)).WillRepeatedly(Invoke([&](report_mouse_t& report) {
+            pos.x += report.x;
+            pos.y += report.y;
+            pos.v += report.v;
+            path.push_back(pos);
+        }));
+        for (uint8_t col : cols) {
+            press_key(col, 0);
+        }
+        idle_for(ms);
+        for (uint8_t col : cols) {
+            release_key(col, 0);
+        }
+        idle_for(MOUSEKEY_REPORT_INTERVAL * 2);
+        testing::Mock::VerifyAndClearExpectations(&driver);
+        return path;
+    }
+};
+
+static const uint8_t up = 0;
+static const uint8_t down = 1;
+static const uint8_t right = 3;
+static const uint8_t wheel_up = 4;
+static const uint8_t accel2 = 7;
+
+// ms until the cursor moves at MOUSEKEY_MAX_SPEED with the default settings
+static const unsigned ramp = MOUSEKEY_DELAY + MOUSEKEY_TIME_TO_MAX * MOUSEKEY_INTERVAL;
+// pixels per ms at full speed
+static const double max_speed = (double)MOUSEKEY_MOVE_DELTA * MOUSEKEY_MAX_SPEED / MOUSEKEY_INTERVAL;
+
+static int distance_between(const std::vector<Point>& path, unsigned from, unsigned to) {
+    return path[to].x - path[from].x;
+}
+
+TEST_F(Mousekey, TapMovesOneStep) {
+    auto path = hold({right}, 1);
+    ASSERT_FALSE(path.empty());
+    EXPECT_EQ(path.back().x, MOUSEKEY_MOVE_DELTA);
+    EXPECT_EQ(path.back().y, 0);
+}
+
+TEST_F(Mousekey, NoMotionDuringDelay) {
+    auto path = hold({right}, MOUSEKEY_DELAY);
+    EXPECT_EQ(path.back().x, MOUSEKEY_MOVE_DELTA);
+}
+
+TEST_F(Mousekey, ReportsAtReportInterval) {
+    const unsigned ms = 1000;
+    mk_delay = 0;
+    auto path = hold({right}, ms);
+    // one report on press, one on release and one per interval in between
+    EXPECT_NEAR(path.size(), ms / MOUSEKEY_REPORT_INTERVAL + 2, 2);
+}
+
+TEST_F(Mousekey, ReachesMaxSpeed) {
+    const unsigned extra = 1000;
+    auto path = hold({right}, ramp + extra);
+    // each report is MOUSEKEY_REPORT_INTERVAL ms apart
+    unsigned reports = extra / MOUSEKEY_REPORT_INTERVAL;
+    unsigned last = path.size() - 2;
+    int moved = distance_between(path, last - reports, last);
+    EXPECT_NEAR(moved, max_speed * extra, 2);
+}
+
+TEST_F(Mousekey, SlowSpeedsKeepSubpixelMotion) {
+    // 0.1 pixels per ms, the old engine could only do whole steps
+    mk_max_speed = 1;
+    mk_delay = 0;
+    auto path = hold({right}, 2000);
+    // up to a report interval of motion and some rounding are lost on release
+    EXPECT_NEAR(path.back().x, MOUSEKEY_MOVE_DELTA + 0.1 * 2000, 0.1 * MOUSEKEY_REPORT_INTERVAL + 2);
+    for (size_t i = 1; i < path.size(); i++) {
+        EXPECT_LE(path[i].x - path[i - 1].x, MOUSEKEY_MOVE_DELTA);
+    }
+}
+
+TEST_F(Mousekey, CurvesOrderedHalfwayThroughRamp) {
+    const unsigned half = MOUSEKEY_DELAY + MOUSEKEY_TIME_TO_MAX * MOUSEKEY_INTERVAL / 2;
+    int distance[MOUSEKEY_CURVE_COUNT];
+    for (uint8_t curve = 0; curve < MOUSEKEY_CURVE_COUNT; curve++) {
+        mk_curve = curve;
+        distance[curve] = hold({right}, half).back().x;
+    }
+    EXPECT_GT(distance[MOUSEKEY_CURVE_CONSTANT], distance[MOUSEKEY_CURVE_LINEAR]);
+    EXPECT_GT(distance[MOUSEKEY_CURVE_LINEAR], distance[MOUSEKEY_CURVE_KINETIC]);
+    EXPECT_GT(distance[MOUSEKEY_CURVE_KINETIC], distance[MOUSEKEY_CURVE_QUADRATIC]);
+}
+
+TEST_F(Mousekey, CurvesAgreeAtMaxSpeed) {
+    const unsigned extra = 500;
+    int reference = -1;
+    for (uint8_t curve = MOUSEKEY_CURVE_LINEAR; curve < MOUSEKEY_CURVE_COUNT; curve++) {
+        mk_curve = curve;
+        auto path = hold({right}, ramp + extra);
+        unsigned last = path.size() - 2;
+        int moved = distance_between(path, last - extra / MOUSEKEY_REPORT_INTERVAL, last);
+        if (reference < 0) {
+            reference = moved;
+        }
+        EXPECT_NEAR(moved, reference, 1);
+    }
+}
+
+TEST_F(Mousekey, PathIsMonotonicAndSmooth) {
+    auto path = hold({right}, ramp + 500);
+    int max_step = max_speed * MOUSEKEY_REPORT_INTERVAL + 1;
+    for (size_t i = 1; i < path.size(); i++) {
+        int step = path[i].x - path[i - 1].x;
+        EXPECT_GE(step, 0);
+        EXPECT_LE(step, max_step);
+    }
+}
+
+TEST_F(Mousekey, DiagonalStaysOnDiagonal) {
+    mk_delay = 0;
+    auto path = hold({right, down}, 1000);
+    // skip the first step, which only has one of the keys
+    for (size_t i = 1; i < path.size(); i++) {
+        EXPECT_EQ(path[i].x, path[i].y);
+    }
+}
+
+TEST_F(Mousekey, DiagonalIsNotFasterThanStraight) {
+    mk_curve = MOUSEKEY_CURVE_CONSTANT;
+    mk_delay = 0;
+    int straight = hold({right}, 1000).back().x - MOUSEKEY_MOVE_DELTA;
+    int diagonal = hold({right, down}, 1000).back().x - MOUSEKEY_MOVE_DELTA;
+    EXPECT_NEAR(diagonal, straight * 181 / 256, 2);
+}
+
+TEST_F(Mousekey, OppositeDirectionsCancel) {
+    mk_delay = 0;
+    auto path = hold({up, down}, 500);
+    for (auto& p : path) {
+        EXPECT_EQ(p.x, 0);
+    }
+    EXPECT_EQ(path.back().y, 0);
+}
+
+TEST_F(Mousekey, AccelKeyJumpsToMaxSpeed) {
+    mk_delay = 0;
+    auto path = hold({right, accel2}, 500);
+    // motion since the last report is dropped on release
+    EXPECT_NEAR(path.back().x, MOUSEKEY_MOVE_DELTA + max_speed * 500, max_speed * MOUSEKEY_REPORT_INTERVAL);
+}
+
+TEST_F(Mousekey, WheelAccumulatesFractions) {
+    mk_delay = 0;
+    mk_curve = MOUSEKEY_CURVE_CONSTANT;
+    auto path = hold({wheel_up}, 1000);
+    double per_ms = (double)MOUSEKEY_WHEEL_DELTA * MOUSEKEY_WHEEL_MAX_SPEED / MOUSEKEY_INTERVAL;
+    EXPECT_NEAR(path.back().v, MOUSEKEY_WHEEL_DELTA + per_ms * 1000, per_ms * MOUSEKEY_REPORT_INTERVAL + 1);
+}
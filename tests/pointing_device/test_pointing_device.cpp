@@ -0,0 +1,133 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <vector>
+
+extern "C" {
+#include "pointing_device.h"
+}
+
+using testing::_;
+using testing::AnyNumber;
+using testing::Invoke;
+
+class PointingDevice : public TestFixture {
+protected:
+    TestDriver driver;
+    std::vector<report_mouse_t> reports;
+
+    void SetUp() override {
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+        EXPECT_CALL(driver, send_mouse_mock(_)).WillRepeatedly(Invoke([&](report_mouse_t& report) {
+            reports.push_back(report);
+        }));
+        // flush whatever an earlier test left pending
+        pointing_device_set_report(report_mouse_t{});
+        while (pointing_device_has_motion()) {
+            idle_for(POINTING_DEVICE_REPORT_INTERVAL);
+        }
+        idle_for(POINTING_DEVICE_REPORT_INTERVAL);
+        reports.clear();
+    }
+
+    void TearDown() override {
+        pointing_device_set_report(report_mouse_t{});
+        while (pointing_device_has_motion()) {
+            idle_for(POINTING_DEVICE_REPORT_INTERVAL);
+        }
+        run_one_scan_loop();
+        testing::Mock::VerifyAndClearExpectations(&driver);
+    }
+
+    void move(int8_t x, int8_t y) {
+        report_mouse_t report = pointing_device_get_report();
+        report.x = x;
+        report.y = y;
+        pointing_device_set_report(report);
+    }
+
+    int sum_x() {
+        int x = 0;
+        for (auto& r : reports) {
+            x += r.x;
+        }
+        return x;
+    }
+};
+
+TEST_F(PointingDevice, NothingSentWithoutChange) {
+    idle_for(100);
+    EXPECT_TRUE(reports.empty());
+}
+
+TEST_F(PointingDevice, ButtonChangesAreSentRightAway) {
+    report_mouse_t report = {};
+    report.buttons = MOUSE_BTN1;
+    pointing_device_set_report(report);
+    run_one_scan_loop();
+    ASSERT_EQ(reports.size(), 1u);
+    EXPECT_EQ(reports[0].buttons, MOUSE_BTN1);
+
+    idle_for(100);
+    EXPECT_EQ(reports.size(), 1u);
+
+    pointing_device_set_report(report_mouse_t{});
+    run_one_scan_loop();
+    ASSERT_EQ(reports.size(), 2u);
+    EXPECT_EQ(reports[1].buttons, 0);
+}
+
+TEST_F(PointingDevice, MotionIsAccumulatedBetweenReports) {
+    const unsigned ms = 100;
+    for (unsigned i = 0; i < ms; i++) {
+        move(1, 0);
+        run_one_scan_loop();
+    }
+    EXPECT_NEAR(reports.size(), ms / POINTING_DEVICE_REPORT_INTERVAL, 1);
+    EXPECT_NEAR(sum_x(), ms, POINTING_DEVICE_REPORT_INTERVAL);
+    idle_for(POINTING_DEVICE_REPORT_INTERVAL);
+    EXPECT_EQ(sum_x(), ms);
+}
+
+TEST_F(PointingDevice, LargeMotionIsSplit) {
+    pointing_device_add_motion(300, -300, 0, 0);
+    idle_for(POINTING_DEVICE_REPORT_INTERVAL * 3);
+    ASSERT_EQ(reports.size(), 3u);
+    EXPECT_EQ(reports[0].x, 127);
+    EXPECT_EQ(reports[0].y, -127);
+    EXPECT_EQ(reports[1].x, 127);
+    EXPECT_EQ(reports[2].x, 46);
+    EXPECT_EQ(reports[2].y, -46);
+    EXPECT_FALSE(pointing_device_has_motion());
+}
+
+TEST_F(PointingDevice, ButtonChangeCarriesPendingMotion) {
+    move(5, 0);
+    run_one_scan_loop();
+    ASSERT_EQ(reports.size(), 1u);
+    move(3, 0);
+    run_one_scan_loop();
+    EXPECT_EQ(reports.size(), 1u);
+
+    report_mouse_t report = pointing_device_get_report();
+    report.buttons = MOUSE_BTN2;
+    pointing_device_set_report(report);
+    run_one_scan_loop();
+    ASSERT_EQ(reports.size(), 2u);
+    EXPECT_EQ(reports[1].x, 3);
+    EXPECT_EQ(reports[1].buttons, MOUSE_BTN2);
+}
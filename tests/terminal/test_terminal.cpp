@@ -0,0 +1,133 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "test_common.hpp"
+#include <string>
+
+extern "C" {
+extern bool terminal_enabled;
+extern char buffer[];
+}
+
+using testing::_;
+using testing::AnyNumber;
+
+class Terminal : public TestFixture {
+protected:
+    TestDriver driver;
+
+    void SetUp() override {
+        // the terminal types its output, which isn't checked here
+        EXPECT_CALL(driver, send_keyboard_mock(_)).Times(AnyNumber());
+        tap(0, 0);
+        type("flush-buffer");
+        enter();
+    }
+
+    void tap(uint8_t col, uint8_t row) {
+        press_key(col, row);
+        run_one_scan_loop();
+        release_key(col, row);
+        run_one_scan_loop();
+        // until the output has been typed
+        idle_for(100);
+    }
+
+    void type(const char *text) {
+        static const std::string keys[2] = { "    abcefh", "ilrstux-" };
+        for (; *text; text++) {
+            for (uint8_t row = 0; row < 2; row++) {
+                size_t col = keys[row].find(*text);
+                if (col != std::string::npos) {
+                    tap(col, row);
+                    break;
+                }
+            }
+        }
+    }
+
+    void enter() { tap(1, 0); }
+    void up() { tap(2, 0); }
+    void down() { tap(3, 0); }
+
+    void run(const char *line) {
+        type(line);
+        enter();
+    }
+};
+
+TEST_F(Terminal, RunsCommandsFoundByHash) {
+    EXPECT_TRUE(terminal_enabled);
+    run("exit");
+    EXPECT_FALSE(terminal_enabled);
+}
+
+TEST_F(Terminal, RecallsNewestFirstAndStopsAtBothEnds) {
+    run("a");
+    run("b");
+    down();
+    EXPECT_STREQ(buffer, "");
+    up();
+    EXPECT_STREQ(buffer, "b");
+    up();
+    EXPECT_STREQ(buffer, "a");
+    // "flush-buffer" doesn't fit the history
+    up();
+    EXPECT_STREQ(buffer, "a");
+    down();
+    EXPECT_STREQ(buffer, "b");
+    down();
+    EXPECT_STREQ(buffer, "");
+    down();
+    EXPECT_STREQ(buffer, "");
+    up();
+    EXPECT_STREQ(buffer, "b");
+}
+
+TEST_F(Terminal, RecallsAnEntryAcrossTheWrap) {
+    // 2 + 2 + 2 bytes, "ab" drops "a" and takes the last two and the first
+    run("a");
+    run("b");
+    run("c");
+    run("ab");
+    up();
+    EXPECT_STREQ(buffer, "ab");
+    up();
+    EXPECT_STREQ(buffer, "c");
+    up();
+    EXPECT_STREQ(buffer, "b");
+    up();
+    EXPECT_STREQ(buffer, "b");
+}
+
+TEST_F(Terminal, DropsOverwrittenEntries) {
+    run("a");
+    run("b");
+    run("c");
+    run("ab");
+    // drops "b"
+    run("cc");
+    up();
+    EXPECT_STREQ(buffer, "cc");
+    up();
+    EXPECT_STREQ(buffer, "ab");
+    up();
+    EXPECT_STREQ(buffer, "c");
+    up();
+    EXPECT_STREQ(buffer, "c");
+    down();
+    EXPECT_STREQ(buffer, "ab");
+}
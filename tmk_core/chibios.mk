@@ -104,6 +104,9 @@ else ifneq ("$(wildcard $(KEYBOARD_PATH_2)/ld/$(MCU_LDSCRIPT).ld)","")
     LDSCRIPT = $(KEYBOARD_PATH_2)/ld/$(MCU_LDSCRIPT).ld
 else ifneq ("$(wildcard $(KEYBOARD_PATH_1)/ld/$(MCU_LDSCRIPT).ld)","")
     LDSCRIPT = $(KEYBOARD_PATH_1)/ld/$(MCU_LDSCRIPT).ld
+else ifneq ("$(wildcard $(TOP_DIR)/tmk_core/common/chibios/ld/$(MCU_LDSCRIPT).ld)","")
+    # Reserves the flash used for the emulated EEPROM
+    LDSCRIPT = $(TOP_DIR)/tmk_core/common/chibios/ld/$(MCU_LDSCRIPT).ld
 else
     LDSCRIPT = $(STARTUPLD)/$(MCU_LDSCRIPT).ld
 endif
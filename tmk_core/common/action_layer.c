@@ -291,15 +291,11 @@ action_t store_or_get_action(bool pressed, keypos_t key)
 int8_t layer_switch_get_layer(keypos_t key)
 {
 #ifndef NO_ACTION_LAYER
-    action_t action;
-    action.code = ACTION_TRANSPARENT;
-
     uint32_t layers = layer_state | default_layer_state;
     /* check top layer first */
     for (int8_t i = 31; i >= 0; i--) {
         if (layers & (1UL<<i)) {
-            action = action_for_key(i, key);
-            if (action.code != ACTION_TRANSPARENT) {
+            if (!action_key_is_transparent(i, key)) {
                 return i;
             }
         }
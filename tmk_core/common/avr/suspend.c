@@ -10,6 +10,7 @@
 #include "timer.h"
 #include "led.h"
 #include "host.h"
+#include "eeconfig.h"
 
 #ifdef PROTOCOL_LUFA
 	#include "lufa.h"
@@ -143,6 +144,8 @@ static void power_down(uint8_t wdto)
  */
 void suspend_power_down(void)
 {
+    // Don't leave settings only in RAM while the host may cut the power
+    eeconfig_flush();
 #ifndef NO_SUSPEND_POWER_DOWN
     power_down(WDTO_15MS);
 #endif
@@ -140,6 +140,35 @@ uint32_t timer_elapsed32(uint32_t last)
     return TIMER_DIFF_32(t, last);
 }
 
+#ifndef __AVR_ATmega32A__
+#define TIMER_RAW_PENDING() (TIFR0 & (1<<OCF0A))
+#else
+#define TIMER_RAW_PENDING() (TIFR & (1<<OCF0))
+#endif
+
+/** \brief timer read raw
+ *
+ * Millisecond count and Timer0 combined into one tick count, fine enough
+ * to time edges from a pin change interrupt.
+ */
+uint16_t timer_read_raw(void)
+{
+    uint16_t ms;
+    uint8_t raw;
+
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+      ms = timer_count;
+      raw = TIMER_RAW;
+      // Timer0 wrapped but timer_count was not updated yet
+      if (TIMER_RAW_PENDING()) {
+        ms++;
+        raw = TIMER_RAW;
+      }
+    }
+
+    return ms * (TIMER_RAW_TOP + 1) + raw;
+}
+
 // excecuted once per 1ms.(excess for just timer count?)
 #ifndef __AVR_ATmega32A__
 #define TIMER_INTERRUPT_VECTOR TIMER0_COMPA_vect
@@ -39,4 +39,15 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #   error "Timer0 can't count 1ms at this clock freq. Use larger prescaler."
 #endif
 
+#define TIMER_RAW_US_PER_TICK   (1000000UL / TIMER_RAW_FREQ)
+
+/* Free running count of TIMER_RAW ticks, wraps every 65536 ticks */
+uint16_t timer_read_raw(void);
+
+/* Ticks to us without a division, saturates at 0xFFFF */
+static inline uint16_t timer_raw_to_us(uint16_t ticks)
+{
+    return ticks < 0xFFFF / TIMER_RAW_US_PER_TICK ? ticks * TIMER_RAW_US_PER_TICK : 0xFFFF;
+}
+
 #endif
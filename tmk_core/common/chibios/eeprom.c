@@ -545,6 +545,100 @@ void eeprom_write_block(const void *buf, void *addr, uint32_t len)
 	}
 }
 
+#else
+#if defined(STM32F303xC) || defined(EEPROM_EMU_PAGE_BASE)
+// Emulated in the last two pages of the flash, see eeprom_log.h
+
+#include "eeprom_log.h"
+// EEPROM_SIZE
+#include "eeprom.h"
+
+#ifndef EEPROM_EMU_PAGE_SIZE
+#define EEPROM_EMU_PAGE_SIZE 2048
+#endif
+#ifndef EEPROM_EMU_PAGE_BASE
+// 256k flash, the pages are kept out of flash0 by ld/STM32F303xC.ld. A
+// keyboard with its own linker script has to leave them out as well.
+#define EEPROM_EMU_PAGE_BASE (0x08040000 - 2 * EEPROM_EMU_PAGE_SIZE)
+#endif
+
+// A compaction must leave at least half of the page for new records
+#if EEPROM_SIZE * 4 > EEPROM_EMU_PAGE_SIZE / 2
+#error "EEPROM_SIZE is too large for EEPROM_EMU_PAGE_SIZE"
+#endif
+
+#define FLASH_UNLOCK_KEY1 0x45670123
+#define FLASH_UNLOCK_KEY2 0xCDEF89AB
+
+static uint8_t buffer[EEPROM_SIZE];
+static eeprom_log_t eeprom_log = {
+	.page = {
+		(uint16_t *)EEPROM_EMU_PAGE_BASE,
+		(uint16_t *)(EEPROM_EMU_PAGE_BASE + EEPROM_EMU_PAGE_SIZE),
+	},
+	.page_size = EEPROM_EMU_PAGE_SIZE / 2,
+	.data = buffer,
+	.size = EEPROM_SIZE,
+};
+static bool initialized = false;
+
+static void flash_wait(void)
+{
+	while (FLASH->SR & FLASH_SR_BSY) ;
+	FLASH->SR = FLASH_SR_EOP | FLASH_SR_PGERR | FLASH_SR_WRPERR;
+}
+
+static void flash_unlock(void)
+{
+	if (FLASH->CR & FLASH_CR_LOCK) {
+		FLASH->KEYR = FLASH_UNLOCK_KEY1;
+		FLASH->KEYR = FLASH_UNLOCK_KEY2;
+	}
+}
+
+void eeprom_log_flash_erase(uint16_t *page)
+{
+	flash_unlock();
+	flash_wait();
+	FLASH->CR |= FLASH_CR_PER;
+	FLASH->AR = (uint32_t)page;
+	FLASH->CR |= FLASH_CR_STRT;
+	flash_wait();
+	FLASH->CR &= ~FLASH_CR_PER;
+	FLASH->CR |= FLASH_CR_LOCK;
+}
+
+void eeprom_log_flash_program(uint16_t *addr, uint16_t value)
+{
+	flash_unlock();
+	flash_wait();
+	FLASH->CR |= FLASH_CR_PG;
+	*(volatile uint16_t *)addr = value;
+	flash_wait();
+	FLASH->CR &= ~FLASH_CR_PG;
+	FLASH->CR |= FLASH_CR_LOCK;
+}
+
+void eeprom_initialize(void)
+{
+	eeprom_log_init(&eeprom_log);
+	initialized = true;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+	uint32_t offset = (uint32_t)addr;
+	if (!initialized) eeprom_initialize();
+	if (offset >= EEPROM_SIZE) return 0xFF;
+	return buffer[offset];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t value) {
+	uint32_t offset = (uint32_t)addr;
+	if (!initialized) eeprom_initialize();
+	// Unchanged bytes are not logged
+	eeprom_log_write(&eeprom_log, offset, value);
+}
+
 #else
 // No EEPROM supported, so emulate it
 
@@ -560,6 +654,7 @@ void eeprom_write_byte(uint8_t *addr, uint8_t value) {
 	uint32_t offset = (uint32_t)addr;
 	buffer[offset] = value;
 }
+#endif
 
 uint16_t eeprom_read_word(const uint16_t *addr) {
 	const uint8_t *p = (const uint8_t *)addr;
@@ -603,30 +698,32 @@ void eeprom_write_block(const void *buf, void *addr, uint32_t len) {
 }
 
 #endif /* chip selection */
-// The update functions just calls write for now, but could probably be optimized
+// Only changed bytes are written, the flash backends wear with every write
 
 void eeprom_update_byte(uint8_t *addr, uint8_t value) {
-	eeprom_write_byte(addr, value);
+	if (eeprom_read_byte(addr) != value) {
+		eeprom_write_byte(addr, value);
+	}
 }
 
 void eeprom_update_word(uint16_t *addr, uint16_t value) {
 	uint8_t *p = (uint8_t *)addr;
-	eeprom_write_byte(p++, value);
-	eeprom_write_byte(p, value >> 8);
+	eeprom_update_byte(p++, value);
+	eeprom_update_byte(p, value >> 8);
 }
 
 void eeprom_update_dword(uint32_t *addr, uint32_t value) {
 	uint8_t *p = (uint8_t *)addr;
-	eeprom_write_byte(p++, value);
-	eeprom_write_byte(p++, value >> 8);
-	eeprom_write_byte(p++, value >> 16);
-	eeprom_write_byte(p, value >> 24);
+	eeprom_update_byte(p++, value);
+	eeprom_update_byte(p++, value >> 8);
+	eeprom_update_byte(p++, value >> 16);
+	eeprom_update_byte(p, value >> 24);
 }
 
 void eeprom_update_block(const void *buf, void *addr, uint32_t len) {
 	uint8_t *p = (uint8_t *)addr;
 	const uint8_t *src = (const uint8_t *)buf;
 	while (len--) {
-		eeprom_write_byte(p++, *src++);
+		eeprom_update_byte(p++, *src++);
 	}
 }
@@ -0,0 +1,113 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include "eeprom_log.h"
+
+#define EEPROM_LOG_FIRST_RECORD 2
+
+static void eeprom_log_erase_unless_erased(eeprom_log_t *log, uint8_t page) {
+    for (uint16_t i = 0; i < log->page_size; i++) {
+        if (log->page[page][i] != EEPROM_LOG_ERASED) {
+            eeprom_log_flash_erase(log->page[page]);
+            return;
+        }
+    }
+}
+
+static void eeprom_log_replay(eeprom_log_t *log) {
+    const uint16_t *page = log->page[log->active];
+    uint16_t i = EEPROM_LOG_FIRST_RECORD;
+
+    memset(log->data, 0xFF, log->size);
+    for (; i + 1 < log->page_size; i += 2) {
+        uint16_t value = page[i];
+        uint16_t offset = page[i + 1];
+        if (offset == EEPROM_LOG_ERASED) {
+            if (value == EEPROM_LOG_ERASED) {
+                break;
+            }
+            // torn record
+            continue;
+        }
+        if (offset < log->size) {
+            log->data[offset] = value;
+        }
+    }
+    log->next = i;
+}
+
+void eeprom_log_init(eeprom_log_t *log) {
+    uint16_t status[2] = { log->page[0][0], log->page[1][0] };
+    uint8_t page;
+
+    if (status[0] == EEPROM_LOG_VALID || status[1] == EEPROM_LOG_VALID) {
+        // A RECEIVING page next to a valid one is an unfinished compaction,
+        // the valid page still has everything
+        page = status[0] == EEPROM_LOG_VALID ? 0 : 1;
+    } else if (status[0] == EEPROM_LOG_RECEIVING || status[1] == EEPROM_LOG_RECEIVING) {
+        // The old page was already erased, so the copy is complete
+        page = status[0] == EEPROM_LOG_RECEIVING ? 0 : 1;
+        eeprom_log_flash_program(&log->page[page][0], EEPROM_LOG_VALID);
+    } else {
+        // Never used
+        page = 0;
+        eeprom_log_erase_unless_erased(log, 0);
+        eeprom_log_flash_program(&log->page[0][0], EEPROM_LOG_VALID);
+    }
+    eeprom_log_erase_unless_erased(log, !page);
+
+    log->active = page;
+    eeprom_log_replay(log);
+}
+
+// Copies the RAM copy into the other page, which is always erased
+static void eeprom_log_compact(eeprom_log_t *log) {
+    uint8_t target = !log->active;
+    uint16_t *page = log->page[target];
+    uint16_t next = EEPROM_LOG_FIRST_RECORD;
+
+    eeprom_log_flash_program(&page[0], EEPROM_LOG_RECEIVING);
+    for (uint16_t offset = 0; offset < log->size; offset++) {
+        // erased bytes read back as 0xFF anyway
+        if (log->data[offset] != 0xFF) {
+            eeprom_log_flash_program(&page[next], log->data[offset]);
+            eeprom_log_flash_program(&page[next + 1], offset);
+            next += 2;
+        }
+    }
+    eeprom_log_flash_erase(log->page[log->active]);
+    eeprom_log_flash_program(&page[0], EEPROM_LOG_VALID);
+
+    log->active = target;
+    log->next = next;
+}
+
+void eeprom_log_write(eeprom_log_t *log, uint16_t offset, uint8_t value) {
+    if (offset >= log->size || log->data[offset] == value) {
+        return;
+    }
+    log->data[offset] = value;
+
+    if (log->next + 2 > log->page_size) {
+        eeprom_log_compact(log);
+        return;
+    }
+    uint16_t *record = &log->page[log->active][log->next];
+    eeprom_log_flash_program(&record[0], value);
+    eeprom_log_flash_program(&record[1], offset);
+    log->next += 2;
+}
@@ -0,0 +1,65 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EEPROM_LOG_H
+#define EEPROM_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Log structured EEPROM emulation in two flash pages
+ *
+ * The emulated EEPROM lives in RAM and every changed byte is appended to
+ * the active page as a record, so each flash location is written only once
+ * between erases. When the active page is full the current contents are
+ * compacted into the other page and the full one is erased, which spreads
+ * the wear evenly over both pages.
+ *
+ * Every page starts with a status halfword followed by 4 byte records, the
+ * byte value and then its offset. Writing the offset last means a record
+ * torn by a power loss is never replayed. A page is only marked valid after
+ * the old one has been erased, so an interrupted compaction is finished on
+ * the next start.
+ *
+ * Flash can only be programmed from 1 to 0, and the status goes from
+ * ERASED to RECEIVING to VALID.
+ */
+
+#define EEPROM_LOG_ERASED    0xFFFF
+#define EEPROM_LOG_RECEIVING 0xEEEE
+#define EEPROM_LOG_VALID     0x0000
+
+typedef struct {
+    uint16_t *page[2];
+    // in halfwords
+    uint16_t page_size;
+    // The emulated EEPROM
+    uint8_t *data;
+    uint16_t size;
+    uint8_t active;
+    // Halfword index of the first free record in the active page
+    uint16_t next;
+} eeprom_log_t;
+
+// Fills the RAM copy from the flash, and repairs an interrupted compaction
+void eeprom_log_init(eeprom_log_t *log);
+void eeprom_log_write(eeprom_log_t *log, uint16_t offset, uint8_t value);
+
+// Implemented by the platform
+void eeprom_log_flash_erase(uint16_t *page);
+void eeprom_log_flash_program(uint16_t *addr, uint16_t value);
+
+#endif
@@ -11,6 +11,7 @@
 #include "backlight.h"
 #include "suspend.h"
 #include "wait.h"
+#include "eeconfig.h"
 
 /** \brief suspend idle
  *
@@ -46,6 +47,8 @@ void suspend_power_down(void) {
 	// also shouldn't power down USB
 
   suspend_power_down_kb();
+  // Don't leave settings only in RAM while the host may cut the power
+  eeconfig_flush();
 	// on AVR, this enables the watchdog for 15ms (max), and goes to
 	// SLEEP_MODE_PWR_DOWN
 
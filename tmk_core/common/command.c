@@ -55,6 +55,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
     #include "audio.h"
 #endif /* AUDIO_ENABLE */
 
+#ifdef THREADED_RUNTIME_ENABLE
+    #include "runtime.h"
+#endif
+
 
 static bool command_common(uint8_t code);
 static void command_common_help(void);
@@ -170,6 +174,10 @@ static void command_common_help(void)
 #ifdef SLEEP_LED_ENABLE
 		STR(MAGIC_KEY_SLEEP_LED   ) ":	Sleep LED Test\n"
 #endif
+
+#ifdef PROFILER_ENABLE
+		STR(MAGIC_KEY_PROFILER    ) ":	Print and Reset Profiler Stats\n"
+#endif
     );
 }
 
@@ -257,6 +265,10 @@ static void print_status(void)
 #   if USB_COUNT_SOF
     print_val_hex8(usbSofCount);
 #   endif
+#endif
+
+#ifdef THREADED_RUNTIME_ENABLE
+    runtime_print_stats();
 #endif
 	return;
 }
@@ -374,6 +386,7 @@ static bool command_common(uint8_t code)
             #else
 	            wait_ms(1000);
             #endif
+            eeconfig_flush();
             bootloader_jump(); // not return
             break;
 
@@ -433,6 +446,14 @@ static bool command_common(uint8_t code)
 			print_status();
             break;
 
+#ifdef PROFILER_ENABLE
+		// print profiler stats, the next dump covers the time from here
+		case MAGIC_KC(MAGIC_KEY_PROFILER):
+			profiler_print();
+			profiler_reset();
+            break;
+#endif
+
 #ifdef NKRO_ENABLE
 
 		// NKRO toggle
@@ -583,6 +604,8 @@ static void mousekey_param_print(void)
     print("4: time_to_max: "); pdec(mk_time_to_max); print("\n");
     print("5: wheel_max_speed: "); pdec(mk_wheel_max_speed); print("\n");
     print("6: wheel_time_to_max: "); pdec(mk_wheel_time_to_max); print("\n");
+    print("7: curve: "); pdec(mk_curve); print("\n");
+    print("8: report_interval(ms): "); pdec(mk_report_interval); print("\n");
 #endif /* !NO_PRINT */
 
 }
@@ -634,6 +657,20 @@ static void mousekey_param_inc(uint8_t param, uint8_t inc)
                 mk_wheel_time_to_max = UINT8_MAX;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve + inc < MOUSEKEY_CURVE_COUNT)
+                mk_curve += inc;
+            else
+                mk_curve = MOUSEKEY_CURVE_COUNT - 1;
+            PRINT_SET_VAL(mk_curve);
+            break;
+        case 8:
+            if (mk_report_interval + inc < UINT8_MAX)
+                mk_report_interval += inc;
+            else
+                mk_report_interval = UINT8_MAX;
+            PRINT_SET_VAL(mk_report_interval);
+            break;
     }
 }
 
@@ -682,6 +719,20 @@ static void mousekey_param_dec(uint8_t param, uint8_t dec)
                 mk_wheel_time_to_max = 0;
             PRINT_SET_VAL(mk_wheel_time_to_max);
             break;
+        case 7:
+            if (mk_curve > dec)
+                mk_curve -= dec;
+            else
+                mk_curve = 0;
+            PRINT_SET_VAL(mk_curve);
+            break;
+        case 8:
+            if (mk_report_interval > dec + 1)
+                mk_report_interval -= dec;
+            else
+                mk_report_interval = 1;
+            PRINT_SET_VAL(mk_report_interval);
+            break;
     }
 }
 
@@ -695,6 +746,8 @@ static void mousekey_console_help(void)
           "4:	time_to_max\n"
           "5:	wheel_max_speed\n"
           "6:	wheel_time_to_max\n"
+          "7:	curve(0:const 1:linear 2:quad 3:kinetic)\n"
+          "8:	report_interval(ms)\n"
           "\n"
           "p:	print values\n"
           "d:	set defaults\n"
@@ -703,7 +756,7 @@ static void mousekey_console_help(void)
           "pgup:	+10\n"
           "pgdown:	-10\n"
           "\n"
-          "speed = delta * max_speed * (repeat / time_to_max)\n");
+          "speed = delta * max_speed * curve(t / (time_to_max * interval)) / interval\n");
     xprintf("where delta: cursor=%d, wheel=%d\n"
             "See http://en.wikipedia.org/wiki/Mouse_keys\n", MOUSEKEY_MOVE_DELTA,  MOUSEKEY_WHEEL_DELTA);
 }
@@ -734,6 +787,8 @@ static bool mousekey_console(uint8_t code)
         case KC_4:
         case KC_5:
         case KC_6:
+        case KC_7:
+        case KC_8:
             mousekey_param = numkey2num(code);
             break;
         case KC_UP:
@@ -755,6 +810,8 @@ static bool mousekey_console(uint8_t code)
             mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
             mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
             mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
+            mk_curve = MOUSEKEY_CURVE;
+            mk_report_interval = MOUSEKEY_REPORT_INTERVAL;
             print("set default\n");
             break;
         default:
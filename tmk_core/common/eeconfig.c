@@ -2,6 +2,136 @@
 #include <stdbool.h>
 #include "eeprom.h"
 #include "eeconfig.h"
+#include "timer.h"
+
+static uint8_t eeconfig_mirror[EECONFIG_SIZE];
+static bool eeconfig_loaded = false;
+// One bit per byte of the mirror that hasn't been written yet
+static uint16_t eeconfig_dirty = 0;
+static uint16_t eeconfig_last_change;
+
+#if EECONFIG_SIZE > 16
+#error "eeconfig_dirty has a bit per byte of the eeconfig block"
+#endif
+
+static inline bool eeconfig_in_mirror(const void *addr, uint8_t size) {
+    return (uintptr_t)addr + size <= EECONFIG_SIZE;
+}
+
+static void eeconfig_load(void) {
+    if (!eeconfig_loaded) {
+        eeprom_read_block(eeconfig_mirror, (const void *)0, EECONFIG_SIZE);
+        eeconfig_loaded = true;
+    }
+}
+
+static uint32_t eeconfig_read(const void *addr, uint8_t size) {
+    uint8_t offset = (uintptr_t)addr;
+    uint32_t val = 0;
+    eeconfig_load();
+    for (uint8_t i = size; i > 0; i--) {
+        val = (val << 8) | eeconfig_mirror[offset + i - 1];
+    }
+    return val;
+}
+
+static void eeconfig_write(void *addr, uint32_t val, uint8_t size) {
+    uint8_t offset = (uintptr_t)addr;
+    eeconfig_load();
+    for (uint8_t i = 0; i < size; i++, val >>= 8) {
+        if (eeconfig_mirror[offset + i] != (uint8_t)val) {
+            eeconfig_mirror[offset + i] = val;
+            eeconfig_dirty |= 1 << (offset + i);
+            eeconfig_last_change = timer_read();
+        }
+    }
+}
+
+/** \brief eeconfig read byte
+ *
+ * Reads from the RAM copy when addr is inside the eeconfig block
+ */
+uint8_t eeconfig_read_byte(const uint8_t *addr)
+{
+    if (!eeconfig_in_mirror(addr, 1)) return eeprom_read_byte(addr);
+    return eeconfig_read(addr, 1);
+}
+
+/** \brief eeconfig update byte
+ *
+ * Updates the RAM copy when addr is inside the eeconfig block, the EEPROM
+ * is written later by eeconfig_task()
+ */
+void eeconfig_update_byte(uint8_t *addr, uint8_t val)
+{
+    if (!eeconfig_in_mirror(addr, 1)) { eeprom_update_byte(addr, val); return; }
+    eeconfig_write(addr, val, 1);
+}
+
+/** \brief eeconfig read word
+ *
+ * See eeconfig_read_byte()
+ */
+uint16_t eeconfig_read_word(const uint16_t *addr)
+{
+    if (!eeconfig_in_mirror(addr, 2)) return eeprom_read_word(addr);
+    return eeconfig_read(addr, 2);
+}
+
+/** \brief eeconfig update word
+ *
+ * See eeconfig_update_byte()
+ */
+void eeconfig_update_word(uint16_t *addr, uint16_t val)
+{
+    if (!eeconfig_in_mirror(addr, 2)) { eeprom_update_word(addr, val); return; }
+    eeconfig_write(addr, val, 2);
+}
+
+/** \brief eeconfig read dword
+ *
+ * See eeconfig_read_byte()
+ */
+uint32_t eeconfig_read_dword(const uint32_t *addr)
+{
+    if (!eeconfig_in_mirror(addr, 4)) return eeprom_read_dword(addr);
+    return eeconfig_read(addr, 4);
+}
+
+/** \brief eeconfig update dword
+ *
+ * See eeconfig_update_byte()
+ */
+void eeconfig_update_dword(uint32_t *addr, uint32_t val)
+{
+    if (!eeconfig_in_mirror(addr, 4)) { eeprom_update_dword(addr, val); return; }
+    eeconfig_write(addr, val, 4);
+}
+
+/** \brief eeconfig flush
+ *
+ * Writes the changed bytes of the RAM copy to the EEPROM
+ */
+void eeconfig_flush(void)
+{
+    for (uint8_t i = 0; eeconfig_dirty; i++, eeconfig_dirty >>= 1) {
+        if (eeconfig_dirty & 1) {
+            eeprom_update_byte((uint8_t *)(uintptr_t)i, eeconfig_mirror[i]);
+        }
+    }
+}
+
+/** \brief eeconfig task
+ *
+ * Commits changes once they have settled, so holding down e.g. a hue key
+ * results in a single write instead of one per step
+ */
+void eeconfig_task(void)
+{
+    if (eeconfig_dirty && timer_elapsed(eeconfig_last_change) >= EECONFIG_COMMIT_DELAY) {
+        eeconfig_flush();
+    }
+}
 
 /** \brief eeconfig initialization
  *
@@ -9,23 +139,24 @@
  */
 void eeconfig_init(void)
 {
-    eeprom_update_word(EECONFIG_MAGIC,          EECONFIG_MAGIC_NUMBER);
-    eeprom_update_byte(EECONFIG_DEBUG,          0);
-    eeprom_update_byte(EECONFIG_DEFAULT_LAYER,  0);
-    eeprom_update_byte(EECONFIG_KEYMAP,         0);
-    eeprom_update_byte(EECONFIG_MOUSEKEY_ACCEL, 0);
+    eeconfig_update_word(EECONFIG_MAGIC,          EECONFIG_MAGIC_NUMBER);
+    eeconfig_update_byte(EECONFIG_DEBUG,          0);
+    eeconfig_update_byte(EECONFIG_DEFAULT_LAYER,  0);
+    eeconfig_update_byte(EECONFIG_KEYMAP,         0);
+    eeconfig_update_byte(EECONFIG_MOUSEKEY_ACCEL, 0);
 #ifdef BACKLIGHT_ENABLE
-    eeprom_update_byte(EECONFIG_BACKLIGHT,      0);
+    eeconfig_update_byte(EECONFIG_BACKLIGHT,      0);
 #endif
 #ifdef AUDIO_ENABLE
-    eeprom_update_byte(EECONFIG_AUDIO,             0xFF); // On by default
+    eeconfig_update_byte(EECONFIG_AUDIO,             0xFF); // On by default
 #endif
 #if defined(RGBLIGHT_ENABLE) || defined(RGB_MATRIX_ENABLE)
-    eeprom_update_dword(EECONFIG_RGBLIGHT,      0);
+    eeconfig_update_dword(EECONFIG_RGBLIGHT,      0);
 #endif
 #ifdef STENO_ENABLE
-    eeprom_update_byte(EECONFIG_STENOMODE,      0);
+    eeconfig_update_byte(EECONFIG_STENOMODE,      0);
 #endif
+    eeconfig_flush();
 }
 
 /** \brief eeconfig enable
@@ -34,7 +165,8 @@ void eeconfig_init(void)
  */
 void eeconfig_enable(void)
 {
-    eeprom_update_word(EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER);
+    eeconfig_update_word(EECONFIG_MAGIC, EECONFIG_MAGIC_NUMBER);
+    eeconfig_flush();
 }
 
 /** \brief eeconfig disable
@@ -43,7 +175,8 @@ void eeconfig_enable(void)
  */
 void eeconfig_disable(void)
 {
-    eeprom_update_word(EECONFIG_MAGIC, 0xFFFF);
+    eeconfig_update_word(EECONFIG_MAGIC, 0xFFFF);
+    eeconfig_flush();
 }
 
 /** \brief eeconfig is enabled
@@ -52,53 +185,53 @@ void eeconfig_disable(void)
  */
 bool eeconfig_is_enabled(void)
 {
-    return (eeprom_read_word(EECONFIG_MAGIC) == EECONFIG_MAGIC_NUMBER);
+    return (eeconfig_read_word(EECONFIG_MAGIC) == EECONFIG_MAGIC_NUMBER);
 }
 
 /** \brief eeconfig read debug
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_debug(void)      { return eeprom_read_byte(EECONFIG_DEBUG); }
+uint8_t eeconfig_read_debug(void)      { return eeconfig_read_byte(EECONFIG_DEBUG); }
 /** \brief eeconfig update debug
  *
  * FIXME: needs doc
  */
-void eeconfig_update_debug(uint8_t val) { eeprom_update_byte(EECONFIG_DEBUG, val); }
+void eeconfig_update_debug(uint8_t val) { eeconfig_update_byte(EECONFIG_DEBUG, val); }
 
 /** \brief eeconfig read default layer
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_default_layer(void)      { return eeprom_read_byte(EECONFIG_DEFAULT_LAYER); }
+uint8_t eeconfig_read_default_layer(void)      { return eeconfig_read_byte(EECONFIG_DEFAULT_LAYER); }
 /** \brief eeconfig update default layer
  *
  * FIXME: needs doc
  */
-void eeconfig_update_default_layer(uint8_t val) { eeprom_update_byte(EECONFIG_DEFAULT_LAYER, val); }
+void eeconfig_update_default_layer(uint8_t val) { eeconfig_update_byte(EECONFIG_DEFAULT_LAYER, val); }
 
 /** \brief eeconfig read keymap
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_keymap(void)      { return eeprom_read_byte(EECONFIG_KEYMAP); }
+uint8_t eeconfig_read_keymap(void)      { return eeconfig_read_byte(EECONFIG_KEYMAP); }
 /** \brief eeconfig update keymap
  *
  * FIXME: needs doc
  */
-void eeconfig_update_keymap(uint8_t val) { eeprom_update_byte(EECONFIG_KEYMAP, val); }
+void eeconfig_update_keymap(uint8_t val) { eeconfig_update_byte(EECONFIG_KEYMAP, val); }
 
 #ifdef BACKLIGHT_ENABLE
 /** \brief eeconfig read backlight
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_backlight(void)      { return eeprom_read_byte(EECONFIG_BACKLIGHT); }
+uint8_t eeconfig_read_backlight(void)      { return eeconfig_read_byte(EECONFIG_BACKLIGHT); }
 /** \brief eeconfig update backlight
  *
  * FIXME: needs doc
  */
-void eeconfig_update_backlight(uint8_t val) { eeprom_update_byte(EECONFIG_BACKLIGHT, val); }
+void eeconfig_update_backlight(uint8_t val) { eeconfig_update_byte(EECONFIG_BACKLIGHT, val); }
 #endif
 
 #ifdef AUDIO_ENABLE
@@ -106,10 +239,10 @@ void eeconfig_update_backlight(uint8_t val) { eeprom_update_byte(EECONFIG_BACKLI
  *
  * FIXME: needs doc
  */
-uint8_t eeconfig_read_audio(void)      { return eeprom_read_byte(EECONFIG_AUDIO); }
+uint8_t eeconfig_read_audio(void)      { return eeconfig_read_byte(EECONFIG_AUDIO); }
 /** \brief eeconfig update audio
  *
  * FIXME: needs doc
  */
-void eeconfig_update_audio(uint8_t val) { eeprom_update_byte(EECONFIG_AUDIO, val); }
+void eeconfig_update_audio(uint8_t val) { eeconfig_update_byte(EECONFIG_AUDIO, val); }
 #endif
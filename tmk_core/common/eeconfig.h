@@ -38,6 +38,14 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 // EEHANDS for two handed boards
 #define EECONFIG_HANDEDNESS         				(uint8_t *)14
 
+/* Bytes from address 0 that are kept in RAM, at most 16 */
+#define EECONFIG_SIZE                               15
+
+/* Changes are written to the EEPROM once nothing changed for this long (ms) */
+#ifndef EECONFIG_COMMIT_DELAY
+#define EECONFIG_COMMIT_DELAY                       3000
+#endif
+
 
 /* debug bit */
 #define EECONFIG_DEBUG_ENABLE                       (1<<0)
@@ -64,6 +72,20 @@ void eeconfig_enable(void);
 
 void eeconfig_disable(void);
 
+/* Settings are read from and written to a RAM copy of the eeconfig block,
+ * and written to the EEPROM by eeconfig_task() once they stopped changing.
+ * Addresses outside the block go to the EEPROM directly. */
+uint8_t eeconfig_read_byte(const uint8_t *addr);
+void eeconfig_update_byte(uint8_t *addr, uint8_t val);
+uint16_t eeconfig_read_word(const uint16_t *addr);
+void eeconfig_update_word(uint16_t *addr, uint16_t val);
+uint32_t eeconfig_read_dword(const uint32_t *addr);
+void eeconfig_update_dword(uint32_t *addr, uint32_t val);
+
+void eeconfig_task(void);
+/* Writes pending changes right away, e.g. before suspend or reset */
+void eeconfig_flush(void);
+
 uint8_t eeconfig_read_debug(void);
 void eeconfig_update_debug(uint8_t val);
 
@@ -18,6 +18,14 @@ void 	eeprom_update_byte (uint8_t *__p, uint8_t __value);
 void 	eeprom_update_word (uint16_t *__p, uint16_t __value);
 void 	eeprom_update_dword (uint32_t *__p, uint32_t __value);
 void 	eeprom_update_block (const void *__src, void *__dst, uint32_t __n);
+
+/* The flash emulated EEPROM, with its last address like on AVR */
+#if defined(STM32F303xC) || defined(EEPROM_EMU_PAGE_BASE)
+#ifndef EEPROM_SIZE
+#define EEPROM_SIZE 256
+#endif
+#define E2END (EEPROM_SIZE - 1)
+#endif
 #endif
 
 
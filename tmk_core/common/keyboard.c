@@ -31,6 +31,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "eeconfig.h"
 #include "backlight.h"
 #include "action_layer.h"
+#include "profiler.h"
 #ifdef BOOTMAGIC_ENABLE
 #   include "bootmagic.h"
 #else
@@ -42,6 +43,9 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifdef PS2_MOUSE_ENABLE
 #   include "ps2_mouse.h"
 #endif
+#ifdef PS2_USE_INT
+#   include "ps2.h"
+#endif
 #ifdef SERIAL_MOUSE_ENABLE
 #   include "serial_mouse.h"
 #endif
@@ -151,6 +155,9 @@ bool is_keyboard_master(void) {
  */
 void keyboard_init(void) {
     timer_init();
+#ifdef PROFILER_ENABLE
+    profiler_init();
+#endif
 // To use PORTF disable JTAG with writing JTD bit twice within four cycles.
 #if  (defined(__AVR_AT90USB1286__) || defined(__AVR_AT90USB1287__) || defined(__AVR_ATmega32U4__))
   MCUCR |= _BV(JTD);
@@ -191,6 +198,71 @@ void keyboard_init(void) {
 #endif
 }
 
+static matrix_row_t matrix_prev[MATRIX_ROWS];
+static uint8_t led_status = 0;
+
+/** \brief Keyboard periodic tasks
+ *
+ * Everything keyboard_task does after an event (or TICK) went through
+ * action_exec: mouse movements, visualizer, midi and LEDs.
+ */
+static void keyboard_periodic_tasks(void)
+{
+#ifdef MOUSEKEY_ENABLE
+    // mousekey repeat & acceleration
+    PROFILE_BEGIN(PROFILER_MOUSEKEY);
+    mousekey_task();
+    PROFILE_END(PROFILER_MOUSEKEY);
+#endif
+
+#ifdef PS2_USE_INT
+    // PS/2 commands queued by LEDs and the mouse
+    ps2_host_task();
+#endif
+
+#ifdef PS2_MOUSE_ENABLE
+    ps2_mouse_task();
+#endif
+
+#ifdef SERIAL_MOUSE_ENABLE
+    serial_mouse_task();
+#endif
+
+#ifdef ADB_MOUSE_ENABLE
+    adb_mouse_task();
+#endif
+
+#ifdef SERIAL_LINK_ENABLE
+	serial_link_update();
+#endif
+
+#ifdef VISUALIZER_ENABLE
+    PROFILE_BEGIN(PROFILER_VISUALIZER);
+    visualizer_update(default_layer_state, layer_state, visualizer_get_mods(), host_keyboard_leds());
+    PROFILE_END(PROFILER_VISUALIZER);
+#endif
+
+#ifdef POINTING_DEVICE_ENABLE
+    PROFILE_BEGIN(PROFILER_POINTING_DEVICE);
+    pointing_device_task();
+    PROFILE_END(PROFILER_POINTING_DEVICE);
+#endif
+
+#ifdef MIDI_ENABLE
+    PROFILE_BEGIN(PROFILER_MIDI);
+    midi_task();
+    PROFILE_END(PROFILER_MIDI);
+#endif
+
+    eeconfig_task();
+
+    // update LED
+    if (led_status != host_keyboard_leds()) {
+        led_status = host_keyboard_leds();
+        keyboard_set_leds(led_status);
+    }
+}
+
 /** \brief Keyboard task: Do keyboard routine jobs
  *
  * Do routine keyboard jobs:
@@ -205,18 +277,19 @@ void keyboard_init(void) {
  */
 void keyboard_task(void)
 {
-    static matrix_row_t matrix_prev[MATRIX_ROWS];
 #ifdef MATRIX_HAS_GHOST
   //  static matrix_row_t matrix_ghost[MATRIX_ROWS];
 #endif
-    static uint8_t led_status = 0;
     matrix_row_t matrix_row = 0;
     matrix_row_t matrix_change = 0;
 #ifdef QMK_KEYS_PER_SCAN
     uint8_t keys_processed = 0;
 #endif
+    PROFILE_BEGIN(PROFILER_KEYBOARD_TASK);
 
+    PROFILE_BEGIN(PROFILER_MATRIX_SCAN);
     matrix_scan();
+    PROFILE_END(PROFILER_MATRIX_SCAN);
     if (is_keyboard_master()) {
         for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
             matrix_row = matrix_get_row(r);
@@ -239,11 +312,13 @@ void keyboard_task(void)
                 if (debug_matrix) matrix_print();
                 for (uint8_t c = 0; c < MATRIX_COLS; c++) {
                     if (matrix_change & ((matrix_row_t)1<<c)) {
+                        PROFILE_BEGIN(PROFILER_ACTION_EXEC);
                         action_exec((keyevent_t){
                             .key = (keypos_t){ .row = r, .col = c },
                             .pressed = (matrix_row & ((matrix_row_t)1<<c)),
                             .time = (timer_read() | 1) /* time should not be 0 */
                         });
+                        PROFILE_END(PROFILER_ACTION_EXEC);
                         // record a processed key
                         matrix_prev[r] ^= ((matrix_row_t)1<<c);
 #ifdef QMK_KEYS_PER_SCAN
@@ -262,50 +337,74 @@ void keyboard_task(void)
     // we can get here with some keys processed now.
     if (!keys_processed)
 #endif
-    action_exec(TICK);
+    {
+        PROFILE_BEGIN(PROFILER_ACTION_EXEC);
+        action_exec(TICK);
+        PROFILE_END(PROFILER_ACTION_EXEC);
+    }
 
 MATRIX_LOOP_END:
+    keyboard_periodic_tasks();
+    PROFILE_END(PROFILER_KEYBOARD_TASK);
+}
 
-#ifdef MOUSEKEY_ENABLE
-    // mousekey repeat & acceleration
-    mousekey_task();
-#endif
-
-#ifdef PS2_MOUSE_ENABLE
-    ps2_mouse_task();
-#endif
-
-#ifdef SERIAL_MOUSE_ENABLE
-    serial_mouse_task();
-#endif
-
-#ifdef ADB_MOUSE_ENABLE
-    adb_mouse_task();
-#endif
-
-#ifdef SERIAL_LINK_ENABLE
-	serial_link_update();
-#endif
-
-#ifdef VISUALIZER_ENABLE
-    visualizer_update(default_layer_state, layer_state, visualizer_get_mods(), host_keyboard_leds());
-#endif
-
-#ifdef POINTING_DEVICE_ENABLE
-    pointing_device_task();
-#endif
-
-#ifdef MIDI_ENABLE
-    midi_task();
+#ifdef THREADED_RUNTIME_ENABLE
+/** \brief Keyboard scan: the scan half of keyboard_task
+ *
+ * Scans the matrix and hands every changed key to post, oldest row first.
+ * When post refuses an event the scan stops there without recording the
+ * key, so it and the keys after it are posted again by the next scan.
+ */
+void keyboard_scan(bool (*post)(keyevent_t event))
+{
+    PROFILE_BEGIN(PROFILER_MATRIX_SCAN);
+    matrix_scan();
+    PROFILE_END(PROFILER_MATRIX_SCAN);
+    if (!is_keyboard_master()) {
+        return;
+    }
+    for (uint8_t r = 0; r < MATRIX_ROWS; r++) {
+        matrix_row_t matrix_row = matrix_get_row(r);
+        matrix_row_t matrix_change = matrix_row ^ matrix_prev[r];
+        if (!matrix_change) {
+            continue;
+        }
+#ifdef MATRIX_HAS_GHOST
+        if (has_ghost_in_row(r, matrix_row)) {
+            continue;
+        }
 #endif
-
-    // update LED
-    if (led_status != host_keyboard_leds()) {
-        led_status = host_keyboard_leds();
-        keyboard_set_leds(led_status);
+        if (debug_matrix) matrix_print();
+        for (uint8_t c = 0; c < MATRIX_COLS; c++) {
+            if (matrix_change & ((matrix_row_t)1<<c)) {
+                bool posted = post((keyevent_t){
+                    .key = (keypos_t){ .row = r, .col = c },
+                    .pressed = (matrix_row & ((matrix_row_t)1<<c)),
+                    .time = (timer_read() | 1) /* time should not be 0 */
+                });
+                if (!posted) {
+                    return;
+                }
+                matrix_prev[r] ^= ((matrix_row_t)1<<c);
+            }
+        }
     }
 }
 
+/** \brief Keyboard process: the action half of keyboard_task
+ *
+ * Runs one event posted by keyboard_scan, or TICK when there is none,
+ * followed by the same periodic jobs as keyboard_task.
+ */
+void keyboard_process(keyevent_t event)
+{
+    PROFILE_BEGIN(PROFILER_ACTION_EXEC);
+    action_exec(event);
+    PROFILE_END(PROFILER_ACTION_EXEC);
+    keyboard_periodic_tasks();
+}
+#endif
+
 /** \brief keyboard set leds
  *
  * FIXME: needs doc
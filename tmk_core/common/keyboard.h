@@ -63,6 +63,11 @@ void keyboard_setup(void);
 void keyboard_init(void);
 /* it runs repeatedly in main loop */
 void keyboard_task(void);
+#ifdef THREADED_RUNTIME_ENABLE
+/* keyboard_task split in two for the ChibiOS threaded runtime */
+void keyboard_scan(bool (*post)(keyevent_t event));
+void keyboard_process(keyevent_t event);
+#endif
 /* it runs when host LED status is updated */
 void keyboard_set_leds(uint8_t leds);
 
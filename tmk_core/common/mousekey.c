@@ -26,125 +26,275 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 static report_mouse_t mouse_report = {};
-static uint8_t mousekey_repeat =  0;
 static uint8_t mousekey_accel = 0;
 
 static void mousekey_debug(void);
 
 
+/* Directions currently held, one bit per key */
+#define MK_UP       (1<<0)
+#define MK_DOWN     (1<<1)
+#define MK_LEFT     (1<<2)
+#define MK_RIGHT    (1<<3)
+#define MK_WH_UP    (1<<4)
+#define MK_WH_DOWN  (1<<5)
+#define MK_WH_LEFT  (1<<6)
+#define MK_WH_RIGHT (1<<7)
+#define MK_MOVE     (MK_UP | MK_DOWN | MK_LEFT | MK_RIGHT)
+#define MK_WHEEL    (MK_WH_UP | MK_WH_DOWN | MK_WH_LEFT | MK_WH_RIGHT)
+
+static uint8_t mousekey_dirs = 0;
+
+/* when the cursor and the wheel started moving */
+static uint16_t move_start = 0;
+static uint16_t wheel_start = 0;
+static uint16_t last_report = 0;
+
+/* fraction of a count not yet reported, in 1/256 counts */
+static int16_t remainder_x = 0;
+static int16_t remainder_y = 0;
+static int16_t remainder_v = 0;
+static int16_t remainder_h = 0;
+
+
 /*
  * Mouse keys  acceleration algorithm
  *  http://en.wikipedia.org/wiki/Mouse_keys
  *
- *  speed = delta * max_speed * (repeat / time_to_max)**((1000+curve)/1000)
+ *  speed = delta + (delta * max_speed - delta) * curve(t / (time_to_max * interval))
+ *
+ * Speeds are 8.8 fixed point counts per interval, and the distance for each
+ * report is speed * elapsed ms / interval, so motion depends on time only and not
+ * on how often mousekey_task() runs. The fraction of a count that doesn't
+ * make it into a report is carried over to the next one.
  */
 /* milliseconds between the initial key press and first repeated motion event (0-2550) */
 uint8_t mk_delay = MOUSEKEY_DELAY/10;
-/* milliseconds between repeated motion events (0-255) */
+/* milliseconds per action_delta step, the time unit of the speeds below (1-255) */
 uint8_t mk_interval = MOUSEKEY_INTERVAL;
-/* steady speed (in action_delta units) applied each event (0-255) */
+/* steady speed (in action_delta units) applied each interval (0-255) */
 uint8_t mk_max_speed = MOUSEKEY_MAX_SPEED;
-/* number of events (count) accelerating to steady speed (0-255) */
+/* number of intervals accelerating to steady speed (0-255) */
 uint8_t mk_time_to_max = MOUSEKEY_TIME_TO_MAX;
-/* ramp used to reach maximum pointer speed (NOT SUPPORTED) */
-//int8_t mk_curve = 0;
+/* ramp used to reach maximum pointer speed, MOUSEKEY_CURVE_* */
+uint8_t mk_curve = MOUSEKEY_CURVE;
+/* milliseconds between motion reports (1-255) */
+uint8_t mk_report_interval = MOUSEKEY_REPORT_INTERVAL;
 /* wheel params */
 uint8_t mk_wheel_max_speed = MOUSEKEY_WHEEL_MAX_SPEED;
 uint8_t mk_wheel_time_to_max = MOUSEKEY_WHEEL_TIME_TO_MAX;
 
 
-static uint16_t last_timer = 0;
-
-inline int8_t times_inv_sqrt2(int8_t x)
+/* curve(progress), both in 1/256 */
+static uint16_t mousekey_curve(uint16_t progress)
 {
-    // 181/256 is pretty close to 1/sqrt(2)
-    // 0.70703125                 0.707106781
-    // 1 too small for x=99 and x=198
-    // This ends up being a mult and discard lower 8 bits
-    return (x * 181) >> 8;
+    switch (mk_curve) {
+        case MOUSEKEY_CURVE_CONSTANT:
+            return 256;
+        case MOUSEKEY_CURVE_QUADRATIC:
+            return (progress * progress) >> 8;
+        case MOUSEKEY_CURVE_KINETIC:
+            // smoothstep: eases in like a mass being pushed, and settles into max speed
+            return ((uint32_t)progress * progress * (3 * 256 - 2 * progress)) >> 16;
+        case MOUSEKEY_CURVE_LINEAR:
+        default:
+            return progress;
+    }
 }
 
-static uint8_t move_unit(void)
+/* speed after elapsed ms of motion, 8.8 fixed point counts per interval */
+static uint32_t mousekey_speed(uint16_t elapsed, uint8_t delta, uint8_t max_speed, uint8_t time_to_max)
 {
-    uint16_t unit;
+    uint32_t base = (uint32_t)delta << 8;
+    uint32_t max = (uint32_t)delta * max_speed << 8;
+
+    if (max < base) {
+        max = base;
+    }
+
     if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/4;
+        return max / 4;
     } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed)/2;
+        return max / 2;
     } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_MOVE_DELTA;
-    } else if (mousekey_repeat >= mk_time_to_max) {
-        unit = MOUSEKEY_MOVE_DELTA * mk_max_speed;
+        return max;
     } else {
-        unit = (MOUSEKEY_MOVE_DELTA * mk_max_speed * mousekey_repeat) / mk_time_to_max;
+        uint32_t ramp = (uint32_t)time_to_max * mk_interval;
+        uint16_t progress = (elapsed >= ramp) ? 256 : ((uint32_t)elapsed << 8) / ramp;
+        return base + (((max - base) * mousekey_curve(progress)) >> 8);
     }
-    return (unit > MOUSEKEY_MOVE_MAX ? MOUSEKEY_MOVE_MAX : (unit == 0 ? 1 : unit));
 }
 
-static uint8_t wheel_unit(void)
+/* distance covered in active ms, 8.8 fixed point counts */
+static uint32_t mousekey_distance(uint32_t speed, uint8_t active)
+{
+    uint8_t interval = mk_interval ? mk_interval : 1;
+    // split so speed * active can't overflow
+    return (speed / interval) * active + (speed % interval) * active / interval;
+}
+
+/* size of the single step sent right on key press, as the old engine did */
+static uint8_t mousekey_step(uint8_t delta, uint8_t max_speed, uint8_t max)
 {
     uint16_t unit;
     if (mousekey_accel & (1<<0)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/4;
+        unit = (delta * max_speed)/4;
     } else if (mousekey_accel & (1<<1)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed)/2;
+        unit = (delta * max_speed)/2;
     } else if (mousekey_accel & (1<<2)) {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed);
-    } else if (mousekey_repeat == 0) {
-        unit = MOUSEKEY_WHEEL_DELTA;
-    } else if (mousekey_repeat >= mk_wheel_time_to_max) {
-        unit = MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed;
+        unit = (delta * max_speed);
     } else {
-        unit = (MOUSEKEY_WHEEL_DELTA * mk_wheel_max_speed * mousekey_repeat) / mk_wheel_time_to_max;
+        unit = delta;
     }
-    return (unit > MOUSEKEY_WHEEL_MAX ? MOUSEKEY_WHEEL_MAX : (unit == 0 ? 1 : unit));
+    return (unit > max ? max : (unit == 0 ? 1 : unit));
 }
 
-void mousekey_task(void)
+/* Adds distance (8.8 fixed point counts) in direction dir to remainder and
+ * returns the whole counts to report. */
+static int8_t mousekey_counts(int16_t *remainder, int8_t dir, uint32_t distance, uint8_t max)
 {
-    if (timer_elapsed(last_timer) < (mousekey_repeat ? mk_interval : mk_delay*10))
-        return;
+    if (dir == 0) {
+        *remainder = 0;
+        return 0;
+    }
+    if (distance > (uint32_t)max << 8) {
+        distance = (uint32_t)max << 8;
+    }
 
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
-        return;
+    int32_t total = *remainder + (dir > 0 ? (int32_t)distance : -(int32_t)distance);
+    int32_t counts = total / 256;
+    if (counts > max) {
+        counts = max;
+    } else if (counts < -max) {
+        counts = -max;
+    }
 
-    if (mousekey_repeat != UINT8_MAX)
-        mousekey_repeat++;
+    // anything beyond a count is what got clamped away, don't replay it later
+    total -= counts * 256;
+    if (total > 255) {
+        total = 255;
+    } else if (total < -255) {
+        total = -255;
+    }
+    *remainder = total;
+    return counts;
+}
 
+static inline int8_t mousekey_dir(uint8_t positive, uint8_t negative)
+{
+    return !!(mousekey_dirs & positive) - !!(mousekey_dirs & negative);
+}
 
-    if (mouse_report.x > 0) mouse_report.x = move_unit();
-    if (mouse_report.x < 0) mouse_report.x = move_unit() * -1;
-    if (mouse_report.y > 0) mouse_report.y = move_unit();
-    if (mouse_report.y < 0) mouse_report.y = move_unit() * -1;
+/* ms of motion within the last dt ms, for motion that started at start.
+ * Capped at 255, if mousekey_task() stalls for longer the rest is dropped. */
+static uint8_t mousekey_active(uint16_t now, uint16_t start, uint16_t dt, uint16_t *elapsed)
+{
+    uint16_t since = TIMER_DIFF_16(now, start);
+    uint16_t delay = mk_delay * 10;
+    if (since <= delay) {
+        return 0;
+    }
+    *elapsed = since - delay;
+    if (dt > *elapsed) {
+        dt = *elapsed;
+    }
+    return dt > UINT8_MAX ? UINT8_MAX : dt;
+}
+
+static bool mousekey_move(uint16_t now, uint16_t dt)
+{
+    uint16_t elapsed;
+    uint8_t active = mousekey_active(now, move_start, dt, &elapsed);
+    if (!active) {
+        return false;
+    }
+
+    int8_t dir_x = mousekey_dir(MK_RIGHT, MK_LEFT);
+    int8_t dir_y = mousekey_dir(MK_DOWN, MK_UP);
+    uint32_t distance = mousekey_distance(mousekey_speed(elapsed, MOUSEKEY_MOVE_DELTA, mk_max_speed, mk_time_to_max), active);
 
     /* diagonal move [1/sqrt(2)] */
-    if (mouse_report.x && mouse_report.y) {
-        mouse_report.x = times_inv_sqrt2(mouse_report.x);
-        mouse_report.x = mouse_report.x == 0 ? 1 : mouse_report.x;
-        mouse_report.y = times_inv_sqrt2(mouse_report.y);
-        mouse_report.y = mouse_report.y == 0 ? 1 : mouse_report.y;
+    if (dir_x && dir_y) {
+        distance = (distance * 181) >> 8;
+    }
+
+    mouse_report.x = mousekey_counts(&remainder_x, dir_x, distance, MOUSEKEY_MOVE_MAX);
+    mouse_report.y = mousekey_counts(&remainder_y, dir_y, distance, MOUSEKEY_MOVE_MAX);
+    return mouse_report.x || mouse_report.y;
+}
+
+static bool mousekey_wheel(uint16_t now, uint16_t dt)
+{
+    uint16_t elapsed;
+    uint8_t active = mousekey_active(now, wheel_start, dt, &elapsed);
+    if (!active) {
+        return false;
     }
 
-    if (mouse_report.v > 0) mouse_report.v = wheel_unit();
-    if (mouse_report.v < 0) mouse_report.v = wheel_unit() * -1;
-    if (mouse_report.h > 0) mouse_report.h = wheel_unit();
-    if (mouse_report.h < 0) mouse_report.h = wheel_unit() * -1;
+    uint32_t distance = mousekey_distance(mousekey_speed(elapsed, MOUSEKEY_WHEEL_DELTA, mk_wheel_max_speed, mk_wheel_time_to_max), active);
 
-    mousekey_send();
+    mouse_report.v = mousekey_counts(&remainder_v, mousekey_dir(MK_WH_UP, MK_WH_DOWN), distance, MOUSEKEY_WHEEL_MAX);
+    mouse_report.h = mousekey_counts(&remainder_h, mousekey_dir(MK_WH_RIGHT, MK_WH_LEFT), distance, MOUSEKEY_WHEEL_MAX);
+    return mouse_report.v || mouse_report.h;
+}
+
+void mousekey_task(void)
+{
+    if (!mousekey_dirs)
+        return;
+
+    uint16_t now = timer_read();
+    uint16_t dt = TIMER_DIFF_16(now, last_report);
+    if (dt < mk_report_interval)
+        return;
+    last_report = now;
+
+    bool moved = false;
+    if (mousekey_dirs & MK_MOVE)
+        moved |= mousekey_move(now, dt);
+    if (mousekey_dirs & MK_WHEEL)
+        moved |= mousekey_wheel(now, dt);
+
+    if (moved)
+        mousekey_send();
+}
+
+static void mousekey_press(uint8_t dir)
+{
+    uint16_t now = timer_read();
+    uint8_t group = (dir & MK_MOVE) ? MK_MOVE : MK_WHEEL;
+
+    if (!(mousekey_dirs & (MK_MOVE | MK_WHEEL))) {
+        last_report = now;
+    }
+    if (!(mousekey_dirs & group)) {
+        if (group == MK_MOVE) {
+            move_start = now;
+        } else {
+            wheel_start = now;
+        }
+    }
+    // a new direction starts from a clean fraction
+    if (dir & (MK_LEFT | MK_RIGHT))         remainder_x = 0;
+    if (dir & (MK_UP | MK_DOWN))            remainder_y = 0;
+    if (dir & (MK_WH_UP | MK_WH_DOWN))      remainder_v = 0;
+    if (dir & (MK_WH_LEFT | MK_WH_RIGHT))   remainder_h = 0;
+    mousekey_dirs |= dir;
 }
 
 void mousekey_on(uint8_t code)
 {
-    if      (code == KC_MS_UP)       mouse_report.y = move_unit() * -1;
-    else if (code == KC_MS_DOWN)     mouse_report.y = move_unit();
-    else if (code == KC_MS_LEFT)     mouse_report.x = move_unit() * -1;
-    else if (code == KC_MS_RIGHT)    mouse_report.x = move_unit();
-    else if (code == KC_MS_WH_UP)    mouse_report.v = wheel_unit();
-    else if (code == KC_MS_WH_DOWN)  mouse_report.v = wheel_unit() * -1;
-    else if (code == KC_MS_WH_LEFT)  mouse_report.h = wheel_unit() * -1;
-    else if (code == KC_MS_WH_RIGHT) mouse_report.h = wheel_unit();
+    uint8_t move_step = mousekey_step(MOUSEKEY_MOVE_DELTA, mk_max_speed, MOUSEKEY_MOVE_MAX);
+    uint8_t wheel_step = mousekey_step(MOUSEKEY_WHEEL_DELTA, mk_wheel_max_speed, MOUSEKEY_WHEEL_MAX);
+
+    if      (code == KC_MS_UP)       { mousekey_press(MK_UP);       mouse_report.y = move_step * -1; }
+    else if (code == KC_MS_DOWN)     { mousekey_press(MK_DOWN);     mouse_report.y = move_step; }
+    else if (code == KC_MS_LEFT)     { mousekey_press(MK_LEFT);     mouse_report.x = move_step * -1; }
+    else if (code == KC_MS_RIGHT)    { mousekey_press(MK_RIGHT);    mouse_report.x = move_step; }
+    else if (code == KC_MS_WH_UP)    { mousekey_press(MK_WH_UP);    mouse_report.v = wheel_step; }
+    else if (code == KC_MS_WH_DOWN)  { mousekey_press(MK_WH_DOWN);  mouse_report.v = wheel_step * -1; }
+    else if (code == KC_MS_WH_LEFT)  { mousekey_press(MK_WH_LEFT);  mouse_report.h = wheel_step * -1; }
+    else if (code == KC_MS_WH_RIGHT) { mousekey_press(MK_WH_RIGHT); mouse_report.h = wheel_step; }
     else if (code == KC_MS_BTN1)     mouse_report.buttons |= MOUSE_BTN1;
     else if (code == KC_MS_BTN2)     mouse_report.buttons |= MOUSE_BTN2;
     else if (code == KC_MS_BTN3)     mouse_report.buttons |= MOUSE_BTN3;
@@ -157,14 +307,14 @@ void mousekey_on(uint8_t code)
 
 void mousekey_off(uint8_t code)
 {
-    if      (code == KC_MS_UP       && mouse_report.y < 0) mouse_report.y = 0;
-    else if (code == KC_MS_DOWN     && mouse_report.y > 0) mouse_report.y = 0;
-    else if (code == KC_MS_LEFT     && mouse_report.x < 0) mouse_report.x = 0;
-    else if (code == KC_MS_RIGHT    && mouse_report.x > 0) mouse_report.x = 0;
-    else if (code == KC_MS_WH_UP    && mouse_report.v > 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_DOWN  && mouse_report.v < 0) mouse_report.v = 0;
-    else if (code == KC_MS_WH_LEFT  && mouse_report.h < 0) mouse_report.h = 0;
-    else if (code == KC_MS_WH_RIGHT && mouse_report.h > 0) mouse_report.h = 0;
+    if      (code == KC_MS_UP)       mousekey_dirs &= ~MK_UP;
+    else if (code == KC_MS_DOWN)     mousekey_dirs &= ~MK_DOWN;
+    else if (code == KC_MS_LEFT)     mousekey_dirs &= ~MK_LEFT;
+    else if (code == KC_MS_RIGHT)    mousekey_dirs &= ~MK_RIGHT;
+    else if (code == KC_MS_WH_UP)    mousekey_dirs &= ~MK_WH_UP;
+    else if (code == KC_MS_WH_DOWN)  mousekey_dirs &= ~MK_WH_DOWN;
+    else if (code == KC_MS_WH_LEFT)  mousekey_dirs &= ~MK_WH_LEFT;
+    else if (code == KC_MS_WH_RIGHT) mousekey_dirs &= ~MK_WH_RIGHT;
     else if (code == KC_MS_BTN1) mouse_report.buttons &= ~MOUSE_BTN1;
     else if (code == KC_MS_BTN2) mouse_report.buttons &= ~MOUSE_BTN2;
     else if (code == KC_MS_BTN3) mouse_report.buttons &= ~MOUSE_BTN3;
@@ -173,34 +323,36 @@ void mousekey_off(uint8_t code)
     else if (code == KC_MS_ACCEL0) mousekey_accel &= ~(1<<0);
     else if (code == KC_MS_ACCEL1) mousekey_accel &= ~(1<<1);
     else if (code == KC_MS_ACCEL2) mousekey_accel &= ~(1<<2);
-
-    if (mouse_report.x == 0 && mouse_report.y == 0 && mouse_report.v == 0 && mouse_report.h == 0)
-        mousekey_repeat = 0;
 }
 
 void mousekey_send(void)
 {
     mousekey_debug();
     host_mouse_send(&mouse_report);
-    last_timer = timer_read();
+    // motion is relative, only buttons persist between reports
+    mouse_report.x = 0;
+    mouse_report.y = 0;
+    mouse_report.v = 0;
+    mouse_report.h = 0;
 }
 
 void mousekey_clear(void)
 {
     mouse_report = (report_mouse_t){};
-    mousekey_repeat = 0;
+    mousekey_dirs = 0;
     mousekey_accel = 0;
+    remainder_x = remainder_y = remainder_v = remainder_h = 0;
 }
 
 static void mousekey_debug(void)
 {
     if (!debug_mouse) return;
-    print("mousekey [btn|x y v h](rep/acl): [");
+    print("mousekey [btn|x y v h](dir/acl): [");
     phex(mouse_report.buttons); print("|");
     print_decs(mouse_report.x); print(" ");
     print_decs(mouse_report.y); print(" ");
     print_decs(mouse_report.v); print(" ");
     print_decs(mouse_report.h); print("](");
-    print_dec(mousekey_repeat); print("/");
+    phex(mousekey_dirs); print("/");
     print_dec(mousekey_accel); print(")\n");
 }
@@ -59,6 +59,20 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MOUSEKEY_WHEEL_TIME_TO_MAX
 #define MOUSEKEY_WHEEL_TIME_TO_MAX 40
 #endif
+/* milliseconds between motion reports, independent of MOUSEKEY_INTERVAL */
+#ifndef MOUSEKEY_REPORT_INTERVAL
+#define MOUSEKEY_REPORT_INTERVAL 8
+#endif
+
+/* how speed ramps from delta to max_speed over time_to_max */
+#define MOUSEKEY_CURVE_CONSTANT  0
+#define MOUSEKEY_CURVE_LINEAR    1
+#define MOUSEKEY_CURVE_QUADRATIC 2
+#define MOUSEKEY_CURVE_KINETIC   3
+#define MOUSEKEY_CURVE_COUNT     4
+#ifndef MOUSEKEY_CURVE
+#define MOUSEKEY_CURVE MOUSEKEY_CURVE_LINEAR
+#endif
 
 
 #ifdef __cplusplus
@@ -71,6 +85,8 @@ extern uint8_t mk_max_speed;
 extern uint8_t mk_time_to_max;
 extern uint8_t mk_wheel_max_speed;
 extern uint8_t mk_wheel_time_to_max;
+extern uint8_t mk_curve;
+extern uint8_t mk_report_interval;
 
 
 void mousekey_task(void);
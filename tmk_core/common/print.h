@@ -29,7 +29,7 @@
 #include <stdbool.h>
 #include "util.h"
 
-#if defined(PROTOCOL_CHIBIOS)
+#if !defined(__AVR__)
 #define PSTR(x) x
 #endif
 
@@ -0,0 +1,225 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "profiler.h"
+#include "print.h"
+#ifdef RAW_ENABLE
+#   include "raw_hid.h"
+#endif
+
+/* Each section is only recorded from one place, so with the threaded
+ * runtime every entry still has a single writer. A dump from another
+ * thread can see a run half recorded, which is fine for statistics.
+ */
+static profiler_stats_t sections[PROFILER_SECTION_COUNT];
+
+static inline uint32_t to_cycles(uint32_t ticks)
+{
+    return ticks * PROFILER_CYCLES_PER_TICK;
+}
+
+static uint8_t histogram_bucket(profiler_ticks_t ticks)
+{
+    uint8_t bucket = 0;
+    ticks >>= PROFILER_HISTOGRAM_SHIFT;
+    while (ticks && bucket < PROFILER_HISTOGRAM_BUCKETS - 1) {
+        ticks >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void profiler_init(void)
+{
+#if defined(PROTOCOL_CHIBIOS)
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+    profiler_reset();
+}
+
+void profiler_record(profiler_section_t section, profiler_ticks_t ticks)
+{
+    profiler_stats_t *stats = &sections[section];
+
+    if (stats->runs == 0 || ticks < stats->min) {
+        stats->min = ticks;
+    }
+    if (ticks > stats->max) {
+        stats->max = ticks;
+    }
+    // halve both instead of overflowing, that keeps the average
+    if (stats->total > UINT32_MAX - ticks) {
+        stats->total >>= 1;
+        stats->runs >>= 1;
+    }
+    stats->total += ticks;
+    stats->runs++;
+
+    uint16_t *count = &stats->histogram[histogram_bucket(ticks)];
+    if (*count == UINT16_MAX) {
+        // same for the histogram, which keeps its shape
+        for (uint8_t i = 0; i < PROFILER_HISTOGRAM_BUCKETS; i++) {
+            stats->histogram[i] >>= 1;
+        }
+    }
+    (*count)++;
+}
+
+void profiler_get_stats(profiler_section_t section, profiler_stats_t *stats)
+{
+    *stats = sections[section];
+}
+
+void profiler_reset(void)
+{
+    for (uint8_t i = 0; i < PROFILER_SECTION_COUNT; i++) {
+        sections[i] = (profiler_stats_t){ 0 };
+    }
+}
+
+static uint32_t average_cycles(const profiler_stats_t *stats)
+{
+    return stats->runs ? to_cycles(stats->total / stats->runs) : 0;
+}
+
+#if !defined(NO_PRINT) && !defined(USER_PRINT)
+static void print_section_name(profiler_section_t section)
+{
+    switch (section) {
+    case PROFILER_KEYBOARD_TASK:   print("keyboard_task"); break;
+    case PROFILER_MATRIX_SCAN:     print("matrix_scan"); break;
+    case PROFILER_ACTION_EXEC:     print("action_exec"); break;
+    case PROFILER_MOUSEKEY:        print("mousekey"); break;
+    case PROFILER_POINTING_DEVICE: print("pointing_device"); break;
+    case PROFILER_VISUALIZER:      print("visualizer"); break;
+    case PROFILER_MIDI:            print("midi"); break;
+    case PROFILER_QUANTUM:         print("quantum"); break;
+    case PROFILER_BACKLIGHT:       print("backlight"); break;
+    case PROFILER_RGB:             print("rgb"); break;
+    case PROFILER_USER:            print("user"); break;
+    default: break;
+    }
+}
+
+void profiler_print(void)
+{
+    print("\n\t- Profiler (cycles) -\n");
+    for (uint8_t i = 0; i < PROFILER_SECTION_COUNT; i++) {
+        const profiler_stats_t *stats = &sections[i];
+        if (stats->runs == 0) {
+            continue;
+        }
+        print_section_name(i);
+        xprintf(": runs %lu, min %lu, avg %lu, max %lu\n",
+                (unsigned long)stats->runs, (unsigned long)to_cycles(stats->min),
+                (unsigned long)average_cycles(stats), (unsigned long)to_cycles(stats->max));
+        for (uint8_t b = 0; b < PROFILER_HISTOGRAM_BUCKETS; b++) {
+            xprintf(" %u", stats->histogram[b]);
+        }
+        print("\n");
+    }
+}
+#else
+void profiler_print(void)
+{
+}
+#endif
+
+static uint8_t *put_be32(uint8_t *data, uint32_t value)
+{
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+    return data + 4;
+}
+
+bool profiler_process_raw_hid(uint8_t *data, uint8_t length)
+{
+    uint8_t *args = &data[1];
+
+    switch (data[0]) {
+    case PROFILER_GET_INFO:
+        if (length < 6) {
+            goto error;
+        }
+        args[0] = PROFILER_SECTION_COUNT;
+        args[1] = PROFILER_HISTOGRAM_BUCKETS;
+        args[2] = PROFILER_HISTOGRAM_SHIFT;
+        args[3] = PROFILER_CYCLES_PER_TICK >> 8;
+        args[4] = PROFILER_CYCLES_PER_TICK & 0xFF;
+        break;
+    case PROFILER_GET_SECTION: {
+        if (length < 18 || args[0] >= PROFILER_SECTION_COUNT) {
+            goto error;
+        }
+        const profiler_stats_t *stats = &sections[args[0]];
+        uint8_t *out = &args[1];
+        out = put_be32(out, stats->runs);
+        out = put_be32(out, to_cycles(stats->min));
+        out = put_be32(out, average_cycles(stats));
+        put_be32(out, to_cycles(stats->max));
+        break;
+    }
+    case PROFILER_GET_HISTOGRAM: {
+        if (length < 5 || args[0] >= PROFILER_SECTION_COUNT || args[1] >= PROFILER_HISTOGRAM_BUCKETS) {
+            goto error;
+        }
+        const profiler_stats_t *stats = &sections[args[0]];
+        uint8_t count = (length - 3) / 2;
+        if (count > PROFILER_HISTOGRAM_BUCKETS - args[1]) {
+            count = PROFILER_HISTOGRAM_BUCKETS - args[1];
+        }
+        for (uint8_t i = 0; i < count; i++) {
+            uint16_t value = stats->histogram[args[1] + i];
+            args[2 + i * 2] = value >> 8;
+            args[3 + i * 2] = value & 0xFF;
+        }
+        break;
+    }
+    case PROFILER_RESET:
+        profiler_reset();
+        break;
+    default:
+        return false;
+    }
+    return true;
+
+error:
+    data[0] = PROFILER_ERROR;
+    return true;
+}
+
+/* The dynamic keymap has its own raw_hid_receive(), which passes the
+ * profiler commands on.
+ */
+#if defined(RAW_ENABLE) && !defined(DYNAMIC_KEYMAP_ENABLE)
+__attribute__ ((weak))
+void raw_hid_receive_kb(uint8_t *data, uint8_t length)
+{
+}
+
+void raw_hid_receive(uint8_t *data, uint8_t length)
+{
+    if (profiler_process_raw_hid(data, length)) {
+        raw_hid_send(data, length);
+    } else {
+        raw_hid_receive_kb(data, length);
+    }
+}
+#endif
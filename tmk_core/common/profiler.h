@@ -0,0 +1,141 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Scan loop profiler (PROFILER_ENABLE = yes)
+ *
+ * PROFILE_BEGIN()/PROFILE_END() around a call record how long it took in
+ * a fixed table of sections: number of runs, min/avg/max and a histogram
+ * with power of two buckets. Sections nest, e.g. matrix_scan includes the
+ * quantum tasks called from matrix_scan_quantum(). Without PROFILER_ENABLE
+ * the macros expand to nothing.
+ *
+ * Durations are counted in ticks of the cheapest fine grained counter of
+ * the platform: the DWT cycle counter on ARM and the Timer0 based
+ * timer_read_raw() on AVR, which ticks every TIMER_PRESCALER cycles.
+ * Everything reported is converted to CPU cycles.
+ */
+
+typedef enum {
+    PROFILER_KEYBOARD_TASK,
+    PROFILER_MATRIX_SCAN,
+    PROFILER_ACTION_EXEC,
+    PROFILER_MOUSEKEY,
+    PROFILER_POINTING_DEVICE,
+    PROFILER_VISUALIZER,
+    PROFILER_MIDI,
+    PROFILER_QUANTUM,
+    PROFILER_BACKLIGHT,
+    PROFILER_RGB,
+    /* free for keyboard and user code */
+    PROFILER_USER,
+    PROFILER_SECTION_COUNT
+} profiler_section_t;
+
+#ifdef PROFILER_ENABLE
+
+#if defined(__AVR__)
+#   include "timer.h"
+typedef uint16_t profiler_ticks_t;
+#   define PROFILER_CYCLES_PER_TICK TIMER_PRESCALER
+#   define profiler_read_ticks() timer_read_raw()
+#elif defined(PROTOCOL_CHIBIOS)
+#   include "hal.h"
+#   ifndef DWT
+#       error "The profiler needs the DWT cycle counter of a Cortex-M3 or later"
+#   endif
+typedef uint32_t profiler_ticks_t;
+#   define PROFILER_CYCLES_PER_TICK 1
+#   define profiler_read_ticks() (DWT->CYCCNT)
+#else
+typedef uint32_t profiler_ticks_t;
+#   define PROFILER_CYCLES_PER_TICK 1
+/* provided by the platform, or by the tests */
+profiler_ticks_t profiler_read_ticks(void);
+#endif
+
+/* Bucket 0 counts runs shorter than 1 << PROFILER_HISTOGRAM_SHIFT ticks,
+ * bucket n > 0 the ones from 1 << (PROFILER_HISTOGRAM_SHIFT + n - 1) up,
+ * and the last bucket everything longer.
+ */
+#ifndef PROFILER_HISTOGRAM_BUCKETS
+#   if defined(__AVR__)
+#       define PROFILER_HISTOGRAM_BUCKETS 8
+#   else
+#       define PROFILER_HISTOGRAM_BUCKETS 16
+#   endif
+#endif
+
+#ifndef PROFILER_HISTOGRAM_SHIFT
+#   if defined(__AVR__)
+#       define PROFILER_HISTOGRAM_SHIFT 0
+#   else
+#       define PROFILER_HISTOGRAM_SHIFT 6
+#   endif
+#endif
+
+typedef struct {
+    uint32_t runs;
+    uint32_t total;
+    profiler_ticks_t min;
+    profiler_ticks_t max;
+    uint16_t histogram[PROFILER_HISTOGRAM_BUCKETS];
+} profiler_stats_t;
+
+/* Raw HID commands, the first byte of a packet. The reply is the same
+ * packet with the results filled in, or with the first byte replaced by
+ * PROFILER_ERROR. Multi-byte values are big endian and in cycles.
+ */
+enum profiler_command {
+    /* -> section count, bucket count, histogram shift, cycles per tick (2 bytes) */
+    PROFILER_GET_INFO = 0x10,
+    /* section -> runs, min, avg, max (4 bytes each) */
+    PROFILER_GET_SECTION,
+    /* section, first bucket -> as many bucket counts (2 bytes each) as fit */
+    PROFILER_GET_HISTOGRAM,
+    /* clears all sections */
+    PROFILER_RESET,
+    PROFILER_ERROR = 0xFF
+};
+
+#define PROFILE_BEGIN(section) \
+    profiler_ticks_t profile_start_##section = profiler_read_ticks()
+#define PROFILE_END(section) \
+    profiler_record(section, (profiler_ticks_t)(profiler_read_ticks() - profile_start_##section))
+
+void profiler_init(void);
+void profiler_record(profiler_section_t section, profiler_ticks_t ticks);
+void profiler_get_stats(profiler_section_t section, profiler_stats_t *stats);
+void profiler_reset(void);
+/* prints every section that ran */
+void profiler_print(void);
+
+/* Handles one raw HID packet in place, returns false when the command
+ * is not a profiler one. */
+bool profiler_process_raw_hid(uint8_t *data, uint8_t length);
+/* gets the packets profiler_process_raw_hid() does not handle */
+void raw_hid_receive_kb(uint8_t *data, uint8_t length);
+
+#else
+
+#define PROFILE_BEGIN(section)
+#define PROFILE_END(section)
+
+#endif
@@ -0,0 +1,109 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+/* Sequence lock for handing a snapshot of some data from one writer to any
+ * number of readers, without blocking the writer.
+ *
+ * The sequence is odd while a write is in progress. A reader copies the
+ * data and retries if the sequence was odd or has changed in the meantime,
+ * so it never ends up with a mix of an old and a new version. The readers
+ * should run at a lower priority than the writer (or on another core), as
+ * they spin while a write is in progress.
+ *
+ * Comparing the sequence with the one of the last read is also a cheap way
+ * to find out if there's anything new.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t sequence;
+} seqlock_t;
+
+#define SEQLOCK_INITIALIZER { 0 }
+
+/*
+ * Writer side
+ */
+static inline void seqlock_write_begin(seqlock_t *lock)
+{
+    __atomic_store_n(&lock->sequence, lock->sequence + 1, __ATOMIC_RELAXED);
+    // the data must not be written before the sequence is odd
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write_end(seqlock_t *lock)
+{
+    __atomic_store_n(&lock->sequence, lock->sequence + 1, __ATOMIC_RELEASE);
+}
+
+static inline void seqlock_write(seqlock_t *lock, void *dst, const void *src, size_t size)
+{
+    seqlock_write_begin(lock);
+    memcpy(dst, src, size);
+    seqlock_write_end(lock);
+}
+
+/*
+ * Reader side
+ */
+
+/* The sequence of the last completed write, which is even */
+static inline uint32_t seqlock_read_begin(seqlock_t *lock)
+{
+    uint32_t sequence;
+    while ((sequence = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE)) & 1);
+    return sequence;
+}
+
+/* True if the data read since seqlock_read_begin() can't be used */
+static inline bool seqlock_read_retry(seqlock_t *lock, uint32_t sequence)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED) != sequence;
+}
+
+/* Copies a consistent snapshot of src, returns its sequence */
+static inline uint32_t seqlock_read(seqlock_t *lock, void *dst, const void *src, size_t size)
+{
+    uint32_t sequence;
+    do {
+        sequence = seqlock_read_begin(lock);
+        memcpy(dst, src, size);
+    } while (seqlock_read_retry(lock, sequence));
+    return sequence;
+}
+
+/* Can be odd, use it to check for changes only */
+static inline uint32_t seqlock_sequence(seqlock_t *lock)
+{
+    return __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,207 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+/* Lock-free single-producer/single-consumer byte queue.
+ *
+ * head is only ever written by the producer and tail only by the consumer.
+ * Both are free running 8-bit counters which are masked down to the buffer
+ * size on access, so the queue can use every slot of the buffer and
+ * head - tail is always the number of queued bytes.  Byte sized loads and
+ * stores are atomic on every MCU we support, so as long as there is exactly
+ * one producer and one consumer (e.g. an ISR and the main loop) no interrupt
+ * masking is required.
+ *
+ * The buffer size must be a power of two between 2 and 128.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SPSC_QUEUE_SIZE_VALID(size) \
+    ((size) >= 2 && (size) <= 128 && (((size) & ((size) - 1)) == 0))
+
+/* acquire/release so the data copy is never reordered across the index update */
+#define SPSC_LOAD(index)         __atomic_load_n(&(index), __ATOMIC_ACQUIRE)
+#define SPSC_STORE(index, value) __atomic_store_n(&(index), (value), __ATOMIC_RELEASE)
+
+typedef struct {
+    uint8_t head;
+    uint8_t tail;
+    uint8_t mask;
+    uint8_t *data;
+} spsc_queue_t;
+
+/* Static initializer for a queue over a whole array, e.g.
+ *   static uint8_t buf[32];
+ *   static spsc_queue_t queue = SPSC_QUEUE_INITIALIZER(buf);
+ */
+#define SPSC_QUEUE_INITIALIZER(buffer) { 0, 0, sizeof(buffer) - 1, (buffer) }
+
+/* size must satisfy SPSC_QUEUE_SIZE_VALID */
+static inline void spsc_queue_init(spsc_queue_t *queue, uint8_t *data, uint8_t size)
+{
+    queue->head = 0;
+    queue->tail = 0;
+    queue->mask = size - 1;
+    queue->data = data;
+}
+
+static inline uint8_t spsc_queue_size(const spsc_queue_t *queue)
+{
+    return queue->mask + 1;
+}
+
+/* Number of bytes queued. Safe to call from either side. */
+static inline uint8_t spsc_queue_count(spsc_queue_t *queue)
+{
+    return (uint8_t)(SPSC_LOAD(queue->head) - SPSC_LOAD(queue->tail));
+}
+
+static inline uint8_t spsc_queue_space(spsc_queue_t *queue)
+{
+    return spsc_queue_size(queue) - spsc_queue_count(queue);
+}
+
+static inline bool spsc_queue_empty(spsc_queue_t *queue)
+{
+    return spsc_queue_count(queue) == 0;
+}
+
+/*
+ * Producer side
+ */
+static inline bool spsc_queue_push(spsc_queue_t *queue, uint8_t data)
+{
+    uint8_t head = queue->head;
+    if ((uint8_t)(head - SPSC_LOAD(queue->tail)) > queue->mask) {
+        return false;
+    }
+    queue->data[head & queue->mask] = data;
+    SPSC_STORE(queue->head, (uint8_t)(head + 1));
+    return true;
+}
+
+/* Contiguous free region at head. Fill it and then call spsc_queue_commit(). */
+static inline uint8_t spsc_queue_write_span(spsc_queue_t *queue, uint8_t **span)
+{
+    uint8_t head = queue->head;
+    uint8_t space = spsc_queue_size(queue) - (uint8_t)(head - SPSC_LOAD(queue->tail));
+    uint8_t index = head & queue->mask;
+    uint8_t linear = spsc_queue_size(queue) - index;
+    *span = &queue->data[index];
+    return space < linear ? space : linear;
+}
+
+static inline void spsc_queue_commit(spsc_queue_t *queue, uint8_t count)
+{
+    SPSC_STORE(queue->head, (uint8_t)(queue->head + count));
+}
+
+/* Copies as much of src as fits, returns the number of bytes queued. */
+static inline uint8_t spsc_queue_write(spsc_queue_t *queue, const uint8_t *src, uint8_t len)
+{
+    uint8_t written = 0;
+    uint8_t *span;
+    for (uint8_t pass = 0; pass < 2 && written < len; pass++) {
+        uint8_t count = spsc_queue_write_span(queue, &span);
+        if (count == 0) {
+            break;
+        }
+        if (count > len - written) {
+            count = len - written;
+        }
+        memcpy(span, src + written, count);
+        spsc_queue_commit(queue, count);
+        written += count;
+    }
+    return written;
+}
+
+/*
+ * Consumer side
+ */
+static inline bool spsc_queue_pop(spsc_queue_t *queue, uint8_t *data)
+{
+    uint8_t tail = queue->tail;
+    if (SPSC_LOAD(queue->head) == tail) {
+        return false;
+    }
+    *data = queue->data[tail & queue->mask];
+    SPSC_STORE(queue->tail, (uint8_t)(tail + 1));
+    return true;
+}
+
+/* Byte at offset from the front, offset must be less than spsc_queue_count(). */
+static inline uint8_t spsc_queue_peek(const spsc_queue_t *queue, uint8_t offset)
+{
+    return queue->data[(uint8_t)(queue->tail + offset) & queue->mask];
+}
+
+/* Contiguous queued region at tail. Use it and then call spsc_queue_consume(). */
+static inline uint8_t spsc_queue_read_span(spsc_queue_t *queue, const uint8_t **span)
+{
+    uint8_t tail = queue->tail;
+    uint8_t count = (uint8_t)(SPSC_LOAD(queue->head) - tail);
+    uint8_t index = tail & queue->mask;
+    uint8_t linear = spsc_queue_size(queue) - index;
+    *span = &queue->data[index];
+    return count < linear ? count : linear;
+}
+
+static inline void spsc_queue_consume(spsc_queue_t *queue, uint8_t count)
+{
+    SPSC_STORE(queue->tail, (uint8_t)(queue->tail + count));
+}
+
+/* Copies up to len bytes into dst, returns the number of bytes dequeued. */
+static inline uint8_t spsc_queue_read(spsc_queue_t *queue, uint8_t *dst, uint8_t len)
+{
+    uint8_t read = 0;
+    const uint8_t *span;
+    for (uint8_t pass = 0; pass < 2 && read < len; pass++) {
+        uint8_t count = spsc_queue_read_span(queue, &span);
+        if (count == 0) {
+            break;
+        }
+        if (count > len - read) {
+            count = len - read;
+        }
+        memcpy(dst + read, span, count);
+        spsc_queue_consume(queue, count);
+        read += count;
+    }
+    return read;
+}
+
+/* Drops everything queued. Consumer side only. */
+static inline void spsc_queue_clear(spsc_queue_t *queue)
+{
+    SPSC_STORE(queue->tail, SPSC_LOAD(queue->head));
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,101 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "eeprom.h"
+#include "eeconfig.h"
+#include "timer.h"
+    void set_time(uint32_t t);
+    void advance_time(uint32_t ms);
+}
+
+class EEConfig : public testing::Test {
+protected:
+    void SetUp() override {
+        // Start from a zeroed block, with the RAM copy in sync
+        for (uintptr_t i = 0; i < EECONFIG_SIZE; i++) {
+            eeconfig_update_byte((uint8_t *)i, 0);
+        }
+        eeconfig_flush();
+        set_time(0);
+        eeconfig_init();
+    }
+};
+
+TEST_F(EEConfig, InitWritesImmediately) {
+    EXPECT_EQ(eeprom_read_word(EECONFIG_MAGIC), EECONFIG_MAGIC_NUMBER);
+    EXPECT_TRUE(eeconfig_is_enabled());
+}
+
+TEST_F(EEConfig, UpdatesAreReadBackBeforeTheyAreWritten) {
+    eeconfig_update_keymap(0x34);
+    EXPECT_EQ(eeconfig_read_keymap(), 0x34);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_KEYMAP), 0);
+}
+
+TEST_F(EEConfig, WrittenOnlyAfterTheCommitDelay) {
+    eeconfig_update_dword(EECONFIG_RGBLIGHT, 0xA1B2C3D4);
+    advance_time(EECONFIG_COMMIT_DELAY - 1);
+    eeconfig_task();
+    EXPECT_EQ(eeprom_read_dword(EECONFIG_RGBLIGHT), 0u);
+    advance_time(1);
+    eeconfig_task();
+    EXPECT_EQ(eeprom_read_dword(EECONFIG_RGBLIGHT), 0xA1B2C3D4);
+}
+
+TEST_F(EEConfig, EveryChangeRestartsTheDelay) {
+    for (int i = 1; i <= 10; i++) {
+        eeconfig_update_debug(i);
+        advance_time(EECONFIG_COMMIT_DELAY / 2);
+        eeconfig_task();
+        EXPECT_EQ(eeprom_read_byte(EECONFIG_DEBUG), 0);
+    }
+    advance_time(EECONFIG_COMMIT_DELAY / 2);
+    eeconfig_task();
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_DEBUG), 10);
+}
+
+TEST_F(EEConfig, UnchangedValueIsNotDirty) {
+    eeconfig_update_debug(0);
+    advance_time(EECONFIG_COMMIT_DELAY);
+    // Would write if it were dirty
+    eeprom_write_byte(EECONFIG_DEBUG, 5);
+    eeconfig_task();
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_DEBUG), 5);
+}
+
+TEST_F(EEConfig, FlushWritesEverything) {
+    eeconfig_update_default_layer(3);
+    eeconfig_update_byte(EECONFIG_MOUSEKEY_ACCEL, 7);
+    eeconfig_flush();
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_DEFAULT_LAYER), 3);
+    EXPECT_EQ(eeprom_read_byte(EECONFIG_MOUSEKEY_ACCEL), 7);
+}
+
+TEST_F(EEConfig, OutsideTheBlockPassesThrough) {
+    uint8_t *addr = (uint8_t *)EECONFIG_SIZE;
+    eeconfig_update_byte(addr, 0x42);
+    EXPECT_EQ(eeprom_read_byte(addr), 0x42);
+    EXPECT_EQ(eeconfig_read_byte(addr), 0x42);
+}
+
+TEST_F(EEConfig, DisableIsWrittenImmediately) {
+    eeconfig_disable();
+    EXPECT_EQ(eeprom_read_word(EECONFIG_MAGIC), 0xFFFF);
+    EXPECT_FALSE(eeconfig_is_enabled());
+}
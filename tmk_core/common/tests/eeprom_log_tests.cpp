@@ -0,0 +1,207 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+#include <string.h>
+
+extern "C" {
+#include "eeprom_log.h"
+}
+
+static const uint16_t page_size = 64;
+static const uint16_t eeprom_size = 8;
+
+// Fake flash that only programs erased halfwords
+static uint16_t flash[2][page_size];
+static int erases;
+static int programs;
+// The number of flash operations left before the power is cut, -1 for no
+// limit. Nothing reaches the flash after that.
+static int power_left;
+
+static bool powered(void) {
+    if (power_left == 0) {
+        return false;
+    }
+    if (power_left > 0) {
+        power_left--;
+    }
+    return true;
+}
+
+extern "C" void eeprom_log_flash_erase(uint16_t *page) {
+    if (!powered()) {
+        return;
+    }
+    for (uint16_t i = 0; i < page_size; i++) {
+        page[i] = EEPROM_LOG_ERASED;
+    }
+    erases++;
+}
+
+extern "C" void eeprom_log_flash_program(uint16_t *addr, uint16_t value) {
+    if (!powered()) {
+        return;
+    }
+    EXPECT_EQ(value & ~*addr, 0) << "programming a 0 back to 1";
+    *addr &= value;
+    programs++;
+}
+
+class EEPROMLog : public testing::Test {
+protected:
+    void SetUp() override {
+        memset(flash, 0xFF, sizeof(flash));
+        erases = 0;
+        programs = 0;
+        power_left = -1;
+        boot();
+    }
+
+    void boot() {
+        log.page[0] = flash[0];
+        log.page[1] = flash[1];
+        log.page_size = page_size;
+        log.data = data;
+        log.size = eeprom_size;
+        eeprom_log_init(&log);
+    }
+
+    eeprom_log_t log;
+    uint8_t data[eeprom_size];
+};
+
+TEST_F(EEPROMLog, StartsEmptyOnErasedFlash) {
+    EXPECT_EQ(erases, 0);
+    EXPECT_EQ(flash[0][0], EEPROM_LOG_VALID);
+    for (uint16_t i = 0; i < eeprom_size; i++) {
+        EXPECT_EQ(data[i], 0xFF);
+    }
+}
+
+TEST_F(EEPROMLog, FormatsUnknownContents) {
+    for (uint16_t i = 0; i < page_size; i++) {
+        flash[0][i] = flash[1][i] = 0x1234;
+    }
+    erases = 0;
+    boot();
+    EXPECT_EQ(erases, 2);
+    for (uint16_t i = 0; i < eeprom_size; i++) {
+        EXPECT_EQ(data[i], 0xFF);
+    }
+}
+
+TEST_F(EEPROMLog, ReplaysWritesAfterReboot) {
+    eeprom_log_write(&log, 1, 0x12);
+    eeprom_log_write(&log, 7, 0x34);
+    eeprom_log_write(&log, 1, 0x56);
+    memset(data, 0, sizeof(data));
+    boot();
+    EXPECT_EQ(data[0], 0xFF);
+    EXPECT_EQ(data[1], 0x56);
+    EXPECT_EQ(data[7], 0x34);
+}
+
+TEST_F(EEPROMLog, UnchangedWritesDontTouchTheFlash) {
+    eeprom_log_write(&log, 2, 0x12);
+    int before = programs;
+    eeprom_log_write(&log, 2, 0x12);
+    eeprom_log_write(&log, 3, 0xFF);
+    EXPECT_EQ(programs, before);
+}
+
+TEST_F(EEPROMLog, OutOfRangeWritesAreIgnored) {
+    int before = programs;
+    eeprom_log_write(&log, eeprom_size, 0x12);
+    EXPECT_EQ(programs, before);
+}
+
+TEST_F(EEPROMLog, CompactsIntoTheOtherPage) {
+    // 31 records fit in a page
+    for (int i = 0; i < 100; i++) {
+        eeprom_log_write(&log, i % eeprom_size, i);
+    }
+    EXPECT_GT(erases, 2);
+    std::vector<uint8_t> expected(data, data + eeprom_size);
+    boot();
+    EXPECT_EQ(std::vector<uint8_t>(data, data + eeprom_size), expected);
+}
+
+TEST_F(EEPROMLog, WearIsSpreadOverBothPages) {
+    int erased[2] = {0, 0};
+    uint8_t active = log.active;
+    for (int i = 0; i < 1000; i++) {
+        eeprom_log_write(&log, 0, i & 1);
+        if (log.active != active) {
+            erased[active]++;
+            active = log.active;
+        }
+    }
+    EXPECT_GT(erased[0], 10);
+    EXPECT_NEAR(erased[0], erased[1], 1);
+}
+
+TEST_F(EEPROMLog, TornRecordIsSkipped) {
+    eeprom_log_write(&log, 0, 0x11);
+    // The value is programmed but not the offset
+    power_left = 1;
+    eeprom_log_write(&log, 0, 0x22);
+    power_left = -1;
+    boot();
+    EXPECT_EQ(data[0], 0x11);
+    eeprom_log_write(&log, 1, 0x33);
+    boot();
+    EXPECT_EQ(data[0], 0x11);
+    EXPECT_EQ(data[1], 0x33);
+}
+
+TEST_F(EEPROMLog, PowerLossAtAnyPointOfACompaction) {
+    for (uint16_t i = 0; i < eeprom_size; i++) {
+        eeprom_log_write(&log, i, i);
+    }
+    // Fill up the rest of the page
+    while (log.next + 2 <= page_size) {
+        eeprom_log_write(&log, 0, data[0] ^ 0x80);
+    }
+    uint8_t last = data[0];
+    uint16_t saved[2][page_size];
+    memcpy(saved, flash, sizeof(flash));
+
+    // Cut the power after every step of the compaction
+    for (int steps = 0;; steps++) {
+        memcpy(flash, saved, sizeof(flash));
+        boot();
+        power_left = steps;
+        eeprom_log_write(&log, 0, 0x42);
+        bool finished = power_left != 0;
+        power_left = -1;
+        boot();
+        for (uint16_t i = 1; i < eeprom_size; i++) {
+            EXPECT_EQ(data[i], i) << "after " << steps << " steps";
+        }
+        // The new value is only in the compacted page, so it's there once
+        // the compaction can be finished at boot
+        if (finished) {
+            EXPECT_EQ(data[0], 0x42);
+        } else {
+            EXPECT_TRUE(data[0] == last || data[0] == 0x42) << "after " << steps << " steps";
+        }
+        if (finished) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,174 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+
+extern "C" {
+#include "profiler.h"
+}
+
+static profiler_ticks_t now;
+
+extern "C" profiler_ticks_t profiler_read_ticks(void) {
+    return now;
+}
+
+class Profiler : public testing::Test {
+protected:
+    void SetUp() override {
+        now = 0;
+        profiler_init();
+    }
+
+    profiler_stats_t stats(profiler_section_t section) {
+        profiler_stats_t result;
+        profiler_get_stats(section, &result);
+        return result;
+    }
+
+    static uint32_t be32(const uint8_t* data) {
+        return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 | data[2] << 8 | data[3];
+    }
+};
+
+static void run_for(profiler_ticks_t ticks) {
+    PROFILE_BEGIN(PROFILER_USER);
+    now += ticks;
+    PROFILE_END(PROFILER_USER);
+}
+
+TEST_F(Profiler, MeasuresBetweenBeginAndEnd) {
+    now = 1000;
+    run_for(150);
+    profiler_stats_t user = stats(PROFILER_USER);
+    EXPECT_EQ(user.runs, 1u);
+    EXPECT_EQ(user.min, 150u);
+    EXPECT_EQ(user.max, 150u);
+    EXPECT_EQ(stats(PROFILER_MATRIX_SCAN).runs, 0u);
+}
+
+TEST_F(Profiler, CounterWrapsAround) {
+    now = UINT32_MAX - 10;
+    run_for(100);
+    EXPECT_EQ(stats(PROFILER_USER).max, 100u);
+}
+
+TEST_F(Profiler, KeepsMinAvgMax) {
+    profiler_record(PROFILER_MATRIX_SCAN, 300);
+    profiler_record(PROFILER_MATRIX_SCAN, 100);
+    profiler_record(PROFILER_MATRIX_SCAN, 200);
+    profiler_stats_t scan = stats(PROFILER_MATRIX_SCAN);
+    EXPECT_EQ(scan.runs, 3u);
+    EXPECT_EQ(scan.min, 100u);
+    EXPECT_EQ(scan.max, 300u);
+    EXPECT_EQ(scan.total / scan.runs, 200u);
+}
+
+TEST_F(Profiler, HistogramHasPowerOfTwoBuckets) {
+    const profiler_ticks_t base = 1 << PROFILER_HISTOGRAM_SHIFT;
+    profiler_record(PROFILER_MIDI, 0);
+    profiler_record(PROFILER_MIDI, base - 1);
+    profiler_record(PROFILER_MIDI, base);
+    profiler_record(PROFILER_MIDI, base * 2 - 1);
+    profiler_record(PROFILER_MIDI, base * 2);
+    profiler_record(PROFILER_MIDI, UINT32_MAX);
+    profiler_stats_t midi = stats(PROFILER_MIDI);
+    EXPECT_EQ(midi.histogram[0], 2);
+    EXPECT_EQ(midi.histogram[1], 2);
+    EXPECT_EQ(midi.histogram[2], 1);
+    EXPECT_EQ(midi.histogram[PROFILER_HISTOGRAM_BUCKETS - 1], 1);
+}
+
+TEST_F(Profiler, OverflowKeepsAverage) {
+    const profiler_ticks_t ticks = 1000000;
+    for (int i = 0; i < 10000; i++) {
+        profiler_record(PROFILER_KEYBOARD_TASK, ticks);
+    }
+    profiler_stats_t task = stats(PROFILER_KEYBOARD_TASK);
+    EXPECT_LT(task.runs, 10000u);
+    EXPECT_EQ(task.total / task.runs, ticks);
+}
+
+TEST_F(Profiler, FullHistogramBucketHalvesAll) {
+    profiler_record(PROFILER_RGB, 0);
+    profiler_record(PROFILER_RGB, 0);
+    profiler_record(PROFILER_RGB, UINT32_MAX);
+    for (int i = 0; i < UINT16_MAX - 1; i++) {
+        profiler_record(PROFILER_RGB, UINT32_MAX);
+    }
+    profiler_stats_t rgb = stats(PROFILER_RGB);
+    EXPECT_EQ(rgb.histogram[PROFILER_HISTOGRAM_BUCKETS - 1], UINT16_MAX);
+    profiler_record(PROFILER_RGB, UINT32_MAX);
+    rgb = stats(PROFILER_RGB);
+    EXPECT_EQ(rgb.histogram[PROFILER_HISTOGRAM_BUCKETS - 1], UINT16_MAX / 2 + 1);
+    EXPECT_EQ(rgb.histogram[0], 1);
+}
+
+TEST_F(Profiler, ResetClearsEverything) {
+    profiler_record(PROFILER_QUANTUM, 500);
+    profiler_reset();
+    profiler_stats_t quantum = stats(PROFILER_QUANTUM);
+    EXPECT_EQ(quantum.runs, 0u);
+    EXPECT_EQ(quantum.max, 0u);
+    EXPECT_EQ(quantum.histogram[PROFILER_HISTOGRAM_SHIFT > 8 ? 0 : 3], 0);
+}
+
+TEST_F(Profiler, RawHidGetSection) {
+    profiler_record(PROFILER_ACTION_EXEC, 10);
+    profiler_record(PROFILER_ACTION_EXEC, 30);
+    uint8_t data[32] = {PROFILER_GET_SECTION, PROFILER_ACTION_EXEC};
+    EXPECT_TRUE(profiler_process_raw_hid(data, sizeof(data)));
+    EXPECT_EQ(data[0], PROFILER_GET_SECTION);
+    EXPECT_EQ(be32(&data[2]), 2u);
+    EXPECT_EQ(be32(&data[6]), 10u * PROFILER_CYCLES_PER_TICK);
+    EXPECT_EQ(be32(&data[10]), 20u * PROFILER_CYCLES_PER_TICK);
+    EXPECT_EQ(be32(&data[14]), 30u * PROFILER_CYCLES_PER_TICK);
+}
+
+TEST_F(Profiler, RawHidGetHistogram) {
+    profiler_record(PROFILER_MOUSEKEY, 0);
+    profiler_record(PROFILER_MOUSEKEY, UINT32_MAX);
+    uint8_t data[32] = {PROFILER_GET_HISTOGRAM, PROFILER_MOUSEKEY, 0};
+    EXPECT_TRUE(profiler_process_raw_hid(data, sizeof(data)));
+    EXPECT_EQ(data[0], PROFILER_GET_HISTOGRAM);
+    EXPECT_EQ(data[3] << 8 | data[4], 1);
+
+    // the last bucket, as the packet can't hold all of them
+    uint8_t last[32] = {PROFILER_GET_HISTOGRAM, PROFILER_MOUSEKEY, PROFILER_HISTOGRAM_BUCKETS - 1};
+    EXPECT_TRUE(profiler_process_raw_hid(last, sizeof(last)));
+    EXPECT_EQ(last[3] << 8 | last[4], 1);
+}
+
+TEST_F(Profiler, RawHidRejectsBadRequests) {
+    uint8_t section[32] = {PROFILER_GET_SECTION, PROFILER_SECTION_COUNT};
+    EXPECT_TRUE(profiler_process_raw_hid(section, sizeof(section)));
+    EXPECT_EQ(section[0], PROFILER_ERROR);
+
+    uint8_t bucket[32] = {PROFILER_GET_HISTOGRAM, PROFILER_USER, PROFILER_HISTOGRAM_BUCKETS};
+    EXPECT_TRUE(profiler_process_raw_hid(bucket, sizeof(bucket)));
+    EXPECT_EQ(bucket[0], PROFILER_ERROR);
+
+    uint8_t other[32] = {0x01};
+    EXPECT_FALSE(profiler_process_raw_hid(other, sizeof(other)));
+    EXPECT_EQ(other[0], 0x01);
+}
+
+TEST_F(Profiler, RawHidReset) {
+    profiler_record(PROFILER_BACKLIGHT, 42);
+    uint8_t data[32] = {PROFILER_RESET};
+    EXPECT_TRUE(profiler_process_raw_hid(data, sizeof(data)));
+    EXPECT_EQ(stats(PROFILER_BACKLIGHT).runs, 0u);
+}
@@ -0,0 +1,33 @@
+COMMON_PATH := $(TMK_PATH)/common
+
+eeconfig_SRC :=\
+	$(COMMON_PATH)/tests/eeconfig_tests.cpp \
+	$(COMMON_PATH)/eeconfig.c \
+	$(COMMON_PATH)/test/eeprom.c \
+	$(COMMON_PATH)/test/timer.c
+
+eeconfig_INC :=\
+	$(COMMON_PATH) \
+	$(COMMON_PATH)/test
+
+eeprom_log_SRC :=\
+	$(COMMON_PATH)/tests/eeprom_log_tests.cpp \
+	$(COMMON_PATH)/chibios/eeprom_log.c
+
+eeprom_log_INC :=\
+	$(COMMON_PATH)/chibios
+
+seqlock_SRC :=\
+	$(COMMON_PATH)/tests/seqlock_tests.cpp
+
+seqlock_INC :=\
+	$(COMMON_PATH)
+
+profiler_SRC :=\
+	$(COMMON_PATH)/tests/profiler_tests.cpp \
+	$(COMMON_PATH)/profiler.c
+
+profiler_INC :=\
+	$(COMMON_PATH)
+
+profiler_DEFS := -DPROFILER_ENABLE -DNO_PRINT
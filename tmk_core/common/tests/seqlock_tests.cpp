@@ -0,0 +1,90 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <atomic>
+#include <thread>
+
+#include "seqlock.h"
+
+struct Data {
+    uint32_t values[16];
+};
+
+TEST(Seqlock, ReadReturnsTheWrittenData) {
+    seqlock_t lock = SEQLOCK_INITIALIZER;
+    Data shared = {};
+    Data written = {};
+    Data read;
+    written.values[3] = 42;
+    seqlock_write(&lock, &shared, &written, sizeof(Data));
+    uint32_t sequence = seqlock_read(&lock, &read, &shared, sizeof(Data));
+    EXPECT_EQ(read.values[3], 42u);
+    EXPECT_EQ(sequence, 2u);
+}
+
+TEST(Seqlock, SequenceTellsAboutChanges) {
+    seqlock_t lock = SEQLOCK_INITIALIZER;
+    uint32_t shared = 0;
+    uint32_t read;
+    uint32_t sequence = seqlock_read(&lock, &read, &shared, sizeof(read));
+    EXPECT_EQ(seqlock_sequence(&lock), sequence);
+    uint32_t value = 1;
+    seqlock_write(&lock, &shared, &value, sizeof(value));
+    EXPECT_NE(seqlock_sequence(&lock), sequence);
+}
+
+TEST(Seqlock, ReadDuringWriteIsRetried) {
+    seqlock_t lock = SEQLOCK_INITIALIZER;
+    uint32_t sequence = seqlock_read_begin(&lock);
+    seqlock_write_begin(&lock);
+    EXPECT_TRUE(seqlock_read_retry(&lock, sequence));
+    seqlock_write_end(&lock);
+    EXPECT_TRUE(seqlock_read_retry(&lock, sequence));
+    EXPECT_FALSE(seqlock_read_retry(&lock, seqlock_read_begin(&lock)));
+}
+
+TEST(Seqlock, ReaderNeverSeesTornData) {
+    seqlock_t lock = SEQLOCK_INITIALIZER;
+    Data shared = {};
+    std::atomic<bool> done(false);
+
+    std::thread writer([&]() {
+        Data data;
+        for (uint32_t i = 1; i <= 200000; i++) {
+            for (auto& value : data.values) {
+                value = i;
+            }
+            seqlock_write(&lock, &shared, &data, sizeof(Data));
+        }
+        done = true;
+    });
+
+    uint32_t reads = 0;
+    uint32_t last = 0;
+    while (!done) {
+        Data read;
+        seqlock_read(&lock, &read, &shared, sizeof(Data));
+        for (auto value : read.values) {
+            EXPECT_EQ(value, read.values[0]);
+        }
+        EXPECT_GE(read.values[0], last);
+        last = read.values[0];
+        reads++;
+    }
+    writer.join();
+    EXPECT_GT(reads, 0u);
+}
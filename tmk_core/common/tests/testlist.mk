@@ -0,0 +1 @@
+TEST_LIST += eeconfig eeprom_log seqlock profiler
@@ -50,5 +50,18 @@ ifdef ADB_MOUSE_ENABLE
 	 OPT_DEFS += -DADB_MOUSE_ENABLE -DMOUSE_ENABLE
 endif
 
+# Keyboards add these drivers to SRC themselves, pull in their decoders
+ifneq ($(filter %adb.c,$(SRC)),)
+    SRC += $(PROTOCOL_DIR)/adb_decoder.c
+endif
+
+ifneq ($(filter %m0110.c,$(SRC)),)
+    SRC += $(PROTOCOL_DIR)/m0110_decoder.c
+endif
+
+ifneq ($(filter %next_kbd.c,$(SRC)),)
+    SRC += $(PROTOCOL_DIR)/next_kbd_decoder.c
+endif
+
 # Search Path
 VPATH += $(TMK_DIR)/protocol
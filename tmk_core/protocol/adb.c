@@ -41,6 +41,19 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "adb.h"
+#ifdef ADB_INT_VECT
+#   include "adb_decoder.h"
+#   include "timer.h"
+#   include "avr/timer_avr.h"
+#endif
+
+
+#if !(defined(ADB_PORT) && \
+      defined(ADB_PIN)  && \
+      defined(ADB_DDR)  && \
+      defined(ADB_DATA_BIT))
+#   error "ADB port setting is required in config.h"
+#endif
 
 
 // GCC doesn't inline functions normally
@@ -70,6 +83,9 @@ void adb_host_init(void)
 #ifdef ADB_PSW_BIT
     psw_hi();
 #endif
+#ifdef ADB_INT_VECT
+    ADB_INT_INIT();
+#endif
 }
 
 #ifdef ADB_PSW_BIT
@@ -143,6 +159,110 @@ uint16_t adb_host_mouse_recv(void)
 }
 #endif
 
+#ifdef ADB_INT_VECT
+/*
+ * Interrupt driven receive
+ *
+ * The Talk command is still placed with the delays below, but the response
+ * is timed by the data line interrupt and decoded by adb_decoder, so the
+ * caller never waits for the device. Each call returns the result of the
+ * previous Talk to that device and starts the next one once the bus has
+ * been quiet for ADB_POLL_INTERVAL, taking turns with the other device.
+ */
+enum {
+    TALK_IDLE,
+    TALK_RESPONSE,  // command sent, ISR decoding
+    TALK_DONE,
+    TALK_ERROR,
+};
+
+static adb_decoder_t decoder;
+static volatile uint8_t talk_state = TALK_IDLE;
+static uint8_t talk_device;
+static uint16_t talk_time;
+static uint16_t last_edge;
+// results by device, ADDR_KEYB and ADDR_MOUSE
+static uint16_t talk_result[ADB_TALK_DEVICES];
+static adb_talk_turn_t talk_turn = { .pending = 0, .last = ADB_TALK_DEVICES - 1 };
+
+#define RESULT_SLOT(device) ((device) == ADDR_MOUSE)
+#define SLOT_ADDR(slot)     ((slot) ? ADDR_MOUSE : ADDR_KEYB)
+
+ISR(ADB_INT_VECT)
+{
+    uint16_t now = timer_read_raw();
+    uint16_t us = timer_raw_to_us(now - last_edge);
+    last_edge = now;
+
+    switch (adb_decoder_edge(&decoder, data_in(), us)) {
+        case ADB_DECODER_DONE:
+            ADB_INT_OFF();
+            talk_state = TALK_DONE;
+            break;
+        case ADB_DECODER_ERROR:
+            ADB_INT_OFF();
+            talk_state = TALK_ERROR;
+            break;
+    }
+}
+
+static void talk_start(uint8_t device)
+{
+    cli();
+    attention();
+    send_byte(device|0x0C);     // Addr:Keyboard(0010)/Mouse(0011), Cmd:Talk(11), Register0(00)
+    place_bit0();               // Stopbit(0)
+    adb_decoder_init(&decoder);
+    last_edge = timer_read_raw();
+    talk_device = device;
+    talk_time = timer_read();
+    talk_state = TALK_RESPONSE;
+    ADB_INT_ON();
+    sei();
+}
+
+/* collects the result of the running Talk */
+static void talk_task(void)
+{
+    switch (talk_state) {
+        case TALK_RESPONSE: {
+            // a device with nothing to send does not answer, a response
+            // takes less than 3ms once started
+            uint16_t elapsed = timer_elapsed(talk_time);
+            if (elapsed <= ADB_RESPONSE_TIMEOUT) {
+                return;
+            }
+            cli();
+            if (talk_state == TALK_RESPONSE &&
+                    (!decoder.started || elapsed > ADB_RESPONSE_TIMEOUT + 3)) {
+                ADB_INT_OFF();
+                talk_state = TALK_IDLE;
+            }
+            sei();
+            break;
+        }
+        case TALK_DONE:
+            talk_result[RESULT_SLOT(talk_device)] = decoder.data;
+            talk_state = TALK_IDLE;
+            break;
+        case TALK_ERROR:
+            talk_state = TALK_IDLE;
+            break;
+    }
+}
+
+static inline uint16_t adb_host_dev_recv(uint8_t device)
+{
+    talk_task();
+    uint16_t data = talk_result[RESULT_SLOT(device)];
+    talk_result[RESULT_SLOT(device)] = 0;
+    adb_talk_turn_request(&talk_turn, RESULT_SLOT(device));
+    if (talk_state == TALK_IDLE && timer_elapsed(talk_time) >= ADB_POLL_INTERVAL) {
+        talk_start(SLOT_ADDR(adb_talk_turn_next(&talk_turn)));
+    }
+    return data;
+}
+#else
 static inline uint16_t adb_host_dev_recv(uint8_t device)
 {
     uint16_t data = 0;
@@ -196,10 +316,21 @@ error:
     sei();
     return -n;
 }
+#endif
 
 void adb_host_listen(uint8_t cmd, uint8_t data_h, uint8_t data_l)
 {
+#ifdef ADB_INT_VECT
+    // the bus is ours, give up on a Talk still waiting for its response
+    talk_task();
     cli();
+    if (talk_state != TALK_IDLE) {
+        ADB_INT_OFF();
+        talk_state = TALK_IDLE;
+    }
+#else
+    cli();
+#endif
     attention();
     send_byte(cmd);
     place_bit0();               // Stopbit(0)
@@ -41,11 +41,18 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <stdint.h>
 #include <stdbool.h>
 
-#if !(defined(ADB_PORT) && \
-      defined(ADB_PIN)  && \
-      defined(ADB_DDR)  && \
-      defined(ADB_DATA_BIT))
-#   error "ADB port setting is required in config.h"
+/* Interrupt driven receive is used when config.h defines ADB_INT_INIT(),
+ * ADB_INT_ON(), ADB_INT_OFF() and ADB_INT_VECT for an interrupt on both
+ * edges of the data pin. */
+#ifdef ADB_INT_VECT
+/* ms between two Talk commands, see adb.c */
+#   ifndef ADB_POLL_INTERVAL
+#       define ADB_POLL_INTERVAL    12
+#   endif
+/* ms after which a Talk without response means no data */
+#   ifndef ADB_RESPONSE_TIMEOUT
+#       define ADB_RESPONSE_TIMEOUT 2
+#   endif
 #endif
 
 #define ADB_POWER       0x7F
@@ -0,0 +1,99 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adb_decoder.h"
+
+void adb_decoder_init(adb_decoder_t *decoder)
+{
+    decoder->data = 0;
+    decoder->low = 0;
+    decoder->cells = 0;
+    decoder->started = false;
+    decoder->level = true;
+}
+
+uint8_t adb_decoder_edge(adb_decoder_t *decoder, bool level, uint16_t us)
+{
+    if (level == decoder->level) {
+        // glitch shorter than the interrupt latency
+        return ADB_DECODER_BUSY;
+    }
+    decoder->level = level;
+
+    if (level) {
+        /* end of the low part of a cell */
+        if (!decoder->started) {
+            return ADB_DECODER_BUSY;
+        }
+        if (decoder->cells == 17) {
+            return us <= ADB_DECODER_STOP_MAX ? ADB_DECODER_DONE : ADB_DECODER_ERROR;
+        }
+        if (us > ADB_DECODER_CELL_MAX) {
+            return ADB_DECODER_ERROR;
+        }
+        decoder->low = us;
+        return ADB_DECODER_BUSY;
+    }
+
+    /* start of the next cell */
+    if (!decoder->started) {
+        // Tlt/Stop to Start, the line was idle
+        decoder->started = true;
+        return ADB_DECODER_BUSY;
+    }
+    uint16_t cell = decoder->low + us;
+    if (cell < ADB_DECODER_CELL_MIN || cell > ADB_DECODER_CELL_MAX) {
+        return ADB_DECODER_ERROR;
+    }
+    bool bit = decoder->low < us;
+    if (decoder->cells == 0) {
+        if (!bit) {
+            return ADB_DECODER_ERROR;
+        }
+    } else {
+        decoder->data = (decoder->data << 1) | bit;
+    }
+    decoder->cells++;
+    return ADB_DECODER_BUSY;
+}
+
+void adb_talk_turn_init(adb_talk_turn_t *turn)
+{
+    turn->pending = 0;
+    turn->last = ADB_TALK_DEVICES - 1;
+}
+
+void adb_talk_turn_request(adb_talk_turn_t *turn, uint8_t device)
+{
+    turn->pending |= 1 << device;
+}
+
+uint8_t adb_talk_turn_next(adb_talk_turn_t *turn)
+{
+    // start after the device served last
+    uint8_t device = turn->last;
+    for (uint8_t i = 0; i < ADB_TALK_DEVICES; i++) {
+        if (++device == ADB_TALK_DEVICES) {
+            device = 0;
+        }
+        if (turn->pending & (1 << device)) {
+            turn->pending &= ~(1 << device);
+            turn->last = device;
+            return device;
+        }
+    }
+    return ADB_TALK_NONE;
+}
@@ -0,0 +1,92 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADB_DECODER_H
+#define ADB_DECODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/*
+ * Decoder for the device side of an ADB Talk transaction.
+ *
+ * It is fed the durations between edges on the data line, as timed by a pin
+ * change or input capture interrupt, so the bits are recovered without
+ * polling the line. No hardware access, which also lets the host tests feed
+ * it recorded timings.
+ *
+ * A response is a start bit(1), 16 data bits MSB first and a stop bit(0).
+ * Every bit cell is low then high, a 1 has the shorter low part.
+ */
+
+/* bit cells are 70-130us, allow for interrupt latency */
+#ifndef ADB_DECODER_CELL_MIN
+#define ADB_DECODER_CELL_MIN    50
+#endif
+#ifndef ADB_DECODER_CELL_MAX
+#define ADB_DECODER_CELL_MAX    160
+#endif
+/* the stop bit may be lengthened by a service request */
+#ifndef ADB_DECODER_STOP_MAX
+#define ADB_DECODER_STOP_MAX    351
+#endif
+
+enum {
+    ADB_DECODER_BUSY,
+    ADB_DECODER_DONE,
+    ADB_DECODER_ERROR,
+};
+
+typedef struct {
+    uint16_t data;
+    uint16_t low;       // us the current cell was low
+    uint8_t  cells;     // bit cells completed, start bit included
+    bool     started;
+    bool     level;
+} adb_decoder_t;
+
+/* call before the response is expected, the line must be idle high */
+void adb_decoder_init(adb_decoder_t *decoder);
+
+/* level is the data line after the edge, us how long it was at the other
+ * level. Returns ADB_DECODER_DONE with the result in decoder->data. */
+uint8_t adb_decoder_edge(adb_decoder_t *decoder, bool level, uint16_t us);
+
+/*
+ * Picks the device that gets the next Talk.
+ *
+ * The keyboard and the mouse share the bus and only one Talk runs at a
+ * time. The keyboard is always polled first in a scan, so a device that
+ * asked for a Talk while the bus was busy goes next when the other one
+ * had the last turn.
+ */
+#define ADB_TALK_DEVICES    2
+#define ADB_TALK_NONE       0xFF
+
+typedef struct {
+    uint8_t pending;    // bit per device waiting for a Talk
+    uint8_t last;       // device that got the last Talk
+} adb_talk_turn_t;
+
+void adb_talk_turn_init(adb_talk_turn_t *turn);
+
+/* device, 0 to ADB_TALK_DEVICES - 1, wants to be polled */
+void adb_talk_turn_request(adb_talk_turn_t *turn, uint8_t device);
+
+/* call when the bus is free, returns the device to Talk to or ADB_TALK_NONE */
+uint8_t adb_talk_turn_next(adb_talk_turn_t *turn);
+
+#endif
@@ -7,6 +7,14 @@ SRC += $(CHIBIOS_DIR)/main.c
 SRC += usb_descriptor.c
 SRC += $(CHIBIOS_DIR)/usb_driver.c
 
+# Experimental and off by default, runtime.c has not been built against
+# ChibiOS on a board yet
+ifeq ($(strip $(THREADED_RUNTIME_ENABLE)), yes)
+  $(warning THREADED_RUNTIME_ENABLE is experimental and untested on hardware)
+  SRC += $(CHIBIOS_DIR)/runtime.c
+  OPT_DEFS += -DTHREADED_RUNTIME_ENABLE
+endif
+
 VPATH += $(TMK_PATH)/$(PROTOCOL_DIR)
 VPATH += $(TMK_PATH)/$(CHIBIOS_DIR)
 VPATH += $(TMK_PATH)/$(CHIBIOS_DIR)/lufa_utils
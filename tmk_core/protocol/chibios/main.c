@@ -46,6 +46,9 @@
 #endif
 #include "suspend.h"
 #include "wait.h"
+#ifdef THREADED_RUNTIME_ENABLE
+#include "runtime.h"
+#endif
 
 /* -------------------------
  *   TMK host driver defs
@@ -168,11 +171,18 @@ int main(void) {
 
   print("Keyboard start.\n");
 
+#ifdef THREADED_RUNTIME_ENABLE
+  runtime_start();
+#endif
+
   /* Main loop */
   while(true) {
 
     if(USB_DRIVER.state == USB_SUSPENDED) {
       print("[s]");
+#ifdef THREADED_RUNTIME_ENABLE
+      runtime_pause();
+#endif
 #ifdef VISUALIZER_ENABLE
       visualizer_suspend();
 #endif
@@ -196,10 +206,18 @@ int main(void) {
 
 #ifdef VISUALIZER_ENABLE
       visualizer_resume();
+#endif
+#ifdef THREADED_RUNTIME_ENABLE
+      runtime_resume();
 #endif
     }
 
+#ifdef THREADED_RUNTIME_ENABLE
+    /* the keyboard runs in its own threads, see runtime.c */
+    chThdSleepMilliseconds(1);
+#else
     keyboard_task();
+#endif
 #ifdef CONSOLE_ENABLE
     console_task();
 #endif
@@ -0,0 +1,262 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ch.h"
+#include "hal.h"
+
+#include "runtime.h"
+#include "keyboard.h"
+#include "matrix.h"
+#include "quantum.h"
+#include "timer.h"
+#include "print.h"
+
+#if MATRIX_COLS > 128
+#   error "The threaded runtime packs the column into 7 bits of an event"
+#endif
+
+/* Key events are packed into a single mailbox message:
+ * time in bits 0-15, column in 16-22, pressed in 23 and row in 24-31.
+ */
+static inline msg_t pack_event(keyevent_t event)
+{
+    return (msg_t)((uint32_t)event.time |
+                   ((uint32_t)(event.key.col & 0x7F) << 16) |
+                   ((uint32_t)event.pressed << 23) |
+                   ((uint32_t)event.key.row << 24));
+}
+
+static inline keyevent_t unpack_event(msg_t msg)
+{
+    uint32_t m = (uint32_t)msg;
+    return (keyevent_t){
+        .key = (keypos_t){ .row = m >> 24, .col = (m >> 16) & 0x7F },
+        .pressed = (m >> 23) & 1,
+        .time = m & 0xFFFF
+    };
+}
+
+static msg_t event_queue[RUNTIME_EVENT_QUEUE_SIZE];
+static mailbox_t event_mailbox;
+
+/* runtime_pause() asks one thread after the other to park, the thread
+ * signals parked and waits on its resume semaphore.
+ */
+static volatile bool pause_requested[RUNTIME_THREAD_COUNT];
+static semaphore_t parked;
+static semaphore_t resume[RUNTIME_THREAD_COUNT];
+
+static runtime_thread_stats_t thread_stats[RUNTIME_THREAD_COUNT];
+static uint32_t queue_stalls;
+
+/* ST2US overflows 32 bits after a few ms with a 100kHz system tick */
+static inline uint32_t ticks_to_us(systime_t ticks)
+{
+    return (uint64_t)ticks * 1000000 / CH_CFG_ST_FREQUENCY;
+}
+
+static void record_run(runtime_thread_t thread, systime_t start, systime_t deadline)
+{
+    uint32_t busy = ticks_to_us((systime_t)(chVTGetSystemTimeX() - start));
+    /* a run that started before its deadline wraps to a huge value */
+    systime_t late_ticks = (systime_t)(start - deadline);
+    uint32_t late = late_ticks < S2ST(1) ? ticks_to_us(late_ticks) : 0;
+
+    chSysLock();
+    runtime_thread_stats_t *stats = &thread_stats[thread];
+    stats->runs++;
+    stats->busy_us_total += busy;
+    if (busy > stats->busy_us_max) {
+        stats->busy_us_max = busy;
+    }
+    if (late > stats->late_us_max) {
+        stats->late_us_max = late;
+    }
+    chSysUnlock();
+}
+
+static void park(runtime_thread_t thread)
+{
+    chSemSignal(&parked);
+    chSemWait(&resume[thread]);
+}
+
+static bool post_event(keyevent_t event)
+{
+    if (chMBPost(&event_mailbox, pack_event(event), TIME_IMMEDIATE) != MSG_OK) {
+        chSysLock();
+        queue_stalls++;
+        chSysUnlock();
+        return false;
+    }
+    return true;
+}
+
+/* Fixed rate matrix scan, the highest priority so the debounce timing does
+ * not depend on how long the actions or animations take.
+ */
+static THD_WORKING_AREA(waScanThread, RUNTIME_SCAN_STACK_SIZE);
+static THD_FUNCTION(ScanThread, arg)
+{
+    (void)arg;
+    chRegSetThreadName("scan");
+    systime_t deadline = chVTGetSystemTime();
+    while (true) {
+        deadline = chThdSleepUntilWindowed(deadline, deadline + US2ST(RUNTIME_SCAN_INTERVAL_US));
+        if (pause_requested[RUNTIME_THREAD_SCAN]) {
+            park(RUNTIME_THREAD_SCAN);
+            deadline = chVTGetSystemTime();
+            continue;
+        }
+        systime_t start = chVTGetSystemTimeX();
+        keyboard_scan(post_event);
+        record_run(RUNTIME_THREAD_SCAN, start, deadline);
+    }
+}
+
+/* Processes the key events, and runs a TICK at least every millisecond so
+ * tap timeouts, mousekeys and matrix_scan_kb keep going without events.
+ */
+static void process_event(keyevent_t event)
+{
+    keyboard_process(event);
+    quantum_task();
+    matrix_scan_kb();
+}
+
+static THD_WORKING_AREA(waActionThread, RUNTIME_ACTION_STACK_SIZE);
+static THD_FUNCTION(ActionThread, arg)
+{
+    (void)arg;
+    chRegSetThreadName("action");
+    while (true) {
+        msg_t msg;
+        if (pause_requested[RUNTIME_THREAD_ACTION]) {
+            /* The scan thread is parked already. Its keys are recorded in
+             * matrix_prev, so the queued events have to run or they would
+             * stick. */
+            while (chMBFetch(&event_mailbox, &msg, TIME_IMMEDIATE) == MSG_OK) {
+                process_event(unpack_event(msg));
+            }
+            park(RUNTIME_THREAD_ACTION);
+            continue;
+        }
+
+        keyevent_t event = TICK;
+        systime_t start;
+        systime_t deadline;
+        if (chMBFetch(&event_mailbox, &msg, MS2ST(1)) == MSG_OK) {
+            event = unpack_event(msg);
+            start = chVTGetSystemTimeX();
+            /* lateness is the time the event waited in the queue */
+            deadline = start - MS2ST(TIMER_DIFF_16(timer_read() | 1, event.time));
+        } else {
+            start = chVTGetSystemTimeX();
+            deadline = start;
+        }
+        process_event(event);
+        record_run(RUNTIME_THREAD_ACTION, start, deadline);
+    }
+}
+
+static THD_WORKING_AREA(waLedThread, RUNTIME_LED_STACK_SIZE);
+static THD_FUNCTION(LedThread, arg)
+{
+    (void)arg;
+    chRegSetThreadName("led");
+    systime_t deadline = chVTGetSystemTime();
+    while (true) {
+        deadline = chThdSleepUntilWindowed(deadline, deadline + MS2ST(RUNTIME_LED_INTERVAL_MS));
+        if (pause_requested[RUNTIME_THREAD_LED]) {
+            park(RUNTIME_THREAD_LED);
+            deadline = chVTGetSystemTime();
+            continue;
+        }
+        systime_t start = chVTGetSystemTimeX();
+        quantum_led_task();
+        record_run(RUNTIME_THREAD_LED, start, deadline);
+    }
+}
+
+void runtime_start(void)
+{
+    chMBObjectInit(&event_mailbox, event_queue, RUNTIME_EVENT_QUEUE_SIZE);
+    chSemObjectInit(&parked, 0);
+    for (uint8_t i = 0; i < RUNTIME_THREAD_COUNT; i++) {
+        chSemObjectInit(&resume[i], 0);
+    }
+    chThdCreateStatic(waScanThread, sizeof(waScanThread), NORMALPRIO + 3, ScanThread, NULL);
+    chThdCreateStatic(waActionThread, sizeof(waActionThread), NORMALPRIO + 2, ActionThread, NULL);
+    chThdCreateStatic(waLedThread, sizeof(waLedThread), NORMALPRIO - 1, LedThread, NULL);
+}
+
+/* Returns once all threads are parked, so the caller has the matrix and
+ * the keyboard state to itself. The threads park in the order of
+ * runtime_thread_t: scan first, so the action thread can empty the
+ * mailbox for good before it parks.
+ */
+void runtime_pause(void)
+{
+    for (uint8_t i = 0; i < RUNTIME_THREAD_COUNT; i++) {
+        pause_requested[i] = true;
+        chSemWait(&parked);
+    }
+}
+
+void runtime_resume(void)
+{
+    for (uint8_t i = 0; i < RUNTIME_THREAD_COUNT; i++) {
+        pause_requested[i] = false;
+        chSemSignal(&resume[i]);
+    }
+}
+
+void runtime_get_stats(runtime_thread_t thread, runtime_thread_stats_t *stats)
+{
+    chSysLock();
+    *stats = thread_stats[thread];
+    chSysUnlock();
+}
+
+uint32_t runtime_get_queue_stalls(void)
+{
+    return queue_stalls;
+}
+
+void runtime_reset_stats(void)
+{
+    chSysLock();
+    for (uint8_t i = 0; i < RUNTIME_THREAD_COUNT; i++) {
+        thread_stats[i] = (runtime_thread_stats_t){ 0 };
+    }
+    queue_stalls = 0;
+    chSysUnlock();
+}
+
+void runtime_print_stats(void)
+{
+#if !defined(NO_PRINT) && !defined(USER_PRINT)
+    static const char *const names[RUNTIME_THREAD_COUNT] = { "scan", "action", "led" };
+    for (uint8_t i = 0; i < RUNTIME_THREAD_COUNT; i++) {
+        runtime_thread_stats_t stats;
+        runtime_get_stats(i, &stats);
+        xprintf("%s: runs %lu, avg %luus, max %luus, late %luus\n", names[i],
+                stats.runs, stats.runs ? stats.busy_us_total / stats.runs : 0,
+                stats.busy_us_max, stats.late_us_max);
+    }
+    xprintf("queue stalls: %lu\n", runtime_get_queue_stalls());
+#endif
+}
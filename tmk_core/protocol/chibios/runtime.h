@@ -0,0 +1,99 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Threaded runtime for ChibiOS keyboards (THREADED_RUNTIME_ENABLE = yes)
+ *
+ * keyboard_task is split over three threads:
+ *
+ * * scan:   scans the matrix at a fixed rate and posts key events to a mailbox
+ * * action: runs the events through action_exec, followed by the periodic
+ *           keyboard jobs, quantum_task and matrix_scan_kb
+ * * led:    backlight and RGB matrix animations, below everything else
+ *
+ * The main thread keeps USB suspend handling and the console/raw HID tasks.
+ */
+
+/* Scan period in microseconds */
+#ifndef RUNTIME_SCAN_INTERVAL_US
+#   define RUNTIME_SCAN_INTERVAL_US 1000
+#endif
+
+/* Key events buffered between the scan and the action thread */
+#ifndef RUNTIME_EVENT_QUEUE_SIZE
+#   define RUNTIME_EVENT_QUEUE_SIZE 32
+#endif
+
+/* Period of the led thread in milliseconds */
+#ifndef RUNTIME_LED_INTERVAL_MS
+#   define RUNTIME_LED_INTERVAL_MS 10
+#endif
+
+/* Thread stacks in bytes, on top of the thread context and the
+ * PORT_INT_REQUIRED_STACK reserve ChibiOS adds to every working area.
+ *
+ * The scan thread runs the keyboard's matrix_scan() and, with debug_matrix
+ * on, matrix_print(): print_matrix_row -> xprintf -> tfp_format (about 80
+ * bytes with its digit buffer) -> sendchar -> the console output queue and
+ * a context switch, roughly 350 bytes. The action thread runs the whole
+ * action/process_record chain, including send_string and the console. The
+ * led thread runs the RGB matrix effects, which keep a hue and a value per
+ * LED on the stack (2 * DRIVER_LED_TOTAL bytes). Enable CH_DBG_FILL_THREADS
+ * to see how much a keyboard really uses.
+ */
+#ifndef RUNTIME_SCAN_STACK_SIZE
+#   define RUNTIME_SCAN_STACK_SIZE 512
+#endif
+
+#ifndef RUNTIME_ACTION_STACK_SIZE
+#   define RUNTIME_ACTION_STACK_SIZE 1024
+#endif
+
+#ifndef RUNTIME_LED_STACK_SIZE
+#   define RUNTIME_LED_STACK_SIZE 768
+#endif
+
+typedef enum {
+    RUNTIME_THREAD_SCAN,
+    RUNTIME_THREAD_ACTION,
+    RUNTIME_THREAD_LED,
+    RUNTIME_THREAD_COUNT
+} runtime_thread_t;
+
+typedef struct {
+    uint32_t runs;
+    uint32_t busy_us_total;
+    uint32_t busy_us_max;
+    /* how far past its deadline a run started */
+    uint32_t late_us_max;
+} runtime_thread_stats_t;
+
+/* starts the threads, call once after keyboard_init */
+void runtime_start(void);
+
+/* park the threads while the host is suspended, returns once they are */
+void runtime_pause(void);
+void runtime_resume(void);
+
+void runtime_get_stats(runtime_thread_t thread, runtime_thread_stats_t *stats);
+/* scans that could not post a key because the mailbox was full */
+uint32_t runtime_get_queue_stalls(void);
+void runtime_reset_stats(void);
+void runtime_print_stats(void);
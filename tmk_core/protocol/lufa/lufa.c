@@ -78,6 +78,10 @@
     #include "virtser.h"
 #endif
 
+#if defined(CONSOLE_ENABLE) || defined(VIRTSER_ENABLE)
+    #include "spsc_queue.h"
+#endif
+
 #if (defined(RGB_MIDI) | defined(RGBLIGHT_ANIMATIONS)) & defined(RGBLIGHT_ENABLE)
     #include "rgblight.h"
 #endif
@@ -230,9 +234,20 @@ static void raw_hid_task(void)
  * Console
  ******************************************************************************/
 #ifdef CONSOLE_ENABLE
+#ifndef CONSOLE_QUEUE_SIZE
+    #define CONSOLE_QUEUE_SIZE 64
+#endif
+#if !SPSC_QUEUE_SIZE_VALID(CONSOLE_QUEUE_SIZE)
+    #error "CONSOLE_QUEUE_SIZE must be a power of two <= 128"
+#endif
+
+static uint8_t console_queue_data[CONSOLE_QUEUE_SIZE];
+static spsc_queue_t console_queue = SPSC_QUEUE_INITIALIZER(console_queue_data);
+
 /** \brief Console Task
  *
- * FIXME: Needs doc
+ * Moves whatever sendchar() queued into console reports, one full endpoint bank
+ * at a time, for as long as the host has a free bank. Never waits on the host.
  */
 static void Console_Task(void)
 {
@@ -240,6 +255,9 @@ static void Console_Task(void)
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return;
 
+    if (spsc_queue_empty(&console_queue))
+        return;
+
     uint8_t ep = Endpoint_GetCurrentEndpoint();
 
 #if 0
@@ -274,12 +292,22 @@ static void Console_Task(void)
         return;
     }
 
-    // fill empty bank
-    while (Endpoint_IsReadWriteAllowed())
-        Endpoint_Write_8(0);
+    while (!spsc_queue_empty(&console_queue) && Endpoint_IsReadWriteAllowed()) {
+        uint8_t left = CONSOLE_EPSIZE;
+        const uint8_t *span;
+        uint8_t len;
+        while (left && (len = spsc_queue_read_span(&console_queue, &span))) {
+            if (len > left)
+                len = left;
+            Endpoint_Write_Stream_LE(span, len, NULL);
+            spsc_queue_consume(&console_queue, len);
+            left -= len;
+        }
+
+        // fill rest of the bank
+        while (left--)
+            Endpoint_Write_8(0);
 
-    // flash senchar packet
-    if (Endpoint_IsINReady()) {
         Endpoint_ClearIN();
     }
 
@@ -370,31 +398,6 @@ void EVENT_USB_Device_WakeUp()
 
 
 
-#ifdef CONSOLE_ENABLE
-static bool console_flush = false;
-#define CONSOLE_FLUSH_SET(b)   do { \
-  ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {\
-    console_flush = b; \
-  } \
-} while (0)
-
-/** \brief Event USB Device Start Of Frame
- *
- * FIXME: Needs doc
- * called every 1ms
- */
-void EVENT_USB_Device_StartOfFrame(void)
-{
-    static uint8_t count;
-    if (++count % 50) return;
-    count = 0;
-
-    if (!console_flush) return;
-    Console_Task();
-    console_flush = false;
-}
-
-#endif
 
 /** \brief Event handler for the USB_ConfigurationChanged event.
  *
@@ -803,7 +806,8 @@ static void send_consumer(uint16_t data)
 #define SEND_TIMEOUT 5
 /** \brief Send Char
  *
- * FIXME: Needs doc
+ * Queues the character for Console_Task(). Only waits for the host when the
+ * queue is full, and then for at most SEND_TIMEOUT ms.
  */
 int8_t sendchar(uint8_t c)
 {
@@ -811,55 +815,28 @@ int8_t sendchar(uint8_t c)
     // Because sendchar() is called so many times, waiting each call causes big lag.
     static bool timeouted = false;
 
-    // prevents Console_Task() from running during sendchar() runs.
-    // or char will be lost. These two function is mutually exclusive.
-    CONSOLE_FLUSH_SET(false);
-
     if (USB_DeviceState != DEVICE_STATE_Configured)
         return -1;
 
-    uint8_t ep = Endpoint_GetCurrentEndpoint();
-    Endpoint_SelectEndpoint(CONSOLE_IN_EPNUM);
-    if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
-        goto ERROR_EXIT;
-    }
-
-    if (timeouted && !Endpoint_IsReadWriteAllowed()) {
-        goto ERROR_EXIT;
-    }
-
-    timeouted = false;
+    if (spsc_queue_push(&console_queue, c))
+        return 0;
 
-    uint8_t timeout = SEND_TIMEOUT;
-    while (!Endpoint_IsReadWriteAllowed()) {
-        if (USB_DeviceState != DEVICE_STATE_Configured) {
-            goto ERROR_EXIT;
+    uint8_t timeout = timeouted ? 0 : SEND_TIMEOUT;
+    while (true) {
+        Console_Task();
+        if (spsc_queue_push(&console_queue, c)) {
+            timeouted = false;
+            return 0;
         }
-        if (Endpoint_IsStalled()) {
-            goto ERROR_EXIT;
+        if (USB_DeviceState != DEVICE_STATE_Configured) {
+            return -1;
         }
         if (!(timeout--)) {
             timeouted = true;
-            goto ERROR_EXIT;
+            return -1;
         }
         _delay_ms(1);
     }
-
-    Endpoint_Write_8(c);
-
-    // send when bank is full
-    if (!Endpoint_IsReadWriteAllowed()) {
-        while (!(Endpoint_IsINReady()));
-        Endpoint_ClearIN();
-    } else {
-        CONSOLE_FLUSH_SET(true);
-    }
-
-    Endpoint_SelectEndpoint(ep);
-    return 0;
-ERROR_EXIT:
-    Endpoint_SelectEndpoint(ep);
-    return -1;
 }
 #else
 int8_t sendchar(uint8_t c)
@@ -908,6 +885,21 @@ bool recv_midi_packet(MIDI_EventPacket_t* const event) {
  ******************************************************************************/
 
 #ifdef VIRTSER_ENABLE
+#ifndef VIRTSER_QUEUE_SIZE
+    #define VIRTSER_QUEUE_SIZE 32
+#endif
+#if !SPSC_QUEUE_SIZE_VALID(VIRTSER_QUEUE_SIZE)
+    #error "VIRTSER_QUEUE_SIZE must be a power of two <= 128"
+#endif
+
+static uint8_t virtser_rx_data[VIRTSER_QUEUE_SIZE];
+static uint8_t virtser_tx_data[VIRTSER_QUEUE_SIZE];
+static spsc_queue_t virtser_rx_queue = SPSC_QUEUE_INITIALIZER(virtser_rx_data);
+static spsc_queue_t virtser_tx_queue = SPSC_QUEUE_INITIALIZER(virtser_tx_data);
+// The last packet sent was a full one, so the host waits for more until a
+// short packet ends the transfer
+static bool virtser_zlp_pending = false;
+
 /** \brief Virtual Serial Init
  *
  * FIXME: Needs doc
@@ -928,49 +920,98 @@ void virtser_recv(uint8_t c)
   // Ignore by default
 }
 
+/** \brief Virtual Serial Flush
+ *
+ * Sends queued output in packets of up to CDC_EPSIZE bytes while the IN
+ * endpoint has a free bank. When the output ends with a full packet, a zero
+ * length packet follows it.
+ */
+static void virtser_flush(void)
+{
+  if (spsc_queue_empty(&virtser_tx_queue) && !virtser_zlp_pending)
+    return;
+
+  if (!(cdc_device.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR)) {
+    // nobody is listening
+    spsc_queue_clear(&virtser_tx_queue);
+    virtser_zlp_pending = false;
+    return;
+  }
+
+  uint8_t ep = Endpoint_GetCurrentEndpoint();
+  Endpoint_SelectEndpoint(cdc_device.Config.DataINEndpoint.Address);
+
+  if (Endpoint_IsEnabled() && Endpoint_IsConfigured()) {
+    while (!spsc_queue_empty(&virtser_tx_queue) && Endpoint_IsReadWriteAllowed()) {
+      uint8_t left = CDC_EPSIZE;
+      const uint8_t *span;
+      uint8_t len;
+      while (left && (len = spsc_queue_read_span(&virtser_tx_queue, &span))) {
+        if (len > left)
+          len = left;
+        Endpoint_Write_Stream_LE(span, len, NULL);
+        spsc_queue_consume(&virtser_tx_queue, len);
+        left -= len;
+      }
+      Endpoint_ClearIN();
+      virtser_zlp_pending = !left;
+    }
+    if (virtser_zlp_pending && spsc_queue_empty(&virtser_tx_queue) && Endpoint_IsReadWriteAllowed()) {
+      Endpoint_ClearIN();
+      virtser_zlp_pending = false;
+    }
+  }
+
+  Endpoint_SelectEndpoint(ep);
+}
+
 /** \brief Virtual Serial Task
  *
- * FIXME: Needs doc
+ * Copies the received packet into the receive queue in one go, hands the bytes
+ * to virtser_recv() and flushes pending output.
  */
 void virtser_task(void)
 {
   uint16_t count = CDC_Device_BytesReceived(&cdc_device);
-  uint8_t ch;
   if (count)
   {
-    ch = CDC_Device_ReceiveByte(&cdc_device);
-    virtser_recv(ch);
+    // CDC_Device_BytesReceived() left the OUT endpoint selected
+    uint8_t *span;
+    uint8_t len;
+    while (count && (len = spsc_queue_write_span(&virtser_rx_queue, &span))) {
+      if (len > count)
+        len = count;
+      Endpoint_Read_Stream_LE(span, len, NULL);
+      spsc_queue_commit(&virtser_rx_queue, len);
+      count -= len;
+    }
+    if (!Endpoint_BytesInEndpoint())
+      Endpoint_ClearOUT();
   }
+
+  uint8_t ch;
+  while (spsc_queue_pop(&virtser_rx_queue, &ch))
+    virtser_recv(ch);
+
+  virtser_flush();
 }
 /** \brief Virtual Serial Send
  *
- * FIXME: Needs doc
+ * Queues the byte, it goes out with the next virtser_task(). Only touches the
+ * endpoint directly when the queue is full.
  */
 void virtser_send(const uint8_t byte)
 {
-  uint8_t timeout = 255;
-  uint8_t ep = Endpoint_GetCurrentEndpoint();
-
-  if (cdc_device.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR)
-  {
-    /* IN packet */
-    Endpoint_SelectEndpoint(cdc_device.Config.DataINEndpoint.Address);
-
-    if (!Endpoint_IsEnabled() || !Endpoint_IsConfigured()) {
-        Endpoint_SelectEndpoint(ep);
-        return;
-    }
-
-    while (timeout-- && !Endpoint_IsReadWriteAllowed()) _delay_us(40);
-
-    Endpoint_Write_8(byte);
-    CDC_Device_Flush(&cdc_device);
-
-    if (Endpoint_IsINReady()) {
-      Endpoint_ClearIN();
-    }
+  if (!(cdc_device.State.ControlLineStates.HostToDevice & CDC_CONTROL_LINE_OUT_DTR))
+    return;
 
-    Endpoint_SelectEndpoint(ep);
+  uint8_t timeout = 255;
+  while (!spsc_queue_push(&virtser_tx_queue, byte)) {
+    if (!(timeout--))
+      return;
+    virtser_flush();
+    if (spsc_queue_space(&virtser_tx_queue) == 0)
+      _delay_us(40);
   }
 }
 #endif
@@ -1006,8 +1047,6 @@ static void setup_usb(void)
 
     USB_Init();
 
-    // for Console_Task
-    USB_Device_EnableSOFEvents();
     print_set_sendchar(sendchar);
 }
 
@@ -1075,7 +1114,9 @@ int main(void)
 #endif
 
 #if defined(RGBLIGHT_ANIMATIONS) & defined(RGBLIGHT_ENABLE)
+        PROFILE_BEGIN(PROFILER_RGB);
         rgblight_task();
+        PROFILE_END(PROFILER_RGB);
 #endif
 
 #ifdef MODULE_ADAFRUIT_BLE
@@ -1091,6 +1132,10 @@ int main(void)
         raw_hid_task();
 #endif
 
+#ifdef CONSOLE_ENABLE
+        Console_Task();
+#endif
+
 #if !defined(INTERRUPT_CONTROL_ENDPOINT)
         USB_USBTask();
 #endif
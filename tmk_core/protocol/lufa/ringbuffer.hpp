@@ -1,63 +1,52 @@
 #pragma once
-// A simple ringbuffer holding Size elements of type T
+#include "spsc_queue.h"
+// A lock-free single-producer/single-consumer ringbuffer holding Size
+// elements of type T. Uses the same free running index scheme as
+// spsc_queue_t, so Size must be a power of two no larger than 128.
 template <typename T, uint8_t Size>
 class RingBuffer {
+  static_assert(SPSC_QUEUE_SIZE_VALID(Size),
+                "RingBuffer size must be a power of two between 2 and 128");
  protected:
+  static constexpr uint8_t Mask = Size - 1;
   T buf_[Size];
   uint8_t head_{0}, tail_{0};
  public:
-  inline uint8_t nextPosition(uint8_t position) {
-    return (position + 1) % Size;
-  }
-
-  inline uint8_t prevPosition(uint8_t position) {
-    if (position == 0) {
-      return Size - 1;
-    }
-    return position - 1;
-  }
-
   inline bool enqueue(const T &item) {
-    static_assert(Size > 1, "RingBuffer size must be > 1");
-    uint8_t next = nextPosition(head_);
-    if (next == tail_) {
+    uint8_t head = head_;
+    if ((uint8_t)(head - SPSC_LOAD(tail_)) == Size) {
       // Full
       return false;
     }
 
-    buf_[head_] = item;
-    head_ = next;
+    buf_[head & Mask] = item;
+    SPSC_STORE(head_, (uint8_t)(head + 1));
     return true;
   }
 
   inline bool get(T &dest, bool commit = true) {
-    auto tail = tail_;
-    if (tail == head_) {
+    uint8_t tail = tail_;
+    if (tail == SPSC_LOAD(head_)) {
       // No more data
       return false;
     }
 
-    dest = buf_[tail];
-    tail = nextPosition(tail);
+    dest = buf_[tail & Mask];
 
     if (commit) {
-      tail_ = tail;
+      SPSC_STORE(tail_, (uint8_t)(tail + 1));
     }
     return true;
   }
 
-  inline bool empty() const { return head_ == tail_; }
+  inline bool empty() { return SPSC_LOAD(head_) == tail_; }
 
-  inline uint8_t size() const {
-    int diff = head_ - tail_;
-    if (diff >= 0) {
-      return diff;
-    }
-    return Size + diff;
+  inline uint8_t size() {
+    return (uint8_t)(SPSC_LOAD(head_) - SPSC_LOAD(tail_));
   }
 
   inline T& front() {
-    return buf_[tail_];
+    return buf_[tail_ & Mask];
   }
 
   inline bool peek(T &item) {
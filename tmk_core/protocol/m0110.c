@@ -41,10 +41,26 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <avr/interrupt.h>
 #include <util/delay.h>
 #include "m0110.h"
+#include "m0110_decoder.h"
 #include "debug.h"
 
 
-static inline uint8_t raw2scan(uint8_t raw);
+/* port settings for clock and data line */
+#if !(defined(M0110_CLOCK_PORT) && \
+      defined(M0110_CLOCK_PIN) && \
+      defined(M0110_CLOCK_DDR) && \
+      defined(M0110_CLOCK_BIT))
+#   error "M0110 clock port setting is required in config.h"
+#endif
+
+#if !(defined(M0110_DATA_PORT) && \
+      defined(M0110_DATA_PIN) && \
+      defined(M0110_DATA_DDR) && \
+      defined(M0110_DATA_BIT))
+#   error "M0110 data port setting is required in config.h"
+#endif
+
+
 static inline uint8_t inquiry(void);
 static inline uint8_t instant(void);
 static inline void clock_lo(void);
@@ -82,9 +98,6 @@ static inline void request(void);
     } \
 } while (0)
 
-#define KEY(raw)        ((raw) & 0x7f)
-#define IS_BREAK(raw)   (((raw) & 0x80) == 0x80)
-
 
 uint8_t m0110_error = 0;
 
@@ -201,117 +214,31 @@ During Calc key is hold:
 */
 uint8_t m0110_recv_key(void)
 {
-    static uint8_t keybuf = 0x00;
-    static uint8_t keybuf2 = 0x00;
-    static uint8_t rawbuf = 0x00;
-    uint8_t raw, raw2, raw3;
-
-    if (keybuf) {
-        raw = keybuf;
-        keybuf = 0x00;
-        return raw;
-    }
-    if (keybuf2) {
-        raw = keybuf2;
-        keybuf2 = 0x00;
-        return raw;
-    }
+    static m0110_decoder_t decoder;
+    static uint8_t keys[M0110_DECODER_MAX_KEYS];
+    static uint8_t count = 0;
+    static uint8_t next = 0;
 
-    if (rawbuf) {
-        raw = rawbuf;
-        rawbuf = 0x00;
-    } else {
-        raw = instant();  // Use INSTANT for better response. Should be INQUIRY ?
+    if (next < count) {
+        return keys[next++];
     }
-    switch (KEY(raw)) {
-        case M0110_KEYPAD:
-            raw2 = instant();
-            switch (KEY(raw2)) {
-                case M0110_ARROW_UP:
-                case M0110_ARROW_DOWN:
-                case M0110_ARROW_LEFT:
-                case M0110_ARROW_RIGHT:
-                    if (IS_BREAK(raw2)) {
-                        // Case B,F,N:
-                        keybuf = (raw2scan(raw2) | M0110_CALC_OFFSET); // Calc(u)
-                        return (raw2scan(raw2) | M0110_KEYPAD_OFFSET); // Arrow(u)
-                    }
-                    break;
-            }
-            // Keypad or Arrow
-            return (raw2scan(raw2) | M0110_KEYPAD_OFFSET);
-            break;
-        case M0110_SHIFT:
-            raw2 = instant();
-            switch (KEY(raw2)) {
-                case M0110_SHIFT:
-                    // Case: 5-8,C,G,H
-                    rawbuf = raw2;
-                    return raw2scan(raw); // Shift(d/u)
-                    break;
-                case M0110_KEYPAD:
-                    // Shift + Arrow, Calc, or etc.
-                    raw3 = instant();
-                    switch (KEY(raw3)) {
-                        case M0110_ARROW_UP:
-                        case M0110_ARROW_DOWN:
-                        case M0110_ARROW_LEFT:
-                        case M0110_ARROW_RIGHT:
-                            if (IS_BREAK(raw)) {
-                                if (IS_BREAK(raw3)) {
-                                    // Case 4:
-                                    print("(4)\n");
-                                    keybuf2 = raw2scan(raw); // Shift(u)
-                                    keybuf  = (raw2scan(raw3) | M0110_CALC_OFFSET); // Calc(u)
-                                    return (raw2scan(raw3) | M0110_KEYPAD_OFFSET);  // Arrow(u)
-                                } else {
-                                    // Case 3:
-                                    print("(3)\n");
-                                    return (raw2scan(raw)); // Shift(u)
-                                }
-                            } else {
-                                if (IS_BREAK(raw3)) {
-                                    // Case 2:
-                                    print("(2)\n");
-                                    keybuf  = (raw2scan(raw3) | M0110_CALC_OFFSET); // Calc(u)
-                                    return (raw2scan(raw3) | M0110_KEYPAD_OFFSET);  // Arrow(u)
-                                } else {
-                                    // Case 1:
-                                    print("(1)\n");
-                                    return (raw2scan(raw3) | M0110_CALC_OFFSET); // Calc(d)
-                                }
-                            }
-                            break;
-                        default:
-                            // Shift + Keypad
-                            keybuf = (raw2scan(raw3) | M0110_KEYPAD_OFFSET);
-                            return raw2scan(raw);   // Shift(d/u)
-                            break;
-                    }
-                    break;
-                default:
-                    // Shift + Normal keys
-                    keybuf = raw2scan(raw2);
-                    return raw2scan(raw);   // Shift(d/u)
-                    break;
-            }
-            break;
-        default:
-            // Normal keys
-            return raw2scan(raw);
+    // a sequence is three bytes at most, the rest is read on the next call
+    // if the keyboard has not sent it yet
+    for (uint8_t i = 0; i < 3; i++) {
+        uint8_t raw = instant();  // Use INSTANT for better response. Should be INQUIRY ?
+        count = m0110_decoder_raw(&decoder, raw, keys);
+        if (count) {
+            next = 1;
+            return keys[0];
+        }
+        if (!m0110_decoder_pending(&decoder)) {
             break;
+        }
     }
+    return M0110_NULL;
 }
 
 
-static inline uint8_t raw2scan(uint8_t raw) {
-    return (raw == M0110_NULL) ?  M0110_NULL : (
-                (raw == M0110_ERROR) ?  M0110_ERROR : (
-                    ((raw&0x80) | ((raw&0x7F)>>1))
-                )
-           );
-}
-
 static inline uint8_t inquiry(void)
 {
     m0110_send(M0110_INQUIRY);
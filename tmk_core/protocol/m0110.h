@@ -39,20 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #define M0110_H
 
 
-/* port settings for clock and data line */
-#if !(defined(M0110_CLOCK_PORT) && \
-      defined(M0110_CLOCK_PIN) && \
-      defined(M0110_CLOCK_DDR) && \
-      defined(M0110_CLOCK_BIT))
-#   error "M0110 clock port setting is required in config.h"
-#endif
-
-#if !(defined(M0110_DATA_PORT) && \
-      defined(M0110_DATA_PIN) && \
-      defined(M0110_DATA_DDR) && \
-      defined(M0110_DATA_BIT))
-#   error "M0110 data port setting is required in config.h"
-#endif
+#include <stdint.h>
 
 /* Commands */
 #define M0110_INQUIRY       0x10
@@ -0,0 +1,153 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "m0110_decoder.h"
+
+#define KEY(raw)        ((raw) & 0x7f)
+#define IS_BREAK(raw)   (((raw) & 0x80) == 0x80)
+
+enum {
+    IDLE,
+    KEYPAD,         // got M0110_KEYPAD
+    SHIFT,          // got M0110_SHIFT
+    SHIFT_KEYPAD,   // got M0110_SHIFT and M0110_KEYPAD
+};
+
+static inline uint8_t raw2scan(uint8_t raw) {
+    return (raw == M0110_NULL) ?  M0110_NULL : (
+                (raw == M0110_ERROR) ?  M0110_ERROR : (
+                    ((raw&0x80) | ((raw&0x7F)>>1))
+                )
+           );
+}
+
+static inline bool is_arrow(uint8_t raw) {
+    switch (KEY(raw)) {
+        case M0110_ARROW_UP:
+        case M0110_ARROW_DOWN:
+        case M0110_ARROW_LEFT:
+        case M0110_ARROW_RIGHT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void m0110_decoder_init(m0110_decoder_t *decoder)
+{
+    decoder->state = IDLE;
+    decoder->shift = 0;
+}
+
+bool m0110_decoder_pending(const m0110_decoder_t *decoder)
+{
+    return decoder->state != IDLE;
+}
+
+uint8_t m0110_decoder_raw(m0110_decoder_t *decoder, uint8_t raw, uint8_t *keys)
+{
+    uint8_t count = 0;
+    uint8_t shift = decoder->shift;
+
+    if (raw == M0110_NULL) {
+        if (decoder->state == SHIFT || decoder->state == SHIFT_KEYPAD) {
+            // Case D: nothing followed the Shift, it was a plain Shift(d/u)
+            keys[count++] = raw2scan(shift);
+            decoder->state = IDLE;
+        }
+        // otherwise keep waiting for the rest of a sequence
+        return count;
+    }
+    if (raw == M0110_ERROR) {
+        decoder->state = IDLE;
+        keys[count++] = M0110_ERROR;
+        return count;
+    }
+
+    switch (decoder->state) {
+        case IDLE:
+            switch (KEY(raw)) {
+                case M0110_KEYPAD:
+                    decoder->state = KEYPAD;
+                    break;
+                case M0110_SHIFT:
+                    decoder->shift = raw;
+                    decoder->state = SHIFT;
+                    break;
+                default:
+                    // Normal keys
+                    keys[count++] = raw2scan(raw);
+                    break;
+            }
+            break;
+        case KEYPAD:
+            // Keypad or Arrow
+            keys[count++] = raw2scan(raw) | M0110_KEYPAD_OFFSET;
+            if (is_arrow(raw) && IS_BREAK(raw)) {
+                // Case B,F,N:
+                keys[count++] = raw2scan(raw) | M0110_CALC_OFFSET;      // Calc(u)
+            }
+            decoder->state = IDLE;
+            break;
+        case SHIFT:
+            switch (KEY(raw)) {
+                case M0110_SHIFT:
+                    // Case: 5-8,C,G,H
+                    keys[count++] = raw2scan(shift);    // Shift(d/u)
+                    decoder->shift = raw;
+                    break;
+                case M0110_KEYPAD:
+                    // Shift + Arrow, Calc, or etc.
+                    decoder->state = SHIFT_KEYPAD;
+                    break;
+                default:
+                    // Shift + Normal keys
+                    keys[count++] = raw2scan(shift);    // Shift(d/u)
+                    keys[count++] = raw2scan(raw);
+                    decoder->state = IDLE;
+                    break;
+            }
+            break;
+        case SHIFT_KEYPAD:
+            if (!is_arrow(raw)) {
+                // Shift + Keypad
+                keys[count++] = raw2scan(shift);        // Shift(d/u)
+                keys[count++] = raw2scan(raw) | M0110_KEYPAD_OFFSET;
+            } else if (IS_BREAK(shift)) {
+                if (IS_BREAK(raw)) {
+                    // Case 4:
+                    keys[count++] = raw2scan(raw) | M0110_KEYPAD_OFFSET;  // Arrow(u)
+                    keys[count++] = raw2scan(raw) | M0110_CALC_OFFSET;    // Calc(u)
+                    keys[count++] = raw2scan(shift);                      // Shift(u)
+                } else {
+                    // Case 3:
+                    keys[count++] = raw2scan(shift);                      // Shift(u)
+                }
+            } else {
+                if (IS_BREAK(raw)) {
+                    // Case 2:
+                    keys[count++] = raw2scan(raw) | M0110_KEYPAD_OFFSET;  // Arrow(u)
+                    keys[count++] = raw2scan(raw) | M0110_CALC_OFFSET;    // Calc(u)
+                } else {
+                    // Case 1:
+                    keys[count++] = raw2scan(raw) | M0110_CALC_OFFSET;    // Calc(d)
+                }
+            }
+            decoder->state = IDLE;
+            break;
+    }
+    return count;
+}
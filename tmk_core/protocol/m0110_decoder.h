@@ -0,0 +1,50 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef M0110_DECODER_H
+#define M0110_DECODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "m0110.h"
+
+/*
+ * Turns the raw bytes of an M0110/M0110A into scan codes.
+ *
+ * Keypad keys come as M0110_KEYPAD and a second byte, and the M0110A adds a
+ * Shift prefix to some of them, see the table in m0110.c. This keeps the
+ * position in such a sequence between bytes, so the bytes can arrive one
+ * poll at a time instead of the caller waiting for the whole sequence. No
+ * hardware access, which also lets the host tests feed it recorded bytes.
+ */
+
+/* most scan codes a single byte can complete */
+#define M0110_DECODER_MAX_KEYS  3
+
+typedef struct {
+    uint8_t state;
+    uint8_t shift;      // raw Shift byte starting the sequence
+} m0110_decoder_t;
+
+void m0110_decoder_init(m0110_decoder_t *decoder);
+
+/* Writes the scan codes completed by raw to keys and returns how many. */
+uint8_t m0110_decoder_raw(m0110_decoder_t *decoder, uint8_t raw, uint8_t *keys);
+
+/* true while in the middle of a sequence */
+bool m0110_decoder_pending(const m0110_decoder_t *decoder);
+
+#endif
@@ -216,57 +216,63 @@ void midi_send_array(MidiDevice * device, uint16_t count, uint8_t * array) {
 
 
 void midi_register_cc_callback(MidiDevice * device, midi_three_byte_func_t func){
-   device->input_cc_callback = func;
+   device->input_callbacks[MIDI_INPUT_CC].three = func;
 }
 
 void midi_register_noteon_callback(MidiDevice * device, midi_three_byte_func_t func){
-   device->input_noteon_callback = func;
+   device->input_callbacks[MIDI_INPUT_NOTEON].three = func;
 }
 
 void midi_register_noteoff_callback(MidiDevice * device, midi_three_byte_func_t func){
-   device->input_noteoff_callback = func;
+   device->input_callbacks[MIDI_INPUT_NOTEOFF].three = func;
 }
 
 void midi_register_aftertouch_callback(MidiDevice * device, midi_three_byte_func_t func){
-   device->input_aftertouch_callback = func;
+   device->input_callbacks[MIDI_INPUT_AFTERTOUCH].three = func;
 }
 
 void midi_register_pitchbend_callback(MidiDevice * device, midi_three_byte_func_t func){
-   device->input_pitchbend_callback = func;
+   device->input_callbacks[MIDI_INPUT_PITCHBEND].three = func;
 }
 
 void midi_register_songposition_callback(MidiDevice * device, midi_three_byte_func_t func){
-   device->input_songposition_callback = func;
+   device->input_callbacks[MIDI_INPUT_SONGPOSITION].three = func;
 }
 
 void midi_register_progchange_callback(MidiDevice * device, midi_two_byte_func_t func) {
-   device->input_progchange_callback = func;
+   device->input_callbacks[MIDI_INPUT_PROGCHANGE].two = func;
 }
 
 void midi_register_chanpressure_callback(MidiDevice * device, midi_two_byte_func_t func) {
-   device->input_chanpressure_callback = func;
+   device->input_callbacks[MIDI_INPUT_CHANPRESSURE].two = func;
 }
 
 void midi_register_songselect_callback(MidiDevice * device, midi_two_byte_func_t func) {
-   device->input_songselect_callback = func;
+   device->input_callbacks[MIDI_INPUT_SONGSELECT].two = func;
 }
 
 void midi_register_tc_quarterframe_callback(MidiDevice * device, midi_two_byte_func_t func) {
-   device->input_tc_quarterframe_callback = func;
+   device->input_callbacks[MIDI_INPUT_TC_QUARTERFRAME].two = func;
 }
 
 void midi_register_realtime_callback(MidiDevice * device, midi_one_byte_func_t func){
-   device->input_realtime_callback = func;
+   device->input_callbacks[MIDI_INPUT_REALTIME].one = func;
 }
 
 void midi_register_tunerequest_callback(MidiDevice * device, midi_one_byte_func_t func){
-   device->input_tunerequest_callback = func;
+   device->input_callbacks[MIDI_INPUT_TUNEREQUEST].one = func;
 }
 
 void midi_register_sysex_callback(MidiDevice * device, midi_sysex_func_t func) {
    device->input_sysex_callback = func;
 }
 
+void midi_register_sysex_buffer(MidiDevice * device, uint8_t * buffer, uint8_t size) {
+   device->sysex_buffer = buffer;
+   device->sysex_buffer_size = size;
+   device->sysex_length = 0;
+}
+
 void midi_register_fallthrough_callback(MidiDevice * device, midi_var_byte_func_t func){
    device->input_fallthrough_callback = func;
 }
@@ -381,6 +381,21 @@ void midi_register_tunerequest_callback(MidiDevice * device, midi_one_byte_func_
  */
 void midi_register_sysex_callback(MidiDevice * device, midi_sysex_func_t func);
 
+/**
+ * @brief Register a buffer to collect sysex messages in.
+ *
+ * Without a buffer the sysex callback is called with every 1 to 3 bytes of
+ * the message as they arrive.  With one, the bytes are collected and the
+ * callback is only called once the buffer is full or the message ends, so a
+ * message that fits is delivered whole, with start_byte 0 and ending in
+ * SYSEX_END.
+ *
+ * @param device the device associate with
+ * @param buffer the buffer to collect sysex bytes in, NULL to disable
+ * @param size the size of the buffer
+ */
+void midi_register_sysex_buffer(MidiDevice * device, uint8_t * buffer, uint8_t size);
+
 /**
  * @brief Register fall through callback.
  *
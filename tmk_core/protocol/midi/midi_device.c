@@ -18,50 +18,100 @@
 
 #include "midi_device.h"
 #include "midi.h"
+#include "progmem.h"
+#include <string.h> //for memcpy
 
 #ifndef NULL
 #define NULL 0
 #endif
 
+#if MIDI_INPUT_QUEUE_LENGTH % MIDI_PACKET_SIZE
+#error "MIDI_INPUT_QUEUE_LENGTH must be a multiple of MIDI_PACKET_SIZE"
+#endif
+
+//USB-MIDI code index numbers, the low nibble of the first packet byte
+#define CIN_SYS_COMMON_2 0x2
+#define CIN_SYS_COMMON_3 0x3
+#define CIN_SYSEX_START_OR_CONT 0x4
+#define CIN_SYSEX_ENDS_IN_1 0x5
+#define CIN_SYS_COMMON_1 0x5
+#define CIN_SYSEX_ENDS_IN_2 0x6
+#define CIN_SYSEX_ENDS_IN_3 0x7
+#define CIN_SINGLE_BYTE 0xF
+
+//Dispatch table entries, the message length in the high nibble and the
+//callback slot in the low nibble. A length of 0 means the status is not a
+//complete message on its own and is dropped.
+#define DISPATCH(length, slot) (((length) << 4) | (slot))
+#define DISPATCH_LENGTH(entry) ((entry) >> 4)
+#define DISPATCH_SLOT(entry) ((entry) & 0x0F)
+
+//channel messages at (status >> 4) - 8, system messages at 7 + (status & 0x0F)
+#define DISPATCH_SYSTEM 7
+static const uint8_t dispatch_table[DISPATCH_SYSTEM + 16] PROGMEM = {
+  DISPATCH(3, MIDI_INPUT_NOTEOFF),         //0x80
+  DISPATCH(3, MIDI_INPUT_NOTEON),          //0x90
+  DISPATCH(3, MIDI_INPUT_AFTERTOUCH),      //0xA0
+  DISPATCH(3, MIDI_INPUT_CC),              //0xB0
+  DISPATCH(2, MIDI_INPUT_PROGCHANGE),      //0xC0
+  DISPATCH(2, MIDI_INPUT_CHANPRESSURE),    //0xD0
+  DISPATCH(3, MIDI_INPUT_PITCHBEND),       //0xE0
+  DISPATCH(0, MIDI_INPUT_NONE),            //0xF0 sysex, handled separately
+  DISPATCH(2, MIDI_INPUT_TC_QUARTERFRAME), //0xF1
+  DISPATCH(3, MIDI_INPUT_SONGPOSITION),    //0xF2
+  DISPATCH(2, MIDI_INPUT_SONGSELECT),      //0xF3
+  DISPATCH(0, MIDI_INPUT_NONE),            //0xF4
+  DISPATCH(0, MIDI_INPUT_NONE),            //0xF5
+  DISPATCH(1, MIDI_INPUT_TUNEREQUEST),     //0xF6
+  DISPATCH(0, MIDI_INPUT_NONE),            //0xF7 sysex end, handled separately
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xF8
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xF9
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xFA
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xFB
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xFC
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xFD
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xFE
+  DISPATCH(1, MIDI_INPUT_REALTIME),        //0xFF
+};
+
 //forward declarations, internally used to call the callbacks
-void midi_input_callbacks(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2);
 void midi_process_byte(MidiDevice * device, uint8_t input);
+void midi_process_packet(MidiDevice * device, const uint8_t * packet);
 
 void midi_device_init(MidiDevice * device){
   device->input_state = IDLE;
   device->input_count = 0;
-  bytequeue_init(&device->input_queue, device->input_queue_data, MIDI_INPUT_QUEUE_LENGTH);
-
-  //three byte funcs
-  device->input_cc_callback = NULL;
-  device->input_noteon_callback = NULL;
-  device->input_noteoff_callback = NULL;
-  device->input_aftertouch_callback = NULL;
-  device->input_pitchbend_callback = NULL;
-  device->input_songposition_callback = NULL;
-
-  //two byte funcs
-  device->input_progchange_callback = NULL;
-  device->input_chanpressure_callback = NULL;
-  device->input_songselect_callback = NULL;
-  device->input_tc_quarterframe_callback = NULL;
-
-  //one byte funcs
-  device->input_realtime_callback = NULL;
-  device->input_tunerequest_callback = NULL;
+  spsc_queue_init(&device->input_queue, device->input_queue_data, MIDI_INPUT_QUEUE_LENGTH);
+
+  memset(device->input_callbacks, 0, sizeof(device->input_callbacks));
 
   //var byte functions
   device->input_sysex_callback = NULL;
   device->input_fallthrough_callback = NULL;
   device->input_catchall_callback = NULL;
 
+  device->sysex_buffer = NULL;
+  device->sysex_buffer_size = 0;
+  device->sysex_length = 0;
+  device->sysex_count = 0;
+
   device->pre_input_process_callback = NULL;
 }
 
+void midi_device_input_packet(MidiDevice * device, const uint8_t * packet) {
+  //only whole packets are queued, so the consumer never sees half of one
+  if (spsc_queue_space(&device->input_queue) >= MIDI_PACKET_SIZE)
+    spsc_queue_write(&device->input_queue, packet, MIDI_PACKET_SIZE);
+}
+
+static void midi_input_packet(MidiDevice * device, uint8_t cin, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+  uint8_t packet[MIDI_PACKET_SIZE] = { cin, byte0, byte1, byte2 };
+  midi_device_input_packet(device, packet);
+}
+
 void midi_device_input(MidiDevice * device, uint8_t cnt, uint8_t * input) {
-  uint8_t i;
-  for (i = 0; i < cnt; i++)
-    bytequeue_enqueue(&device->input_queue, input[i]);
+  for (uint8_t i = 0; i < cnt; i++)
+    midi_process_byte(device, input[i]);
 }
 
 void midi_device_set_send_func(MidiDevice * device, midi_var_byte_func_t send_func){
@@ -77,35 +127,46 @@ void midi_device_process(MidiDevice * device) {
   if(device->pre_input_process_callback)
     device->pre_input_process_callback(device);
 
-  //pull stuff off the queue and process
-  byteQueueIndex_t len = bytequeue_length(&device->input_queue);
-  uint16_t i;
-  //TODO limit number of bytes processed?
-  for(i = 0; i < len; i++) {
-    uint8_t val = bytequeue_get(&device->input_queue, 0);
-    midi_process_byte(device, val);
-    bytequeue_remove(&device->input_queue, 1);
+  //pull packets off the queue and process them in place, a contiguous span at a time
+  //only what is queued now is processed, so a flood of input can't starve the caller
+  uint8_t len = spsc_queue_count(&device->input_queue);
+  while (len) {
+    const uint8_t * span;
+    uint8_t cnt = spsc_queue_read_span(&device->input_queue, &span);
+    if (cnt > len)
+      cnt = len;
+    for (uint8_t i = 0; i < cnt; i += MIDI_PACKET_SIZE)
+      midi_process_packet(device, span + i);
+    spsc_queue_consume(&device->input_queue, cnt);
+    len -= cnt;
   }
 }
 
+//Turns a byte stream into packets, keeping the running status. This runs on
+//the producing side, so the input state is only touched by the producer.
 void midi_process_byte(MidiDevice * device, uint8_t input) {
   if (midi_is_realtime(input)) {
-    //call callback, store and restore state
-    input_state_t state = device->input_state;
-    device->input_state = ONE_BYTE_MESSAGE;
-    midi_input_callbacks(device, 1, input, 0, 0);
-    device->input_state = state;
+    //realtime messages can appear anywhere and don't change the state
+    midi_input_packet(device, CIN_SINGLE_BYTE, input, 0, 0);
   } else if (midi_is_statusbyte(input)) {
-    //store the byte
-    if (device->input_state != SYSEX_MESSAGE) {
-      device->input_buffer[0] = input;
-      device->input_count = 1;
+    if (input == SYSEX_END) {
+      if (device->input_state == SYSEX_MESSAGE) {
+        device->input_buffer[device->input_count] = input;
+        midi_input_packet(device, CIN_SYSEX_ENDS_IN_1 + device->input_count,
+            device->input_buffer[0], device->input_buffer[1], device->input_buffer[2]);
+      }
+      device->input_state = IDLE;
+      device->input_count = 0;
+      return;
     }
+
+    device->input_buffer[0] = input;
+    device->input_count = 1;
     switch (midi_packet_length(input)) {
       case ONE:
-        device->input_state = ONE_BYTE_MESSAGE;;
-        midi_input_callbacks(device, 1, input, 0, 0);
+        midi_input_packet(device, CIN_SYS_COMMON_1, input, 0, 0);
         device->input_state = IDLE;
+        device->input_count = 0;
         break;
       case TWO:
         device->input_state = TWO_BYTE_MESSAGE;
@@ -113,179 +174,138 @@ void midi_process_byte(MidiDevice * device, uint8_t input) {
       case THREE:
         device->input_state = THREE_BYTE_MESSAGE;
         break;
-      case UNDEFINED:
-        switch(input) {
-          case SYSEX_BEGIN:
-            device->input_state = SYSEX_MESSAGE;
-            device->input_buffer[0] = input;
-            device->input_count = 1;
-            break;
-          case SYSEX_END:
-            //send what is left in the input buffer, set idle
-            device->input_buffer[device->input_count % 3] = input;
-            device->input_count += 1;
-            //call the callback
-            midi_input_callbacks(device, device->input_count, 
-                device->input_buffer[0], device->input_buffer[1], device->input_buffer[2]);
-            device->input_state = IDLE;
-            break;
-          default:
-            device->input_state = IDLE;
-            device->input_count = 0;
+      default:
+        if (input == SYSEX_BEGIN) {
+          device->input_state = SYSEX_MESSAGE;
+        } else {
+          device->input_state = IDLE;
+          device->input_count = 0;
         }
-
         break;
-      default:
-        device->input_state = IDLE;
+    }
+  } else if (device->input_state != IDLE) {
+    //store the byte
+    device->input_buffer[device->input_count] = input;
+    device->input_count += 1;
+
+    if (device->input_state == SYSEX_MESSAGE) {
+      if (device->input_count == 3) {
+        midi_input_packet(device, CIN_SYSEX_START_OR_CONT,
+            device->input_buffer[0], device->input_buffer[1], device->input_buffer[2]);
         device->input_count = 0;
-        break;
+      }
+    } else if (device->input_count == device->input_state) {
+      uint8_t status = device->input_buffer[0];
+      uint8_t cin;
+      if (status < SYSEX_BEGIN)
+        cin = status >> 4;
+      else
+        cin = (device->input_count == 3) ? CIN_SYS_COMMON_3 : CIN_SYS_COMMON_2;
+      midi_input_packet(device, cin, status, device->input_buffer[1],
+          device->input_count == 3 ? device->input_buffer[2] : 0);
+      //set to 1, keeping status byte, allowing for running status
+      device->input_count = 1;
     }
-  } else {
-    if (device->input_state != IDLE) {
-      //store the byte
-      device->input_buffer[device->input_count % 3] = input;
-      //increment count
-      uint16_t prev = device->input_count;
-      device->input_count += 1;
-
-      switch(prev % 3) {
-        case 2:
-          //call callback
-          midi_input_callbacks(device, device->input_count,
-              device->input_buffer[0], device->input_buffer[1], device->input_buffer[2]);
-          if (device->input_state != SYSEX_MESSAGE) {
-            //set to 1, keeping status byte, allowing for running status
-            device->input_count = 1;
-          }
-          break;
-        case 1:
-          if (device->input_state == TWO_BYTE_MESSAGE) {
-            //call callback
-            midi_input_callbacks(device, device->input_count,
-                device->input_buffer[0], device->input_buffer[1], 0);
-            if (device->input_state != SYSEX_MESSAGE) {
-              //set to 1, keeping status byte, allowing for running status
-              device->input_count = 1;
-            }
-          }
-          break;
-        case 0:
-        default:
-          //one byte messages are dealt with directly
-          break;
+  }
+}
+
+//end is the position in the message just after the last buffered byte
+static void midi_sysex_flush(MidiDevice * device, uint16_t end) {
+  device->input_sysex_callback(device, end - device->sysex_length,
+      device->sysex_length, device->sysex_buffer);
+  device->sysex_length = 0;
+}
+
+//Sysex bytes are gathered in the registered buffer and handed over in as few
+//callbacks as possible, a whole message at once if it fits.
+static void midi_process_sysex(MidiDevice * device, const uint8_t * data, uint8_t cnt) {
+  if (data[0] == SYSEX_BEGIN) {
+    device->sysex_count = 0;
+    device->sysex_length = 0;
+  }
+  device->sysex_count += cnt;
+
+  if (device->input_sysex_callback) {
+    if (device->sysex_buffer) {
+      for (uint8_t i = 0; i < cnt; i++) {
+        if (device->sysex_length == device->sysex_buffer_size)
+          midi_sysex_flush(device, device->sysex_count - cnt + i);
+        device->sysex_buffer[device->sysex_length++] = data[i];
       }
+      if (data[cnt - 1] == SYSEX_END)
+        midi_sysex_flush(device, device->sysex_count);
+    } else {
+      device->input_sysex_callback(device, device->sysex_count - cnt, cnt, (uint8_t *)data);
     }
+  } else if (device->input_fallthrough_callback) {
+    device->input_fallthrough_callback(device, device->sysex_count,
+        data[0], cnt > 1 ? data[1] : 0, cnt > 2 ? data[2] : 0);
   }
+
+  if (device->input_catchall_callback)
+    device->input_catchall_callback(device, device->sysex_count,
+        data[0], cnt > 1 ? data[1] : 0, cnt > 2 ? data[2] : 0);
 }
 
-void midi_input_callbacks(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
-  //did we end up calling a callback?
+void midi_process_packet(MidiDevice * device, const uint8_t * packet) {
+  const uint8_t * data = packet + 1;
+  uint8_t status = data[0];
+
+  switch (packet[0] & 0x0F) {
+    case CIN_SYSEX_START_OR_CONT:
+      midi_process_sysex(device, data, 3);
+      return;
+    case CIN_SYSEX_ENDS_IN_1:
+      //shares its code index with single byte system common messages
+      if (status != SYSEX_END)
+        break;
+      midi_process_sysex(device, data, 1);
+      return;
+    case CIN_SYSEX_ENDS_IN_2:
+      midi_process_sysex(device, data, 2);
+      return;
+    case CIN_SYSEX_ENDS_IN_3:
+      midi_process_sysex(device, data, 3);
+      return;
+    default:
+      break;
+  }
+
+  if (!midi_is_statusbyte(status))
+    return;
+
+  uint8_t entry = pgm_read_byte(&dispatch_table[status < SYSEX_BEGIN ?
+      (status >> 4) - 8 : DISPATCH_SYSTEM + (status & 0x0F)]);
+  uint8_t cnt = DISPATCH_LENGTH(entry);
+  if (cnt == 0)
+    return;
+
+  //mask off the channel for channel messages
+  uint8_t byte0 = status < SYSEX_BEGIN ? (status & MIDI_CHANMASK) : status;
+  midi_input_func_t func = device->input_callbacks[DISPATCH_SLOT(entry)];
   bool called = false;
-  if (device->input_state == SYSEX_MESSAGE) {
-    if (device->input_sysex_callback) {
-      const uint16_t start = ((cnt - 1) / 3) * 3;
-      const uint8_t length = (cnt - start);
-      uint8_t data[3];
-      data[0] = byte0;
-      data[1] = byte1;
-      data[2] = byte2;
-      device->input_sysex_callback(device, start, length, data);
-      called = true;
-    }
-  } else {
+  if (func.one) {
     switch (cnt) {
       case 3:
-        {
-          midi_three_byte_func_t func = NULL;
-          switch (byte0 & 0xF0) {
-            case MIDI_CC:
-              func = device->input_cc_callback;
-              break;
-            case MIDI_NOTEON:
-              func = device->input_noteon_callback;
-              break;
-            case MIDI_NOTEOFF:
-              func = device->input_noteoff_callback;
-              break;
-            case MIDI_AFTERTOUCH:
-              func = device->input_aftertouch_callback;
-              break;
-            case MIDI_PITCHBEND:
-              func = device->input_pitchbend_callback;
-              break;
-            case 0xF0:
-              if (byte0 == MIDI_SONGPOSITION)
-                func = device->input_songposition_callback;
-              break;
-            default:
-              break;
-          }
-          if(func) {
-            //mask off the channel for non song position functions
-            if (byte0 == MIDI_SONGPOSITION)
-              func(device, byte0, byte1, byte2);
-            else
-              func(device, byte0 & 0x0F, byte1, byte2);
-            called = true;
-          }
-        }
+        func.three(device, byte0, data[1], data[2]);
         break;
       case 2:
-        {
-          midi_two_byte_func_t func = NULL;
-          switch (byte0 & 0xF0) {
-            case MIDI_PROGCHANGE:
-              func = device->input_progchange_callback;
-              break;
-            case MIDI_CHANPRESSURE:
-              func = device->input_chanpressure_callback;
-              break;
-            case 0xF0:
-              if (byte0 == MIDI_SONGSELECT)
-                func = device->input_songselect_callback;
-              else if (byte0 == MIDI_TC_QUARTERFRAME)
-                func = device->input_tc_quarterframe_callback;
-              break;
-            default:
-              break;
-          }
-          if(func) {
-            //mask off the channel
-            if (byte0 == MIDI_SONGSELECT || byte0 == MIDI_TC_QUARTERFRAME)
-              func(device, byte0, byte1);
-            else
-              func(device, byte0 & 0x0F, byte1);
-            called = true;
-          }
-        }
-        break;
-      case 1:
-        {
-          midi_one_byte_func_t func = NULL;
-          if (midi_is_realtime(byte0))
-            func = device->input_realtime_callback;
-          else if (byte0 == MIDI_TUNEREQUEST)
-            func = device->input_tunerequest_callback;
-          if (func) {
-            func(device, byte0);
-            called = true;
-          }
-        }
+        func.two(device, byte0, data[1]);
         break;
       default:
-        //just in case
-        if (cnt > 3)
-          cnt = 0;
+        func.one(device, byte0);
         break;
     }
+    called = true;
   }
 
   //if there is fallthrough default callback and we haven't called a more specific one, 
   //call the fallthrough
   if (!called && device->input_fallthrough_callback)
-    device->input_fallthrough_callback(device, cnt, byte0, byte1, byte2);
+    device->input_fallthrough_callback(device, cnt, status,
+        cnt > 1 ? data[1] : 0, cnt > 2 ? data[2] : 0);
   //always call the catch all if it exists
   if (device->input_catchall_callback)
-    device->input_catchall_callback(device, cnt, byte0, byte1, byte2);
+    device->input_catchall_callback(device, cnt, status,
+        cnt > 1 ? data[1] : 0, cnt > 2 ? data[2] : 0);
 }
-
@@ -48,8 +48,11 @@ extern "C" {
  */
 
 #include "midi_function_types.h"
-#include "bytequeue/bytequeue.h"
-#define MIDI_INPUT_QUEUE_LENGTH 192
+#include "spsc_queue.h"
+
+//input is queued as 4 byte USB-MIDI event packets
+#define MIDI_PACKET_SIZE 4
+#define MIDI_INPUT_QUEUE_LENGTH 128
 
 typedef enum {
    IDLE, 
@@ -58,6 +61,35 @@ typedef enum {
    THREE_BYTE_MESSAGE = 3,
    SYSEX_MESSAGE} input_state_t;
 
+/**
+ * \enum midi_input_slot_t
+ *
+ * Index of each message callback in the device's dispatch table.  The channel
+ * messages come first, in status byte order.
+ */
+typedef enum {
+   MIDI_INPUT_NOTEOFF,
+   MIDI_INPUT_NOTEON,
+   MIDI_INPUT_AFTERTOUCH,
+   MIDI_INPUT_CC,
+   MIDI_INPUT_PROGCHANGE,
+   MIDI_INPUT_CHANPRESSURE,
+   MIDI_INPUT_PITCHBEND,
+   MIDI_INPUT_SONGPOSITION,
+   MIDI_INPUT_SONGSELECT,
+   MIDI_INPUT_TC_QUARTERFRAME,
+   MIDI_INPUT_TUNEREQUEST,
+   MIDI_INPUT_REALTIME,
+   MIDI_INPUT_CALLBACK_COUNT,
+   MIDI_INPUT_NONE = MIDI_INPUT_CALLBACK_COUNT} midi_input_slot_t;
+
+//the member used depends on the length of the message in that slot
+typedef union {
+   midi_one_byte_func_t one;
+   midi_two_byte_func_t two;
+   midi_three_byte_func_t three;
+} midi_input_func_t;
+
 typedef void (* midi_no_byte_func_t)(MidiDevice * device);
 
 /**
@@ -75,21 +107,8 @@ struct _midi_device {
    midi_var_byte_func_t send_func;
 
    //********input callbacks
-   //three byte funcs
-   midi_three_byte_func_t input_cc_callback;
-   midi_three_byte_func_t input_noteon_callback;
-   midi_three_byte_func_t input_noteoff_callback;
-   midi_three_byte_func_t input_aftertouch_callback;
-   midi_three_byte_func_t input_pitchbend_callback;
-   midi_three_byte_func_t input_songposition_callback;
-   //two byte funcs
-   midi_two_byte_func_t input_progchange_callback;
-   midi_two_byte_func_t input_chanpressure_callback;
-   midi_two_byte_func_t input_songselect_callback;
-   midi_two_byte_func_t input_tc_quarterframe_callback;
-   //one byte funcs
-   midi_one_byte_func_t input_realtime_callback;
-   midi_one_byte_func_t input_tunerequest_callback;
+   //one, two and three byte funcs, indexed by midi_input_slot_t
+   midi_input_func_t input_callbacks[MIDI_INPUT_CALLBACK_COUNT];
 
    //sysex
    midi_sysex_func_t input_sysex_callback;
@@ -102,14 +121,20 @@ struct _midi_device {
    //pre input processing function
    midi_no_byte_func_t pre_input_process_callback;
 
-   //for internal input processing
+   //for turning byte input into packets, producer side
    uint8_t input_buffer[3];
    input_state_t input_state;
    uint16_t input_count;
 
-   //for queueing data between the input and the processing functions
+   //sysex streaming, consumer side
+   uint8_t * sysex_buffer;
+   uint8_t sysex_buffer_size;
+   uint8_t sysex_length;
+   uint16_t sysex_count;
+
+   //for queueing packets between the input and the processing functions
    uint8_t input_queue_data[MIDI_INPUT_QUEUE_LENGTH];
-   byteQueue_t input_queue;
+   spsc_queue_t input_queue;
 };
 
 /**
@@ -124,6 +149,17 @@ struct _midi_device {
  */
 void midi_device_input(MidiDevice * device, uint8_t cnt, uint8_t * input);
 
+/**
+ * @brief Process an input USB-MIDI event packet.  This is the fast path for
+ * devices which already receive whole packets, the message is passed on
+ * as is without going through the byte parser.  Packets are dropped if the
+ * input queue is full.
+ *
+ * @param device the midi device to associate the input with
+ * @param packet the cable number/code index byte followed by 3 midi bytes
+ */
+void midi_device_input_packet(MidiDevice * device, const uint8_t * packet);
+
 /**
  * @brief Set the callback function that will be used for sending output
  * data bytes.  This is only used if you're creating a custom device.
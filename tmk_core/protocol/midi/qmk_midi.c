@@ -77,29 +77,9 @@ static void usb_send_func(MidiDevice * device, uint16_t cnt, uint8_t byte0, uint
 
 static void usb_get_midi(MidiDevice * device) {
   MIDI_EventPacket_t event;
+  //USB-MIDI event packets go to the device as is, the parser works on whole packets
   while (recv_midi_packet(&event)) {
-
-    midi_packet_length_t length = midi_packet_length(event.Data1);
-    uint8_t input[3];
-    input[0] = event.Data1;
-    input[1] = event.Data2;
-    input[2] = event.Data3;
-    if (length == UNDEFINED) {
-      //sysex
-      if (event.Event == MIDI_EVENT(0, SYSEX_START_OR_CONT) || event.Event == MIDI_EVENT(0, SYSEX_ENDS_IN_3)) {
-        length = 3;
-      } else if (event.Event == MIDI_EVENT(0, SYSEX_ENDS_IN_2)) {
-        length = 2;
-      } else if(event.Event ==  MIDI_EVENT(0, SYSEX_ENDS_IN_1)) {
-        length = 1;
-      } else {
-        //XXX what to do?
-      }
-    }
-
-    //pass the data to the device input function
-    if (length != UNDEFINED)
-      midi_device_input(device, length, input);
+    midi_device_input_packet(device, (const uint8_t *)&event);
   }
 }
 
@@ -131,38 +111,21 @@ static void cc_callback(MidiDevice * device,
 }
 
 #ifdef API_SYSEX_ENABLE
-uint8_t midi_buffer[MIDI_SYSEX_BUFFER] = {0};
+//SYSEX_BEGIN, the 3 byte header, the encoded message and SYSEX_END
+#define MIDI_SYSEX_HEADER 4
+static uint8_t midi_buffer[MIDI_SYSEX_HEADER + MIDI_SYSEX_BUFFER + 1] = {0};
 
 static void sysex_callback(MidiDevice * device, uint16_t start, uint8_t length, uint8_t * data) {
-  // SEND_STRING("\n");
-  // send_word(start);
-  // SEND_STRING(": ");
-  // Don't store the header
-  int16_t pos = start - 4;
-  for (uint8_t place = 0; place < length; place++) {
-      // send_byte(*data);
-      if (pos >= 0) {
-          if (*data == 0xF7) {
-              // SEND_STRING("\nRD: ");
-              // for (uint8_t i = 0; i < start + place + 1; i++){
-              //     send_byte(midi_buffer[i]);
-              // SEND_STRING(" ");
-              // }
-              const unsigned decoded_length = sysex_decoded_length(pos);
-              uint8_t decoded[API_SYSEX_MAX_SIZE];
-              sysex_decode(decoded, midi_buffer, pos);
-              process_api(decoded_length, decoded);
-              return;
-          }
-          else if (pos >= MIDI_SYSEX_BUFFER) {
-              return;
-          }
-          midi_buffer[pos] = *data;
-      }
-      // SEND_STRING(" ");
-      data++;
-      pos++;
+  // Only a whole message fits the buffer, anything longer isn't an api message
+  if (start != 0 || length <= MIDI_SYSEX_HEADER || data[length - 1] != SYSEX_END) {
+    return;
   }
+  // Don't store the header
+  const uint8_t encoded_length = length - MIDI_SYSEX_HEADER - 1;
+  const unsigned decoded_length = sysex_decoded_length(encoded_length);
+  uint8_t decoded[API_SYSEX_MAX_SIZE];
+  sysex_decode(decoded, data + MIDI_SYSEX_HEADER, encoded_length);
+  process_api(decoded_length, decoded);
 }
 #endif
 
@@ -180,5 +143,6 @@ void setup_midi(void)
   midi_register_cc_callback(&midi_device, cc_callback);
 #ifdef API_SYSEX_ENABLE
   midi_register_sysex_callback(&midi_device, sysex_callback);
+  midi_register_sysex_buffer(&midi_device, midi_buffer, sizeof(midi_buffer));
 #endif
 }
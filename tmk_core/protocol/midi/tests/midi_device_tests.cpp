@@ -0,0 +1,239 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdio>
+#include <vector>
+extern "C" {
+#include "midi.h"
+}
+
+using std::vector;
+
+struct Message {
+    int callback;
+    uint16_t count;
+    uint8_t bytes[3];
+    bool operator==(const Message& other) const {
+        return callback == other.callback && count == other.count &&
+            bytes[0] == other.bytes[0] && bytes[1] == other.bytes[1] && bytes[2] == other.bytes[2];
+    }
+};
+
+enum { NOTEON, CC, PROGCHANGE, REALTIME, FALLTHROUGH };
+
+static vector<Message> messages;
+static vector<vector<uint8_t>> sysex;
+static vector<uint16_t> sysex_start;
+static unsigned catchall_calls;
+
+extern "C" {
+static void noteon_callback(MidiDevice* device, uint8_t chan, uint8_t note, uint8_t velocity) {
+    messages.push_back({NOTEON, 3, {chan, note, velocity}});
+}
+
+static void cc_callback(MidiDevice* device, uint8_t chan, uint8_t num, uint8_t val) {
+    messages.push_back({CC, 3, {chan, num, val}});
+}
+
+static void progchange_callback(MidiDevice* device, uint8_t chan, uint8_t num) {
+    messages.push_back({PROGCHANGE, 2, {chan, num, 0}});
+}
+
+static void realtime_callback(MidiDevice* device, uint8_t byte) {
+    messages.push_back({REALTIME, 1, {byte, 0, 0}});
+}
+
+static void fallthrough_callback(MidiDevice* device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+    messages.push_back({FALLTHROUGH, cnt, {byte0, byte1, byte2}});
+}
+
+static void catchall_callback(MidiDevice* device, uint16_t cnt, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+    catchall_calls++;
+}
+
+static void sysex_callback(MidiDevice* device, uint16_t start, uint8_t length, uint8_t* data) {
+    sysex.push_back(vector<uint8_t>(data, data + length));
+    sysex_start.push_back(start);
+}
+}
+
+class MidiInput : public testing::Test {
+public:
+    MidiInput() {
+        messages.clear();
+        sysex.clear();
+        sysex_start.clear();
+        catchall_calls = 0;
+        midi_device_init(&device);
+        midi_register_noteon_callback(&device, noteon_callback);
+        midi_register_cc_callback(&device, cc_callback);
+        midi_register_progchange_callback(&device, progchange_callback);
+        midi_register_realtime_callback(&device, realtime_callback);
+        midi_register_fallthrough_callback(&device, fallthrough_callback);
+        midi_register_catchall_callback(&device, catchall_callback);
+        midi_register_sysex_callback(&device, sysex_callback);
+    }
+
+    void input(vector<uint8_t> bytes) {
+        midi_device_input(&device, bytes.size(), bytes.data());
+        midi_device_process(&device);
+    }
+
+    void packet(uint8_t cin, uint8_t byte0, uint8_t byte1, uint8_t byte2) {
+        uint8_t data[] = {cin, byte0, byte1, byte2};
+        midi_device_input_packet(&device, data);
+    }
+
+    MidiDevice device;
+};
+
+TEST_F(MidiInput, DispatchesChannelMessagePackets) {
+    packet(0x9, 0x93, 60, 100);
+    packet(0xB, 0xB0, 7, 127);
+    packet(0xC, 0xC5, 12, 0);
+    midi_device_process(&device);
+    vector<Message> expected = {
+        {NOTEON, 3, {3, 60, 100}},
+        {CC, 3, {0, 7, 127}},
+        {PROGCHANGE, 2, {5, 12, 0}},
+    };
+    EXPECT_EQ(messages, expected);
+    EXPECT_EQ(catchall_calls, 3);
+}
+
+TEST_F(MidiInput, UnregisteredMessagesFallThrough) {
+    packet(0x8, 0x81, 60, 0);
+    packet(0x3, MIDI_SONGPOSITION, 1, 2);
+    midi_device_process(&device);
+    vector<Message> expected = {
+        {FALLTHROUGH, 3, {0x81, 60, 0}},
+        {FALLTHROUGH, 3, {MIDI_SONGPOSITION, 1, 2}},
+    };
+    EXPECT_EQ(messages, expected);
+}
+
+TEST_F(MidiInput, SingleByteSystemCommonIsNotSysexEnd) {
+    packet(0x5, MIDI_TUNEREQUEST, 0, 0);
+    midi_device_process(&device);
+    vector<Message> expected = {{FALLTHROUGH, 1, {MIDI_TUNEREQUEST, 0, 0}}};
+    EXPECT_EQ(messages, expected);
+    EXPECT_TRUE(sysex.empty());
+}
+
+TEST_F(MidiInput, ByteInputKeepsRunningStatus) {
+    input({0x92, 60, 100, 61, 101, 0xC1, 3, 4});
+    vector<Message> expected = {
+        {NOTEON, 3, {2, 60, 100}},
+        {NOTEON, 3, {2, 61, 101}},
+        {PROGCHANGE, 2, {1, 3, 0}},
+        {PROGCHANGE, 2, {1, 4, 0}},
+    };
+    EXPECT_EQ(messages, expected);
+}
+
+TEST_F(MidiInput, ByteInputRealtimeInterleaves) {
+    input({0xB0, 1, MIDI_CLOCK, 2});
+    vector<Message> expected = {
+        {REALTIME, 1, {MIDI_CLOCK, 0, 0}},
+        {CC, 3, {0, 1, 2}},
+    };
+    EXPECT_EQ(messages, expected);
+}
+
+TEST_F(MidiInput, SysexWithoutBufferComesInPackets) {
+    input({SYSEX_BEGIN, 1, 2, 3, 4, SYSEX_END});
+    vector<vector<uint8_t>> expected = {{SYSEX_BEGIN, 1, 2}, {3, 4, SYSEX_END}};
+    EXPECT_EQ(sysex, expected);
+    EXPECT_EQ(sysex_start, vector<uint16_t>({0, 3}));
+}
+
+TEST_F(MidiInput, SysexIsDeliveredWholeWhenItFits) {
+    uint8_t buffer[16];
+    midi_register_sysex_buffer(&device, buffer, sizeof(buffer));
+    vector<uint8_t> message = {SYSEX_BEGIN, 1, 2, 3, 4, 5, 6, 7, SYSEX_END};
+    for (int i = 0; i < 3; i++) {
+        input(message);
+    }
+    EXPECT_EQ(sysex, vector<vector<uint8_t>>(3, message));
+    EXPECT_EQ(sysex_start, vector<uint16_t>(3, 0));
+}
+
+TEST_F(MidiInput, SysexFromPacketsEndingInEachLength) {
+    uint8_t buffer[16];
+    midi_register_sysex_buffer(&device, buffer, sizeof(buffer));
+    packet(0x4, SYSEX_BEGIN, 1, 2);
+    packet(0x5, SYSEX_END, 0, 0);
+    packet(0x4, SYSEX_BEGIN, 1, 2);
+    packet(0x6, 3, SYSEX_END, 0);
+    packet(0x4, SYSEX_BEGIN, 1, 2);
+    packet(0x7, 3, 4, SYSEX_END);
+    midi_device_process(&device);
+    vector<vector<uint8_t>> expected = {
+        {SYSEX_BEGIN, 1, 2, SYSEX_END},
+        {SYSEX_BEGIN, 1, 2, 3, SYSEX_END},
+        {SYSEX_BEGIN, 1, 2, 3, 4, SYSEX_END},
+    };
+    EXPECT_EQ(sysex, expected);
+}
+
+TEST_F(MidiInput, LongSysexIsStreamedInBufferSizedChunks) {
+    uint8_t buffer[4];
+    midi_register_sysex_buffer(&device, buffer, sizeof(buffer));
+    input({SYSEX_BEGIN, 1, 2, 3, 4, 5, 6, 7, 8, SYSEX_END});
+    vector<vector<uint8_t>> expected = {
+        {SYSEX_BEGIN, 1, 2, 3},
+        {4, 5, 6, 7},
+        {8, SYSEX_END},
+    };
+    EXPECT_EQ(sysex, expected);
+    EXPECT_EQ(sysex_start, vector<uint16_t>({0, 4, 8}));
+}
+
+TEST_F(MidiInput, FullQueueDropsWholePackets) {
+    for (int i = 0; i < MIDI_INPUT_QUEUE_LENGTH / MIDI_PACKET_SIZE + 1; i++) {
+        packet(0xB, 0xB0, i, 0);
+    }
+    midi_device_process(&device);
+    ASSERT_EQ(messages.size(), MIDI_INPUT_QUEUE_LENGTH / MIDI_PACKET_SIZE);
+    EXPECT_EQ(messages.back().bytes[1], MIDI_INPUT_QUEUE_LENGTH / MIDI_PACKET_SIZE - 1);
+}
+
+// A DAW streaming clock and CC automation, processed as it would be from
+// keyboard_task. Prints the throughput, the check is only that nothing is lost.
+TEST_F(MidiInput, Throughput) {
+    const unsigned rounds = 200000;
+    const unsigned per_round = MIDI_INPUT_QUEUE_LENGTH / MIDI_PACKET_SIZE;
+    unsigned expected = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (unsigned round = 0; round < rounds; round++) {
+        messages.clear();
+        for (unsigned i = 0; i < per_round; i++) {
+            if (i % 4 == 0) {
+                packet(0xF, MIDI_CLOCK, 0, 0);
+            } else {
+                packet(0xB, 0xB0 | (i & 0x0F), i & 0x7F, round & 0x7F);
+            }
+        }
+        midi_device_process(&device);
+        expected += per_round;
+        ASSERT_EQ(messages.size(), per_round);
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    EXPECT_EQ(catchall_calls, expected);
+    printf("%u packets in %.3f s, %.0f packets/s\n", expected, elapsed, expected / elapsed);
+}
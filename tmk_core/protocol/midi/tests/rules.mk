@@ -0,0 +1,10 @@
+MIDI_PATH := $(TMK_PATH)/protocol/midi
+
+midi_device_SRC :=\
+	$(MIDI_PATH)/tests/midi_device_tests.cpp \
+	$(MIDI_PATH)/midi_device.c \
+	$(MIDI_PATH)/midi.c
+
+midi_device_INC :=\
+	$(MIDI_PATH) \
+	$(TMK_PATH)/$(COMMON_DIR)
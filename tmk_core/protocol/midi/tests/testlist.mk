@@ -0,0 +1,2 @@
+TEST_LIST +=\
+	midi_device
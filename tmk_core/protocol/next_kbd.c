@@ -52,12 +52,20 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <util/delay.h>
 #include "next_kbd.h"
 #include "debug.h"
+#ifdef NEXT_KBD_INT_VECT
+#   include <avr/interrupt.h>
+#   include "next_kbd_decoder.h"
+#   include "timer.h"
+#   include "avr/timer_avr.h"
+#endif
 
 static inline void out_lo(void);
 static inline void out_hi(void);
 static inline void query(void);
 static inline void reset(void);
+#ifndef NEXT_KBD_INT_VECT
 static inline uint32_t response(void);
+#endif
 
 /* The keyboard sends signal with 50us pulse width on OUT line
  * while it seems to miss the 50us pulse on In line.
@@ -81,6 +89,10 @@ void next_kbd_init(void)
     
     query_delay(5);
     reset_delay(8);
+
+#ifdef NEXT_KBD_INT_VECT
+    NEXT_KBD_INT_INIT();
+#endif
 }
 
 void next_kbd_set_leds(bool left, bool right)
@@ -109,6 +121,99 @@ void next_kbd_set_leds(bool left, bool right)
 }
 
 #define NEXT_KBD_READ (NEXT_KBD_IN_PIN&(1<<NEXT_KBD_IN_BIT))
+
+#ifdef NEXT_KBD_INT_VECT
+/*
+ * Interrupt driven receive
+ *
+ * The query is still placed with the delays above, but the response is
+ * timed by the KBD_IN pin interrupt and decoded by next_kbd_decoder, so
+ * the caller never waits for the keyboard. Each call returns the result of
+ * the previous query and sends the next one.
+ */
+enum {
+    QUERY_IDLE,
+    QUERY_RESPONSE, // query sent, ISR decoding
+    QUERY_DONE,
+    QUERY_ERROR,
+};
+
+static next_kbd_decoder_t decoder;
+static volatile uint8_t query_state = QUERY_IDLE;
+static uint16_t query_time;
+static uint16_t last_edge;
+
+ISR(NEXT_KBD_INT_VECT)
+{
+    uint16_t now = timer_read_raw();
+    uint16_t us = timer_raw_to_us(now - last_edge);
+    last_edge = now;
+
+    switch (next_kbd_decoder_edge(&decoder, NEXT_KBD_READ, us)) {
+        case NEXT_KBD_DECODER_DONE:
+            NEXT_KBD_INT_OFF();
+            query_state = QUERY_DONE;
+            break;
+        case NEXT_KBD_DECODER_ERROR:
+            NEXT_KBD_INT_OFF();
+            query_state = QUERY_ERROR;
+            break;
+    }
+}
+
+/* finishes a response whose last bits are high, or gives up on it */
+static void response_task(void)
+{
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        if (query_state != QUERY_RESPONSE) {
+            break;
+        }
+        if (decoder.started) {
+            uint16_t us = timer_raw_to_us(timer_read_raw() - last_edge);
+            uint16_t rest = (NEXT_KBD_DECODER_BITS - decoder.bits) * NEXT_KBD_TIMING + NEXT_KBD_TIMING / 2;
+            if (us > rest) {
+                NEXT_KBD_INT_OFF();
+                next_kbd_decoder_idle(&decoder);
+                query_state = QUERY_DONE;
+            }
+        } else if (timer_elapsed(query_time) > NEXT_KBD_RESPONSE_TIMEOUT) {
+            NEXT_KBD_INT_OFF();
+            query_state = QUERY_ERROR;
+        }
+    }
+}
+
+uint32_t next_kbd_recv(void)
+{
+    uint32_t data = 0;
+
+    response_task();
+    switch (query_state) {
+        case QUERY_RESPONSE:
+            return 0;
+        case QUERY_DONE:
+            data = decoder.data;
+            break;
+        case QUERY_ERROR:
+            // no response, same as the blocking version
+            reset();
+            break;
+    }
+    query_state = QUERY_IDLE;
+
+    // First check to make sure that the keyboard is actually connected;
+    // if not, don't query it
+    if (NEXT_KBD_READ) {
+        query();
+        next_kbd_decoder_init(&decoder);
+        last_edge = timer_read_raw();
+        query_time = timer_read();
+        query_state = QUERY_RESPONSE;
+        NEXT_KBD_INT_ON();
+    }
+    return data;
+}
+#else
 uint32_t next_kbd_recv(void)
 {
     
@@ -179,6 +284,7 @@ static inline uint32_t response(void)
     
     return data;
 }
+#endif
 
 static inline void out_lo(void)
 {
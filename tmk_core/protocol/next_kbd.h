@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 */
 
+#include <stdint.h>
 #include <stdbool.h>
 
 #ifndef NEXT_KBD_H
@@ -53,6 +54,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #define NEXT_KBD_KMBUS_IDLE 0x300600
 #define NEXT_KBD_TIMING     50
 
+/* Interrupt driven receive is used when config.h defines NEXT_KBD_INT_INIT(),
+ * NEXT_KBD_INT_ON(), NEXT_KBD_INT_OFF() and NEXT_KBD_INT_VECT for an
+ * interrupt on both edges of the KBD_IN pin. */
+/* ms to wait for the response to a query */
+#ifndef NEXT_KBD_RESPONSE_TIMEOUT
+#define NEXT_KBD_RESPONSE_TIMEOUT   5
+#endif
+
 extern uint8_t next_kbd_error;
 
 /* host role */
@@ -0,0 +1,70 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "next_kbd_decoder.h"
+
+void next_kbd_decoder_init(next_kbd_decoder_t *decoder)
+{
+    decoder->data = 0;
+    decoder->bit_us = NEXT_KBD_TIMING;
+    decoder->bits = 0;
+    decoder->started = false;
+    decoder->level = true;
+}
+
+static void add_bits(next_kbd_decoder_t *decoder, bool level, uint8_t count)
+{
+    for (; count && decoder->bits < NEXT_KBD_DECODER_BITS; count--) {
+        if (level) {
+            decoder->data |= (uint32_t)1 << decoder->bits;
+        }
+        decoder->bits++;
+    }
+}
+
+uint8_t next_kbd_decoder_edge(next_kbd_decoder_t *decoder, bool level, uint16_t us)
+{
+    if (level == decoder->level) {
+        // glitch shorter than the interrupt latency
+        return NEXT_KBD_DECODER_BUSY;
+    }
+    decoder->level = level;
+
+    if (!decoder->started) {
+        // the idle time before the first bit is no part of the frame
+        decoder->started = !level;
+        return NEXT_KBD_DECODER_BUSY;
+    }
+
+    uint16_t count = (us + decoder->bit_us / 2) / decoder->bit_us;
+    if (count == 0) {
+        return NEXT_KBD_DECODER_ERROR;
+    }
+    if (count == 1) {
+        decoder->bit_us = (decoder->bit_us + us) / 2;
+    }
+    add_bits(decoder, !level, count > NEXT_KBD_DECODER_BITS ? NEXT_KBD_DECODER_BITS : count);
+    return decoder->bits == NEXT_KBD_DECODER_BITS ? NEXT_KBD_DECODER_DONE : NEXT_KBD_DECODER_BUSY;
+}
+
+uint8_t next_kbd_decoder_idle(next_kbd_decoder_t *decoder)
+{
+    if (!decoder->started) {
+        return NEXT_KBD_DECODER_BUSY;
+    }
+    add_bits(decoder, decoder->level, NEXT_KBD_DECODER_BITS);
+    return NEXT_KBD_DECODER_DONE;
+}
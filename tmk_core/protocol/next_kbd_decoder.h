@@ -0,0 +1,63 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NEXT_KBD_DECODER_H
+#define NEXT_KBD_DECODER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "next_kbd.h"
+
+/*
+ * Decoder for NeXT keyboard responses.
+ *
+ * A response is 22 bits LSB first, NEXT_KBD_TIMING us each, starting with
+ * the line dropping from idle high. It is fed the durations between edges
+ * on the line, as timed by a pin change interrupt, and turns every run into
+ * as many bits as fit in it, so there is no sampling point to drift away
+ * from. Single bit runs keep the bit time in step with the keyboard clock
+ * for the longer runs. No hardware access, which also lets the host tests
+ * feed it recorded timings.
+ */
+
+#define NEXT_KBD_DECODER_BITS   22
+
+enum {
+    NEXT_KBD_DECODER_BUSY,
+    NEXT_KBD_DECODER_DONE,
+    NEXT_KBD_DECODER_ERROR,
+};
+
+typedef struct {
+    uint32_t data;
+    uint16_t bit_us;    // measured bit time
+    uint8_t  bits;
+    bool     started;
+    bool     level;
+} next_kbd_decoder_t;
+
+/* call before the response is expected, the line must be idle high */
+void next_kbd_decoder_init(next_kbd_decoder_t *decoder);
+
+/* level is the line after the edge, us how long it was at the other level.
+ * Returns NEXT_KBD_DECODER_DONE with the result in decoder->data. */
+uint8_t next_kbd_decoder_edge(next_kbd_decoder_t *decoder, bool level, uint16_t us);
+
+/* The line kept its level for the rest of the frame, the trailing bits have
+ * no edge to end them. Returns NEXT_KBD_DECODER_DONE once started. */
+uint8_t next_kbd_decoder_idle(next_kbd_decoder_t *decoder);
+
+#endif
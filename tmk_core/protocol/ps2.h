@@ -78,6 +78,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #define PS2_ERR_STARTBIT3   3
 #define PS2_ERR_PARITY      0x10
 #define PS2_ERR_NODATA      0x20
+#define PS2_ERR_NOACK       0x30
+#define PS2_ERR_TIMEOUT     0x40
+#define PS2_ERR_BUSY        0x50
 
 #define PS2_LED_SCROLL_LOCK 0
 #define PS2_LED_NUM_LOCK    1
@@ -92,6 +95,49 @@ uint8_t ps2_host_recv_response(void);
 uint8_t ps2_host_recv(void);
 void ps2_host_set_led(uint8_t usb_led);
 
+#ifdef PS2_USE_INT
+/* bytes of device data buffered between ps2_host_recv() calls, power of two */
+#ifndef PS2_HOST_RECV_BUFFER_SIZE
+#define PS2_HOST_RECV_BUFFER_SIZE   32
+#endif
+/* commands waiting to be sent, power of two */
+#ifndef PS2_HOST_COMMAND_QUEUE_SIZE
+#define PS2_HOST_COMMAND_QUEUE_SIZE 8
+#endif
+/* command plus parameter bytes */
+#ifndef PS2_HOST_COMMAND_MAX_LEN
+#define PS2_HOST_COMMAND_MAX_LEN    2
+#endif
+/* ms allowed for a device to clock in a command byte */
+#ifndef PS2_HOST_TX_TIMEOUT
+#define PS2_HOST_TX_TIMEOUT         15
+#endif
+/* ms allowed for the response after that */
+#ifndef PS2_HOST_RESPONSE_TIMEOUT
+#define PS2_HOST_RESPONSE_TIMEOUT   25
+#endif
+/* ms without clock after which a partly received byte is dropped */
+#ifndef PS2_HOST_FRAME_TIMEOUT
+#define PS2_HOST_FRAME_TIMEOUT      2
+#endif
+/* times a byte is sent again when the device answers PS2_RESEND */
+#ifndef PS2_HOST_RESEND_RETRY
+#define PS2_HOST_RESEND_RETRY       3
+#endif
+
+/* Called from the main loop once the command completes with the last
+ * response byte, or 0 and ps2_error set when it failed. */
+typedef void (*ps2_host_callback_t)(uint8_t response);
+
+/* Queues a command and its parameter bytes, each is sent once the
+ * previous one was acked. Returns false when the queue is full. */
+bool ps2_host_send_async(const uint8_t *data, uint8_t len, ps2_host_callback_t callback);
+/* true while commands are queued or on the bus */
+bool ps2_host_busy(void);
+/* drives the command queue, call from the main loop */
+void ps2_host_task(void);
+#endif
+
 
 /*--------------------------------------------------------------------
  * static functions
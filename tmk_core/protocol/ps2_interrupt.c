@@ -37,31 +37,90 @@ POSSIBILITY OF SUCH DAMAGE.
 
 /*
  * PS/2 protocol Pin interrupt version
+ *
+ * Both directions are driven by the clock line interrupt. Commands are
+ * queued with ps2_host_send_async() and clocked out bit by bit in the ISR;
+ * ps2_host_task() only starts the next command, collects the device response
+ * and handles timeouts, so nothing here waits on the bus.
  */
 
 #include <stdbool.h>
 #include <avr/interrupt.h>
-#include <util/delay.h>
 #include "ps2.h"
 #include "ps2_io.h"
+#include "spsc_queue.h"
+#include "timer.h"
+#include "wait.h"
 #include "print.h"
 
 
-#define WAIT(stat, us, err) do { \
-    if (!wait_##stat(us)) { \
-        ps2_error = err; \
-        goto ERROR; \
-    } \
-} while (0)
+uint8_t ps2_error = PS2_ERR_NONE;
 
 
-uint8_t ps2_error = PS2_ERR_NONE;
+/*--------------------------------------------------------------------
+ * Scan codes from the device, filled by the ISR
+ *------------------------------------------------------------------*/
+static uint8_t pbuf_data[PS2_HOST_RECV_BUFFER_SIZE];
+static spsc_queue_t pbuf = SPSC_QUEUE_INITIALIZER(pbuf_data);
+
+
+/*--------------------------------------------------------------------
+ * Command queue, only touched from the main loop
+ *------------------------------------------------------------------*/
+typedef struct {
+    uint8_t data[PS2_HOST_COMMAND_MAX_LEN];
+    uint8_t len;
+    ps2_host_callback_t callback;
+} ps2_command_t;
 
+static ps2_command_t commands[PS2_HOST_COMMAND_QUEUE_SIZE];
+static uint8_t command_head = 0;
+static uint8_t command_tail = 0;
+// byte of the front command on the bus and how often it was resent
+static uint8_t command_pos = 0;
+static uint8_t command_retry = 0;
 
-static inline uint8_t pbuf_dequeue(void);
-static inline void pbuf_enqueue(uint8_t data);
-static inline bool pbuf_has_data(void);
-static inline void pbuf_clear(void);
+
+/*--------------------------------------------------------------------
+ * Bus state shared with the ISR
+ *------------------------------------------------------------------*/
+enum {
+    TX_IDLE,
+    TX_INHIBIT,     // clock held low to abort the device, ISR off
+    TX_SENDING,     // device clocks the byte out of the ISR
+    TX_RESPONSE,    // byte acked, next received byte is the response
+    TX_DONE,        // response received
+    TX_ERROR,       // ISR gave up, ps2_error tells why
+};
+
+enum {
+    RX_INIT,
+    RX_START,
+    RX_BIT0, RX_BIT1, RX_BIT2, RX_BIT3, RX_BIT4, RX_BIT5, RX_BIT6, RX_BIT7,
+    RX_PARITY,
+    RX_STOP,
+};
+
+static volatile uint8_t tx_state = TX_IDLE;
+static volatile uint8_t tx_response = 0;
+static volatile uint8_t rx_state = RX_INIT;
+// timer_read() at the start bit of the byte being received
+static volatile uint16_t rx_time = 0;
+static uint8_t tx_data = 0;
+static uint8_t tx_bit = 0;
+static uint8_t tx_parity = 1;
+static uint16_t tx_time = 0;
+
+static void rx_reset(void);
+
+static inline bool rx_stalled(void)
+{
+    uint8_t sreg = SREG;
+    cli();
+    bool stalled = rx_state != RX_INIT && timer_elapsed(rx_time) > PS2_HOST_FRAME_TIMEOUT;
+    SREG = sreg;
+    return stalled;
+}
 
 
 void ps2_host_init(void)
@@ -73,124 +132,246 @@ void ps2_host_init(void)
     //_delay_ms(2500);
 }
 
-uint8_t ps2_host_send(uint8_t data)
+bool ps2_host_send_async(const uint8_t *data, uint8_t len, ps2_host_callback_t callback)
 {
-    bool parity = true;
-    ps2_error = PS2_ERR_NONE;
+    if (len == 0 || len > PS2_HOST_COMMAND_MAX_LEN ||
+            (uint8_t)(command_head - command_tail) >= PS2_HOST_COMMAND_QUEUE_SIZE) {
+        return false;
+    }
+    ps2_command_t *command = &commands[command_head % PS2_HOST_COMMAND_QUEUE_SIZE];
+    for (uint8_t i = 0; i < len; i++) {
+        command->data[i] = data[i];
+    }
+    command->len = len;
+    command->callback = callback;
+    command_head++;
+    return true;
+}
 
-    PS2_INT_OFF();
+bool ps2_host_busy(void)
+{
+    return command_head != command_tail;
+}
 
-    /* terminate a transmission if we have */
-    inhibit();
-    _delay_us(100); // 100us [4]p.13, [5]p.50
+static void command_finish(uint8_t response)
+{
+    ps2_host_callback_t callback = commands[command_tail % PS2_HOST_COMMAND_QUEUE_SIZE].callback;
+    command_tail++;
+    command_pos = 0;
+    command_retry = 0;
+    tx_state = TX_IDLE;
+    if (callback) {
+        callback(response);
+    }
+}
 
-    /* 'Request to Send' and Start bit */
-    data_lo();
-    clock_hi();
-    WAIT(clock_lo, 10000, 10);   // 10ms [5]p.50
+void ps2_host_task(void)
+{
+    /* a device that stops clocking mid byte would wedge the receiver */
+    if (rx_stalled()) {
+        PS2_INT_OFF();
+        rx_reset();
+        PS2_INT_ON();
+    }
 
-    /* Data bit[2-9] */
-    for (uint8_t i = 0; i < 8; i++) {
-        _delay_us(15);
-        if (data&(1<<i)) {
-            parity = !parity;
-            data_hi();
-        } else {
+    switch (tx_state) {
+        case TX_IDLE:
+            // wait for any byte the device is sending to finish
+            if (!ps2_host_busy() || rx_state != RX_INIT) {
+                break;
+            }
+            /* terminate a transmission if we have */
+            PS2_INT_OFF();
+            inhibit();
+            tx_time = timer_read();
+            tx_state = TX_INHIBIT;
+            break;
+        case TX_INHIBIT:
+            // at least 100us [4]p.13, [5]p.50, whole ticks since the timer is in ms
+            if (timer_elapsed(tx_time) < 2) {
+                break;
+            }
+            tx_data = commands[command_tail % PS2_HOST_COMMAND_QUEUE_SIZE].data[command_pos];
+            tx_bit = 0;
+            tx_parity = 1;
+            rx_reset();
+            tx_time = timer_read();
+            tx_state = TX_SENDING;
+            /* 'Request to Send' and Start bit */
             data_lo();
+            clock_hi();
+            PS2_INT_ON();
+            break;
+        case TX_SENDING:
+            // device has to start clocking in 10ms and finish in 2ms more [5]p.50
+            if (timer_elapsed(tx_time) > PS2_HOST_TX_TIMEOUT) {
+                PS2_INT_OFF();
+                if (tx_state == TX_SENDING) {
+                    idle();
+                    rx_reset();
+                    ps2_error = PS2_ERR_TIMEOUT;
+                    command_finish(0);
+                }
+                PS2_INT_ON();
+            }
+            break;
+        case TX_RESPONSE:
+            // Command may take 25ms/20ms at most([5]p.46, [3]p.21)
+            if (timer_elapsed(tx_time) > PS2_HOST_TX_TIMEOUT + PS2_HOST_RESPONSE_TIMEOUT) {
+                ps2_error = PS2_ERR_NODATA;
+                command_finish(0);
+            }
+            break;
+        case TX_DONE: {
+            uint8_t response = tx_response;
+            const ps2_command_t *command = &commands[command_tail % PS2_HOST_COMMAND_QUEUE_SIZE];
+            if (response == PS2_RESEND && command_retry < PS2_HOST_RESEND_RETRY) {
+                command_retry++;
+                tx_state = TX_IDLE;
+            } else if (response == PS2_ACK && command_pos + 1 < command->len) {
+                // parameter byte of the same command
+                command_pos++;
+                command_retry = 0;
+                tx_state = TX_IDLE;
+            } else {
+                ps2_error = PS2_ERR_NONE;
+                command_finish(response);
+            }
+            break;
         }
-        WAIT(clock_hi, 50, 2);
-        WAIT(clock_lo, 50, 3);
+        case TX_ERROR:
+            idle();
+            command_finish(0);
+            break;
     }
+}
 
-    /* Parity bit */
-    _delay_us(15);
-    if (parity) { data_hi(); } else { data_lo(); }
-    WAIT(clock_hi, 50, 4);
-    WAIT(clock_lo, 50, 5);
-
-    /* Stop bit */
-    _delay_us(15);
-    data_hi();
-
-    /* Ack */
-    WAIT(data_lo, 50, 6);
-    WAIT(clock_lo, 50, 7);
+/* Blocking version of ps2_host_send_async() for a single byte */
+static volatile bool sync_done;
+static uint8_t sync_response;
 
-    /* wait for idle state */
-    WAIT(clock_hi, 50, 8);
-    WAIT(data_hi, 50, 9);
+static void sync_callback(uint8_t response)
+{
+    sync_response = response;
+    sync_done = true;
+}
 
-    idle();
-    PS2_INT_ON();
-    return ps2_host_recv_response();
-ERROR:
-    idle();
-    PS2_INT_ON();
-    return 0;
+uint8_t ps2_host_send(uint8_t data)
+{
+    sync_done = false;
+    if (!ps2_host_send_async(&data, 1, sync_callback)) {
+        ps2_error = PS2_ERR_BUSY;
+        return 0;
+    }
+    while (!sync_done) {
+        ps2_host_task();
+    }
+    return sync_response;
 }
 
 uint8_t ps2_host_recv_response(void)
 {
     // Command may take 25ms/20ms at most([5]p.46, [3]p.21)
     uint8_t retry = 25;
-    while (retry-- && !pbuf_has_data()) {
-        _delay_ms(1);
+    while (retry-- && spsc_queue_empty(&pbuf)) {
+        wait_ms(1);
     }
-    return pbuf_dequeue();
+    return ps2_host_recv();
 }
 
 /* get data received by interrupt */
 uint8_t ps2_host_recv(void)
 {
-    if (pbuf_has_data()) {
+    uint8_t data;
+    if (spsc_queue_pop(&pbuf, &data)) {
         ps2_error = PS2_ERR_NONE;
-        return pbuf_dequeue();
+        return data;
     } else {
         ps2_error = PS2_ERR_NODATA;
         return 0;
     }
 }
 
+/* send LED state to keyboard, the update is dropped if the queue is full */
+void ps2_host_set_led(uint8_t led)
+{
+    uint8_t command[] = { PS2_SET_LED, led };
+    ps2_host_send_async(command, sizeof(command), NULL);
+}
+
+static void rx_reset(void)
+{
+    rx_state = RX_INIT;
+}
+
+static inline void tx_edge(void)
+{
+    tx_bit++;
+    if (tx_bit <= 8) {
+        /* Data bit[2-9] */
+        if (tx_data & 1) {
+            tx_parity = !tx_parity;
+            data_hi();
+        } else {
+            data_lo();
+        }
+        tx_data >>= 1;
+    } else if (tx_bit == 9) {
+        /* Parity bit */
+        if (tx_parity) { data_hi(); } else { data_lo(); }
+    } else if (tx_bit == 10) {
+        /* Stop bit */
+        data_hi();
+    } else {
+        /* Ack */
+        if (data_in()) {
+            ps2_error = PS2_ERR_NOACK;
+            tx_state = TX_ERROR;
+        } else {
+            tx_state = TX_RESPONSE;
+        }
+    }
+}
+
 ISR(PS2_INT_VECT)
 {
-    static enum {
-        INIT,
-        START,
-        BIT0, BIT1, BIT2, BIT3, BIT4, BIT5, BIT6, BIT7,
-        PARITY,
-        STOP,
-    } state = INIT;
     static uint8_t data = 0;
     static uint8_t parity = 1;
 
-    // TODO: abort if elapse 100us from previous interrupt
-
     // return unless falling edge
     if (clock_in()) {
-        goto RETURN;
+        return;
+    }
+
+    if (tx_state == TX_SENDING) {
+        tx_edge();
+        return;
     }
 
-    state++;
+    uint8_t state = rx_state + 1;
     switch (state) {
-        case START:
+        case RX_START:
             if (data_in())
                 goto ERROR;
+            data = 0;
+            parity = 1;
+            rx_time = timer_read();
             break;
-        case BIT0:
-        case BIT1:
-        case BIT2:
-        case BIT3:
-        case BIT4:
-        case BIT5:
-        case BIT6:
-        case BIT7:
+        case RX_BIT0:
+        case RX_BIT1:
+        case RX_BIT2:
+        case RX_BIT3:
+        case RX_BIT4:
+        case RX_BIT5:
+        case RX_BIT6:
+        case RX_BIT7:
             data >>= 1;
             if (data_in()) {
                 data |= 0x80;
                 parity++;
             }
             break;
-        case PARITY:
+        case RX_PARITY:
             if (data_in()) {
                 if (!(parity & 0x01))
                     goto ERROR;
@@ -199,81 +380,23 @@ ISR(PS2_INT_VECT)
                     goto ERROR;
             }
             break;
-        case STOP:
+        case RX_STOP:
             if (!data_in())
                 goto ERROR;
-            pbuf_enqueue(data);
+            if (tx_state == TX_RESPONSE) {
+                tx_response = data;
+                tx_state = TX_DONE;
+            } else if (!spsc_queue_push(&pbuf, data)) {
+                print("pbuf: full\n");
+            }
             goto DONE;
-            break;
         default:
             goto ERROR;
     }
-    goto RETURN;
+    rx_state = state;
+    return;
 ERROR:
     ps2_error = state;
 DONE:
-    state = INIT;
-    data = 0;
-    parity = 1;
-RETURN:
-    return;
+    rx_state = RX_INIT;
 }
-
-/* send LED state to keyboard */
-void ps2_host_set_led(uint8_t led)
-{
-    ps2_host_send(0xED);
-    ps2_host_send(led);
-}
-
-
-/*--------------------------------------------------------------------
- * Ring buffer to store scan codes from keyboard
- *------------------------------------------------------------------*/
-#define PBUF_SIZE 32
-static uint8_t pbuf[PBUF_SIZE];
-static uint8_t pbuf_head = 0;
-static uint8_t pbuf_tail = 0;
-static inline void pbuf_enqueue(uint8_t data)
-{
-    uint8_t sreg = SREG;
-    cli();
-    uint8_t next = (pbuf_head + 1) % PBUF_SIZE;
-    if (next != pbuf_tail) {
-        pbuf[pbuf_head] = data;
-        pbuf_head = next;
-    } else {
-        print("pbuf: full\n");
-    }
-    SREG = sreg;
-}
-static inline uint8_t pbuf_dequeue(void)
-{
-    uint8_t val = 0;
-
-    uint8_t sreg = SREG;
-    cli();
-    if (pbuf_head != pbuf_tail) {
-        val = pbuf[pbuf_tail];
-        pbuf_tail = (pbuf_tail + 1) % PBUF_SIZE;
-    }
-    SREG = sreg;
-
-    return val;
-}
-static inline bool pbuf_has_data(void)
-{
-    uint8_t sreg = SREG;
-    cli();
-    bool has_data = (pbuf_head != pbuf_tail);
-    SREG = sreg;
-    return has_data;
-}
-static inline void pbuf_clear(void)
-{
-    uint8_t sreg = SREG;
-    cli();
-    pbuf_head = pbuf_tail = 0;
-    SREG = sreg;
-}
-
@@ -38,6 +38,82 @@ static inline void ps2_mouse_scroll_button_task(report_mouse_t *mouse_report);
 
 /* ============================= IMPLEMENTATION ============================ */
 
+#ifdef PS2_USE_INT
+/*
+ * Non-blocking version on top of the interrupt driven host: the power up
+ * delay and the reset are timed with timer_read(), setup commands go through
+ * the host command queue and packets are assembled from whatever bytes have
+ * arrived, so ps2_mouse_task() never waits on the mouse.
+ */
+
+/* bytes per movement packet */
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+#   define PS2_MOUSE_PACKET_SIZE 4
+#else
+#   define PS2_MOUSE_PACKET_SIZE 3
+#endif
+/* ms the mouse may take for BAT after reset */
+#define PS2_MOUSE_BAT_TIMEOUT       1000
+/* ms between two bytes of the same packet before it is dropped */
+#define PS2_MOUSE_PACKET_TIMEOUT    3
+/* ms to wait for the packet after PS2_MOUSE_READ_DATA in remote mode */
+#define PS2_MOUSE_READ_TIMEOUT      50
+
+static enum {
+    PS2_MOUSE_POWER_UP,
+    PS2_MOUSE_RESETTING,
+    PS2_MOUSE_CONFIGURING,
+    PS2_MOUSE_READY,
+} ps2_mouse_state = PS2_MOUSE_POWER_UP;
+static uint16_t ps2_mouse_timer = 0;
+static uint8_t packet[PS2_MOUSE_PACKET_SIZE];
+static uint8_t packet_len = 0;
+static bool read_pending = false;
+
+static void ps2_mouse_command_done(uint8_t response) {
+    if (debug_mouse) xprintf("ps2_mouse: result: %X, error: %X\n", response, ps2_error);
+}
+
+static void ps2_mouse_read_acked(uint8_t response) {
+    if (response != PS2_ACK) {
+        if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
+        read_pending = false;
+    }
+}
+
+static void ps2_mouse_queue(uint8_t command, int16_t value) {
+    uint8_t data[] = { command, (uint8_t)value };
+    ps2_host_send_async(data, value < 0 ? 1 : 2, ps2_mouse_command_done);
+}
+
+static void ps2_mouse_queue_setup(void) {
+#ifdef PS2_MOUSE_USE_REMOTE_MODE
+    ps2_mouse_queue(PS2_MOUSE_SET_REMOTE_MODE, -1);
+    ps2_mouse_mode = PS2_MOUSE_REMOTE_MODE;
+#else
+    ps2_mouse_queue(PS2_MOUSE_ENABLE_DATA_REPORTING, -1);
+#endif
+
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+    ps2_mouse_queue(PS2_MOUSE_SET_SAMPLE_RATE, 200);
+    ps2_mouse_queue(PS2_MOUSE_SET_SAMPLE_RATE, 100);
+    ps2_mouse_queue(PS2_MOUSE_SET_SAMPLE_RATE, 80);
+    // the device ID that follows fails the packet sync check and is dropped
+    ps2_mouse_queue(PS2_MOUSE_GET_DEVICE_ID, -1);
+#endif
+
+#ifdef PS2_MOUSE_USE_2_1_SCALING
+    ps2_mouse_queue(PS2_MOUSE_SET_SCALING_2_1, -1);
+#endif
+}
+
+void ps2_mouse_init(void) {
+    ps2_host_init();
+    // wait for powering up in ps2_mouse_task
+    ps2_mouse_timer = timer_read();
+    ps2_mouse_state = PS2_MOUSE_POWER_UP;
+}
+#else
 /* supports only 3 button mouse at this time */
 void ps2_mouse_init(void) {
     ps2_host_init();
@@ -65,29 +141,15 @@ void ps2_mouse_init(void) {
 
     ps2_mouse_init_user();
 }
+#endif
 
 __attribute__((weak))
 void ps2_mouse_init_user(void) {
 }
 
-void ps2_mouse_task(void) {
+/* sends mouse_report to the host if anything changed and clears it */
+static void ps2_mouse_process_report(void) {
     static uint8_t buttons_prev = 0;
-    extern int tp_buttons;
-
-    /* receives packet from mouse */
-    uint8_t rcv;
-    rcv = ps2_host_send(PS2_MOUSE_READ_DATA);
-    if (rcv == PS2_ACK) {
-        mouse_report.buttons = ps2_host_recv_response() | tp_buttons;
-        mouse_report.x = ps2_host_recv_response() * PS2_MOUSE_X_MULTIPLIER;
-        mouse_report.y = ps2_host_recv_response() * PS2_MOUSE_Y_MULTIPLIER;
-#ifdef PS2_MOUSE_ENABLE_SCROLLING
-        mouse_report.v = -(ps2_host_recv_response() & PS2_MOUSE_SCROLL_MASK) * PS2_MOUSE_V_MULTIPLIER;
-#endif
-    } else {
-        if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
-        return;
-    }
 
     /* if mouse moves or buttons state changes */
     if (mouse_report.x || mouse_report.y || mouse_report.v ||
@@ -111,6 +173,107 @@ void ps2_mouse_task(void) {
     ps2_mouse_clear_report(&mouse_report);
 }
 
+#ifdef PS2_USE_INT
+void ps2_mouse_task(void) {
+    extern int tp_buttons;
+
+    switch (ps2_mouse_state) {
+        case PS2_MOUSE_POWER_UP:
+            if (timer_elapsed(ps2_mouse_timer) >= PS2_MOUSE_INIT_DELAY) {
+                ps2_mouse_queue(PS2_MOUSE_RESET, -1);
+                ps2_mouse_timer = timer_read();
+                packet_len = 0;
+                ps2_mouse_state = PS2_MOUSE_RESETTING;
+            }
+            return;
+        case PS2_MOUSE_RESETTING:
+            // BAT result and device ID follow the ack of the reset
+            while (packet_len < 2) {
+                uint8_t data = ps2_host_recv();
+                if (ps2_error != PS2_ERR_NONE) break;
+                if (debug_mouse) xprintf("ps2_mouse_init: %s %X\n", packet_len ? "DevID" : "BAT", data);
+                packet_len++;
+            }
+            if (packet_len == 2 || timer_elapsed(ps2_mouse_timer) > PS2_MOUSE_BAT_TIMEOUT) {
+                packet_len = 0;
+                ps2_mouse_queue_setup();
+                ps2_mouse_state = PS2_MOUSE_CONFIGURING;
+            }
+            return;
+        case PS2_MOUSE_CONFIGURING:
+            if (!ps2_host_busy()) {
+                ps2_mouse_init_user();
+                ps2_mouse_state = PS2_MOUSE_READY;
+            }
+            return;
+        case PS2_MOUSE_READY:
+            break;
+    }
+
+    /* drop a packet that lost bytes, the next one starts over */
+    if (packet_len && timer_elapsed(ps2_mouse_timer) > PS2_MOUSE_PACKET_TIMEOUT) {
+        packet_len = 0;
+    }
+    if (read_pending && timer_elapsed(ps2_mouse_timer) > PS2_MOUSE_READ_TIMEOUT) {
+        read_pending = false;
+    }
+
+    /* polls the mouse in remote mode, in stream mode it sends on its own */
+    if (ps2_mouse_mode == PS2_MOUSE_REMOTE_MODE && !read_pending && !packet_len) {
+        uint8_t command = PS2_MOUSE_READ_DATA;
+        if (ps2_host_send_async(&command, 1, ps2_mouse_read_acked)) {
+            read_pending = true;
+            ps2_mouse_timer = timer_read();
+        }
+    }
+
+    /* receives packet from mouse */
+    while (packet_len < PS2_MOUSE_PACKET_SIZE) {
+        uint8_t data = ps2_host_recv();
+        if (ps2_error != PS2_ERR_NONE) {
+            return;
+        }
+        // bit 3 of the first byte is always set
+        if (packet_len == 0 && !(data & 0x08)) {
+            continue;
+        }
+        packet[packet_len++] = data;
+        ps2_mouse_timer = timer_read();
+    }
+    packet_len = 0;
+    read_pending = false;
+
+    mouse_report.buttons = packet[0] | tp_buttons;
+    mouse_report.x = packet[1] * PS2_MOUSE_X_MULTIPLIER;
+    mouse_report.y = packet[2] * PS2_MOUSE_Y_MULTIPLIER;
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+    mouse_report.v = -(packet[3] & PS2_MOUSE_SCROLL_MASK) * PS2_MOUSE_V_MULTIPLIER;
+#endif
+    ps2_mouse_process_report();
+}
+#else
+void ps2_mouse_task(void) {
+    extern int tp_buttons;
+
+    /* receives packet from mouse */
+    uint8_t rcv;
+    rcv = ps2_host_send(PS2_MOUSE_READ_DATA);
+    if (rcv == PS2_ACK) {
+        mouse_report.buttons = ps2_host_recv_response() | tp_buttons;
+        mouse_report.x = ps2_host_recv_response() * PS2_MOUSE_X_MULTIPLIER;
+        mouse_report.y = ps2_host_recv_response() * PS2_MOUSE_Y_MULTIPLIER;
+#ifdef PS2_MOUSE_ENABLE_SCROLLING
+        mouse_report.v = -(ps2_host_recv_response() & PS2_MOUSE_SCROLL_MASK) * PS2_MOUSE_V_MULTIPLIER;
+#endif
+    } else {
+        if (debug_mouse) print("ps2_mouse: fail to get mouse packet\n");
+        return;
+    }
+
+    ps2_mouse_process_report();
+}
+#endif
+
 void ps2_mouse_disable_data_reporting(void) {
     PS2_MOUSE_SEND(PS2_MOUSE_DISABLE_DATA_REPORTING, "ps2 mouse disable data reporting");
 }
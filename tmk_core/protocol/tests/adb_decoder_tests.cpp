@@ -0,0 +1,179 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "adb_decoder.h"
+}
+
+struct Edge {
+    bool level;     // line after the edge
+    uint16_t us;    // time at the other level
+};
+
+// Edges of a Talk response as the data line interrupt sees them. Low parts
+// are 35% or 65% of the cell like the Apple IIgs reference, rounded to the
+// 4us resolution of timer_read_raw() at 16MHz.
+static std::vector<Edge> response(uint16_t data, unsigned cell = 100, unsigned stop_low = 65) {
+    std::vector<Edge> edges;
+    unsigned high = 200;    // Tlt, stop to start
+    auto add_cell = [&](bool bit) {
+        unsigned low = (bit ? cell * 35 : cell * 65) / 100;
+        edges.push_back({false, (uint16_t)(high / 4 * 4)});
+        edges.push_back({true, (uint16_t)(low / 4 * 4)});
+        high = cell - low;
+    };
+    add_cell(true);
+    for (int i = 15; i >= 0; i--) {
+        add_cell(data & (1 << i));
+    }
+    edges.push_back({false, (uint16_t)(high / 4 * 4)});
+    edges.push_back({true, (uint16_t)(stop_low / 4 * 4)});
+    return edges;
+}
+
+// Feeds edges until the decoder is no longer busy
+static uint8_t feed(adb_decoder_t *decoder, const std::vector<Edge>& edges, size_t *used = nullptr) {
+    size_t i = 0;
+    uint8_t result = ADB_DECODER_BUSY;
+    while (i < edges.size() && result == ADB_DECODER_BUSY) {
+        result = adb_decoder_edge(decoder, edges[i].level, edges[i].us);
+        i++;
+    }
+    if (used) {
+        *used = i;
+    }
+    return result;
+}
+
+TEST(AdbDecoder, DecodesKeyboardResponse) {
+    adb_decoder_t decoder;
+    adb_decoder_init(&decoder);
+    size_t used;
+    EXPECT_EQ(feed(&decoder, response(0x3880), &used), ADB_DECODER_DONE);
+    EXPECT_EQ(used, response(0x3880).size());
+    EXPECT_EQ(decoder.data, 0x3880);
+}
+
+TEST(AdbDecoder, DecodesAllBitPatterns) {
+    for (uint16_t data : {0x0000, 0xFFFF, 0xAAAA, 0x5555, 0x7FFF, 0x8001}) {
+        adb_decoder_t decoder;
+        adb_decoder_init(&decoder);
+        ASSERT_EQ(feed(&decoder, response(data)), ADB_DECODER_DONE) << std::hex << data;
+        EXPECT_EQ(decoder.data, data);
+    }
+}
+
+TEST(AdbDecoder, AcceptsSlowAndFastDevices) {
+    for (unsigned cell : {70, 130}) {
+        adb_decoder_t decoder;
+        adb_decoder_init(&decoder);
+        ASSERT_EQ(feed(&decoder, response(0x2C81, cell)), ADB_DECODER_DONE) << cell;
+        EXPECT_EQ(decoder.data, 0x2C81);
+    }
+}
+
+TEST(AdbDecoder, DecodesCapturedJitter) {
+    // 0x0E8E from a keyboard with cells between 92 and 108us
+    const std::vector<Edge> edges = {
+        {false, 212}, {true, 36}, {false, 60},      // start
+        {true, 64}, {false, 36}, {true, 60}, {false, 40},
+        {true, 68}, {false, 32}, {true, 64}, {false, 36},
+        {true, 32}, {false, 64}, {true, 36}, {false, 68},
+        {true, 40}, {false, 60}, {true, 64}, {false, 36},
+        {true, 36}, {false, 60}, {true, 60}, {false, 40},
+        {true, 68}, {false, 32}, {true, 64}, {false, 36},
+        {true, 32}, {false, 68}, {true, 36}, {false, 60},
+        {true, 36}, {false, 64}, {true, 64}, {false, 36},
+        {true, 64},                                 // stop
+    };
+    adb_decoder_t decoder;
+    adb_decoder_init(&decoder);
+    EXPECT_EQ(feed(&decoder, edges), ADB_DECODER_DONE);
+    EXPECT_EQ(decoder.data, 0x0E8E);
+}
+
+TEST(AdbDecoder, AcceptsServiceRequestOnStopBit) {
+    adb_decoder_t decoder;
+    adb_decoder_init(&decoder);
+    EXPECT_EQ(feed(&decoder, response(0x1234, 100, 300)), ADB_DECODER_DONE);
+    EXPECT_EQ(decoder.data, 0x1234);
+}
+
+TEST(AdbDecoder, RejectsZeroStartBit) {
+    auto edges = response(0x1234);
+    // swap the low and high part of the start bit cell
+    std::swap(edges[1].us, edges[2].us);
+    adb_decoder_t decoder;
+    adb_decoder_init(&decoder);
+    EXPECT_EQ(feed(&decoder, edges), ADB_DECODER_ERROR);
+}
+
+TEST(AdbDecoder, RejectsStretchedCell) {
+    auto edges = response(0x1234);
+    edges[10].us = 400;
+    adb_decoder_t decoder;
+    adb_decoder_init(&decoder);
+    size_t used;
+    EXPECT_EQ(feed(&decoder, edges, &used), ADB_DECODER_ERROR);
+    EXPECT_EQ(used, 11u);
+}
+
+TEST(AdbDecoder, IgnoresRepeatedLevel) {
+    auto edges = response(0x4321);
+    edges.insert(edges.begin() + 5, edges[4]);
+    adb_decoder_t decoder;
+    adb_decoder_init(&decoder);
+    EXPECT_EQ(feed(&decoder, edges), ADB_DECODER_DONE);
+    EXPECT_EQ(decoder.data, 0x4321);
+}
+
+TEST(AdbTalkTurn, KeyboardAloneGetsEveryTalk) {
+    adb_talk_turn_t turn;
+    adb_talk_turn_init(&turn);
+    for (int i = 0; i < 3; i++) {
+        adb_talk_turn_request(&turn, 0);
+        EXPECT_EQ(adb_talk_turn_next(&turn), 0);
+    }
+    EXPECT_EQ(adb_talk_turn_next(&turn), ADB_TALK_NONE);
+}
+
+TEST(AdbTalkTurn, KeyboardAndMouseTakeTurns) {
+    adb_talk_turn_t turn;
+    adb_talk_turn_init(&turn);
+    int talks[ADB_TALK_DEVICES] = { 0 };
+    bool busy = false;
+    // every scan polls the keyboard, then the mouse, and the bus is free
+    // for one new Talk every other scan
+    for (int scan = 0; scan < 20; scan++) {
+        for (uint8_t device = 0; device < ADB_TALK_DEVICES; device++) {
+            adb_talk_turn_request(&turn, device);
+            if (!busy) {
+                uint8_t next = adb_talk_turn_next(&turn);
+                ASSERT_NE(next, ADB_TALK_NONE);
+                talks[next]++;
+                busy = true;
+            }
+        }
+        if (scan % 2) {
+            busy = false;
+        }
+    }
+    EXPECT_EQ(talks[0], 5);
+    EXPECT_EQ(talks[1], 5);
+}
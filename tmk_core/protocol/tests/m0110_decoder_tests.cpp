@@ -0,0 +1,130 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "m0110_decoder.h"
+}
+
+using Keys = std::vector<uint8_t>;
+
+class M0110Decoder : public testing::Test {
+protected:
+    m0110_decoder_t decoder;
+
+    void SetUp() override {
+        m0110_decoder_init(&decoder);
+    }
+
+    // Scan codes completed by each raw byte, as polled with INSTANT
+    std::vector<Keys> feed(const Keys& raws) {
+        std::vector<Keys> result;
+        for (uint8_t raw : raws) {
+            uint8_t keys[M0110_DECODER_MAX_KEYS];
+            uint8_t count = m0110_decoder_raw(&decoder, raw, keys);
+            result.push_back(Keys(keys, keys + count));
+        }
+        return result;
+    }
+};
+
+static const uint8_t shift_down = 0x71;
+static const uint8_t shift_up = 0xF1;
+static const uint8_t up_down = 0x1B;
+static const uint8_t up_up = 0x9B;
+// scan codes
+static const uint8_t shift = 0x38;
+static const uint8_t arrow_up = 0x0D | M0110_KEYPAD_OFFSET;
+static const uint8_t calc_up = 0x0D | M0110_CALC_OFFSET;
+
+TEST_F(M0110Decoder, NormalKeys) {
+    EXPECT_EQ(feed({0x07, 0x87}), (std::vector<Keys>{{0x03}, {0x83}}));
+}
+
+TEST_F(M0110Decoder, NullAndErrorPassThrough) {
+    EXPECT_EQ(feed({M0110_NULL, M0110_ERROR}), (std::vector<Keys>{{}, {M0110_ERROR}}));
+}
+
+TEST_F(M0110Decoder, KeypadKey) {
+    EXPECT_EQ(feed({M0110_KEYPAD, 0x2B}), (std::vector<Keys>{{}, {0x15 | M0110_KEYPAD_OFFSET}}));
+    EXPECT_FALSE(m0110_decoder_pending(&decoder));
+}
+
+TEST_F(M0110Decoder, ArrowReleaseAlsoReleasesCalc) {
+    // Case B
+    EXPECT_EQ(feed({M0110_KEYPAD, up_up}), (std::vector<Keys>{{}, {0x80 | arrow_up, 0x80 | calc_up}}));
+}
+
+TEST_F(M0110Decoder, ShiftWithNormalKey) {
+    EXPECT_EQ(feed({shift_down, 0x07}), (std::vector<Keys>{{}, {shift, 0x03}}));
+}
+
+TEST_F(M0110Decoder, ShiftTwice) {
+    // Case 5: 71, 71, 79, DD
+    EXPECT_EQ(feed({shift_down, shift_down, M0110_KEYPAD, up_down}),
+              (std::vector<Keys>{{}, {shift}, {}, {calc_up & ~0x80}}));
+}
+
+TEST_F(M0110Decoder, ShiftDownArrowDownIsCalc) {
+    // Case 1
+    EXPECT_EQ(feed({shift_down, M0110_KEYPAD, up_down}), (std::vector<Keys>{{}, {}, {calc_up}}));
+}
+
+TEST_F(M0110Decoder, ShiftDownArrowUp) {
+    // Case 2
+    EXPECT_EQ(feed({shift_down, M0110_KEYPAD, up_up}),
+              (std::vector<Keys>{{}, {}, {0x80 | arrow_up, 0x80 | calc_up}}));
+}
+
+TEST_F(M0110Decoder, ShiftUpArrowDownIgnoresArrow) {
+    // Case 3
+    EXPECT_EQ(feed({shift_up, M0110_KEYPAD, up_down}), (std::vector<Keys>{{}, {}, {0x80 | shift}}));
+}
+
+TEST_F(M0110Decoder, ShiftUpArrowUpReleasesAll) {
+    // Case 4
+    EXPECT_EQ(feed({shift_up, M0110_KEYPAD, up_up}),
+              (std::vector<Keys>{{}, {}, {0x80 | arrow_up, 0x80 | calc_up, 0x80 | shift}}));
+}
+
+TEST_F(M0110Decoder, ShiftWithKeypadKey) {
+    EXPECT_EQ(feed({shift_down, M0110_KEYPAD, 0x2B}),
+              (std::vector<Keys>{{}, {}, {shift, 0x15 | M0110_KEYPAD_OFFSET}}));
+}
+
+TEST_F(M0110Decoder, LoneShiftIsSentOnNull) {
+    // Case D
+    EXPECT_EQ(feed({shift_down, M0110_NULL, shift_up, M0110_NULL}),
+              (std::vector<Keys>{{}, {shift}, {}, {0x80 | shift}}));
+    EXPECT_FALSE(m0110_decoder_pending(&decoder));
+}
+
+TEST_F(M0110Decoder, NullAfterShiftKeypadSendsShift) {
+    EXPECT_EQ(feed({shift_up, M0110_KEYPAD, M0110_NULL}),
+              (std::vector<Keys>{{}, {}, {0x80 | shift}}));
+    EXPECT_FALSE(m0110_decoder_pending(&decoder));
+}
+
+TEST_F(M0110Decoder, KeypadWaitsForLateByte) {
+    EXPECT_EQ(feed({M0110_KEYPAD, M0110_NULL, 0x2B}),
+              (std::vector<Keys>{{}, {}, {0x15 | M0110_KEYPAD_OFFSET}}));
+}
+
+TEST_F(M0110Decoder, ErrorAbortsSequence) {
+    EXPECT_EQ(feed({shift_down, M0110_ERROR, 0x07}), (std::vector<Keys>{{}, {M0110_ERROR}, {0x03}}));
+}
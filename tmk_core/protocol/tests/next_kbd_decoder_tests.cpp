@@ -0,0 +1,122 @@
+/* Copyright 2018 QMK
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "gtest/gtest.h"
+#include <vector>
+
+extern "C" {
+#include "next_kbd_decoder.h"
+}
+
+struct Edge {
+    bool level;     // line after the edge
+    uint16_t us;    // time at the other level
+};
+
+// Edges of a response sent with bit_us wide bits, rounded to the 4us
+// resolution of timer_read_raw() at 16MHz. The run of trailing ones has no
+// edge, the line just stays high.
+static std::vector<Edge> response(uint32_t data, double bit_us = NEXT_KBD_TIMING) {
+    std::vector<Edge> edges;
+    edges.push_back({false, 1000});     // idle before the response
+    bool level = false;
+    unsigned run = 0;
+    for (int i = 0; i < NEXT_KBD_DECODER_BITS; i++) {
+        bool bit = data & (1UL << i);
+        if (bit != level) {
+            edges.push_back({bit, (uint16_t)((unsigned)(run * bit_us) / 4 * 4)});
+            level = bit;
+            run = 0;
+        }
+        run++;
+    }
+    if (!level) {
+        edges.push_back({true, (uint16_t)((unsigned)(run * bit_us) / 4 * 4)});
+    }
+    return edges;
+}
+
+static uint8_t feed(next_kbd_decoder_t *decoder, const std::vector<Edge>& edges) {
+    uint8_t result = NEXT_KBD_DECODER_BUSY;
+    for (size_t i = 0; i < edges.size() && result == NEXT_KBD_DECODER_BUSY; i++) {
+        result = next_kbd_decoder_edge(decoder, edges[i].level, edges[i].us);
+    }
+    return result;
+}
+
+// What next_kbd_recv() does: edges, then the idle line ends the frame
+static uint32_t decode(const std::vector<Edge>& edges) {
+    next_kbd_decoder_t decoder;
+    next_kbd_decoder_init(&decoder);
+    uint8_t result = feed(&decoder, edges);
+    if (result == NEXT_KBD_DECODER_BUSY) {
+        result = next_kbd_decoder_idle(&decoder);
+    }
+    EXPECT_EQ(result, NEXT_KBD_DECODER_DONE);
+    return decoder.data;
+}
+
+TEST(NextKbdDecoder, DecodesIdleFrame) {
+    EXPECT_EQ(decode(response(NEXT_KBD_KMBUS_IDLE)), (uint32_t)NEXT_KBD_KMBUS_IDLE);
+}
+
+TEST(NextKbdDecoder, DecodesKeyFrames) {
+    // key 0x25 down and up with Command held
+    for (uint32_t data : {0x300C4AUL, 0x300CCAUL, 0x3006CAUL, 0x1FFFFEUL, 0x2AAAAAUL}) {
+        EXPECT_EQ(decode(response(data)), data) << std::hex << data;
+    }
+}
+
+TEST(NextKbdDecoder, FrameEndingLowIsDoneWithoutIdle) {
+    next_kbd_decoder_t decoder;
+    next_kbd_decoder_init(&decoder);
+    EXPECT_EQ(feed(&decoder, response(0x0C4A)), NEXT_KBD_DECODER_DONE);
+    EXPECT_EQ(decoder.data, 0x0C4AUL);
+}
+
+TEST(NextKbdDecoder, FollowsDriftingKeyboardClock) {
+    // sampling at fixed 50us points was off by a bit at the end of the
+    // second byte with clocks like these, the run of eight zeros needs the
+    // bit time measured on the shorter runs before it
+    for (double bit_us : {46.0, 54.0}) {
+        EXPECT_EQ(decode(response(0x300CCA, bit_us)), 0x300CCAUL) << bit_us;
+    }
+}
+
+TEST(NextKbdDecoder, DecodesCapturedFrame) {
+    // 0x300C4A with a keyboard running 4% slow
+    const std::vector<Edge> edges = {
+        {false, 2412},
+        {true, 52}, {false, 52}, {true, 52}, {false, 52},
+        {true, 104}, {false, 52}, {true, 156}, {false, 104},
+        {true, 416},
+    };
+    EXPECT_EQ(decode(edges), 0x300C4AUL);
+}
+
+TEST(NextKbdDecoder, IdleBeforeStartIsNotAFrame) {
+    next_kbd_decoder_t decoder;
+    next_kbd_decoder_init(&decoder);
+    EXPECT_EQ(next_kbd_decoder_idle(&decoder), NEXT_KBD_DECODER_BUSY);
+}
+
+TEST(NextKbdDecoder, RejectsGlitch) {
+    auto edges = response(NEXT_KBD_KMBUS_IDLE);
+    edges[2].us = 12;
+    next_kbd_decoder_t decoder;
+    next_kbd_decoder_init(&decoder);
+    EXPECT_EQ(feed(&decoder, edges), NEXT_KBD_DECODER_ERROR);
+}
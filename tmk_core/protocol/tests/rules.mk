@@ -0,0 +1,22 @@
+PROTOCOL_PATH := $(TMK_PATH)/protocol
+
+adb_decoder_SRC :=\
+	$(PROTOCOL_PATH)/tests/adb_decoder_tests.cpp \
+	$(PROTOCOL_PATH)/adb_decoder.c
+
+adb_decoder_INC :=\
+	$(PROTOCOL_PATH)
+
+m0110_decoder_SRC :=\
+	$(PROTOCOL_PATH)/tests/m0110_decoder_tests.cpp \
+	$(PROTOCOL_PATH)/m0110_decoder.c
+
+m0110_decoder_INC :=\
+	$(PROTOCOL_PATH)
+
+next_kbd_decoder_SRC :=\
+	$(PROTOCOL_PATH)/tests/next_kbd_decoder_tests.cpp \
+	$(PROTOCOL_PATH)/next_kbd_decoder.c
+
+next_kbd_decoder_INC :=\
+	$(PROTOCOL_PATH)
@@ -0,0 +1 @@
+TEST_LIST += adb_decoder m0110_decoder next_kbd_decoder